@@ -0,0 +1,222 @@
+//***************************************************************************************
+// Benchmark.cpp
+//***************************************************************************************
+
+#include "Benchmark.h"
+
+#include <iomanip>
+#include <Psapi.h>
+
+#pragma comment(lib, "psapi.lib")
+
+using namespace DirectX;
+
+namespace
+{
+	std::string WStringToUtf8(const std::wstring& str)
+	{
+		if(str.empty())
+			return std::string();
+
+		int size = WideCharToMultiByte(CP_UTF8, 0, str.c_str(), (int)str.size(), nullptr, 0, nullptr, nullptr);
+		std::string result(size, '\0');
+		WideCharToMultiByte(CP_UTF8, 0, str.c_str(), (int)str.size(), &result[0], size, nullptr, nullptr);
+		return result;
+	}
+
+	std::string JsonString(const std::string& str)
+	{
+		std::string result = "\"";
+		for(char c : str)
+		{
+			if(c == '"' || c == '\\')
+				result += '\\';
+			result += c;
+		}
+		return result + "\"";
+	}
+
+	// Nearest-rank percentile of an ascending list.
+	float Percentile(const std::vector<float>& sorted, UINT percent)
+	{
+		size_t rank = (sorted.size() * percent + 99) / 100;
+		return sorted[MathHelper::Clamp(rank, (size_t)1, sorted.size()) - 1];
+	}
+}
+
+void BenchmarkSettings::Parse(CommandLine& args)
+{
+	Enabled = args.HasFlag("-benchmark");
+
+	args.GetUint("-frames", 1, UINT_MAX, FrameCount);
+	args.GetUint("-warmup", 0, UINT_MAX, WarmupFrames);
+	args.GetUint("-scale", 1, 100000, SceneScale);
+	args.GetFloat("-step", 0.0001f, 1.0f, TimeStep);
+
+	std::string path;
+	if(args.GetString("-path", path))
+	{
+		if(path == "orbit")
+			Path = CameraPathType::Orbit;
+		else if(path == "flythrough")
+			Path = CameraPathType::Flythrough;
+		else
+			args.SetInvalidValue("-path", path);
+	}
+
+	std::string file;
+	if(args.GetString("-report", file))
+		ReportFile = AnsiToWString(file);
+}
+
+void EvaluateCameraPath(CameraPathType path, float t, float sceneRadius, XMFLOAT3& eye, XMFLOAT3& target)
+{
+	if(path == CameraPathType::Orbit)
+	{
+		// One revolution every 30 seconds, looking at the center.
+		const float angle = XM_2PI * t / 30.0f;
+
+		eye = XMFLOAT3(1.1f*sceneRadius*cosf(angle), 0.45f*sceneRadius, 1.1f*sceneRadius*sinf(angle));
+		target = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		return;
+	}
+
+	// Closed loop through the scene, in units of sceneRadius, flown once every 40
+	// seconds while looking half a second ahead.
+	static const XMFLOAT3 keys[] =
+	{
+		{ -0.9f, 0.15f, -0.9f },
+		{  0.0f, 0.08f, -0.6f },
+		{  0.8f, 0.20f, -0.7f },
+		{  0.7f, 0.12f,  0.1f },
+		{  0.6f, 0.30f,  0.8f },
+		{ -0.2f, 0.10f,  0.7f },
+		{ -0.8f, 0.25f,  0.2f }
+	};
+	const int keyCount = _countof(keys);
+	const float period = 40.0f;
+
+	auto evaluate = [&](float time)
+	{
+		float u = fmodf(time, period) / period * keyCount;
+		int i = (int)u;
+
+		XMVECTOR p0 = XMLoadFloat3(&keys[(i + keyCount - 1) % keyCount]);
+		XMVECTOR p1 = XMLoadFloat3(&keys[i % keyCount]);
+		XMVECTOR p2 = XMLoadFloat3(&keys[(i + 1) % keyCount]);
+		XMVECTOR p3 = XMLoadFloat3(&keys[(i + 2) % keyCount]);
+
+		return XMVectorScale(XMVectorCatmullRom(p0, p1, p2, p3, u - i), sceneRadius);
+	};
+
+	XMStoreFloat3(&eye, evaluate(t));
+	XMStoreFloat3(&target, evaluate(t + 0.5f));
+}
+
+BenchmarkRecorder::BenchmarkRecorder(const BenchmarkSettings& settings) :
+	mSettings(settings)
+{
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	mCpuFrequency = frequency.QuadPart;
+
+	mFrameMs.reserve(mSettings.FrameCount);
+}
+
+void BenchmarkRecorder::EndFrame(UINT drawCalls, UINT64 uploadBytes, UINT64 gpuMemoryBytes)
+{
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+
+	INT64 prev = mPrevFrameTime;
+	mPrevFrameTime = now.QuadPart;
+
+	// The first frame has nothing to measure against.
+	if(mFramesSeen++ <= mSettings.WarmupFrames || IsDone())
+		return;
+
+	mFrameMs.push_back((float)((now.QuadPart - prev) * 1000.0 / mCpuFrequency));
+
+	mTotalDrawCalls += drawCalls;
+	mMaxDrawCalls = MathHelper::Max(mMaxDrawCalls, drawCalls);
+	mTotalUploadBytes += uploadBytes;
+	mMaxUploadBytes = MathHelper::Max(mMaxUploadBytes, uploadBytes);
+	mPeakGpuMemory = MathHelper::Max(mPeakGpuMemory, gpuMemoryBytes);
+}
+
+bool BenchmarkRecorder::IsDone()const
+{
+	return mFrameMs.size() >= mSettings.FrameCount;
+}
+
+std::string BenchmarkRecorder::GetReport(const std::wstring& adapterName, UINT objectCount)const
+{
+	std::vector<float> sorted = mFrameMs;
+	std::sort(sorted.begin(), sorted.end());
+
+	const size_t frames = sorted.size();
+	double totalMs = 0.0;
+	for(float ms : sorted)
+		totalMs += ms;
+
+	PROCESS_MEMORY_COUNTERS memory = {};
+	memory.cb = sizeof(memory);
+	GetProcessMemoryInfo(GetCurrentProcess(), &memory, sizeof(memory));
+
+	std::ostringstream report;
+	report << std::fixed << std::setprecision(3);
+	report << "{\n";
+	report << "  \"adapter\": " << JsonString(WStringToUtf8(adapterName)) << ",\n";
+	report << "  \"path\": \"" << (mSettings.Path == CameraPathType::Orbit ? "orbit" : "flythrough") << "\",\n";
+	report << "  \"scene_scale\": " << mSettings.SceneScale << ",\n";
+	report << "  \"objects\": " << objectCount << ",\n";
+	report << "  \"time_step\": " << mSettings.TimeStep << ",\n";
+	report << "  \"warmup_frames\": " << mSettings.WarmupFrames << ",\n";
+	report << "  \"frames\": " << frames << ",\n";
+
+	report << "  \"frame_ms\": { ";
+	if(frames > 0)
+	{
+		report << "\"min\": " << sorted.front()
+			<< ", \"avg\": " << totalMs / frames
+			<< ", \"p50\": " << Percentile(sorted, 50)
+			<< ", \"p90\": " << Percentile(sorted, 90)
+			<< ", \"p95\": " << Percentile(sorted, 95)
+			<< ", \"p99\": " << Percentile(sorted, 99)
+			<< ", \"max\": " << sorted.back() << " ";
+	}
+	report << "},\n";
+
+	report << "  \"draws_per_frame\": { \"avg\": " << (frames > 0 ? (double)mTotalDrawCalls / frames : 0.0)
+		<< ", \"max\": " << mMaxDrawCalls << " },\n";
+	report << "  \"upload_bytes_per_frame\": { \"avg\": " << (frames > 0 ? (double)mTotalUploadBytes / frames : 0.0)
+		<< ", \"max\": " << mMaxUploadBytes << " },\n";
+
+	report << "  \"peak_working_set_bytes\": " << (UINT64)memory.PeakWorkingSetSize << ",\n";
+	report << "  \"peak_commit_bytes\": " << (UINT64)memory.PeakPagefileUsage << ",\n";
+	report << "  \"peak_gpu_local_bytes\": " << mPeakGpuMemory << "\n";
+	report << "}\n";
+
+	return report.str();
+}
+
+bool BenchmarkRecorder::WriteReport(const std::wstring& adapterName, UINT objectCount)const
+{
+	std::string report = GetReport(adapterName, objectCount);
+
+	// Also echo to the console the benchmark was started from, if any, so a
+	// script can capture stdout instead of reading the file.
+	if(AttachConsole(ATTACH_PARENT_PROCESS))
+	{
+		DWORD written = 0;
+		WriteFile(GetStdHandle(STD_OUTPUT_HANDLE), report.data(), (DWORD)report.size(), &written, nullptr);
+		FreeConsole();
+	}
+
+	std::ofstream fout(mSettings.ReportFile);
+	if(!fout)
+		return false;
+
+	fout << report;
+	return true;
+}
@@ -0,0 +1,84 @@
+//***************************************************************************************
+// Benchmark.h
+//
+// Command line driven benchmark mode.  The app replays a scripted camera path at a
+// fixed GameTimer step for a fixed number of frames, then writes a JSON report of
+// frame time percentiles, draw calls, upload bytes and peak memory so runs on
+// different builds and machines can be compared directly.
+//
+// Usage: -benchmark [-frames N] [-warmup N] [-scale N] [-path orbit|flythrough]
+//                   [-step seconds] [-report file]
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "CommandLine.h"
+
+enum class CameraPathType
+{
+	Orbit,
+	Flythrough
+};
+
+struct BenchmarkSettings
+{
+	bool Enabled = false;
+
+	// Frames measured, after WarmupFrames unmeasured ones.
+	UINT FrameCount = 1000;
+	UINT WarmupFrames = 60;
+
+	// Number of copies of the scene to draw.
+	UINT SceneScale = 1;
+
+	CameraPathType Path = CameraPathType::Orbit;
+
+	// Simulated seconds per frame.
+	float TimeStep = 1.0f / 60.0f;
+
+	std::wstring ReportFile = L"benchmark.json";
+
+	// Reads the benchmark options; see the usage line above.
+	void Parse(CommandLine& args);
+};
+
+// Eye position and look-at target at time t of a looping path around a scene
+// centered on the origin that fits in a sphere of the given radius.
+void EvaluateCameraPath(CameraPathType path, float t, float sceneRadius,
+	DirectX::XMFLOAT3& eye, DirectX::XMFLOAT3& target);
+
+class BenchmarkRecorder
+{
+public:
+	BenchmarkRecorder(const BenchmarkSettings& settings);
+	BenchmarkRecorder(const BenchmarkRecorder& rhs) = delete;
+	BenchmarkRecorder& operator=(const BenchmarkRecorder& rhs) = delete;
+	~BenchmarkRecorder() = default;
+
+	// Call once at the end of every frame.  Frame time is the wall time since the
+	// previous call; warmup frames are not recorded.
+	void EndFrame(UINT drawCalls, UINT64 uploadBytes, UINT64 gpuMemoryBytes);
+
+	// True once FrameCount frames have been recorded.
+	bool IsDone()const;
+
+	// The report as a single JSON object.
+	std::string GetReport(const std::wstring& adapterName, UINT objectCount)const;
+
+	bool WriteReport(const std::wstring& adapterName, UINT objectCount)const;
+
+private:
+	BenchmarkSettings mSettings;
+
+	INT64 mCpuFrequency = 1;
+	INT64 mPrevFrameTime = 0;
+	UINT mFramesSeen = 0;
+
+	std::vector<float> mFrameMs;
+	UINT64 mTotalDrawCalls = 0;
+	UINT mMaxDrawCalls = 0;
+	UINT64 mTotalUploadBytes = 0;
+	UINT64 mMaxUploadBytes = 0;
+	UINT64 mPeakGpuMemory = 0;
+};
@@ -0,0 +1,236 @@
+//***************************************************************************************
+// BoundingVolumeHierarchy.cpp
+//***************************************************************************************
+
+#include "BoundingVolumeHierarchy.h"
+
+#include <algorithm>
+#include <cfloat>
+
+using namespace DirectX;
+
+namespace
+{
+	// Objects tested one by one once a node holds this few.
+	const unsigned int MaxLeafObjects = 4;
+
+	// Median splits keep the depth at log2 of the object count, and the traversal
+	// stack never holds more than one entry per level.
+	const unsigned int MaxDepth = 64;
+}
+
+void BoundingVolumeHierarchy::Build(const std::vector<BoundingBox>& bounds)
+{
+	const unsigned int count = (unsigned int)bounds.size();
+
+	mNodes.clear();
+	mObjects.resize(count);
+	mLeafOf.assign(count, 0);
+	mArea = 0.0f;
+
+	for(unsigned int i = 0; i < count; ++i)
+		mObjects[i] = i;
+
+	if(count > 0)
+	{
+		std::vector<XMFLOAT3> centers(count);
+		for(unsigned int i = 0; i < count; ++i)
+			centers[i] = bounds[i].Center;
+
+		mNodes.reserve(2*count);
+		BuildNode(0, 0, count, bounds, centers);
+	}
+
+	mNodeQueued.assign(mNodes.size(), 0);
+	mBuiltArea = mArea;
+}
+
+unsigned int BoundingVolumeHierarchy::BuildNode(unsigned int parent, unsigned int first, unsigned int count,
+	const std::vector<BoundingBox>& bounds, std::vector<XMFLOAT3>& centers)
+{
+	const unsigned int index = (unsigned int)mNodes.size();
+	mNodes.emplace_back();
+	mNodes[index].Box = BoundingBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 0.0f));
+	mNodes[index].First = first;
+	mNodes[index].Count = count;
+	mNodes[index].Parent = parent;
+
+	if(count <= MaxLeafObjects)
+	{
+		for(unsigned int i = first; i < first + count; ++i)
+			mLeafOf[mObjects[i]] = index;
+
+		UpdateNodeBox(index, bounds);
+		return index;
+	}
+
+	// Split at the median center along the axis the centers spread the most.
+	XMFLOAT3 lo = centers[mObjects[first]];
+	XMFLOAT3 hi = lo;
+	for(unsigned int i = first + 1; i < first + count; ++i)
+	{
+		const XMFLOAT3& c = centers[mObjects[i]];
+		lo = XMFLOAT3(std::min(lo.x, c.x), std::min(lo.y, c.y), std::min(lo.z, c.z));
+		hi = XMFLOAT3(std::max(hi.x, c.x), std::max(hi.y, c.y), std::max(hi.z, c.z));
+	}
+
+	const float spread[3] = { hi.x - lo.x, hi.y - lo.y, hi.z - lo.z };
+	const int axis = (spread[0] >= spread[1] && spread[0] >= spread[2]) ? 0 : (spread[1] >= spread[2] ? 1 : 2);
+
+	const unsigned int half = count / 2;
+	std::nth_element(mObjects.begin() + first, mObjects.begin() + first + half, mObjects.begin() + first + count,
+		[&centers, axis](unsigned int a, unsigned int b)
+	{
+		return (&centers[a].x)[axis] < (&centers[b].x)[axis];
+	});
+
+	BuildNode(index, first, half, bounds, centers);
+	mNodes[index].Right = BuildNode(index, first + half, count - half, bounds, centers);
+
+	UpdateNodeBox(index, bounds);
+	return index;
+}
+
+void BoundingVolumeHierarchy::UpdateNodeBox(unsigned int index, const std::vector<BoundingBox>& bounds)
+{
+	Node& node = mNodes[index];
+
+	BoundingBox box;
+	if(node.Right == 0)
+	{
+		box = bounds[mObjects[node.First]];
+		for(unsigned int i = node.First + 1; i < node.First + node.Count; ++i)
+			BoundingBox::CreateMerged(box, box, bounds[mObjects[i]]);
+	}
+	else
+	{
+		BoundingBox::CreateMerged(box, mNodes[index + 1].Box, mNodes[node.Right].Box);
+	}
+
+	mArea += SurfaceArea(box) - SurfaceArea(node.Box);
+	node.Box = box;
+}
+
+void BoundingVolumeHierarchy::Refit(const std::vector<unsigned int>& objects, const std::vector<BoundingBox>& bounds)
+{
+	// Queue every changed leaf and its ancestors once; an ancestor that is already
+	// queued has all of its own ancestors queued too.
+	mRefitNodes.clear();
+	for(unsigned int object : objects)
+	{
+		unsigned int node = mLeafOf[object];
+		while(!mNodeQueued[node])
+		{
+			mNodeQueued[node] = 1;
+			mRefitNodes.push_back(node);
+			if(node == 0)
+				break;
+			node = mNodes[node].Parent;
+		}
+	}
+
+	// Children come after their parent in depth-first order, so refitting from the
+	// highest index down updates both children before the parent reads them.
+	std::sort(mRefitNodes.begin(), mRefitNodes.end(), [](unsigned int a, unsigned int b) { return a > b; });
+	for(unsigned int node : mRefitNodes)
+	{
+		UpdateNodeBox(node, bounds);
+		mNodeQueued[node] = 0;
+	}
+}
+
+bool BoundingVolumeHierarchy::NeedsRebuild()const
+{
+	return mArea > 2.0f*mBuiltArea;
+}
+
+void BoundingVolumeHierarchy::QueryFrustum(const BoundingFrustum& frustum, const std::vector<BoundingBox>& bounds,
+	std::vector<unsigned int>& objects)const
+{
+	if(mNodes.empty())
+		return;
+
+	unsigned int stack[MaxDepth];
+	unsigned int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while(stackSize > 0)
+	{
+		const unsigned int index = stack[--stackSize];
+		const Node& node = mNodes[index];
+
+		ContainmentType containment = frustum.Contains(node.Box);
+		if(containment == DISJOINT)
+			continue;
+
+		// Everything below a node inside the frustum is visible.
+		if(containment == CONTAINS)
+		{
+			objects.insert(objects.end(), mObjects.begin() + node.First, mObjects.begin() + node.First + node.Count);
+			continue;
+		}
+
+		if(node.Right == 0)
+		{
+			for(unsigned int i = node.First; i < node.First + node.Count; ++i)
+			{
+				if(frustum.Intersects(bounds[mObjects[i]]))
+					objects.push_back(mObjects[i]);
+			}
+			continue;
+		}
+
+		stack[stackSize++] = node.Right;
+		stack[stackSize++] = index + 1;
+	}
+}
+
+bool BoundingVolumeHierarchy::RayCast(FXMVECTOR origin, FXMVECTOR direction, const std::vector<BoundingBox>& bounds,
+	unsigned int& object, float& distance)const
+{
+	bool hit = false;
+	float nearest = FLT_MAX;
+
+	unsigned int stack[MaxDepth];
+	unsigned int stackSize = 0;
+	if(!mNodes.empty())
+		stack[stackSize++] = 0;
+
+	while(stackSize > 0)
+	{
+		const unsigned int index = stack[--stackSize];
+		const Node& node = mNodes[index];
+
+		// Subtrees that start behind the nearest hit so far cannot hold a nearer one.
+		float entry;
+		if(!node.Box.Intersects(origin, direction, entry) || entry >= nearest)
+			continue;
+
+		if(node.Right == 0)
+		{
+			for(unsigned int i = node.First; i < node.First + node.Count; ++i)
+			{
+				float d;
+				if(bounds[mObjects[i]].Intersects(origin, direction, d) && d < nearest)
+				{
+					nearest = d;
+					object = mObjects[i];
+					hit = true;
+				}
+			}
+			continue;
+		}
+
+		stack[stackSize++] = node.Right;
+		stack[stackSize++] = index + 1;
+	}
+
+	distance = nearest;
+	return hit;
+}
+
+float BoundingVolumeHierarchy::SurfaceArea(const BoundingBox& box)
+{
+	const XMFLOAT3& e = box.Extents;
+	return 8.0f*(e.x*e.y + e.y*e.z + e.z*e.x);
+}
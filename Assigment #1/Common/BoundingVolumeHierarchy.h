@@ -0,0 +1,86 @@
+//***************************************************************************************
+// BoundingVolumeHierarchy.h
+//
+// Axis-aligned bounding box tree over the objects of a scene, for frustum culling
+// and ray picking that visit a number of nodes logarithmic in the object count
+// instead of every object.
+//
+// The tree is built top down over the world bounds of objects [0, count), by
+// median splits along the longest axis of the box centers.  Nodes are stored in
+// depth-first order and every subtree's objects are contiguous in mObjects, so a
+// subtree entirely inside the frustum is appended as one range without testing
+// its descendants.
+//
+// Moving objects are handled by Refit(), which recomputes the boxes of their
+// leaves and ancestors but keeps the topology.  Refitting lets the boxes grow
+// apart from the tree's original split; NeedsRebuild() tells when the summed node
+// area got large enough that a Build() pays off.
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXCollision.h>
+#include <DirectXMath.h>
+#include <vector>
+
+class BoundingVolumeHierarchy
+{
+public:
+	// Rebuild the tree over every object in bounds.
+	void Build(const std::vector<DirectX::BoundingBox>& bounds);
+
+	// Recompute the boxes of the given objects, whose entries in bounds changed,
+	// and of every node above them.
+	void Refit(const std::vector<unsigned int>& objects, const std::vector<DirectX::BoundingBox>& bounds);
+
+	// True when refits have doubled the summed area of the nodes since the last
+	// Build(), which makes queries visit about twice as many of them.
+	bool NeedsRebuild()const;
+
+	unsigned int ObjectCount()const { return (unsigned int)mObjects.size(); }
+
+	// Appends the objects whose bounds intersect the frustum, in no particular
+	// order.  The frustum is in the same space as the bounds.
+	void QueryFrustum(const DirectX::BoundingFrustum& frustum, const std::vector<DirectX::BoundingBox>& bounds,
+		std::vector<unsigned int>& objects)const;
+
+	// Nearest object whose bounds the ray hits, and the distance to the hit.  The
+	// direction must be normalized.
+	bool RayCast(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, const std::vector<DirectX::BoundingBox>& bounds,
+		unsigned int& object, float& distance)const;
+
+private:
+	struct Node
+	{
+		DirectX::BoundingBox Box;
+
+		// The subtree's objects are mObjects[First, First + Count).
+		unsigned int First = 0;
+		unsigned int Count = 0;
+
+		// The left child directly follows its parent; Right is 0 for a leaf.
+		unsigned int Right = 0;
+		unsigned int Parent = 0;
+	};
+
+	unsigned int BuildNode(unsigned int parent, unsigned int first, unsigned int count,
+		const std::vector<DirectX::BoundingBox>& bounds, std::vector<DirectX::XMFLOAT3>& centers);
+	void UpdateNodeBox(unsigned int node, const std::vector<DirectX::BoundingBox>& bounds);
+
+	static float SurfaceArea(const DirectX::BoundingBox& box);
+
+	std::vector<Node> mNodes;
+
+	// Object indices, permuted so every subtree's objects are contiguous.
+	std::vector<unsigned int> mObjects;
+
+	// Leaf holding each object.
+	std::vector<unsigned int> mLeafOf;
+
+	// Scratch for Refit().
+	std::vector<unsigned int> mRefitNodes;
+	std::vector<unsigned char> mNodeQueued;
+
+	float mBuiltArea = 0.0f;
+	float mArea = 0.0f;
+};
@@ -0,0 +1,113 @@
+//***************************************************************************************
+// CommandLine.cpp
+//***************************************************************************************
+
+#include "CommandLine.h"
+
+#include <sstream>
+
+CommandLine::CommandLine(const std::string& cmdLine)
+{
+	std::istringstream tokens(cmdLine);
+	std::string token;
+	while(tokens >> token)
+		mTokens.push_back(token);
+
+	mConsumed.assign(mTokens.size(), false);
+}
+
+bool CommandLine::HasFlag(const char* name)
+{
+	return FindOption(name) >= 0;
+}
+
+bool CommandLine::GetString(const char* name, std::string& value)
+{
+	int i = FindOption(name);
+	if(i < 0)
+		return false;
+
+	if(i + 1 >= (int)mTokens.size() || mConsumed[i + 1])
+	{
+		SetError(std::string("Missing value for ") + name);
+		return false;
+	}
+
+	mConsumed[i + 1] = true;
+	value = mTokens[i + 1];
+	return true;
+}
+
+bool CommandLine::GetUint(const char* name, unsigned int minValue, unsigned int maxValue, unsigned int& value)
+{
+	std::string str;
+	if(!GetString(name, str))
+		return false;
+
+	std::istringstream in(str);
+	long long v = 0;
+	if(!(in >> v) || !in.eof() || v < minValue || v > maxValue)
+	{
+		SetInvalidValue(name, str);
+		return false;
+	}
+
+	value = (unsigned int)v;
+	return true;
+}
+
+bool CommandLine::GetFloat(const char* name, float minValue, float maxValue, float& value)
+{
+	std::string str;
+	if(!GetString(name, str))
+		return false;
+
+	std::istringstream in(str);
+	float v = 0.0f;
+	if(!(in >> v) || !in.eof() || v < minValue || v > maxValue)
+	{
+		SetInvalidValue(name, str);
+		return false;
+	}
+
+	value = v;
+	return true;
+}
+
+bool CommandLine::Validate(std::wstring& error)const
+{
+	std::string message = mError;
+	for(size_t i = 0; i < mTokens.size() && message.empty(); ++i)
+	{
+		if(!mConsumed[i])
+			message = "Unknown option " + mTokens[i];
+	}
+
+	error.assign(message.begin(), message.end());
+	return message.empty();
+}
+
+void CommandLine::SetInvalidValue(const char* name, const std::string& value)
+{
+	SetError(std::string("Invalid value for ") + name + ": " + value);
+}
+
+int CommandLine::FindOption(const char* name)
+{
+	for(size_t i = 0; i < mTokens.size(); ++i)
+	{
+		if(!mConsumed[i] && mTokens[i] == name)
+		{
+			mConsumed[i] = true;
+			return (int)i;
+		}
+	}
+
+	return -1;
+}
+
+void CommandLine::SetError(const std::string& message)
+{
+	if(mError.empty())
+		mError = message;
+}
@@ -0,0 +1,41 @@
+//***************************************************************************************
+// CommandLine.h
+//
+// Splits the WinMain command line into options so each subsystem can read the
+// ones it owns.  Options are consumed when read; Validate() reports anything left
+// over or malformed once every subsystem has had its turn.
+//***************************************************************************************
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+class CommandLine
+{
+public:
+	explicit CommandLine(const std::string& cmdLine);
+
+	// True if the flag is present.
+	bool HasFlag(const char* name);
+
+	// Each returns true and sets value if the option is present with a valid
+	// value, and leaves value untouched otherwise.
+	bool GetString(const char* name, std::string& value);
+	bool GetUint(const char* name, unsigned int minValue, unsigned int maxValue, unsigned int& value);
+	bool GetFloat(const char* name, float minValue, float maxValue, float& value);
+
+	// For options whose values are checked by the caller.
+	void SetInvalidValue(const char* name, const std::string& value);
+
+	// Returns false and describes the first malformed or unrecognized option.
+	bool Validate(std::wstring& error)const;
+
+private:
+	int FindOption(const char* name);
+	void SetError(const std::string& message);
+
+	std::vector<std::string> mTokens;
+	std::vector<bool> mConsumed;
+	std::string mError;
+};
@@ -268,6 +268,118 @@ static HRESULT LoadTextureDataFromFile( _In_z_ const wchar_t* fileName,
     return S_OK;
 }
 
+//--------------------------------------------------------------------------------------
+// Like LoadTextureDataFromFile, but maps the file read-only instead of reading it
+// into a heap allocation, so the texels are only touched, and paged in, when they
+// are copied out.  The pointers stay valid for as long as mappedView is held.
+static HRESULT MapTextureDataFromFile( _In_z_ const wchar_t* fileName,
+                                       std::shared_ptr<const uint8_t>& mappedView,
+                                       const DDS_HEADER** header,
+                                       const uint8_t** bitData,
+                                       size_t* bitSize
+                                     )
+{
+    if (!header || !bitData || !bitSize)
+    {
+        return E_POINTER;
+    }
+
+    // open the file
+#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
+    ScopedHandle hFile( safe_handle( CreateFile2( fileName,
+                                                  GENERIC_READ,
+                                                  FILE_SHARE_READ,
+                                                  OPEN_EXISTING,
+                                                  nullptr ) ) );
+#else
+    ScopedHandle hFile( safe_handle( CreateFileW( fileName,
+                                                  GENERIC_READ,
+                                                  FILE_SHARE_READ,
+                                                  nullptr,
+                                                  OPEN_EXISTING,
+                                                  FILE_ATTRIBUTE_NORMAL,
+                                                  nullptr ) ) );
+#endif
+
+    if ( !hFile )
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
+    }
+
+    LARGE_INTEGER FileSize = { 0 };
+    if ( !GetFileSizeEx( hFile.get(), &FileSize ) )
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
+    }
+
+    // Same limits as LoadTextureDataFromFile
+    if (FileSize.HighPart > 0)
+    {
+        return E_FAIL;
+    }
+
+    if (FileSize.LowPart < ( sizeof(DDS_HEADER) + sizeof(uint32_t) ) )
+    {
+        return E_FAIL;
+    }
+
+    // The view keeps the mapping, and the mapping the file, alive, so both
+    // handles can be closed on return.
+    ScopedHandle hMapping( CreateFileMappingW( hFile.get(), nullptr, PAGE_READONLY, 0, 0, nullptr ) );
+    if ( !hMapping )
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
+    }
+
+    const void* view = MapViewOfFile( hMapping.get(), FILE_MAP_READ, 0, 0, 0 );
+    if ( !view )
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
+    }
+
+    mappedView.reset( static_cast<const uint8_t*>( view ),
+                      []( const uint8_t* p ) { UnmapViewOfFile( p ); } );
+
+    // DDS files always start with the same magic number ("DDS ")
+    uint32_t dwMagicNumber = *( const uint32_t* )( mappedView.get() );
+    if (dwMagicNumber != DDS_MAGIC)
+    {
+        return E_FAIL;
+    }
+
+    auto hdr = reinterpret_cast<const DDS_HEADER*>( mappedView.get() + sizeof( uint32_t ) );
+
+    // Verify header to validate DDS file
+    if (hdr->size != sizeof(DDS_HEADER) ||
+        hdr->ddspf.size != sizeof(DDS_PIXELFORMAT))
+    {
+        return E_FAIL;
+    }
+
+    // Check for DX10 extension
+    bool bDXT10Header = false;
+    if ((hdr->ddspf.flags & DDS_FOURCC) &&
+        (MAKEFOURCC( 'D', 'X', '1', '0' ) == hdr->ddspf.fourCC))
+    {
+        // Must be long enough for both headers and magic value
+        if (FileSize.LowPart < ( sizeof(DDS_HEADER) + sizeof(uint32_t) + sizeof(DDS_HEADER_DXT10) ) )
+        {
+            return E_FAIL;
+        }
+
+        bDXT10Header = true;
+    }
+
+    // setup the pointers in the process request
+    *header = hdr;
+    ptrdiff_t offset = sizeof( uint32_t ) + sizeof( DDS_HEADER )
+                       + (bDXT10Header ? sizeof( DDS_HEADER_DXT10 ) : 0);
+    *bitData = mappedView.get() + offset;
+    *bitSize = FileSize.LowPart - offset;
+
+    return S_OK;
+}
+
 
 //--------------------------------------------------------------------------------------
 // Return the BPP for a particular format
@@ -1669,16 +1781,22 @@ static HRESULT CreateTextureFromDDS( _In_ ID3D11Device* d3dDevice,
     return hr;
 }
 
-static HRESULT CreateTextureFromDDS12(
-	_In_ ID3D12Device* device,
-	_In_opt_ ID3D12GraphicsCommandList* cmdList,
+// Validates the DDS metadata and points initData at the subresources inside bitData.
+// Does not touch the device, so it can run on any thread.
+static HRESULT PrepareTextureFromDDS12(
 	_In_ const DDS_HEADER* header,
 	_In_reads_bytes_(bitSize) const uint8_t* bitData,
 	_In_ size_t bitSize,
 	_In_ size_t maxsize,
-	_In_ bool forceSRGB,
-	ComPtr<ID3D12Resource>& texture,
-	ComPtr<ID3D12Resource>& textureUploadHeap)
+	_Out_ uint32_t& resDimOut,
+	_Out_ size_t& twidth,
+	_Out_ size_t& theight,
+	_Out_ size_t& tdepth,
+	_Out_ size_t& tmipCount,
+	_Out_ size_t& tarraySize,
+	_Out_ DXGI_FORMAT& formatOut,
+	_Out_ bool& isCubeMapOut,
+	std::unique_ptr<D3D12_SUBRESOURCE_DATA[]>& initData)
 {
 	HRESULT hr = S_OK;
 
@@ -1836,9 +1954,7 @@ static HRESULT CreateTextureFromDDS12(
 	}
 
 	// Create the texture
-	std::unique_ptr<D3D12_SUBRESOURCE_DATA[]> initData(
-		new (std::nothrow) D3D12_SUBRESOURCE_DATA[mipCount * arraySize]
-		);
+	initData.reset(new (std::nothrow) D3D12_SUBRESOURCE_DATA[mipCount * arraySize]);
 
 	if (!initData)
 	{
@@ -1846,21 +1962,54 @@ static HRESULT CreateTextureFromDDS12(
 	}
 
 	size_t skipMip = 0;
-	size_t twidth = 0;
-	size_t theight = 0;
-	size_t tdepth = 0;
 
 	hr = FillInitData12(
 		width, height, depth, mipCount, arraySize, format, maxsize, bitSize, bitData,
 		twidth, theight, tdepth, skipMip, initData.get()
 		);
 
+	resDimOut = resDim;
+	tmipCount = mipCount - skipMip;
+	tarraySize = arraySize;
+	formatOut = format;
+	isCubeMapOut = isCubeMap;
+
+	return hr;
+}
+
+//--------------------------------------------------------------------------------------
+static HRESULT CreateTextureFromDDS12(
+	_In_ ID3D12Device* device,
+	_In_opt_ ID3D12GraphicsCommandList* cmdList,
+	_In_ const DDS_HEADER* header,
+	_In_reads_bytes_(bitSize) const uint8_t* bitData,
+	_In_ size_t bitSize,
+	_In_ size_t maxsize,
+	_In_ bool forceSRGB,
+	ComPtr<ID3D12Resource>& texture,
+	ComPtr<ID3D12Resource>& textureUploadHeap)
+{
+	uint32_t resDim = D3D12_RESOURCE_DIMENSION_UNKNOWN;
+	size_t twidth = 0;
+	size_t theight = 0;
+	size_t tdepth = 0;
+	size_t mipCount = 0;
+	size_t arraySize = 0;
+	DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+	bool isCubeMap = false;
+	std::unique_ptr<D3D12_SUBRESOURCE_DATA[]> initData;
+
+	HRESULT hr = PrepareTextureFromDDS12(
+		header, bitData, bitSize, maxsize,
+		resDim, twidth, theight, tdepth, mipCount, arraySize, format, isCubeMap,
+		initData);
+
 	if (SUCCEEDED(hr))
 	{
 		hr = CreateD3DResources12(
 			device, cmdList,
 			resDim, twidth, theight, tdepth,
-			mipCount - skipMip,
+			mipCount,
 			arraySize,
 			format,
 			false, // forceSRGB
@@ -2228,6 +2377,120 @@ HRESULT DirectX::CreateDDSTextureFromFile12(_In_ ID3D12Device* device,
 	return hr;
 }
 
+//--------------------------------------------------------------------------------------
+// Shared tail of LoadDDSTextureDataFromFile12 and MapDDSTextureDataFromFile12:
+// validates the metadata and fills in everything but the file data.
+static HRESULT FillDDSTextureData12(_In_ const DDS_HEADER* header,
+	_In_reads_bytes_(bitSize) const uint8_t* bitData,
+	_In_ size_t bitSize,
+	_In_ size_t maxsize,
+	_Out_ DirectX::DDSTextureData12& textureData)
+{
+	HRESULT hr = S_OK;
+
+	uint32_t resDim = D3D12_RESOURCE_DIMENSION_UNKNOWN;
+	size_t twidth = 0;
+	size_t theight = 0;
+	size_t tdepth = 0;
+	size_t mipCount = 0;
+	size_t arraySize = 0;
+	DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+	std::unique_ptr<D3D12_SUBRESOURCE_DATA[]> initData;
+
+	hr = PrepareTextureFromDDS12(
+		header, bitData, bitSize, maxsize,
+		resDim, twidth, theight, tdepth, mipCount, arraySize, format, textureData.IsCubeMap,
+		initData);
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+
+	// Same restriction as CreateD3DResources12.
+	if (resDim != D3D12_RESOURCE_DIMENSION_TEXTURE2D)
+	{
+		return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+	}
+
+	D3D12_RESOURCE_DESC& texDesc = textureData.Desc;
+	texDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+	texDesc.Alignment = 0;
+	texDesc.Width = twidth;
+	texDesc.Height = (uint32_t)theight;
+	texDesc.DepthOrArraySize = (tdepth > 1) ? (uint16_t)tdepth : (uint16_t)arraySize;
+	texDesc.MipLevels = (uint16_t)mipCount;
+	texDesc.Format = format;
+	texDesc.SampleDesc.Count = 1;
+	texDesc.SampleDesc.Quality = 0;
+	texDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+	texDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+
+	textureData.Subresources.assign(initData.get(), initData.get() + texDesc.DepthOrArraySize * mipCount);
+	textureData.AlphaMode = GetAlphaMode(header);
+
+	return S_OK;
+}
+
+static void ResetDDSTextureData12(DirectX::DDSTextureData12& textureData)
+{
+	textureData.FileData.reset();
+	textureData.MappedFile.reset();
+	textureData.Subresources.clear();
+	ZeroMemory(&textureData.Desc, sizeof(D3D12_RESOURCE_DESC));
+	textureData.IsCubeMap = false;
+	textureData.AlphaMode = DirectX::DDS_ALPHA_MODE_UNKNOWN;
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT DirectX::LoadDDSTextureDataFromFile12(_In_z_ const wchar_t* szFileName,
+	_Out_ DDSTextureData12& textureData,
+	_In_ size_t maxsize)
+{
+	ResetDDSTextureData12(textureData);
+
+	if (!szFileName)
+	{
+		return E_INVALIDARG;
+	}
+
+	DDS_HEADER* header = nullptr;
+	uint8_t* bitData = nullptr;
+	size_t bitSize = 0;
+
+	HRESULT hr = LoadTextureDataFromFile(szFileName, textureData.FileData, &header, &bitData, &bitSize);
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+
+	return FillDDSTextureData12(header, bitData, bitSize, maxsize, textureData);
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT DirectX::MapDDSTextureDataFromFile12(_In_z_ const wchar_t* szFileName,
+	_Out_ DDSTextureData12& textureData,
+	_In_ size_t maxsize)
+{
+	ResetDDSTextureData12(textureData);
+
+	if (!szFileName)
+	{
+		return E_INVALIDARG;
+	}
+
+	const DDS_HEADER* header = nullptr;
+	const uint8_t* bitData = nullptr;
+	size_t bitSize = 0;
+
+	HRESULT hr = MapTextureDataFromFile(szFileName, textureData.MappedFile, &header, &bitData, &bitSize);
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+
+	return FillDDSTextureData12(header, bitData, bitSize, maxsize, textureData);
+}
+
 _Use_decl_annotations_
 HRESULT DirectX::CreateDDSTextureFromFile( ID3D11Device* d3dDevice,
                                            ID3D11DeviceContext* d3dContext,
@@ -25,6 +25,8 @@
 #include <wrl.h>
 #include <d3d11_1.h>
 #include "d3dx12.h"
+#include <memory>
+#include <vector>
 
 #pragma warning(push)
 #pragma warning(disable : 4005)
@@ -92,6 +94,35 @@ namespace DirectX
 		                               _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr
 		                               );
 
+	// CPU side contents of a DDS file, parsed and ready to be uploaded to a D3D12
+	// texture created from Desc.  Subresources point into FileData, or into
+	// MappedFile when the file was mapped instead of read.
+	struct DDSTextureData12
+	{
+		std::unique_ptr<uint8_t[]> FileData;
+		std::shared_ptr<const uint8_t> MappedFile;
+		D3D12_RESOURCE_DESC Desc;
+		std::vector<D3D12_SUBRESOURCE_DATA> Subresources;
+		bool IsCubeMap;
+		DDS_ALPHA_MODE AlphaMode;
+	};
+
+	// Reads and parses a DDS file without touching the device, so it can run on a
+	// worker thread while the upload is recorded elsewhere.  Only 2D textures
+	// (including arrays and cube maps) are supported.
+	HRESULT LoadDDSTextureDataFromFile12(_In_z_ const wchar_t* szFileName,
+		                                 _Out_ DDSTextureData12& textureData,
+		                                 _In_ size_t maxsize = 0
+		                                 );
+
+	// Same as LoadDDSTextureDataFromFile12, but memory-maps the file read-only.
+	// Nothing is read up front; the texels are paged in by whoever copies them out
+	// of Subresources, so they are copied once instead of twice.
+	HRESULT MapDDSTextureDataFromFile12(_In_z_ const wchar_t* szFileName,
+		                                _Out_ DDSTextureData12& textureData,
+		                                _In_ size_t maxsize = 0
+		                                );
+
     // Standard version with optional auto-gen mipmap support
     HRESULT CreateDDSTextureFromMemory( _In_ ID3D11Device* d3dDevice,
                                         _In_opt_ ID3D11DeviceContext* d3dContext,
@@ -0,0 +1,77 @@
+//***************************************************************************************
+// DescriptorHeapAllocator.cpp
+//***************************************************************************************
+
+#include "DescriptorHeapAllocator.h"
+
+DescriptorHeapAllocator::DescriptorHeapAllocator(ID3D12Device* device, UINT capacity) :
+	mCapacity(capacity)
+{
+	D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
+	heapDesc.NumDescriptors = mCapacity;
+	heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+	heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+	ThrowIfFailed(device->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&mHeap)));
+
+	mCpuStart = mHeap->GetCPUDescriptorHandleForHeapStart();
+	mGpuStart = mHeap->GetGPUDescriptorHandleForHeapStart();
+	mDescriptorSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+	mFreeList.resize(mCapacity);
+	for(UINT i = 0; i < mCapacity; ++i)
+		mFreeList[i] = mCapacity - 1 - i;
+}
+
+ID3D12DescriptorHeap* DescriptorHeapAllocator::Heap()const
+{
+	return mHeap.Get();
+}
+
+UINT DescriptorHeapAllocator::Allocate()
+{
+	if(mFreeList.empty())
+		throw DxException(E_OUTOFMEMORY, L"DescriptorHeapAllocator::Allocate", AnsiToWString(__FILE__), __LINE__);
+
+	UINT index = mFreeList.back();
+	mFreeList.pop_back();
+	return index;
+}
+
+void DescriptorHeapAllocator::Free(UINT index, UINT64 fenceValue)
+{
+	assert(index < mCapacity);
+
+	PendingFree pending;
+	pending.Index = index;
+	pending.Fence = fenceValue;
+	mPendingFrees.push(pending);
+}
+
+void DescriptorHeapAllocator::Retire(UINT64 completedFenceValue)
+{
+	while(!mPendingFrees.empty() && mPendingFrees.front().Fence <= completedFenceValue)
+	{
+		mFreeList.push_back(mPendingFrees.front().Index);
+		mPendingFrees.pop();
+	}
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE DescriptorHeapAllocator::CpuHandle(UINT index)const
+{
+	return CD3DX12_CPU_DESCRIPTOR_HANDLE(mCpuStart, index, mDescriptorSize);
+}
+
+D3D12_GPU_DESCRIPTOR_HANDLE DescriptorHeapAllocator::GpuHandle(UINT index)const
+{
+	return CD3DX12_GPU_DESCRIPTOR_HANDLE(mGpuStart, index, mDescriptorSize);
+}
+
+UINT DescriptorHeapAllocator::Capacity()const
+{
+	return mCapacity;
+}
+
+UINT DescriptorHeapAllocator::AllocatedCount()const
+{
+	return mCapacity - (UINT)mFreeList.size() - (UINT)mPendingFrees.size();
+}
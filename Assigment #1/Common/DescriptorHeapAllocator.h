@@ -0,0 +1,57 @@
+//***************************************************************************************
+// DescriptorHeapAllocator.h
+//
+// One large shader-visible CBV/SRV/UAV heap handed out a descriptor at a time
+// from a free list.  Shaders index the heap directly (bindless), so a descriptor
+// index is all a material or draw needs to refer to a texture.
+//
+// Freed descriptors may still be read by frames in flight, so Free() takes the
+// fence value of the last frame that can use the descriptor and Retire() returns
+// it to the free list once the GPU has passed that fence.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+
+#include <queue>
+
+class DescriptorHeapAllocator
+{
+public:
+	DescriptorHeapAllocator(ID3D12Device* device, UINT capacity);
+	DescriptorHeapAllocator(const DescriptorHeapAllocator& rhs) = delete;
+	DescriptorHeapAllocator& operator=(const DescriptorHeapAllocator& rhs) = delete;
+	~DescriptorHeapAllocator() = default;
+
+	ID3D12DescriptorHeap* Heap()const;
+
+	// Throws a DxException if the heap is full.
+	UINT Allocate();
+
+	void Free(UINT index, UINT64 fenceValue);
+	void Retire(UINT64 completedFenceValue);
+
+	D3D12_CPU_DESCRIPTOR_HANDLE CpuHandle(UINT index)const;
+	D3D12_GPU_DESCRIPTOR_HANDLE GpuHandle(UINT index)const;
+
+	UINT Capacity()const;
+	UINT AllocatedCount()const;
+
+private:
+	struct PendingFree
+	{
+		UINT Index = 0;
+		UINT64 Fence = 0;
+	};
+
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> mHeap;
+	D3D12_CPU_DESCRIPTOR_HANDLE mCpuStart;
+	D3D12_GPU_DESCRIPTOR_HANDLE mGpuStart;
+	UINT mDescriptorSize = 0;
+	UINT mCapacity = 0;
+
+	// Free indices, popped from the back so low indices are handed out first.
+	std::vector<UINT> mFreeList;
+	std::queue<PendingFree> mPendingFrees;
+};
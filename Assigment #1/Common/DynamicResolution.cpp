@@ -0,0 +1,37 @@
+//***************************************************************************************
+// DynamicResolution.cpp
+//***************************************************************************************
+
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+DynamicResolution::DynamicResolution(const Settings& settings) :
+	mSettings(settings)
+{
+	mScale = mSettings.MaxScale;
+}
+
+float DynamicResolution::Update(float gpuMs)
+{
+	if(gpuMs <= 0.0f)
+		return mScale;
+
+	float suggested = mScale * std::sqrt(mSettings.TargetMs * mSettings.Headroom / gpuMs);
+	suggested = std::min(std::max(suggested, mSettings.MinScale), mSettings.MaxScale);
+
+	if(std::fabs(suggested - mScale) <= mSettings.DeadBand * mScale)
+		return mScale;
+
+	const float rate = suggested < mScale ? mSettings.DownRate : mSettings.UpRate;
+	mScale += (suggested - mScale) * rate;
+	mScale = std::min(std::max(mScale, mSettings.MinScale), mSettings.MaxScale);
+
+	return mScale;
+}
+
+unsigned int DynamicResolution::Apply(unsigned int nativeSize)const
+{
+	return std::max(1u, (unsigned int)(nativeSize * mScale + 0.5f));
+}
@@ -0,0 +1,52 @@
+//***************************************************************************************
+// DynamicResolution.h
+//
+// Picks the fraction of the native resolution to render at from measured GPU frame
+// times.  GPU time is taken to grow with the pixel count, i.e. with the square of
+// the scale, so every sample suggests the scale that would have hit the budget.
+// The controller moves towards it quickly when over budget and slowly when under,
+// so a spike is absorbed within a few frames without the resolution pumping
+// while the load is steady.
+//
+// This header only depends on the standard library.
+//***************************************************************************************
+
+#pragma once
+
+class DynamicResolution
+{
+public:
+	struct Settings
+	{
+		// GPU time to aim for, in milliseconds.  The controller keeps Headroom of it
+		// spare to ride out small variations.
+		float TargetMs = 16.6f;
+		float Headroom = 0.9f;
+
+		float MinScale = 0.5f;
+		float MaxScale = 1.0f;
+
+		// Fraction of the distance to the suggested scale covered per sample, when
+		// lowering and when raising the resolution.
+		float DownRate = 0.5f;
+		float UpRate = 0.05f;
+
+		// Suggestions within this fraction of the current scale are ignored.
+		float DeadBand = 0.03f;
+	};
+
+	explicit DynamicResolution(const Settings& settings);
+
+	// Feeds the GPU time of one finished frame and returns the new scale.
+	// Non-positive times, which mean no measurement, leave the scale alone.
+	float Update(float gpuMs);
+
+	float Scale()const { return mScale; }
+
+	// Scales a native dimension, never below one pixel.
+	unsigned int Apply(unsigned int nativeSize)const;
+
+private:
+	Settings mSettings;
+	float mScale = 1.0f;
+};
@@ -0,0 +1,289 @@
+//***************************************************************************************
+// FrameTelemetry.cpp
+//***************************************************************************************
+
+#include "FrameTelemetry.h"
+
+#include <TraceLoggingProvider.h>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+// {4E395E9A-BC03-4457-8D9D-C172E076EB43}
+TRACELOGGING_DEFINE_PROVIDER(gFrameTelemetryProvider, "LitColumns.FrameTelemetry",
+	(0x4e395e9a, 0xbc03, 0x4457, 0x8d, 0x9d, 0xc1, 0x72, 0xe0, 0x76, 0xeb, 0x43));
+
+namespace
+{
+	// Frames needed before the median is trusted for hitch detection.
+	const UINT64 HitchWarmupFrames = 60;
+
+	// A frame this many times longer than the median is a hitch.
+	const float HitchFactor = 2.0f;
+
+	const char* const PhaseNames[(int)FramePhase::Count] =
+	{
+		"update", "record", "submit", "fence_wait", "latency_wait", "present"
+	};
+}
+
+FrameTelemetry::FrameTelemetry() :
+	mRing(HistoryFrames)
+{
+	for(Slot& slot : mRing)
+	{
+		slot.Sequence.store(0, std::memory_order_relaxed);
+		for(auto& word : slot.Words)
+			word.store(0, std::memory_order_relaxed);
+	}
+
+	auto clear = [](Histogram& histogram)
+	{
+		for(auto& count : histogram.Counts)
+			count.store(0, std::memory_order_relaxed);
+		histogram.Total.store(0, std::memory_order_relaxed);
+	};
+
+	clear(mFrameHistogram);
+	for(Histogram& histogram : mPhaseHistograms)
+		clear(histogram);
+
+	mLatestFrame.store(0, std::memory_order_relaxed);
+	mHitchCount.store(0, std::memory_order_relaxed);
+
+	TraceLoggingRegister(gFrameTelemetryProvider);
+}
+
+FrameTelemetry::~FrameTelemetry()
+{
+	TraceLoggingUnregister(gFrameTelemetryProvider);
+}
+
+void FrameTelemetry::AddPhaseTime(FramePhase phase, __int64 ticks)
+{
+	mPhaseTicks[(int)phase] += ticks;
+}
+
+void FrameTelemetry::EndFrame(UINT drawCalls, UINT64 uploadBytes)
+{
+	const __int64 now = GameTimer::Now();
+	const double msPerTick = 1000.0*GameTimer::SecondsPerTick();
+
+	FrameRecord record;
+	record.Frame = mLatestFrame.load(std::memory_order_relaxed) + 1;
+	record.FrameMs = mPrevFrameEnd != 0 ? (float)((now - mPrevFrameEnd)*msPerTick) : 0.0f;
+	for(int i = 0; i < (int)FramePhase::Count; ++i)
+	{
+		record.PhaseMs[i] = (float)(mPhaseTicks[i]*msPerTick);
+		mPhaseTicks[i] = 0;
+	}
+	record.DrawCalls = drawCalls;
+	record.UploadBytes = uploadBytes;
+	mPrevFrameEnd = now;
+
+	// Publish the record; see ReadFrame for the other half of the protocol.
+	UINT64 words[RecordWords] = {};
+	std::memcpy(words, &record, sizeof(record));
+
+	Slot& slot = mRing[record.Frame % HistoryFrames];
+	slot.Sequence.store(2*record.Frame - 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	for(UINT i = 0; i < RecordWords; ++i)
+		slot.Words[i].store(words[i], std::memory_order_relaxed);
+	slot.Sequence.store(2*record.Frame, std::memory_order_release);
+	mLatestFrame.store(record.Frame, std::memory_order_release);
+
+	// The first frame has no previous one to measure from.
+	if(record.Frame > 1)
+	{
+		const bool hitch = record.Frame > HitchWarmupFrames && record.FrameMs > HitchFactor*FramePercentile(50.0);
+
+		Add(mFrameHistogram, record.FrameMs);
+		if(hitch)
+		{
+			mHitchCount.fetch_add(1, std::memory_order_relaxed);
+			TraceLoggingWrite(gFrameTelemetryProvider, "Hitch",
+				TraceLoggingUInt64(record.Frame, "Frame"),
+				TraceLoggingFloat32(record.FrameMs, "FrameMs"),
+				TraceLoggingFloat32(FramePercentile(50.0), "MedianMs"));
+		}
+	}
+
+	for(int i = 0; i < (int)FramePhase::Count; ++i)
+		Add(mPhaseHistograms[i], record.PhaseMs[i]);
+
+	TraceLoggingWrite(gFrameTelemetryProvider, "Frame",
+		TraceLoggingUInt64(record.Frame, "Frame"),
+		TraceLoggingFloat32(record.FrameMs, "FrameMs"),
+		TraceLoggingFloat32(record.PhaseMs[(int)FramePhase::Update], "UpdateMs"),
+		TraceLoggingFloat32(record.PhaseMs[(int)FramePhase::Record], "RecordMs"),
+		TraceLoggingFloat32(record.PhaseMs[(int)FramePhase::Submit], "SubmitMs"),
+		TraceLoggingFloat32(record.PhaseMs[(int)FramePhase::FenceWait], "FenceWaitMs"),
+		TraceLoggingFloat32(record.PhaseMs[(int)FramePhase::LatencyWait], "LatencyWaitMs"),
+		TraceLoggingFloat32(record.PhaseMs[(int)FramePhase::Present], "PresentMs"),
+		TraceLoggingUInt32(record.DrawCalls, "DrawCalls"),
+		TraceLoggingUInt64(record.UploadBytes, "UploadBytes"));
+}
+
+UINT64 FrameTelemetry::LatestFrame()const
+{
+	return mLatestFrame.load(std::memory_order_acquire);
+}
+
+bool FrameTelemetry::ReadFrame(UINT64 frame, FrameRecord& record)const
+{
+	if(frame == 0)
+		return false;
+
+	const Slot& slot = mRing[frame % HistoryFrames];
+	if(slot.Sequence.load(std::memory_order_acquire) != 2*frame)
+		return false;
+
+	UINT64 words[RecordWords];
+	for(UINT i = 0; i < RecordWords; ++i)
+		words[i] = slot.Words[i].load(std::memory_order_relaxed);
+
+	// Only a copy made without the writer coming back to the slot is whole.
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if(slot.Sequence.load(std::memory_order_relaxed) != 2*frame)
+		return false;
+
+	std::memcpy(&record, words, sizeof(record));
+	return true;
+}
+
+std::vector<FrameRecord> FrameTelemetry::ReadRecent(UINT maxCount)const
+{
+	const UINT64 latest = LatestFrame();
+	const UINT64 count = latest < maxCount ? latest : maxCount;
+
+	std::vector<FrameRecord> records;
+	records.reserve((size_t)count);
+	for(UINT64 frame = latest - count + 1; frame <= latest; ++frame)
+	{
+		FrameRecord record;
+		if(ReadFrame(frame, record))
+			records.push_back(record);
+	}
+
+	return records;
+}
+
+float FrameTelemetry::FramePercentile(double percentile)const
+{
+	return Percentile(mFrameHistogram, percentile);
+}
+
+float FrameTelemetry::PhasePercentile(FramePhase phase, double percentile)const
+{
+	return Percentile(mPhaseHistograms[(int)phase], percentile);
+}
+
+UINT64 FrameTelemetry::HitchCount()const
+{
+	return mHitchCount.load(std::memory_order_relaxed);
+}
+
+std::wstring FrameTelemetry::GetReport()const
+{
+	std::wostringstream text;
+	text << std::fixed << std::setprecision(3);
+	text << L"telemetry              p50      p99    p99.9      max   (ms, " << LatestFrame() << L" frames, "
+		<< HitchCount() << L" hitches)\n";
+
+	auto line = [&text](const char* name, const Histogram& histogram)
+	{
+		text << std::left << std::setw(20) << name << std::right
+			<< std::setw(9) << Percentile(histogram, 50.0) << std::setw(9) << Percentile(histogram, 99.0)
+			<< std::setw(9) << Percentile(histogram, 99.9) << std::setw(9) << Percentile(histogram, 100.0) << L"\n";
+	};
+
+	line("frame", mFrameHistogram);
+	for(int i = 0; i < (int)FramePhase::Count; ++i)
+		line(PhaseNames[i], mPhaseHistograms[i]);
+
+	return text.str();
+}
+
+bool FrameTelemetry::WriteCsv(const std::wstring& filename)const
+{
+	std::ofstream fout(filename);
+	if(!fout)
+		return false;
+
+	fout << "frame,frame_ms";
+	for(const char* name : PhaseNames)
+		fout << ',' << name << "_ms";
+	fout << ",draw_calls,upload_bytes\n";
+
+	fout << std::fixed << std::setprecision(3);
+	for(const FrameRecord& record : ReadRecent(HistoryFrames))
+	{
+		fout << record.Frame << ',' << record.FrameMs;
+		for(float ms : record.PhaseMs)
+			fout << ',' << ms;
+		fout << ',' << record.DrawCalls << ',' << record.UploadBytes << '\n';
+	}
+
+	return true;
+}
+
+UINT FrameTelemetry::BucketOf(UINT64 us)
+{
+	// Values below 2*SubBuckets get a bucket each; above that every power of two
+	// is split into SubBuckets buckets of equal width.
+	if(us >= (1ull << 32))
+		us = (1ull << 32) - 1;
+	if(us < 2*SubBuckets)
+		return (UINT)us;
+
+	UINT msb = 0;
+	while((us >> (msb + 1)) != 0)
+		msb++;
+
+	const UINT shift = msb - SubBucketBits;
+	return 2*SubBuckets + (msb - SubBucketBits - 1)*SubBuckets + (UINT)(us >> shift) - SubBuckets;
+}
+
+double FrameTelemetry::BucketValue(UINT bucket)
+{
+	// Middle of the bucket's range.
+	if(bucket < 2*SubBuckets)
+		return bucket + 0.5;
+
+	const UINT octave = (bucket - 2*SubBuckets) / SubBuckets;
+	const UINT64 sub = (bucket - 2*SubBuckets) % SubBuckets + SubBuckets;
+	const UINT shift = octave + 1;
+	return (double)(sub << shift) + 0.5*(double)(1ull << shift);
+}
+
+void FrameTelemetry::Add(Histogram& histogram, float ms)
+{
+	const UINT64 us = (UINT64)(ms > 0.0f ? ms*1000.0f + 0.5f : 0.0f);
+	histogram.Counts[BucketOf(us)].fetch_add(1, std::memory_order_relaxed);
+	histogram.Total.fetch_add(1, std::memory_order_relaxed);
+}
+
+float FrameTelemetry::Percentile(const Histogram& histogram, double percentile)
+{
+	const UINT64 total = histogram.Total.load(std::memory_order_relaxed);
+	if(total == 0)
+		return 0.0f;
+
+	// Smallest bucket with at least the percentile's share of the samples at or
+	// below it.  Counts read while the main thread adds may be a sample apart.
+	UINT64 target = (UINT64)(percentile / 100.0*(double)total + 0.5);
+	if(target < 1)
+		target = 1;
+
+	UINT64 seen = 0;
+	for(UINT bucket = 0; bucket < BucketCount; ++bucket)
+	{
+		seen += histogram.Counts[bucket].load(std::memory_order_relaxed);
+		if(seen >= target)
+			return (float)(BucketValue(bucket) / 1000.0);
+	}
+
+	return (float)(BucketValue(BucketCount - 1) / 1000.0);
+}
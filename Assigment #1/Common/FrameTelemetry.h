@@ -0,0 +1,153 @@
+//***************************************************************************************
+// FrameTelemetry.h
+//
+// Per-frame timing records for spotting stutter, which averages hide.  The main
+// thread times the phases of each frame with GameTimer's counter and ends the
+// frame with its draw count and upload bytes; the finished record goes into a
+// ring of the last HistoryFrames frames, into one log-linear histogram per
+// measurement, and out as an ETW event.
+//
+// Readers may be on any thread.  Ring slots are sequence locked: the writer makes
+// a slot's sequence odd while it stores the record, so a reader that raced with
+// it sees the sequence change and drops the copy instead of returning a torn one.
+// Histogram buckets are atomic counters, so percentiles can be read at any time.
+//
+// The histograms bucket microseconds by powers of two, with SubBuckets linear
+// steps in each, so every percentile is within 1/SubBuckets of the true value
+// from a microsecond up to an hour, in constant memory.
+//
+// ETW events come from the "LitColumns.FrameTelemetry" TraceLogging provider: a
+// "Frame" event per frame and a "Hitch" event for every frame longer than twice
+// the median so far.  They cost nothing while no session, such as WPA, PIX or a
+// fleet collector, listens to the provider.  Only one instance registers the
+// provider, so create one per process.
+//***************************************************************************************
+
+#pragma once
+
+#include "GameTimer.h"
+
+#include <windows.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+enum class FramePhase : int
+{
+	Update = 0,
+	Record,      // command list recording, including waiting on the record threads
+	Submit,      // ExecuteCommandLists and the fence signal
+	FenceWait,   // waiting for a frame resource, inside Update
+	LatencyWait, // waiting on the swap chain's frame latency object
+	Present,
+	Count
+};
+
+struct FrameRecord
+{
+	UINT64 Frame = 0;
+
+	// Wall time since the end of the previous frame.
+	float FrameMs = 0.0f;
+	float PhaseMs[(int)FramePhase::Count] = {};
+
+	UINT DrawCalls = 0;
+	UINT64 UploadBytes = 0;
+};
+
+class FrameTelemetry
+{
+public:
+	FrameTelemetry();
+	FrameTelemetry(const FrameTelemetry& rhs) = delete;
+	FrameTelemetry& operator=(const FrameTelemetry& rhs) = delete;
+	~FrameTelemetry();
+
+	// Main thread only.  Phase times add up, so a phase may be timed in pieces.
+	void AddPhaseTime(FramePhase phase, __int64 ticks);
+	void EndFrame(UINT drawCalls, UINT64 uploadBytes);
+
+	// Number of frames ended so far; frame n is the n-th, starting at 1.
+	UINT64 LatestFrame()const;
+
+	// Copies frame's record, or returns false if it has not ended yet or has been
+	// overwritten, including while being copied.
+	bool ReadFrame(UINT64 frame, FrameRecord& record)const;
+
+	// The up to maxCount latest records still in the ring, oldest first.
+	std::vector<FrameRecord> ReadRecent(UINT maxCount)const;
+
+	// Percentile (0-100) of the frame times, or of a phase's, in milliseconds.
+	float FramePercentile(double percentile)const;
+	float PhasePercentile(FramePhase phase, double percentile)const;
+
+	UINT64 HitchCount()const;
+
+	// Percentiles of the frame and every phase, one per line.
+	std::wstring GetReport()const;
+
+	// The records in the ring, one frame per row.
+	bool WriteCsv(const std::wstring& filename)const;
+
+private:
+	static const UINT HistoryFrames = 1024;
+	static const UINT SubBuckets = 64;
+	static const UINT SubBucketBits = 6;
+	static const UINT BucketCount = 2*SubBuckets + (32 - SubBucketBits - 1)*SubBuckets;
+
+	static const UINT RecordWords = (sizeof(FrameRecord) + sizeof(UINT64) - 1) / sizeof(UINT64);
+
+	struct Slot
+	{
+		// 2*frame while the slot holds frame's record, odd while it is written.
+		std::atomic<UINT64> Sequence;
+		std::atomic<UINT64> Words[RecordWords];
+	};
+
+	struct Histogram
+	{
+		std::atomic<UINT64> Counts[BucketCount];
+		std::atomic<UINT64> Total;
+	};
+
+	static UINT BucketOf(UINT64 us);
+	static double BucketValue(UINT bucket);
+	static void Add(Histogram& histogram, float ms);
+	static float Percentile(const Histogram& histogram, double percentile);
+
+	std::vector<Slot> mRing;
+	std::atomic<UINT64> mLatestFrame;
+
+	Histogram mFrameHistogram;
+	Histogram mPhaseHistograms[(int)FramePhase::Count];
+	std::atomic<UINT64> mHitchCount;
+
+	// The frame being timed.
+	__int64 mPhaseTicks[(int)FramePhase::Count] = {};
+	__int64 mPrevFrameEnd = 0;
+};
+
+// Adds the time until it goes out of scope to a phase of the current frame.
+class ScopedPhaseTimer
+{
+public:
+	ScopedPhaseTimer(FrameTelemetry& telemetry, FramePhase phase) :
+		mTelemetry(telemetry),
+		mPhase(phase),
+		mStart(GameTimer::Now())
+	{
+	}
+
+	ScopedPhaseTimer(const ScopedPhaseTimer& rhs) = delete;
+	ScopedPhaseTimer& operator=(const ScopedPhaseTimer& rhs) = delete;
+
+	~ScopedPhaseTimer()
+	{
+		mTelemetry.AddPhaseTime(mPhase, GameTimer::Now() - mStart);
+	}
+
+private:
+	FrameTelemetry& mTelemetry;
+	FramePhase mPhase;
+	__int64 mStart;
+};
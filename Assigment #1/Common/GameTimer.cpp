@@ -6,7 +6,7 @@
 #include "GameTimer.h"
 
 GameTimer::GameTimer()
-: mSecondsPerCount(0.0), mDeltaTime(-1.0), mBaseTime(0), 
+: mSecondsPerCount(0.0), mDeltaTime(-1.0), mFixedTimeStep(0.0), mBaseTime(0), 
   mPausedTime(0), mPrevTime(0), mCurrTime(0), mStopped(false)
 {
 	__int64 countsPerSec;
@@ -53,6 +53,31 @@ float GameTimer::DeltaTime()const
 	return (float)mDeltaTime;
 }
 
+double GameTimer::PreciseDeltaTime()const
+{
+	return mDeltaTime;
+}
+
+__int64 GameTimer::Now()
+{
+	__int64 currTime;
+	QueryPerformanceCounter((LARGE_INTEGER*)&currTime);
+	return currTime;
+}
+
+double GameTimer::SecondsPerTick()
+{
+	// The frequency is fixed at boot; it is queried once, on first use.
+	static const double secondsPerTick = []()
+	{
+		__int64 countsPerSec;
+		QueryPerformanceFrequency((LARGE_INTEGER*)&countsPerSec);
+		return 1.0 / (double)countsPerSec;
+	}();
+
+	return secondsPerTick;
+}
+
 void GameTimer::Reset()
 {
 	__int64 currTime;
@@ -98,6 +123,11 @@ void GameTimer::Stop()
 	}
 }
 
+void GameTimer::SetFixedTimeStep(double seconds)
+{
+	mFixedTimeStep = seconds > 0.0 ? seconds : 0.0;
+}
+
 void GameTimer::Tick()
 {
 	if( mStopped )
@@ -106,6 +136,15 @@ void GameTimer::Tick()
 		return;
 	}
 
+	// Advance the counts by the fixed step so TotalTime() stays consistent.
+	if( mFixedTimeStep > 0.0 )
+	{
+		mCurrTime = mPrevTime + (__int64)(mFixedTimeStep / mSecondsPerCount + 0.5);
+		mDeltaTime = mFixedTimeStep;
+		mPrevTime = mCurrTime;
+		return;
+	}
+
 	__int64 currTime;
 	QueryPerformanceCounter((LARGE_INTEGER*)&currTime);
 	mCurrTime = currTime;
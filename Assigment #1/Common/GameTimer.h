@@ -18,9 +18,23 @@ public:
 	void Stop();  // Call when paused.
 	void Tick();  // Call every frame.
 
+	// Full precision DeltaTime(), for measurements rather than simulation.
+	double PreciseDeltaTime()const; // in seconds
+
+	// Raw performance counter and the length of one of its ticks.  Unlike the
+	// clock above these may be called from any thread.
+	static __int64 Now();
+	static double SecondsPerTick();
+
+	// With a step above zero every Tick() advances the clock by exactly that many
+	// seconds, whatever the wall time, so runs are reproducible.  Zero restores
+	// the real time clock.
+	void SetFixedTimeStep(double seconds);
+
 private:
 	double mSecondsPerCount;
 	double mDeltaTime;
+	double mFixedTimeStep;
 
 	__int64 mBaseTime;
 	__int64 mPausedTime;
@@ -3,7 +3,11 @@
 //***************************************************************************************
 
 #include "GeometryGenerator.h"
+#include "ThreadPool.h"
 #include <algorithm>
+#include <cassert>
+#include <map>
+#include <tuple>
 
 #define PI 3.14159265
 
@@ -11,7 +15,14 @@ using namespace DirectX;
 
 GeometryGenerator::MeshData GeometryGenerator::CreateBox(float width, float height, float depth, uint32 numSubdivisions)
 {
-    MeshData meshData;
+	MeshData meshData;
+	CreateBox(width, height, depth, numSubdivisions, meshData);
+	return meshData;
+}
+
+void GeometryGenerator::CreateBox(float width, float height, float depth, uint32 numSubdivisions, MeshData& meshData)
+{
+    meshData.Clear();
 
     //
 	// Create the vertices.
@@ -98,13 +109,18 @@ GeometryGenerator::MeshData GeometryGenerator::CreateBox(float width, float heig
 
     for(uint32 i = 0; i < numSubdivisions; ++i)
         Subdivide(meshData);
-
-    return meshData;
 }
 
 GeometryGenerator::MeshData GeometryGenerator::CreateDiamond(float width, float height, float depth, uint32 numSubdivisions)
 {
 	MeshData meshData;
+	CreateDiamond(width, height, depth, numSubdivisions, meshData);
+	return meshData;
+}
+
+void GeometryGenerator::CreateDiamond(float width, float height, float depth, uint32 numSubdivisions, MeshData& meshData)
+{
+	meshData.Clear();
 
 	Vertex v[18];
 
@@ -196,13 +212,22 @@ GeometryGenerator::MeshData GeometryGenerator::CreateDiamond(float width, float
 
 	for (uint32 i = 0; i < numSubdivisions; ++i)
 		Subdivide(meshData);
-
-	return meshData;
 }
 
 GeometryGenerator::MeshData GeometryGenerator::CreateCone(float radius, float height, uint32 sliceCount, uint32 stackCount)
 {
 	MeshData meshData;
+	CreateCone(radius, height, sliceCount, stackCount, meshData);
+	return meshData;
+}
+
+void GeometryGenerator::CreateCone(float radius, float height, uint32 sliceCount, uint32 stackCount, MeshData& meshData)
+{
+	meshData.Clear();
+
+	// The stack height divides by the count.
+	sliceCount = std::max<uint32>(sliceCount, 3);
+	stackCount = std::max<uint32>(stackCount, 1);
 
 	//
 	// Build Stacks.
@@ -227,8 +252,8 @@ GeometryGenerator::MeshData GeometryGenerator::CreateCone(float radius, float he
 		{
 			Vertex vertex;
 
-			float c = cosf(j*dTheta);
-			float s = sinf(j*dTheta);
+			float s, c;
+			XMScalarSinCos(&s, &c, j*dTheta);
 
 			vertex.Position = XMFLOAT3(r*c, y, r*s);
 
@@ -271,13 +296,18 @@ GeometryGenerator::MeshData GeometryGenerator::CreateCone(float radius, float he
 
 	BuildCylinderTopCap(radius, 0, height, sliceCount, stackCount, meshData);
 	BuildCylinderBottomCap(radius, 0, height, sliceCount, stackCount, meshData);
-
-	return meshData;
 }
 
 GeometryGenerator::MeshData GeometryGenerator::CreateWedge(float width, float height, float depth, uint32 numSubdivisions)
 {
 	MeshData meshData;
+	CreateWedge(width, height, depth, numSubdivisions, meshData);
+	return meshData;
+}
+
+void GeometryGenerator::CreateWedge(float width, float height, float depth, uint32 numSubdivisions, MeshData& meshData)
+{
+	meshData.Clear();
 
 	//
 	// Create the vertices.
@@ -347,13 +377,18 @@ GeometryGenerator::MeshData GeometryGenerator::CreateWedge(float width, float he
 
 	for (uint32 i = 0; i < numSubdivisions; ++i)
 		Subdivide(meshData);
-
-	return meshData;
 }
 
 GeometryGenerator::MeshData GeometryGenerator::CreatePyramid(float width, float height, float depth, uint32 numSubdivisions)
 {
 	MeshData meshData;
+	CreatePyramid(width, height, depth, numSubdivisions, meshData);
+	return meshData;
+}
+
+void GeometryGenerator::CreatePyramid(float width, float height, float depth, uint32 numSubdivisions, MeshData& meshData)
+{
+	meshData.Clear();
 
 	//
 	// Create the vertices.
@@ -422,13 +457,23 @@ GeometryGenerator::MeshData GeometryGenerator::CreatePyramid(float width, float
 
 	for (uint32 i = 0; i < numSubdivisions; ++i)
 		Subdivide(meshData);
-
-	return meshData;
 }
 
 GeometryGenerator::MeshData GeometryGenerator::CreateTorus(float radius, float innerRadius, uint32 sliceCount, uint32 stackCount)
 {
 	MeshData meshData;
+	CreateTorus(radius, innerRadius, sliceCount, stackCount, meshData);
+	return meshData;
+}
+
+void GeometryGenerator::CreateTorus(float radius, float innerRadius, uint32 sliceCount, uint32 stackCount, MeshData& meshData)
+{
+	meshData.Clear();
+
+	// The index loop below skips the first and last ring, so three stacks are the
+	// fewest that make a surface; fewer would wrap the unsigned counts around.
+	sliceCount = std::max<uint32>(sliceCount, 3);
+	stackCount = std::max<uint32>(stackCount, 3);
 
 	//
 	// Compute the vertices stating at the top pole and moving down the stacks.
@@ -440,25 +485,34 @@ GeometryGenerator::MeshData GeometryGenerator::CreateTorus(float radius, float i
 	
 
 	// Compute vertices for each stack ring (do not count the poles as rings).
+	meshData.Vertices.reserve((stackCount - 1)*(sliceCount + 1));
+	meshData.Indices32.reserve(6 * sliceCount*(stackCount - 2));
+
 	for (uint32 i = 1; i <= stackCount - 1; ++i)
 	{
 		float phi = i*phiStep;
 
+		float sinPhi, cosPhi;
+		XMScalarSinCos(&sinPhi, &cosPhi, phi);
+
 		// Vertices of ring.
 		for (uint32 j = 0; j <= sliceCount; ++j)
 		{
 			float theta = j*thetaStep;
 
+			float sinTheta, cosTheta;
+			XMScalarSinCos(&sinTheta, &cosTheta, theta);
+
 			Vertex v;
 
-			v.Position.x = cos(theta) * (radius + innerRadius * cos(phi));
-			v.Position.y = sin(theta) * (radius + innerRadius * cos(phi));
-			v.Position.z = innerRadius * sin(phi);
+			v.Position.x = cosTheta * (radius + innerRadius * cosPhi);
+			v.Position.y = sinTheta * (radius + innerRadius * cosPhi);
+			v.Position.z = innerRadius * sinPhi;
 
 			// Partial derivative of P with respect to theta
-			v.TangentU.x = -innerRadius * sin(phi);
+			v.TangentU.x = -innerRadius * sinPhi;
 			v.TangentU.y = 0.0f;
-			v.TangentU.z = cos(theta) * (radius + innerRadius * cos(phi));
+			v.TangentU.z = cosTheta * (radius + innerRadius * cosPhi);
 
 			XMVECTOR T = XMLoadFloat3(&v.TangentU);
 			XMStoreFloat3(&v.TangentU, XMVector3Normalize(T));
@@ -491,13 +545,23 @@ GeometryGenerator::MeshData GeometryGenerator::CreateTorus(float radius, float i
 		}
 	}
 	
+}
 
+GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32 sliceCount, uint32 stackCount)
+{
+	MeshData meshData;
+	CreateSphere(radius, sliceCount, stackCount, meshData);
 	return meshData;
 }
 
-GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32 sliceCount, uint32 stackCount)
+void GeometryGenerator::CreateSphere(float radius, uint32 sliceCount, uint32 stackCount, MeshData& meshData)
 {
-    MeshData meshData;
+    meshData.Clear();
+
+	// Two stacks, one ring between the poles, are the fewest the ring and cap
+	// loops handle; fewer would wrap the unsigned counts around.
+	sliceCount = std::max<uint32>(sliceCount, 3);
+	stackCount = std::max<uint32>(stackCount, 2);
 
 	//
 	// Compute the vertices stating at the top pole and moving down the stacks.
@@ -514,27 +578,36 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32
 	float phiStep   = XM_PI/stackCount;
 	float thetaStep = 2.0f*XM_PI/sliceCount;
 
+	meshData.Vertices.reserve((stackCount-1)*(sliceCount+1) + 2);
+	meshData.Indices32.reserve(6*sliceCount*(stackCount-1));
+
 	// Compute vertices for each stack ring (do not count the poles as rings).
 	for(uint32 i = 1; i <= stackCount-1; ++i)
 	{
 		float phi = i*phiStep;
 
+		float sinPhi, cosPhi;
+		XMScalarSinCos(&sinPhi, &cosPhi, phi);
+
 		// Vertices of ring.
         for(uint32 j = 0; j <= sliceCount; ++j)
 		{
 			float theta = j*thetaStep;
 
+			float sinTheta, cosTheta;
+			XMScalarSinCos(&sinTheta, &cosTheta, theta);
+
 			Vertex v;
 
 			// spherical to cartesian
-			v.Position.x = radius*sinf(phi)*cosf(theta);
-			v.Position.y = radius*cosf(phi);
-			v.Position.z = radius*sinf(phi)*sinf(theta);
+			v.Position.x = radius*sinPhi*cosTheta;
+			v.Position.y = radius*cosPhi;
+			v.Position.z = radius*sinPhi*sinTheta;
 
 			// Partial derivative of P with respect to theta
-			v.TangentU.x = -radius*sinf(phi)*sinf(theta);
+			v.TangentU.x = -radius*sinPhi*sinTheta;
 			v.TangentU.y = 0.0f;
-			v.TangentU.z = +radius*sinf(phi)*cosf(theta);
+			v.TangentU.z = +radius*sinPhi*cosTheta;
 
 			XMVECTOR T = XMLoadFloat3(&v.TangentU);
 			XMStoreFloat3(&v.TangentU, XMVector3Normalize(T));
@@ -602,18 +675,19 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32
 		meshData.Indices32.push_back(baseIndex+i);
 		meshData.Indices32.push_back(baseIndex+i+1);
 	}
-
-    return meshData;
 }
  
 void GeometryGenerator::Subdivide(MeshData& meshData)
 {
-	// Save a copy of the input geometry.
-	MeshData inputCopy = meshData;
-
+	// Move the input geometry aside; every input triangle becomes six vertices
+	// and four triangles.
+	MeshData inputCopy;
+	inputCopy.Vertices.swap(meshData.Vertices);
+	inputCopy.Indices32.swap(meshData.Indices32);
+	meshData.Clear();
 
-	meshData.Vertices.resize(0);
-	meshData.Indices32.resize(0);
+	meshData.Vertices.reserve(inputCopy.Indices32.size()*2);
+	meshData.Indices32.reserve(inputCopy.Indices32.size()*4);
 
 	//       v1
 	//       *
@@ -701,7 +775,14 @@ GeometryGenerator::Vertex GeometryGenerator::MidPoint(const Vertex& v0, const Ve
 
 GeometryGenerator::MeshData GeometryGenerator::CreateGeosphere(float radius, uint32 numSubdivisions)
 {
-    MeshData meshData;
+	MeshData meshData;
+	CreateGeosphere(radius, numSubdivisions, meshData);
+	return meshData;
+}
+
+void GeometryGenerator::CreateGeosphere(float radius, uint32 numSubdivisions, MeshData& meshData)
+{
+    meshData.Clear();
 
 	// Put a cap on the number of subdivisions.
     numSubdivisions = std::min<uint32>(numSubdivisions, 6u);
@@ -770,13 +851,22 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGeosphere(float radius, uin
 		XMVECTOR T = XMLoadFloat3(&meshData.Vertices[i].TangentU);
 		XMStoreFloat3(&meshData.Vertices[i].TangentU, XMVector3Normalize(T));
 	}
-
-    return meshData;
 }
 
 GeometryGenerator::MeshData GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount)
 {
-    MeshData meshData;
+	MeshData meshData;
+	CreateCylinder(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
+	return meshData;
+}
+
+void GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, MeshData& meshData)
+{
+    meshData.Clear();
+
+	// The stack height divides by the count.
+	sliceCount = std::max<uint32>(sliceCount, 3);
+	stackCount = std::max<uint32>(stackCount, 1);
 
 	//
 	// Build Stacks.
@@ -801,8 +891,8 @@ GeometryGenerator::MeshData GeometryGenerator::CreateCylinder(float bottomRadius
 		{
 			Vertex vertex;
 
-			float c = cosf(j*dTheta);
-			float s = sinf(j*dTheta);
+			float s, c;
+			XMScalarSinCos(&s, &c, j*dTheta);
 
 			vertex.Position = XMFLOAT3(r*c, y, r*s);
 
@@ -864,8 +954,6 @@ GeometryGenerator::MeshData GeometryGenerator::CreateCylinder(float bottomRadius
 
 	BuildCylinderTopCap(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
 	BuildCylinderBottomCap(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
-
-    return meshData;
 }
 
 void GeometryGenerator::BuildCylinderTopCap(float bottomRadius, float topRadius, float height,
@@ -879,8 +967,11 @@ void GeometryGenerator::BuildCylinderTopCap(float bottomRadius, float topRadius,
 	// Duplicate cap ring vertices because the texture coordinates and normals differ.
 	for(uint32 i = 0; i <= sliceCount; ++i)
 	{
-		float x = topRadius*cosf(i*dTheta);
-		float z = topRadius*sinf(i*dTheta);
+		float s, c;
+		XMScalarSinCos(&s, &c, i*dTheta);
+
+		float x = topRadius*c;
+		float z = topRadius*s;
 
 		// Scale down by the height to try and make top cap texture coord area
 		// proportional to base.
@@ -918,8 +1009,11 @@ void GeometryGenerator::BuildCylinderBottomCap(float bottomRadius, float topRadi
 	float dTheta = 2.0f*XM_PI/sliceCount;
 	for(uint32 i = 0; i <= sliceCount; ++i)
 	{
-		float x = bottomRadius*cosf(i*dTheta);
-		float z = bottomRadius*sinf(i*dTheta);
+		float s, c;
+		XMScalarSinCos(&s, &c, i*dTheta);
+
+		float x = bottomRadius*c;
+		float z = bottomRadius*s;
 
 		// Scale down by the height to try and make top cap texture coord area
 		// proportional to base.
@@ -945,7 +1039,18 @@ void GeometryGenerator::BuildCylinderBottomCap(float bottomRadius, float topRadi
 
 GeometryGenerator::MeshData GeometryGenerator::CreateGrid(float width, float depth, uint32 m, uint32 n)
 {
-    MeshData meshData;
+	MeshData meshData;
+	CreateGrid(width, depth, m, n, meshData);
+	return meshData;
+}
+
+void GeometryGenerator::CreateGrid(float width, float depth, uint32 m, uint32 n, MeshData& meshData)
+{
+    meshData.Clear();
+
+	// A grid needs two rows and two columns of vertices for one quad.
+	m = std::max<uint32>(m, 2);
+	n = std::max<uint32>(n, 2);
 
 	uint32 vertexCount = m*n;
 	uint32 faceCount   = (m-1)*(n-1)*2;
@@ -1004,8 +1109,6 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGrid(float width, float dep
 			k += 6; // next quad
 		}
 	}
-
-    return meshData;
 }
 
 GeometryGenerator::MeshData GeometryGenerator::CreateQuad(float x, float y, float w, float h, float depth)
@@ -1050,3 +1153,257 @@ GeometryGenerator::MeshData GeometryGenerator::CreateQuad(float x, float y, floa
 
     return meshData;
 }
+
+GeometryGenerator::uint32 GeometryGenerator::LodTessellation(uint32 count, uint32 level, uint32 minCount)
+{
+	if(count <= minCount)
+		return count;
+
+	return std::max<uint32>(count >> std::min<uint32>(level, 31u), minCount);
+}
+
+GeometryGenerator::LodChain GeometryGenerator::CreateBoxLods(float width, float height, float depth, uint32 numSubdivisions, uint32 numLevels)
+{
+	ShapeDesc desc = { ShapeType::Box, { width, height, depth }, { numSubdivisions, 0 } };
+	return CreateLods(desc, numLevels);
+}
+
+GeometryGenerator::LodChain GeometryGenerator::CreateDiamondLods(float width, float height, float depth, uint32 numSubdivisions, uint32 numLevels)
+{
+	ShapeDesc desc = { ShapeType::Diamond, { width, height, depth }, { numSubdivisions, 0 } };
+	return CreateLods(desc, numLevels);
+}
+
+GeometryGenerator::LodChain GeometryGenerator::CreateConeLods(float radius, float height, uint32 sliceCount, uint32 stackCount, uint32 numLevels)
+{
+	ShapeDesc desc = { ShapeType::Cone, { radius, height, 0.0f }, { sliceCount, stackCount } };
+	return CreateLods(desc, numLevels);
+}
+
+GeometryGenerator::LodChain GeometryGenerator::CreateWedgeLods(float width, float height, float depth, uint32 numSubdivisions, uint32 numLevels)
+{
+	ShapeDesc desc = { ShapeType::Wedge, { width, height, depth }, { numSubdivisions, 0 } };
+	return CreateLods(desc, numLevels);
+}
+
+GeometryGenerator::LodChain GeometryGenerator::CreatePyramidLods(float width, float height, float depth, uint32 numSubdivisions, uint32 numLevels)
+{
+	ShapeDesc desc = { ShapeType::Pyramid, { width, height, depth }, { numSubdivisions, 0 } };
+	return CreateLods(desc, numLevels);
+}
+
+GeometryGenerator::LodChain GeometryGenerator::CreateTorusLods(float radius, float innerRadius, uint32 sliceCount, uint32 stackCount, uint32 numLevels)
+{
+	ShapeDesc desc = { ShapeType::Torus, { radius, innerRadius, 0.0f }, { sliceCount, stackCount } };
+	return CreateLods(desc, numLevels);
+}
+
+GeometryGenerator::LodChain GeometryGenerator::CreateSphereLods(float radius, uint32 sliceCount, uint32 stackCount, uint32 numLevels)
+{
+	ShapeDesc desc = { ShapeType::Sphere, { radius, 0.0f, 0.0f }, { sliceCount, stackCount } };
+	return CreateLods(desc, numLevels);
+}
+
+GeometryGenerator::LodChain GeometryGenerator::CreateCylinderLods(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, uint32 numLevels)
+{
+	ShapeDesc desc = { ShapeType::Cylinder, { bottomRadius, topRadius, height }, { sliceCount, stackCount } };
+	return CreateLods(desc, numLevels);
+}
+
+GeometryGenerator::LodChain GeometryGenerator::CreateGridLods(float width, float depth, uint32 m, uint32 n, uint32 numLevels)
+{
+	ShapeDesc desc = { ShapeType::Grid, { width, depth, 0.0f }, { m, n } };
+	return CreateLods(desc, numLevels);
+}
+
+GeometryGenerator::LodChain GeometryGenerator::CreateLods(const ShapeDesc& desc, uint32 numLevels)
+{
+	std::vector<ShapeDesc> levels;
+	AppendLods(desc, numLevels, levels);
+
+	LodChain lods(levels.size());
+	for(size_t i = 0; i < levels.size(); ++i)
+		Create(levels[i], lods[i]);
+
+	return lods;
+}
+
+GeometryGenerator::MeshData GeometryGenerator::Create(const ShapeDesc& desc)
+{
+	MeshData meshData;
+	Create(desc, meshData);
+	return meshData;
+}
+
+void GeometryGenerator::Create(const ShapeDesc& desc, MeshData& meshData)
+{
+	const float* s = desc.Size;
+	const uint32* t = desc.Tessellation;
+
+	switch(desc.Type)
+	{
+	case ShapeType::Box:       CreateBox(s[0], s[1], s[2], t[0], meshData); break;
+	case ShapeType::Diamond:   CreateDiamond(s[0], s[1], s[2], t[0], meshData); break;
+	case ShapeType::Cone:      CreateCone(s[0], s[1], t[0], t[1], meshData); break;
+	case ShapeType::Wedge:     CreateWedge(s[0], s[1], s[2], t[0], meshData); break;
+	case ShapeType::Pyramid:   CreatePyramid(s[0], s[1], s[2], t[0], meshData); break;
+	case ShapeType::Torus:     CreateTorus(s[0], s[1], t[0], t[1], meshData); break;
+	case ShapeType::Sphere:    CreateSphere(s[0], t[0], t[1], meshData); break;
+	case ShapeType::Geosphere: CreateGeosphere(s[0], t[0], meshData); break;
+	case ShapeType::Cylinder:  CreateCylinder(s[0], s[1], s[2], t[0], t[1], meshData); break;
+	case ShapeType::Grid:      CreateGrid(s[0], s[1], t[0], t[1], meshData); break;
+	}
+}
+
+GeometryGenerator::uint32 GeometryGenerator::AppendLods(const ShapeDesc& desc, uint32 numLevels, std::vector<ShapeDesc>& levels)
+{
+	// Smallest slice and stack (or row and column) counts a level may drop to.
+	uint32 minCount[2] = { 0, 0 };
+	switch(desc.Type)
+	{
+	case ShapeType::Cone:
+	case ShapeType::Cylinder: minCount[0] = 6; minCount[1] = 1; break;
+	case ShapeType::Torus:    minCount[0] = 6; minCount[1] = 8; break;
+	case ShapeType::Sphere:   minCount[0] = 6; minCount[1] = 4; break;
+	case ShapeType::Grid:     minCount[0] = 2; minCount[1] = 2; break;
+
+	default:
+	{
+		// Subdividing flat faces only adds vertices, so the coarser levels look the same.
+		uint32 count = 0;
+		for(uint32 level = 0; level < numLevels && level <= desc.Tessellation[0]; ++level, ++count)
+		{
+			ShapeDesc lod = desc;
+			lod.Tessellation[0] = desc.Tessellation[0] - level;
+			levels.push_back(lod);
+		}
+
+		return count;
+	}
+	}
+
+	uint32 count = 0;
+	for(uint32 level = 0; level < numLevels; ++level, ++count)
+	{
+		ShapeDesc lod = desc;
+		lod.Tessellation[0] = LodTessellation(desc.Tessellation[0], level, minCount[0]);
+		lod.Tessellation[1] = LodTessellation(desc.Tessellation[1], level, minCount[1]);
+		if(level > 0 && lod.Tessellation[0] == levels.back().Tessellation[0] && lod.Tessellation[1] == levels.back().Tessellation[1])
+			break;
+
+		levels.push_back(lod);
+	}
+
+	return count;
+}
+
+bool GeometryGenerator::MeasureBatch(const std::vector<ShapeDesc>& shapes, std::vector<BatchRange>& ranges,
+	uint32& vertexCount, uint32& indexCount)
+{
+	// The counts only depend on the type and the tessellation, so each distinct
+	// tessellation is generated once however many sizes of it the batch has.
+	std::map<std::tuple<ShapeType, uint32, uint32>, std::pair<uint32, uint32>> counts;
+	MeshData scratch;
+
+	ranges.resize(shapes.size());
+	vertexCount = 0;
+	indexCount = 0;
+	bool indexable = true;
+	for(size_t i = 0; i < shapes.size(); ++i)
+	{
+		const ShapeDesc& desc = shapes[i];
+
+		auto key = std::make_tuple(desc.Type, desc.Tessellation[0], desc.Tessellation[1]);
+		auto it = counts.find(key);
+		if(it == counts.end())
+		{
+			Create(desc, scratch);
+			it = counts.emplace(key, std::make_pair((uint32)scratch.Vertices.size(), (uint32)scratch.Indices32.size())).first;
+		}
+
+		ranges[i].BaseVertex = vertexCount;
+		ranges[i].VertexCount = it->second.first;
+		ranges[i].StartIndex = indexCount;
+		ranges[i].IndexCount = it->second.second;
+
+		vertexCount += ranges[i].VertexCount;
+		indexCount += ranges[i].IndexCount;
+		indexable = indexable && ranges[i].VertexCount <= 0x10000;
+	}
+
+	return indexable;
+}
+
+void GeometryGenerator::CreateBatch(const std::vector<ShapeDesc>& shapes, const std::vector<BatchRange>& ranges,
+	const VertexLayout& layout, void* vertices, uint16* indices, ThreadPool* threadPool)
+{
+	assert(ranges.size() == shapes.size());
+
+	// Every job builds its shapes in one scratch mesh, so after the first shape
+	// the generators no longer allocate.
+	auto build = [&](size_t begin, size_t end)
+	{
+		MeshData scratch;
+		for(size_t i = begin; i < end; ++i)
+		{
+			Create(shapes[i], scratch);
+			WriteBatchShape(scratch, ranges[i], layout, vertices, indices);
+		}
+	};
+
+	if(threadPool == nullptr || shapes.size() < 2)
+	{
+		build(0, shapes.size());
+		return;
+	}
+
+	// Contiguous runs of shapes with about the same number of indices each.  A few
+	// jobs per thread even out the shapes that take longer than their size suggests.
+	const size_t jobCount = std::min<size_t>(shapes.size(), threadPool->ThreadCount() * 4);
+
+	std::uint64_t totalIndices = 0;
+	for(const BatchRange& range : ranges)
+		totalIndices += range.IndexCount;
+
+	size_t begin = 0;
+	std::uint64_t indicesSoFar = 0;
+	for(size_t job = 1; job <= jobCount && begin < shapes.size(); ++job)
+	{
+		const std::uint64_t target = totalIndices * job / jobCount;
+
+		size_t end = begin;
+		while(end < shapes.size() && (end == begin || indicesSoFar < target))
+			indicesSoFar += ranges[end++].IndexCount;
+
+		if(job == jobCount)
+			end = shapes.size();
+
+		threadPool->Enqueue([&build, begin, end]() { build(begin, end); });
+		begin = end;
+	}
+
+	threadPool->Wait();
+}
+
+void GeometryGenerator::WriteBatchShape(const MeshData& meshData, const BatchRange& range,
+	const VertexLayout& layout, void* vertices, uint16* indices)
+{
+	assert(meshData.Vertices.size() == range.VertexCount && meshData.Indices32.size() == range.IndexCount);
+	assert(range.VertexCount <= 0x10000);
+
+	char* dst = static_cast<char*>(vertices) + (size_t)range.BaseVertex*layout.Stride;
+	for(const Vertex& v : meshData.Vertices)
+	{
+		XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(dst + layout.PositionOffset), XMLoadFloat3(&v.Position));
+		XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(dst + layout.NormalOffset), XMLoadFloat3(&v.Normal));
+		if(layout.TangentOffset != VertexLayout::NoElement)
+			XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(dst + layout.TangentOffset), XMLoadFloat3(&v.TangentU));
+		XMStoreFloat2(reinterpret_cast<XMFLOAT2*>(dst + layout.TexCOffset), XMLoadFloat2(&v.TexC));
+
+		dst += layout.Stride;
+	}
+
+	uint16* dstIndices = indices + range.StartIndex;
+	for(size_t i = 0; i < meshData.Indices32.size(); ++i)
+		dstIndices[i] = static_cast<uint16>(meshData.Indices32[i]);
+}
@@ -18,6 +18,8 @@
 #include <DirectXMath.h>
 #include <vector>
 
+class ThreadPool;
+
 class GeometryGenerator
 {
 public:
@@ -70,57 +72,123 @@ public:
 			return mIndices16;
         }
 
+		// Empties the mesh but keeps its storage for the next mesh built into it.
+		void Clear()
+		{
+			Vertices.clear();
+			Indices32.clear();
+			mIndices16.clear();
+		}
+
 	private:
 		std::vector<uint16> mIndices16;
 	};
 
+	// Detail levels of one shape, most detailed first.
+	using LodChain = std::vector<MeshData>;
+
+	enum class ShapeType
+	{
+		Box,
+		Diamond,
+		Cone,
+		Wedge,
+		Pyramid,
+		Torus,
+		Sphere,
+		Geosphere,
+		Cylinder,
+		Grid
+	};
+
+	// Parameters of one shape, for the batch functions.  Size and Tessellation hold
+	// the float and the integer parameters of the matching Create function in
+	// order; e.g. bottom radius, top radius and height, then slices and stacks for
+	// a cylinder.  Unused entries should be zero.
+	struct ShapeDesc
+	{
+		ShapeType Type;
+		float Size[3];
+		uint32 Tessellation[2];
+	};
+
+	// Byte layout of the vertices CreateBatch writes.  The defaults are those of
+	// Vertex; TangentOffset can be NoElement for layouts without a tangent.
+	struct VertexLayout
+	{
+		static const uint32 NoElement = 0xffffffff;
+
+		uint32 Stride = sizeof(Vertex);
+		uint32 PositionOffset = 0;
+		uint32 NormalOffset = 12;
+		uint32 TangentOffset = 24;
+		uint32 TexCOffset = 36;
+	};
+
+	// Where one shape of a batch is written.
+	struct BatchRange
+	{
+		uint32 BaseVertex = 0;
+		uint32 VertexCount = 0;
+		uint32 StartIndex = 0;
+		uint32 IndexCount = 0;
+	};
+
 	///<summary>
 	/// Creates a box centered at the origin with the given dimensions, where each
     /// face has m rows and n columns of vertices.
 	///</summary>
     MeshData CreateBox(float width, float height, float depth, uint32 numSubdivisions);
+    void CreateBox(float width, float height, float depth, uint32 numSubdivisions, MeshData& meshData);
 
 	///<summary>
 	/// Creates a Diamond centered at the origin with the given dimensions, where each
 	/// face has m rows and n columns of vertices.
 	///</summary>
 	MeshData CreateDiamond(float width, float height, float depth, uint32 numSubdivisions);
+	void CreateDiamond(float width, float height, float depth, uint32 numSubdivisions, MeshData& meshData);
 
 	///<summary>
 	/// Creates a Cone centered at the origin with the given dimensions, where each
 	/// face has m rows and n columns of vertices.
 	///</summary>
 	MeshData CreateCone(float radius, float height, uint32 sliceCount, uint32 stackCount);
+	void CreateCone(float radius, float height, uint32 sliceCount, uint32 stackCount, MeshData& meshData);
 
 	///<summary>
 	/// Creates a Cone centered at the origin with the given dimensions, where each
 	/// face has m rows and n columns of vertices.
 	///</summary>
 	MeshData CreateWedge(float width, float height, float depth, uint32 numSubdivisions);
+	void CreateWedge(float width, float height, float depth, uint32 numSubdivisions, MeshData& meshData);
 
 	///<summary>
 	/// Creates a Pyramid centered at the origin with the given dimensions, where each
 	/// face has m rows and n columns of vertices.
 	///</summary>
 	MeshData CreatePyramid(float width, float height, float depth, uint32 numSubdivisions);
+	void CreatePyramid(float width, float height, float depth, uint32 numSubdivisions, MeshData& meshData);
 
 	///<summary>
 	/// Creates a Torus centered at the origin with the given dimensions, where each
 	/// face has m rows and n columns of vertices.
 	///</summary>
 	MeshData CreateTorus(float radius, float innerRadius, uint32 sliceCount, uint32 stackCount);
+	void CreateTorus(float radius, float innerRadius, uint32 sliceCount, uint32 stackCount, MeshData& meshData);
 
 	///<summary>
 	/// Creates a sphere centered at the origin with the given radius.  The
 	/// slices and stacks parameters control the degree of tessellation.
 	///</summary>
     MeshData CreateSphere(float radius, uint32 sliceCount, uint32 stackCount);
+    void CreateSphere(float radius, uint32 sliceCount, uint32 stackCount, MeshData& meshData);
 
 	///<summary>
 	/// Creates a geosphere centered at the origin with the given radius.  The
 	/// depth controls the level of tessellation.
 	///</summary>
     MeshData CreateGeosphere(float radius, uint32 numSubdivisions);
+    void CreateGeosphere(float radius, uint32 numSubdivisions, MeshData& meshData);
 
 	///<summary>
 	/// Creates a cylinder parallel to the y-axis, and centered about the origin.  
@@ -128,19 +196,74 @@ public:
 	// cylinders.  The slices and stacks parameters control the degree of tessellation.
 	///</summary>
     MeshData CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount);
+    void CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, MeshData& meshData);
 
 	///<summary>
 	/// Creates an mxn grid in the xz-plane with m rows and n columns, centered
 	/// at the origin with the specified width and depth.
 	///</summary>
     MeshData CreateGrid(float width, float depth, uint32 m, uint32 n);
+    void CreateGrid(float width, float depth, uint32 m, uint32 n, MeshData& meshData);
 
 	///<summary>
 	/// Creates a quad aligned with the screen.  This is useful for postprocessing and screen effects.
 	///</summary>
     MeshData CreateQuad(float x, float y, float w, float h, float depth);
 
+	///<summary>
+	/// Create up to numLevels detail levels of a shape for distance based LOD
+	/// selection.  The first level is the shape as the matching Create function
+	/// builds it; each further level halves the subdivisions, slices, stacks or
+	/// rows and columns of the previous one.  The chain stops early once the shape
+	/// is at its coarsest tessellation.
+	///</summary>
+	LodChain CreateBoxLods(float width, float height, float depth, uint32 numSubdivisions, uint32 numLevels);
+	LodChain CreateDiamondLods(float width, float height, float depth, uint32 numSubdivisions, uint32 numLevels);
+	LodChain CreateConeLods(float radius, float height, uint32 sliceCount, uint32 stackCount, uint32 numLevels);
+	LodChain CreateWedgeLods(float width, float height, float depth, uint32 numSubdivisions, uint32 numLevels);
+	LodChain CreatePyramidLods(float width, float height, float depth, uint32 numSubdivisions, uint32 numLevels);
+	LodChain CreateTorusLods(float radius, float innerRadius, uint32 sliceCount, uint32 stackCount, uint32 numLevels);
+	LodChain CreateSphereLods(float radius, uint32 sliceCount, uint32 stackCount, uint32 numLevels);
+	LodChain CreateCylinderLods(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, uint32 numLevels);
+	LodChain CreateGridLods(float width, float depth, uint32 m, uint32 n, uint32 numLevels);
+	LodChain CreateLods(const ShapeDesc& desc, uint32 numLevels);
+
+	///<summary>
+	/// Creates the shape desc describes with the matching Create function.
+	///</summary>
+	MeshData Create(const ShapeDesc& desc);
+	void Create(const ShapeDesc& desc, MeshData& meshData);
+
+	///<summary>
+	/// Appends the detail levels CreateLods would build for desc to levels and
+	/// returns how many there are.
+	///</summary>
+	uint32 AppendLods(const ShapeDesc& desc, uint32 numLevels, std::vector<ShapeDesc>& levels);
+
+	///<summary>
+	/// Batch generation for building many shapes at once.  MeasureBatch lays the
+	/// shapes out back to back and returns the total vertex and index counts, so
+	/// the caller can size one arena for all of them.  CreateBatch then generates
+	/// the shapes on threadPool (or the calling thread if it is null) straight into
+	/// the arena: vertices in the given layout, and 16-bit indices relative to the
+	/// shape's BaseVertex.  MeasureBatch returns false if a shape has more than
+	/// the 65536 vertices a 16-bit index reaches; such a batch cannot be created.
+	///</summary>
+	bool MeasureBatch(const std::vector<ShapeDesc>& shapes, std::vector<BatchRange>& ranges,
+		uint32& vertexCount, uint32& indexCount);
+	void CreateBatch(const std::vector<ShapeDesc>& shapes, const std::vector<BatchRange>& ranges,
+		const VertexLayout& layout, void* vertices, uint16* indices, ThreadPool* threadPool);
+
 private:
+	// Tessellation of a detail level: count halved level times, but not below
+	// minCount (or count, if that is lower already).
+	static uint32 LodTessellation(uint32 count, uint32 level, uint32 minCount);
+
+	// Copies a mesh into its range of a batch arena.
+	static void WriteBatchShape(const MeshData& meshData, const BatchRange& range,
+		const VertexLayout& layout, void* vertices, uint16* indices);
+
+
 	void Subdivide(MeshData& meshData);
     Vertex MidPoint(const Vertex& v0, const Vertex& v1);
     void BuildCylinderTopCap(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, MeshData& meshData);
@@ -0,0 +1,278 @@
+//***************************************************************************************
+// GpuMemoryAllocator.cpp
+//***************************************************************************************
+
+#include "GpuMemoryAllocator.h"
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	// Placed buffers are aligned to 64KB, so that is the smallest block.
+	const UINT64 MinBlockBytes = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+}
+
+GpuMemoryAllocator::GpuMemoryAllocator(ID3D12Device* device, IDXGIAdapter3* adapter,
+	UINT64 heapByteSize, UINT64 stagingByteSize) :
+	mDevice(device),
+	mAdapter(adapter)
+{
+	// A power of two, so every size class up to the heap size divides it.
+	mHeapByteSize = MinBlockBytes;
+	while(mHeapByteSize < heapByteSize)
+	{
+		mHeapByteSize *= 2;
+		++mHeapSizeClass;
+	}
+
+	mStaging = std::make_unique<UploadRingBuffer>(device, stagingByteSize);
+}
+
+ComPtr<ID3D12Resource> GpuMemoryAllocator::CreateBuffer(UINT64 byteSize,
+	D3D12_RESOURCE_FLAGS flags, D3D12_RESOURCE_STATES initialState)
+{
+	ComPtr<ID3D12Resource> buffer;
+
+	// Too large to pool.
+	if(byteSize > mHeapByteSize)
+	{
+		ThrowIfFailed(mDevice->CreateCommittedResource(
+			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+			D3D12_HEAP_FLAG_NONE,
+			&CD3DX12_RESOURCE_DESC::Buffer(byteSize, flags),
+			initialState,
+			nullptr,
+			IID_PPV_ARGS(&buffer)));
+
+		Block block;
+		block.ByteSize = byteSize;
+		mBlocks[buffer.Get()] = block;
+		return buffer;
+	}
+
+	Block block = AllocateBlock(byteSize);
+
+	HRESULT hr = mDevice->CreatePlacedResource(
+		mHeaps[block.Heap].Memory.Get(),
+		block.Offset,
+		&CD3DX12_RESOURCE_DESC::Buffer(byteSize, flags),
+		initialState,
+		nullptr,
+		IID_PPV_ARGS(&buffer));
+
+	if(FAILED(hr))
+	{
+		FreeBlock(block);
+		ThrowIfFailed(hr);
+	}
+
+	mBlocks[buffer.Get()] = block;
+	return buffer;
+}
+
+ComPtr<ID3D12Resource> GpuMemoryAllocator::CreateBuffer(ID3D12GraphicsCommandList* cmdList,
+	const void* initData, UINT64 byteSize)
+{
+	ComPtr<ID3D12Resource> buffer = CreateBuffer(byteSize, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_COPY_DEST);
+
+	ID3D12Resource* source = mStaging->Resource();
+	UploadRingBuffer::Allocation staging;
+	if(!mStaging->TryAllocate(byteSize, 16, staging))
+	{
+		// Larger than what is left of the ring; give this upload a buffer of its own.
+		ComPtr<ID3D12Resource> upload;
+		ThrowIfFailed(mDevice->CreateCommittedResource(
+			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+			D3D12_HEAP_FLAG_NONE,
+			&CD3DX12_RESOURCE_DESC::Buffer(byteSize),
+			D3D12_RESOURCE_STATE_GENERIC_READ,
+			nullptr,
+			IID_PPV_ARGS(&upload)));
+
+		ThrowIfFailed(upload->Map(0, nullptr, reinterpret_cast<void**>(&staging.CPU)));
+		staging.Offset = 0;
+
+		source = upload.Get();
+		mFrameUploads.push_back(upload);
+	}
+
+	memcpy(staging.CPU, initData, (size_t)byteSize);
+	if(source != mStaging->Resource())
+		source->Unmap(0, nullptr);
+
+	cmdList->CopyBufferRegion(buffer.Get(), 0, source, staging.Offset, byteSize);
+	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(buffer.Get(),
+		D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ));
+
+	return buffer;
+}
+
+void GpuMemoryAllocator::Free(ComPtr<ID3D12Resource>& resource, UINT64 fenceValue)
+{
+	if(resource == nullptr)
+		return;
+
+	PendingRelease release;
+	release.Fence = fenceValue;
+	release.Resource = std::move(resource);
+	mPendingReleases.push_back(std::move(release));
+
+	resource = nullptr;
+}
+
+void GpuMemoryAllocator::FinishFrame(UINT64 fenceValue)
+{
+	mStaging->FinishFrame(fenceValue);
+
+	for(ComPtr<ID3D12Resource>& upload : mFrameUploads)
+	{
+		PendingRelease release;
+		release.Fence = fenceValue;
+		release.Resource = std::move(upload);
+		mPendingReleases.push_back(std::move(release));
+	}
+	mFrameUploads.clear();
+}
+
+void GpuMemoryAllocator::Retire(UINT64 completedFenceValue)
+{
+	mStaging->Retire(completedFenceValue);
+
+	// Fence values are not necessarily freed in order, so look at all of them.
+	size_t kept = 0;
+	for(size_t i = 0; i < mPendingReleases.size(); ++i)
+	{
+		PendingRelease& release = mPendingReleases[i];
+		if(release.Fence > completedFenceValue)
+		{
+			if(kept != i)
+				mPendingReleases[kept] = std::move(release);
+			++kept;
+			continue;
+		}
+
+		auto it = mBlocks.find(release.Resource.Get());
+		if(it != mBlocks.end())
+		{
+			if(it->second.Heap != NoHeap)
+				FreeBlock(it->second);
+			mBlocks.erase(it);
+		}
+
+		release.Resource = nullptr;
+	}
+
+	mPendingReleases.resize(kept);
+}
+
+GpuMemoryAllocator::Stats GpuMemoryAllocator::GetStats()const
+{
+	Stats stats;
+	stats.HeapCount = (UINT)mHeaps.size();
+	stats.HeapBytes = (UINT64)mHeaps.size() * mHeapByteSize;
+
+	for(const auto& entry : mBlocks)
+	{
+		const Block& block = entry.second;
+		if(block.Heap == NoHeap)
+		{
+			++stats.CommittedCount;
+			stats.CommittedBytes += block.ByteSize;
+			continue;
+		}
+
+		++stats.BufferCount;
+		stats.BlockBytes += SizeClassBytes(block.SizeClass);
+		stats.RequestedBytes += block.ByteSize;
+	}
+
+	stats.StagingCapacity = mStaging->Capacity();
+	stats.StagingUsedBytes = mStaging->UsedBytes();
+	return stats;
+}
+
+GpuMemoryAllocator::Budget GpuMemoryAllocator::QueryBudget()const
+{
+	Budget budget;
+	if(mAdapter != nullptr)
+	{
+		mAdapter->QueryVideoMemoryInfo(0, DXGI_MEMORY_SEGMENT_GROUP_LOCAL, &budget.Local);
+		mAdapter->QueryVideoMemoryInfo(0, DXGI_MEMORY_SEGMENT_GROUP_NON_LOCAL, &budget.NonLocal);
+	}
+
+	return budget;
+}
+
+UINT64 GpuMemoryAllocator::SizeClassBytes(UINT sizeClass)const
+{
+	return MinBlockBytes << sizeClass;
+}
+
+GpuMemoryAllocator::Block GpuMemoryAllocator::AllocateBlock(UINT64 byteSize)
+{
+	Block block;
+	block.ByteSize = byteSize;
+	while(SizeClassBytes(block.SizeClass) < byteSize)
+		++block.SizeClass;
+
+	// Smallest free block that fits, in any heap.
+	UINT sizeClass = block.SizeClass;
+	for(; sizeClass <= mHeapSizeClass && block.Heap == NoHeap; ++sizeClass)
+	{
+		for(UINT h = 0; h < (UINT)mHeaps.size(); ++h)
+		{
+			std::set<UINT64>& freeBlocks = mHeaps[h].FreeBlocks[sizeClass];
+			if(!freeBlocks.empty())
+			{
+				block.Heap = h;
+				block.Offset = *freeBlocks.begin();
+				freeBlocks.erase(freeBlocks.begin());
+				break;
+			}
+		}
+	}
+
+	if(block.Heap == NoHeap)
+	{
+		// Every heap is full.  Buffers only heaps work on every resource heap tier.
+		Heap heap;
+		heap.FreeBlocks.resize(mHeapSizeClass + 1);
+
+		CD3DX12_HEAP_DESC heapDesc(mHeapByteSize, D3D12_HEAP_TYPE_DEFAULT, 0, D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS);
+		ThrowIfFailed(mDevice->CreateHeap(&heapDesc, IID_PPV_ARGS(&heap.Memory)));
+
+		block.Heap = (UINT)mHeaps.size();
+		block.Offset = 0;
+		sizeClass = mHeapSizeClass + 1;
+
+		mHeaps.push_back(std::move(heap));
+	}
+
+	// sizeClass is one past that of the block taken.  Halve the block down to the
+	// requested size class, freeing the upper halves.
+	Heap& heap = mHeaps[block.Heap];
+	while(--sizeClass > block.SizeClass)
+		heap.FreeBlocks[sizeClass - 1].insert(block.Offset + SizeClassBytes(sizeClass - 1));
+
+	return block;
+}
+
+void GpuMemoryAllocator::FreeBlock(const Block& block)
+{
+	Heap& heap = mHeaps[block.Heap];
+
+	// Merge with the buddy while it is free too.
+	UINT64 offset = block.Offset;
+	UINT sizeClass = block.SizeClass;
+	for(; sizeClass < mHeapSizeClass; ++sizeClass)
+	{
+		auto buddy = heap.FreeBlocks[sizeClass].find(offset ^ SizeClassBytes(sizeClass));
+		if(buddy == heap.FreeBlocks[sizeClass].end())
+			break;
+
+		heap.FreeBlocks[sizeClass].erase(buddy);
+		offset &= ~SizeClassBytes(sizeClass);
+	}
+
+	heap.FreeBlocks[sizeClass].insert(offset);
+}
@@ -0,0 +1,146 @@
+//***************************************************************************************
+// GpuMemoryAllocator.h
+//
+// Pooled GPU memory for buffers.  Default heap buffers are placed resources in a
+// few large ID3D12Heaps.  Every heap is a buddy allocator over power-of-two
+// blocks from 64KB up to the whole heap: a request takes the smallest free block
+// that fits, halving larger ones as needed, and a freed block merges back with
+// its free buddy.  All size classes share the heaps, so a new heap is only
+// created when none has room, and creating or freeing a buffer is a free list
+// operation instead of a trip through the driver's allocator.  Buffers larger
+// than a heap fall back to committed resources.
+//
+// Initial data goes through one shared staging ring whose space is handed back
+// by fence value, the same way as the per-frame UploadRingBuffer, so there are
+// no upload buffers to keep alive per resource.  Data that does not fit in the
+// ring gets a temporary upload buffer that is released the same way.
+//
+// Placed resources are not zeroed.  Create buffers that must start out zeroed as
+// committed resources.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "UploadRingBuffer.h"
+
+#include <set>
+
+class GpuMemoryAllocator
+{
+public:
+	static const UINT64 DefaultHeapByteSize = 64 * 1024 * 1024;
+	static const UINT64 DefaultStagingByteSize = 8 * 1024 * 1024;
+
+	struct Stats
+	{
+		UINT HeapCount = 0;
+		UINT64 HeapBytes = 0;
+
+		// Blocks handed out and the bytes the buffers in them asked for; the
+		// difference is lost to rounding up to the size class.
+		UINT BufferCount = 0;
+		UINT64 BlockBytes = 0;
+		UINT64 RequestedBytes = 0;
+
+		// Buffers too large for a heap.
+		UINT CommittedCount = 0;
+		UINT64 CommittedBytes = 0;
+
+		UINT64 StagingCapacity = 0;
+		UINT64 StagingUsedBytes = 0;
+	};
+
+	// What DXGI reports for the adapter's local (video) and non-local (system)
+	// memory segment groups.
+	struct Budget
+	{
+		DXGI_QUERY_VIDEO_MEMORY_INFO Local = {};
+		DXGI_QUERY_VIDEO_MEMORY_INFO NonLocal = {};
+	};
+
+	// heapByteSize is rounded up to a power of two.  adapter may be null, in which
+	// case QueryBudget() reports zeros.
+	GpuMemoryAllocator(ID3D12Device* device, IDXGIAdapter3* adapter,
+		UINT64 heapByteSize = DefaultHeapByteSize, UINT64 stagingByteSize = DefaultStagingByteSize);
+	GpuMemoryAllocator(const GpuMemoryAllocator& rhs) = delete;
+	GpuMemoryAllocator& operator=(const GpuMemoryAllocator& rhs) = delete;
+	~GpuMemoryAllocator() = default;
+
+	// Creates a default heap buffer in initialState.  Its contents are undefined.
+	// Buffers from either CreateBuffer go back through Free(), not by releasing
+	// the last reference.
+	Microsoft::WRL::ComPtr<ID3D12Resource> CreateBuffer(UINT64 byteSize,
+		D3D12_RESOURCE_FLAGS flags, D3D12_RESOURCE_STATES initialState);
+
+	// Creates a default heap buffer holding a copy of initData.  The copy is
+	// recorded on cmdList and leaves the buffer in GENERIC_READ; initData only has
+	// to live until the call returns.
+	Microsoft::WRL::ComPtr<ID3D12Resource> CreateBuffer(ID3D12GraphicsCommandList* cmdList,
+		const void* initData, UINT64 byteSize);
+
+	// Releases resource once the GPU has passed fenceValue and returns its block to
+	// the pool.  Works for any resource, so buffers that were not created here can
+	// share the deferred release.
+	void Free(Microsoft::WRL::ComPtr<ID3D12Resource>& resource, UINT64 fenceValue);
+
+	// Staging space used since the last call belongs to the commands that signal
+	// fenceValue.
+	void FinishFrame(UINT64 fenceValue);
+
+	// Frees the staging space and the resources of every fence value at or below
+	// completedFenceValue.
+	void Retire(UINT64 completedFenceValue);
+
+	Stats GetStats()const;
+	Budget QueryBudget()const;
+
+private:
+	static const UINT NoHeap = 0xffffffff;
+
+	struct Heap
+	{
+		Microsoft::WRL::ComPtr<ID3D12Heap> Memory;
+
+		// Offsets of the free blocks of every size class.
+		std::vector<std::set<UINT64>> FreeBlocks;
+	};
+
+	struct Block
+	{
+		UINT Heap = NoHeap;
+		UINT SizeClass = 0;
+		UINT64 Offset = 0;
+		UINT64 ByteSize = 0;
+	};
+
+	struct PendingRelease
+	{
+		UINT64 Fence = 0;
+		Microsoft::WRL::ComPtr<ID3D12Resource> Resource;
+	};
+
+	UINT64 SizeClassBytes(UINT sizeClass)const;
+	Block AllocateBlock(UINT64 byteSize);
+	void FreeBlock(const Block& block);
+
+	Microsoft::WRL::ComPtr<ID3D12Device> mDevice;
+	Microsoft::WRL::ComPtr<IDXGIAdapter3> mAdapter;
+
+	UINT64 mHeapByteSize = 0;
+
+	// Size class of a whole heap.
+	UINT mHeapSizeClass = 0;
+	std::vector<Heap> mHeaps;
+
+	// Block of every live buffer, by resource.
+	std::unordered_map<ID3D12Resource*, Block> mBlocks;
+
+	std::unique_ptr<UploadRingBuffer> mStaging;
+
+	// Upload buffers for the data that did not fit the ring, until FinishFrame()
+	// knows their fence.
+	std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> mFrameUploads;
+
+	std::vector<PendingRelease> mPendingReleases;
+};
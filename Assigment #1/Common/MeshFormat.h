@@ -0,0 +1,80 @@
+//***************************************************************************************
+// MeshFormat.h
+//
+// On-disk layout of the packed binary mesh container (.mesh).  The file is a
+// header followed by a vertex stream, an index stream and a submesh table, each
+// starting at the byte offset stored in the header.  All streams are stored in
+// the exact layout the GPU buffers use, so a loader can hand a memory-mapped
+// view of the file straight to the upload heap.
+//
+// This header only depends on the standard library so offline tools can share
+// it with the runtime loader.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+
+namespace MeshFormat
+{
+	// 'M' 'E' 'S' 'H' read as a little-endian uint32.
+	const std::uint32_t Magic = 0x4853454D;
+	const std::uint32_t Version = 2;
+
+	// Index stream element sizes.
+	const std::uint32_t IndexSize16 = 2;
+	const std::uint32_t IndexSize32 = 4;
+
+	// Stream offsets are aligned to this many bytes.
+	const std::uint32_t StreamAlignment = 16;
+
+	const std::uint32_t MaxSubmeshName = 32;
+
+	// Submeshes named <name>_lod1, <name>_lod2 and so on are the coarser detail
+	// levels of submesh <name>, stored after it in increasing level order.
+	const char* const LodSuffix = "_lod";
+
+	struct Header
+	{
+		std::uint32_t Magic;
+		std::uint32_t Version;
+
+		// Size in bytes of one vertex.  The runtime checks this matches its
+		// Vertex struct, a VertexCompression::CompressedVertex whose position is
+		// quantized within the bounds of the submeshes that use it.
+		std::uint32_t VertexStride;
+		std::uint32_t VertexCount;
+
+		// IndexSize16 or IndexSize32.
+		std::uint32_t IndexSize;
+		std::uint32_t IndexCount;
+
+		std::uint32_t SubmeshCount;
+		std::uint32_t Reserved;
+
+		std::uint64_t VertexDataOffset;
+		std::uint64_t IndexDataOffset;
+		std::uint64_t SubmeshTableOffset;
+	};
+
+	struct Submesh
+	{
+		char Name[MaxSubmeshName];
+
+		std::uint32_t IndexCount;
+		std::uint32_t StartIndexLocation;
+		std::int32_t  BaseVertexLocation;
+
+		// Local space axis-aligned bounding box.
+		float BoundsCenter[3];
+		float BoundsExtents[3];
+	};
+
+	static_assert(sizeof(Header) == 56, "MeshFormat::Header layout changed.");
+	static_assert(sizeof(Submesh) == 68, "MeshFormat::Submesh layout changed.");
+
+	inline std::uint64_t AlignOffset(std::uint64_t offset)
+	{
+		return (offset + StreamAlignment - 1) & ~std::uint64_t(StreamAlignment - 1);
+	}
+}
@@ -0,0 +1,212 @@
+//***************************************************************************************
+// MeshLoader.cpp
+//***************************************************************************************
+
+#include "MeshLoader.h"
+
+using Microsoft::WRL::ComPtr;
+using namespace DirectX;
+
+namespace
+{
+	// Written so that neither side can wrap around, whatever the header says.
+	bool FitsInFile(std::uint64_t offset, std::uint64_t byteSize, std::uint64_t fileSize)
+	{
+		return offset <= fileSize && byteSize <= fileSize - offset;
+	}
+}
+
+MappedMeshFile::~MappedMeshFile()
+{
+	Close();
+}
+
+bool MappedMeshFile::Open(const std::wstring& filename)
+{
+	Close();
+
+	mFile = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if(mFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if(!GetFileSizeEx(mFile, &fileSize) || fileSize.QuadPart < (LONGLONG)sizeof(MeshFormat::Header))
+	{
+		Close();
+		return false;
+	}
+	mFileSize = (std::uint64_t)fileSize.QuadPart;
+
+	mMapping = CreateFileMappingW(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if(mMapping == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	mView = reinterpret_cast<const std::uint8_t*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+	if(mView == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	// Validate the header before anyone dereferences the streams.
+	const MeshFormat::Header& header = GetHeader();
+	bool valid =
+		header.Magic == MeshFormat::Magic &&
+		header.Version == MeshFormat::Version &&
+		(header.IndexSize == MeshFormat::IndexSize16 || header.IndexSize == MeshFormat::IndexSize32);
+
+	if(valid)
+	{
+		std::uint64_t vbByteSize = (std::uint64_t)header.VertexCount * header.VertexStride;
+		std::uint64_t ibByteSize = (std::uint64_t)header.IndexCount * header.IndexSize;
+		std::uint64_t submeshByteSize = (std::uint64_t)header.SubmeshCount * sizeof(MeshFormat::Submesh);
+
+		valid =
+			FitsInFile(header.VertexDataOffset, vbByteSize, mFileSize) &&
+			FitsInFile(header.IndexDataOffset, ibByteSize, mFileSize) &&
+			FitsInFile(header.SubmeshTableOffset, submeshByteSize, mFileSize) &&
+			header.SubmeshTableOffset % alignof(MeshFormat::Submesh) == 0;
+	}
+
+	// Every submesh, detail levels included, has to draw from inside the streams.
+	for(std::uint32_t i = 0; valid && i < header.SubmeshCount; ++i)
+	{
+		const MeshFormat::Submesh& s = Submeshes()[i];
+		valid =
+			(std::uint64_t)s.StartIndexLocation + s.IndexCount <= header.IndexCount &&
+			s.BaseVertexLocation >= 0 && (std::uint32_t)s.BaseVertexLocation <= header.VertexCount;
+	}
+
+	if(!valid)
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void MappedMeshFile::Close()
+{
+	if(mView != nullptr)
+	{
+		UnmapViewOfFile(mView);
+		mView = nullptr;
+	}
+
+	if(mMapping != nullptr)
+	{
+		CloseHandle(mMapping);
+		mMapping = nullptr;
+	}
+
+	if(mFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(mFile);
+		mFile = INVALID_HANDLE_VALUE;
+	}
+
+	mFileSize = 0;
+}
+
+const MeshFormat::Header& MappedMeshFile::GetHeader()const
+{
+	return *reinterpret_cast<const MeshFormat::Header*>(mView);
+}
+
+const void* MappedMeshFile::VertexData()const
+{
+	return mView + GetHeader().VertexDataOffset;
+}
+
+const void* MappedMeshFile::IndexData()const
+{
+	return mView + GetHeader().IndexDataOffset;
+}
+
+const MeshFormat::Submesh* MappedMeshFile::Submeshes()const
+{
+	return reinterpret_cast<const MeshFormat::Submesh*>(mView + GetHeader().SubmeshTableOffset);
+}
+
+std::unique_ptr<MeshGeometry> MeshLoader::LoadMeshGeometry(
+	GpuMemoryAllocator* allocator,
+	ID3D12GraphicsCommandList* cmdList,
+	const std::wstring& filename,
+	const std::string& name,
+	UINT vertexByteStride)
+{
+	MappedMeshFile file;
+	if(!file.Open(filename))
+		return nullptr;
+
+	const MeshFormat::Header& header = file.GetHeader();
+	if(header.VertexStride != vertexByteStride)
+		return nullptr;
+
+	// MeshGeometry keeps the sizes as UINTs.
+	const std::uint64_t vbByteSize64 = (std::uint64_t)header.VertexCount * header.VertexStride;
+	const std::uint64_t ibByteSize64 = (std::uint64_t)header.IndexCount * header.IndexSize;
+	if(vbByteSize64 > UINT_MAX || ibByteSize64 > UINT_MAX)
+		return nullptr;
+
+	const UINT vbByteSize = (UINT)vbByteSize64;
+	const UINT ibByteSize = (UINT)ibByteSize64;
+
+	auto geo = std::make_unique<MeshGeometry>();
+	geo->Name = name;
+
+	// CreateBuffer copies into the staging ring before it returns, so the mapped
+	// view only has to outlive these two calls.
+	geo->VertexBufferGPU = allocator->CreateBuffer(cmdList, file.VertexData(), vbByteSize);
+	geo->IndexBufferGPU = allocator->CreateBuffer(cmdList, file.IndexData(), ibByteSize);
+
+	geo->VertexByteStride = header.VertexStride;
+	geo->VertexBufferByteSize = vbByteSize;
+	geo->IndexFormat = header.IndexSize == MeshFormat::IndexSize16 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+	geo->IndexBufferByteSize = ibByteSize;
+
+	const MeshFormat::Submesh* submeshes = file.Submeshes();
+	for(UINT i = 0; i < header.SubmeshCount; ++i)
+	{
+		const MeshFormat::Submesh& s = submeshes[i];
+
+		SubmeshGeometry submesh;
+		submesh.IndexCount = s.IndexCount;
+		submesh.StartIndexLocation = s.StartIndexLocation;
+		submesh.BaseVertexLocation = s.BaseVertexLocation;
+		submesh.Bounds.Center = XMFLOAT3(s.BoundsCenter);
+		submesh.Bounds.Extents = XMFLOAT3(s.BoundsExtents);
+
+		// Names are zero padded but not necessarily zero terminated.
+		size_t nameLength = 0;
+		while(nameLength < MeshFormat::MaxSubmeshName && s.Name[nameLength] != '\0')
+			++nameLength;
+
+		std::string submeshName(s.Name, nameLength);
+
+		// Detail levels follow their submesh in level order.
+		size_t suffix = submeshName.rfind(MeshFormat::LodSuffix);
+		if(suffix != std::string::npos && suffix > 0)
+		{
+			std::string baseName = submeshName.substr(0, suffix);
+			if(geo->DrawArgs.Contains(baseName))
+			{
+				SubmeshLod lod;
+				lod.IndexCount = s.IndexCount;
+				lod.StartIndexLocation = s.StartIndexLocation;
+				lod.BaseVertexLocation = s.BaseVertexLocation;
+				geo->DrawArgs.Get(baseName).Lods.push_back(lod);
+				continue;
+			}
+		}
+
+		geo->DrawArgs.Add(submeshName, submesh);
+	}
+
+	return geo;
+}
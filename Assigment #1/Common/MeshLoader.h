@@ -0,0 +1,61 @@
+//***************************************************************************************
+// MeshLoader.h
+//
+// Loads packed binary meshes (see MeshFormat.h) through a read-only memory-mapped
+// view of the file.  The vertex and index streams are copied from the mapped view
+// directly into the allocator's staging ring, without an intermediate system
+// memory copy.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "GpuMemoryAllocator.h"
+#include "MeshFormat.h"
+
+// Read-only memory-mapped view of a .mesh file.
+class MappedMeshFile
+{
+public:
+	MappedMeshFile() = default;
+	MappedMeshFile(const MappedMeshFile& rhs) = delete;
+	MappedMeshFile& operator=(const MappedMeshFile& rhs) = delete;
+	~MappedMeshFile();
+
+	// Maps the file and validates the header, the stream extents and the index
+	// and vertex ranges of the submeshes.  Returns false if the file is missing
+	// or malformed.
+	bool Open(const std::wstring& filename);
+	void Close();
+
+	const MeshFormat::Header& GetHeader()const;
+	const void* VertexData()const;
+	const void* IndexData()const;
+	const MeshFormat::Submesh* Submeshes()const;
+
+private:
+	HANDLE mFile = INVALID_HANDLE_VALUE;
+	HANDLE mMapping = nullptr;
+	const std::uint8_t* mView = nullptr;
+	std::uint64_t mFileSize = 0;
+};
+
+class MeshLoader
+{
+public:
+	// Creates the GPU buffers of a MeshGeometry from a .mesh file with allocator.
+	// The upload commands are recorded on cmdList, and the staging space is handed
+	// back by the allocator's fence.  Returns nullptr if the file cannot be loaded
+	// or its vertex stride differs from vertexByteStride.
+	//
+	// Detail level submeshes (see MeshFormat::LodSuffix) become the Lods of their
+	// submesh rather than submeshes of their own.
+	//
+	// The system memory copies (VertexBufferCPU/IndexBufferCPU) are not filled in.
+	static std::unique_ptr<MeshGeometry> LoadMeshGeometry(
+		GpuMemoryAllocator* allocator,
+		ID3D12GraphicsCommandList* cmdList,
+		const std::wstring& filename,
+		const std::string& name,
+		UINT vertexByteStride);
+};
@@ -0,0 +1,433 @@
+//***************************************************************************************
+// MeshOptimizer.cpp
+//***************************************************************************************
+
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	// Simulates a FIFO cache; returns the number of misses of the triangles in
+	// [firstTriangle, endTriangle).
+	std::size_t CountMisses(const std::uint32_t* indices, std::size_t firstTriangle, std::size_t endTriangle,
+		std::vector<std::uint32_t>& cacheTime, std::uint32_t& time, unsigned int cacheSize)
+	{
+		std::size_t misses = 0;
+		for(std::size_t i = firstTriangle*3; i < endTriangle*3; ++i)
+		{
+			std::uint32_t& stamp = cacheTime[indices[i]];
+			if(stamp == 0 || time - stamp >= cacheSize)
+			{
+				stamp = ++time;
+				++misses;
+			}
+		}
+
+		return misses;
+	}
+
+	struct Float3
+	{
+		double x, y, z;
+	};
+
+	Float3 LoadPosition(const float* positions, std::size_t stride, std::uint32_t index)
+	{
+		const float* p = reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + index*stride);
+		return Float3{ p[0], p[1], p[2] };
+	}
+}
+
+float MeshOptimizer::ComputeAcmr(const std::vector<std::uint32_t>& indices, std::size_t vertexCount,
+	unsigned int cacheSize)
+{
+	const std::size_t triangleCount = indices.size() / 3;
+	if(triangleCount == 0)
+		return 0.0f;
+
+	std::vector<std::uint32_t> cacheTime(vertexCount, 0);
+	std::uint32_t time = 0;
+	return (float)CountMisses(indices.data(), 0, triangleCount, cacheTime, time, cacheSize) / triangleCount;
+}
+
+void MeshOptimizer::OptimizeVertexCache(std::vector<std::uint32_t>& indices, std::size_t vertexCount)
+{
+	const std::size_t triangleCount = indices.size() / 3;
+	if(triangleCount == 0)
+		return;
+
+	//
+	// Tipsify, after Sander et al., "Fast Triangle Reordering for Vertex Locality
+	// and Reduced Overdraw".  All remaining triangles of a fanning vertex are
+	// emitted, then the fan moves on to the vertex that is still going to be in a
+	// FIFO cache of AcmrCacheSize after its own remaining triangles are drawn,
+	// preferring the one that entered the cache longest ago.  Dead ends continue
+	// with a recently used vertex that has triangles left.
+	//
+
+	const std::uint32_t cacheSize = AcmrCacheSize;
+
+	// Triangles of every vertex, as ranges of one array.
+	std::vector<std::uint32_t> live(vertexCount, 0);
+	for(std::size_t i = 0; i < triangleCount*3; ++i)
+		live[indices[i]]++;
+
+	std::vector<std::uint32_t> firstTriangle(vertexCount + 1, 0);
+	for(std::size_t v = 0; v < vertexCount; ++v)
+		firstTriangle[v + 1] = firstTriangle[v] + live[v];
+
+	std::vector<std::uint32_t> adjacency(triangleCount*3);
+	{
+		std::vector<std::uint32_t> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+		for(std::size_t i = 0; i < triangleCount*3; ++i)
+			adjacency[fill[indices[i]]++] = (std::uint32_t)(i / 3);
+	}
+
+	// Time each vertex last entered the cache; 0 is never.  Time starts past the
+	// cache size so that every vertex begins outside the cache.
+	std::vector<std::uint32_t> cacheTime(vertexCount, 0);
+	std::uint32_t time = cacheSize + 1;
+
+	std::vector<unsigned char> emitted(triangleCount, 0);
+	std::vector<std::uint32_t> deadEnds;
+	std::vector<std::uint32_t> candidates;
+
+	std::vector<std::uint32_t> result;
+	result.reserve(triangleCount*3);
+
+	std::size_t cursor = 0;
+	std::int64_t fan = indices[0];
+	while(fan >= 0)
+	{
+		candidates.clear();
+
+		const std::uint32_t f = (std::uint32_t)fan;
+		for(std::uint32_t a = firstTriangle[f]; a < firstTriangle[f + 1]; ++a)
+		{
+			const std::uint32_t t = adjacency[a];
+			if(emitted[t])
+				continue;
+
+			for(int k = 0; k < 3; ++k)
+			{
+				const std::uint32_t v = indices[t*3 + k];
+				deadEnds.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+
+				if(time - cacheTime[v] > cacheSize)
+					cacheTime[v] = time++;
+			}
+
+			emitted[t] = 1;
+			result.insert(result.end(), &indices[t*3], &indices[t*3] + 3);
+		}
+
+		// Next fan among the vertices just used.
+		fan = -1;
+		std::int64_t bestPriority = -1;
+		for(std::uint32_t v : candidates)
+		{
+			if(live[v] == 0)
+				continue;
+
+			std::int64_t priority = 0;
+			if(time - cacheTime[v] + 2*live[v] <= cacheSize)
+				priority = time - cacheTime[v];
+
+			if(priority > bestPriority)
+			{
+				bestPriority = priority;
+				fan = v;
+			}
+		}
+
+		// Dead end: the most recent vertex with triangles left, else the next one
+		// in order.
+		while(fan < 0 && !deadEnds.empty())
+		{
+			const std::uint32_t v = deadEnds.back();
+			deadEnds.pop_back();
+			if(live[v] > 0)
+				fan = v;
+		}
+
+		while(fan < 0 && cursor < vertexCount)
+		{
+			if(live[cursor] > 0)
+				fan = (std::int64_t)cursor;
+			++cursor;
+		}
+	}
+
+	// Some inputs, such as meshes exported by a tool that already optimized them,
+	// are better than the greedy order; keep those as they are.
+	if(ComputeAcmr(result, vertexCount) < ComputeAcmr(indices, vertexCount))
+		indices.swap(result);
+}
+
+void MeshOptimizer::OptimizeOverdraw(std::vector<std::uint32_t>& indices, const float* positions,
+	std::size_t vertexCount, std::size_t positionStride, float threshold)
+{
+	const std::size_t triangleCount = indices.size() / 3;
+	if(triangleCount == 0)
+		return;
+
+	//
+	// Clusters after Sander et al., "Fast Triangle Reordering for Vertex Locality
+	// and Reduced Overdraw".  A triangle that misses the cache on all three
+	// vertices starts a new cluster anyway.  Within those, a cluster may also end
+	// once its own ACMR is within threshold of the ACMR of the whole run, since
+	// moving it then costs little.
+	//
+
+	std::vector<std::uint32_t> cacheTime(vertexCount, 0);
+	std::uint32_t time = 0;
+
+	std::vector<std::size_t> hardBoundaries;
+	for(std::size_t t = 0; t < triangleCount; ++t)
+	{
+		if(CountMisses(indices.data(), t, t + 1, cacheTime, time, MeshOptimizer::AcmrCacheSize) == 3)
+			hardBoundaries.push_back(t);
+	}
+	hardBoundaries.push_back(triangleCount);
+
+	std::vector<std::size_t> clusterStarts;
+	for(std::size_t h = 0; h + 1 < hardBoundaries.size(); ++h)
+	{
+		const std::size_t begin = hardBoundaries[h];
+		const std::size_t end = hardBoundaries[h + 1];
+
+		std::fill(cacheTime.begin(), cacheTime.end(), 0);
+		time = 0;
+		const float runAcmr = (float)CountMisses(indices.data(), begin, end, cacheTime, time,
+			MeshOptimizer::AcmrCacheSize) / (end - begin);
+
+		std::fill(cacheTime.begin(), cacheTime.end(), 0);
+		time = 0;
+		clusterStarts.push_back(begin);
+
+		std::size_t misses = 0;
+		std::size_t clusterStart = begin;
+		for(std::size_t t = begin; t < end; ++t)
+		{
+			misses += CountMisses(indices.data(), t, t + 1, cacheTime, time, MeshOptimizer::AcmrCacheSize);
+
+			if(t + 1 < end && (float)misses / (t + 1 - clusterStart) <= threshold * runAcmr)
+			{
+				clusterStart = t + 1;
+				clusterStarts.push_back(clusterStart);
+				misses = 0;
+
+				// The next cluster may be drawn after anything, so assume a cold cache.
+				std::fill(cacheTime.begin(), cacheTime.end(), 0);
+				time = 0;
+			}
+		}
+	}
+	clusterStarts.push_back(triangleCount);
+
+	//
+	// Sort the clusters by how far they face away from the center of the mesh:
+	// the outer surface occludes more of the rest and is drawn first.
+	//
+
+	Float3 meshCenter = { 0.0, 0.0, 0.0 };
+	double meshArea = 0.0;
+
+	const std::size_t clusterCount = clusterStarts.size() - 1;
+	std::vector<Float3> clusterCenter(clusterCount, Float3{ 0.0, 0.0, 0.0 });
+	std::vector<Float3> clusterNormal(clusterCount, Float3{ 0.0, 0.0, 0.0 });
+	std::vector<double> clusterArea(clusterCount, 0.0);
+
+	for(std::size_t c = 0; c < clusterCount; ++c)
+	{
+		for(std::size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; ++t)
+		{
+			Float3 p0 = LoadPosition(positions, positionStride, indices[t*3]);
+			Float3 p1 = LoadPosition(positions, positionStride, indices[t*3 + 1]);
+			Float3 p2 = LoadPosition(positions, positionStride, indices[t*3 + 2]);
+
+			Float3 e0 = { p1.x - p0.x, p1.y - p0.y, p1.z - p0.z };
+			Float3 e1 = { p2.x - p0.x, p2.y - p0.y, p2.z - p0.z };
+			Float3 n = { e0.y*e1.z - e0.z*e1.y, e0.z*e1.x - e0.x*e1.z, e0.x*e1.y - e0.y*e1.x };
+			double area = 0.5 * std::sqrt(n.x*n.x + n.y*n.y + n.z*n.z);
+
+			clusterCenter[c].x += area * (p0.x + p1.x + p2.x) / 3.0;
+			clusterCenter[c].y += area * (p0.y + p1.y + p2.y) / 3.0;
+			clusterCenter[c].z += area * (p0.z + p1.z + p2.z) / 3.0;
+			clusterNormal[c].x += n.x;
+			clusterNormal[c].y += n.y;
+			clusterNormal[c].z += n.z;
+			clusterArea[c] += area;
+		}
+
+		meshCenter.x += clusterCenter[c].x;
+		meshCenter.y += clusterCenter[c].y;
+		meshCenter.z += clusterCenter[c].z;
+		meshArea += clusterArea[c];
+	}
+
+	if(meshArea > 0.0)
+	{
+		meshCenter.x /= meshArea;
+		meshCenter.y /= meshArea;
+		meshCenter.z /= meshArea;
+	}
+
+	std::vector<double> sortKey(clusterCount, 0.0);
+	for(std::size_t c = 0; c < clusterCount; ++c)
+	{
+		if(clusterArea[c] <= 0.0)
+			continue;
+
+		const Float3& n = clusterNormal[c];
+		const double length = std::sqrt(n.x*n.x + n.y*n.y + n.z*n.z);
+		if(length <= 0.0)
+			continue;
+
+		const double cx = clusterCenter[c].x / clusterArea[c] - meshCenter.x;
+		const double cy = clusterCenter[c].y / clusterArea[c] - meshCenter.y;
+		const double cz = clusterCenter[c].z / clusterArea[c] - meshCenter.z;
+		sortKey[c] = (cx*n.x + cy*n.y + cz*n.z) / length;
+	}
+
+	std::vector<std::uint32_t> order(clusterCount);
+	for(std::size_t c = 0; c < clusterCount; ++c)
+		order[c] = (std::uint32_t)c;
+	std::stable_sort(order.begin(), order.end(), [&](std::uint32_t a, std::uint32_t b)
+	{
+		return sortKey[a] > sortKey[b];
+	});
+
+	std::vector<std::uint32_t> result;
+	result.reserve(indices.size());
+	for(std::uint32_t c : order)
+		result.insert(result.end(), indices.begin() + clusterStarts[c]*3, indices.begin() + clusterStarts[c + 1]*3);
+
+	indices.swap(result);
+}
+
+std::size_t MeshOptimizer::ComputeWeldRemap(std::vector<std::uint32_t>& remap, const void* vertices,
+	std::size_t vertexCount, std::size_t vertexStride)
+{
+	const char* data = static_cast<const char*>(vertices);
+	remap.assign(vertexCount, UINT32_MAX);
+
+	// Open addressing table of vertex indices, at most half full.
+	std::size_t tableSize = 1;
+	while(tableSize < 2*vertexCount)
+		tableSize *= 2;
+	std::vector<std::uint32_t> table(tableSize, UINT32_MAX);
+
+	std::size_t uniqueCount = 0;
+	for(std::size_t v = 0; v < vertexCount; ++v)
+	{
+		const char* vertex = data + v*vertexStride;
+
+		// FNV-1a.
+		std::uint64_t hash = 14695981039346656037ull;
+		for(std::size_t b = 0; b < vertexStride; ++b)
+			hash = (hash ^ (unsigned char)vertex[b]) * 1099511628211ull;
+
+		std::size_t slot = (std::size_t)hash & (tableSize - 1);
+		while(table[slot] != UINT32_MAX && std::memcmp(data + (std::size_t)table[slot]*vertexStride, vertex, vertexStride) != 0)
+			slot = (slot + 1) & (tableSize - 1);
+
+		if(table[slot] == UINT32_MAX)
+		{
+			table[slot] = (std::uint32_t)v;
+			remap[v] = (std::uint32_t)uniqueCount++;
+		}
+		else
+		{
+			remap[v] = remap[table[slot]];
+		}
+	}
+
+	return uniqueCount;
+}
+
+std::vector<std::uint32_t> MeshOptimizer::ComputeVertexFetchRemap(
+	const std::vector<const std::vector<std::uint32_t>*>& indexLists, std::size_t vertexCount)
+{
+	std::vector<std::uint32_t> remap(vertexCount, UINT32_MAX);
+
+	std::uint32_t next = 0;
+	for(const std::vector<std::uint32_t>* indices : indexLists)
+	{
+		for(std::uint32_t index : *indices)
+		{
+			if(remap[index] == UINT32_MAX)
+				remap[index] = next++;
+		}
+	}
+
+	for(std::uint32_t& r : remap)
+	{
+		if(r == UINT32_MAX)
+			r = next++;
+	}
+
+	return remap;
+}
+
+void MeshOptimizer::RemapIndices(std::vector<std::uint32_t>& indices, const std::vector<std::uint32_t>& remap)
+{
+	for(std::uint32_t& index : indices)
+		index = remap[index];
+}
+
+void MeshOptimizer::RemapVertices(void* dest, const void* source, std::size_t vertexCount, std::size_t vertexStride,
+	const std::vector<std::uint32_t>& remap)
+{
+	const char* src = static_cast<const char*>(source);
+	char* dst = static_cast<char*>(dest);
+	for(std::size_t v = 0; v < vertexCount; ++v)
+		std::memcpy(dst + (std::size_t)remap[v]*vertexStride, src + v*vertexStride, vertexStride);
+}
+
+void MeshOptimizer::OptimizeTriangleOrder(std::vector<std::uint32_t>& indices, const float* positions,
+	std::size_t vertexCount, std::size_t positionStride, float overdrawThreshold)
+{
+	const float acmrInput = ComputeAcmr(indices, vertexCount);
+	OptimizeVertexCache(indices, vertexCount);
+	if(positions == nullptr)
+		return;
+
+	// OptimizeVertexCache keeps an input order that beats its own, and clustering
+	// that order again would undo the point of keeping it.
+	std::vector<std::uint32_t> clustered(indices);
+	OptimizeOverdraw(clustered, positions, vertexCount, positionStride, overdrawThreshold);
+	if(ComputeAcmr(clustered, vertexCount) <= acmrInput)
+		indices.swap(clustered);
+}
+
+MeshOptimizer::Stats MeshOptimizer::OptimizeMesh(std::vector<std::uint32_t>& indices, void* vertices,
+	std::size_t vertexCount, std::size_t vertexStride, std::size_t positionOffset, float overdrawThreshold)
+{
+	Stats stats;
+	stats.AcmrBefore = ComputeAcmr(indices, vertexCount);
+
+	std::vector<std::uint32_t> remap;
+	const std::size_t weldedCount = ComputeWeldRemap(remap, vertices, vertexCount, vertexStride);
+	RemapIndices(indices, remap);
+
+	std::vector<char> welded(weldedCount*vertexStride);
+	RemapVertices(welded.data(), vertices, vertexCount, vertexStride, remap);
+
+	OptimizeTriangleOrder(indices, weldedCount > 0 ? reinterpret_cast<const float*>(welded.data() + positionOffset) : nullptr,
+		weldedCount, vertexStride, overdrawThreshold);
+
+	remap = ComputeVertexFetchRemap({ &indices }, weldedCount);
+	RemapIndices(indices, remap);
+	RemapVertices(vertices, welded.data(), weldedCount, vertexStride, remap);
+
+	stats.AcmrAfter = ComputeAcmr(indices, weldedCount);
+	stats.VertexCountAfter = weldedCount;
+	return stats;
+}
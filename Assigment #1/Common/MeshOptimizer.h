@@ -0,0 +1,92 @@
+//***************************************************************************************
+// MeshOptimizer.h
+//
+// Triangle and vertex reordering for indexed triangle lists, with no change to
+// the rendered content:
+//
+//   1. ComputeWeldRemap merges vertices with identical bytes, so triangles that
+//      were built with their own copies of a vertex share it in the cache.
+//   2. OptimizeVertexCache reorders triangles for post-transform cache hits
+//      (Tipsify, tuned to a FIFO cache of AcmrCacheSize vertices).
+//   3. OptimizeOverdraw cuts that order into clusters at the points where doing
+//      so costs little cache efficiency and sorts the clusters so that outward
+//      facing ones come first, which lets early-Z reject more of the rest.
+//   4. ComputeVertexFetchRemap renumbers the vertices in order of first use so
+//      vertex fetch walks memory linearly.
+//
+// Run them in that order; OptimizeTriangleOrder does steps 2 and 3 and
+// OptimizeMesh all four for a mesh with a single index list.  ComputeAcmr reports the average cache miss ratio (transformed
+// vertices per triangle) of an order.
+//
+// This header only depends on the standard library so offline tools can use it.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace MeshOptimizer
+{
+	// Size of the FIFO cache ComputeAcmr simulates; a typical post-transform cache.
+	const unsigned int AcmrCacheSize = 16;
+
+	// Overdraw threshold the converter and the app use: clusters may cost up to 5%
+	// more cache misses than the order they were cut from.
+	const float DefaultOverdrawThreshold = 1.05f;
+
+	// Average number of cache misses per triangle of the triangle list with a FIFO
+	// cache of cacheSize vertices.  0.5 is the ideal for a large regular mesh and
+	// 3 the worst case.
+	float ComputeAcmr(const std::vector<std::uint32_t>& indices, std::size_t vertexCount,
+		unsigned int cacheSize = AcmrCacheSize);
+
+	// Reorders the triangles of the list for vertex cache hits.  The winding of
+	// every triangle is kept.
+	void OptimizeVertexCache(std::vector<std::uint32_t>& indices, std::size_t vertexCount);
+
+	// Reorders clusters of the cache optimized triangle list to reduce overdraw.
+	// A cluster may end wherever its ACMR is within threshold (e.g. DefaultOverdrawThreshold) times
+	// that of the order it was cut from.  positions points at the x, y, z floats of
+	// the first vertex and consecutive vertices are positionStride bytes apart.
+	void OptimizeOverdraw(std::vector<std::uint32_t>& indices, const float* positions,
+		std::size_t vertexCount, std::size_t positionStride, float threshold);
+
+	// OptimizeVertexCache, then OptimizeOverdraw unless the clustered order ends up
+	// with more cache misses than the input, which happens for inputs that were
+	// already in a good cache order.  positions may be null to skip overdraw.
+	void OptimizeTriangleOrder(std::vector<std::uint32_t>& indices, const float* positions,
+		std::size_t vertexCount, std::size_t positionStride, float overdrawThreshold);
+
+	// remap[v] is the first vertex with the same vertexStride bytes as vertex v,
+	// with the distinct vertices numbered in order.  Returns how many there are.
+	std::size_t ComputeWeldRemap(std::vector<std::uint32_t>& remap, const void* vertices,
+		std::size_t vertexCount, std::size_t vertexStride);
+
+	// remap[v] is the new index of vertex v when the vertices are numbered in order
+	// of first use by the index lists.  Vertices no list uses go to the end.  The
+	// lists are taken in order, so pass the full detail list first.
+	std::vector<std::uint32_t> ComputeVertexFetchRemap(
+		const std::vector<const std::vector<std::uint32_t>*>& indexLists, std::size_t vertexCount);
+
+	void RemapIndices(std::vector<std::uint32_t>& indices, const std::vector<std::uint32_t>& remap);
+
+	// Copies every vertexStride byte vertex v of source to remap[v] in dest, which
+	// must not overlap source.
+	void RemapVertices(void* dest, const void* source, std::size_t vertexCount, std::size_t vertexStride,
+		const std::vector<std::uint32_t>& remap);
+
+	struct Stats
+	{
+		float AcmrBefore = 0.0f;
+		float AcmrAfter = 0.0f;
+		std::size_t VertexCountAfter = 0;
+	};
+
+	// All four steps for a mesh with a single index list.  The welded vertices are
+	// written back over the first VertexCountAfter vertices of the input.  The
+	// position floats are at positionOffset in every vertex.
+	Stats OptimizeMesh(std::vector<std::uint32_t>& indices, void* vertices, std::size_t vertexCount,
+		std::size_t vertexStride, std::size_t positionOffset, float overdrawThreshold);
+}
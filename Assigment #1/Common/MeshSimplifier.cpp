@@ -0,0 +1,215 @@
+//***************************************************************************************
+// MeshSimplifier.cpp
+//***************************************************************************************
+
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <unordered_map>
+
+namespace
+{
+	struct Float3
+	{
+		double x, y, z;
+	};
+
+	// Symmetric 4x4 matrix summing the squared distances to a set of planes.
+	struct Quadric
+	{
+		double a2 = 0, ab = 0, ac = 0, ad = 0;
+		double b2 = 0, bc = 0, bd = 0;
+		double c2 = 0, cd = 0;
+		double d2 = 0;
+
+		void AddPlane(double a, double b, double c, double d, double weight)
+		{
+			a2 += weight*a*a; ab += weight*a*b; ac += weight*a*c; ad += weight*a*d;
+			b2 += weight*b*b; bc += weight*b*c; bd += weight*b*d;
+			c2 += weight*c*c; cd += weight*c*d;
+			d2 += weight*d*d;
+		}
+
+		double Error(const Float3& p)const
+		{
+			return a2*p.x*p.x + 2*ab*p.x*p.y + 2*ac*p.x*p.z + 2*ad*p.x
+				+ b2*p.y*p.y + 2*bc*p.y*p.z + 2*bd*p.y
+				+ c2*p.z*p.z + 2*cd*p.z
+				+ d2;
+		}
+	};
+
+	Float3 LoadPosition(const float* positions, std::size_t stride, std::uint32_t index)
+	{
+		const float* p = reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + index*stride);
+		return Float3{ p[0], p[1], p[2] };
+	}
+
+	// One clustering pass with gridSize cells along the longest axis of the bounds.
+	std::vector<std::uint32_t> Cluster(
+		const std::vector<Float3>& points,
+		const std::vector<std::uint32_t>& indices,
+		const Float3& boundsMin,
+		double extent,
+		std::uint32_t gridSize)
+	{
+		const double cellSize = extent / gridSize;
+
+		// Cell of every vertex, numbered in order of first use.
+		std::unordered_map<std::uint64_t, std::uint32_t> cellIds;
+		std::vector<std::uint32_t> vertexCell(points.size());
+		for(std::size_t i = 0; i < points.size(); ++i)
+		{
+			auto cellCoord = [&](double v, double lo)
+			{
+				return (std::uint64_t)std::min<double>(std::floor((v - lo) / cellSize), gridSize - 1);
+			};
+
+			std::uint64_t key =
+				(cellCoord(points[i].x, boundsMin.x) * (gridSize + 1) +
+				 cellCoord(points[i].y, boundsMin.y)) * (gridSize + 1) +
+				 cellCoord(points[i].z, boundsMin.z);
+
+			auto it = cellIds.emplace(key, (std::uint32_t)cellIds.size()).first;
+			vertexCell[i] = it->second;
+		}
+
+		// Sum the area weighted planes of the triangles touching each cell.
+		std::vector<Quadric> quadrics(cellIds.size());
+		for(std::size_t t = 0; t + 2 < indices.size(); t += 3)
+		{
+			const Float3& p0 = points[indices[t]];
+			const Float3& p1 = points[indices[t + 1]];
+			const Float3& p2 = points[indices[t + 2]];
+
+			Float3 e0 = { p1.x - p0.x, p1.y - p0.y, p1.z - p0.z };
+			Float3 e1 = { p2.x - p0.x, p2.y - p0.y, p2.z - p0.z };
+			Float3 n = { e0.y*e1.z - e0.z*e1.y, e0.z*e1.x - e0.x*e1.z, e0.x*e1.y - e0.y*e1.x };
+
+			double length = std::sqrt(n.x*n.x + n.y*n.y + n.z*n.z);
+			if(length <= 0.0)
+				continue;
+
+			double a = n.x / length, b = n.y / length, c = n.z / length;
+			double d = -(a*p0.x + b*p0.y + c*p0.z);
+
+			for(int k = 0; k < 3; ++k)
+				quadrics[vertexCell[indices[t + k]]].AddPlane(a, b, c, d, 0.5*length);
+		}
+
+		// Each cell keeps the vertex that best fits the surface around it.
+		std::vector<std::uint32_t> representative(cellIds.size(), UINT32_MAX);
+		std::vector<double> bestError(cellIds.size(), DBL_MAX);
+		for(std::size_t i = 0; i < points.size(); ++i)
+		{
+			std::uint32_t cell = vertexCell[i];
+			double error = quadrics[cell].Error(points[i]);
+			if(error < bestError[cell])
+			{
+				bestError[cell] = error;
+				representative[cell] = (std::uint32_t)i;
+			}
+		}
+
+		// Remap the triangles, dropping the ones that collapsed and the duplicates.
+		// Rotating every triangle to start at its smallest index keeps the winding
+		// while making duplicates compare equal.
+		struct Triangle
+		{
+			std::uint32_t v[3];
+			bool operator<(const Triangle& rhs)const
+			{
+				return std::lexicographical_compare(v, v + 3, rhs.v, rhs.v + 3);
+			}
+			bool operator==(const Triangle& rhs)const
+			{
+				return v[0] == rhs.v[0] && v[1] == rhs.v[1] && v[2] == rhs.v[2];
+			}
+		};
+
+		std::vector<Triangle> triangles;
+		triangles.reserve(indices.size() / 3);
+		for(std::size_t t = 0; t + 2 < indices.size(); t += 3)
+		{
+			Triangle tri;
+			for(int k = 0; k < 3; ++k)
+				tri.v[k] = representative[vertexCell[indices[t + k]]];
+
+			if(tri.v[0] == tri.v[1] || tri.v[1] == tri.v[2] || tri.v[0] == tri.v[2])
+				continue;
+
+			std::rotate(tri.v, std::min_element(tri.v, tri.v + 3), tri.v + 3);
+			triangles.push_back(tri);
+		}
+
+		// Keep the original triangle order apart from the duplicates, as the input
+		// order is usually the better one for the vertex cache.
+		std::vector<Triangle> sorted = triangles;
+		std::sort(sorted.begin(), sorted.end());
+		sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+		std::vector<unsigned char> emitted(sorted.size(), 0);
+		std::vector<std::uint32_t> result;
+		result.reserve(sorted.size() * 3);
+		for(const Triangle& tri : triangles)
+		{
+			std::size_t slot = std::lower_bound(sorted.begin(), sorted.end(), tri) - sorted.begin();
+			if(emitted[slot])
+				continue;
+
+			emitted[slot] = 1;
+			result.insert(result.end(), tri.v, tri.v + 3);
+		}
+
+		return result;
+	}
+}
+
+std::vector<std::uint32_t> MeshSimplifier::Simplify(
+	const float* positions,
+	std::size_t vertexCount,
+	std::size_t positionStride,
+	const std::vector<std::uint32_t>& indices,
+	std::size_t targetTriangleCount)
+{
+	if(indices.size() / 3 <= targetTriangleCount || vertexCount == 0)
+		return indices;
+
+	std::vector<Float3> points(vertexCount);
+	Float3 vMin = { +DBL_MAX, +DBL_MAX, +DBL_MAX };
+	Float3 vMax = { -DBL_MAX, -DBL_MAX, -DBL_MAX };
+	for(std::size_t i = 0; i < vertexCount; ++i)
+	{
+		points[i] = LoadPosition(positions, positionStride, (std::uint32_t)i);
+
+		vMin.x = std::min(vMin.x, points[i].x); vMax.x = std::max(vMax.x, points[i].x);
+		vMin.y = std::min(vMin.y, points[i].y); vMax.y = std::max(vMax.y, points[i].y);
+		vMin.z = std::min(vMin.z, points[i].z); vMax.z = std::max(vMax.z, points[i].z);
+	}
+
+	// Slightly larger than the bounds so the far faces fall inside the last cell.
+	const double extent = 1.0001 * std::max(std::max(vMax.x - vMin.x, vMax.y - vMin.y), std::max(vMax.z - vMin.z, 1e-6));
+
+	// The triangle count grows with the grid resolution, so binary search for the
+	// finest grid that still meets the target.
+	std::uint32_t lo = 1, hi = 1024;
+	std::vector<std::uint32_t> best = Cluster(points, indices, vMin, extent, lo);
+	while(lo < hi)
+	{
+		std::uint32_t mid = (lo + hi + 1) / 2;
+		std::vector<std::uint32_t> result = Cluster(points, indices, vMin, extent, mid);
+		if(result.size() / 3 <= targetTriangleCount)
+		{
+			lo = mid;
+			best.swap(result);
+		}
+		else
+		{
+			hi = mid - 1;
+		}
+	}
+
+	return best;
+}
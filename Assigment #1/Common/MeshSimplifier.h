@@ -0,0 +1,31 @@
+//***************************************************************************************
+// MeshSimplifier.h
+//
+// Triangle count reduction for building the coarser detail levels of imported
+// meshes.  Vertices are clustered on a uniform grid and every cluster collapses
+// onto the one original vertex with the least quadric error, so a simplified
+// level is just another index list over the mesh's existing vertex stream.
+//
+// This header only depends on the standard library so offline tools can use it.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace MeshSimplifier
+{
+	// Simplifies the triangle list in indices to at most targetTriangleCount
+	// triangles, or as close as the clustering gets.  positions points at the x, y,
+	// z floats of the first vertex and consecutive vertices are positionStride
+	// bytes apart.  The result indexes the same vertices; degenerate and duplicate
+	// triangles are removed.
+	std::vector<std::uint32_t> Simplify(
+		const float* positions,
+		std::size_t vertexCount,
+		std::size_t positionStride,
+		const std::vector<std::uint32_t>& indices,
+		std::size_t targetTriangleCount);
+}
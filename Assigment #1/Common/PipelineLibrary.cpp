@@ -0,0 +1,190 @@
+//***************************************************************************************
+// PipelineLibrary.cpp
+//***************************************************************************************
+
+#include "PipelineLibrary.h"
+
+#include <iomanip>
+
+using Microsoft::WRL::ComPtr;
+
+PipelineLibrary::PipelineLibrary(ID3D12Device* device, const std::wstring& filename) :
+	mDevice(device),
+	mFilename(filename)
+{
+	// Pipeline libraries need ID3D12Device1; without it every PSO is created from
+	// scratch.
+	ComPtr<ID3D12Device1> device1;
+	if(FAILED(mDevice->QueryInterface(IID_PPV_ARGS(&device1))))
+		return;
+
+	std::ifstream fin(mFilename, std::ios::binary);
+	if(fin)
+		mFileData.assign(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+
+	// Fails with D3D12_ERROR_DRIVER_VERSION_MISMATCH or D3D12_ERROR_ADAPTER_NOT_FOUND
+	// after a driver or GPU change, and with E_INVALIDARG if the file is corrupt.
+	// In every case start over with an empty library.
+	if(!mFileData.empty() &&
+		FAILED(device1->CreatePipelineLibrary(mFileData.data(), mFileData.size(), IID_PPV_ARGS(&mLibrary))))
+	{
+		mLibrary = nullptr;
+		mFileData.clear();
+	}
+
+	if(mLibrary == nullptr && FAILED(device1->CreatePipelineLibrary(nullptr, 0, IID_PPV_ARGS(&mLibrary))))
+		mLibrary = nullptr;
+}
+
+void PipelineLibrary::AddRootSignature(ID3D12RootSignature* rootSignature, ID3DBlob* serialized)
+{
+	mRootSignatureHashes[rootSignature] = d3dUtil::HashBytes(serialized->GetBufferPointer(), serialized->GetBufferSize());
+}
+
+ComPtr<ID3D12PipelineState> PipelineLibrary::CreateGraphicsPipeline(
+	const std::wstring& name,
+	const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc)
+{
+	std::uint64_t hash;
+	const bool cacheable = HashDesc(desc, hash);
+	std::wstring key = MakeKey(name, hash);
+
+	ComPtr<ID3D12PipelineState> pso;
+	if(cacheable && mLibrary != nullptr && SUCCEEDED(mLibrary->LoadGraphicsPipeline(key.c_str(), &desc, IID_PPV_ARGS(&pso))))
+	{
+		++mLoadedCount;
+		return pso;
+	}
+
+	ThrowIfFailed(mDevice->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(&pso)));
+	++mCreatedCount;
+
+	if(cacheable)
+		Store(key, pso.Get());
+	return pso;
+}
+
+ComPtr<ID3D12PipelineState> PipelineLibrary::CreateComputePipeline(
+	const std::wstring& name,
+	const D3D12_COMPUTE_PIPELINE_STATE_DESC& desc)
+{
+	std::uint64_t hash;
+	const bool cacheable = HashDesc(desc, hash);
+	std::wstring key = MakeKey(name, hash);
+
+	ComPtr<ID3D12PipelineState> pso;
+	if(cacheable && mLibrary != nullptr && SUCCEEDED(mLibrary->LoadComputePipeline(key.c_str(), &desc, IID_PPV_ARGS(&pso))))
+	{
+		++mLoadedCount;
+		return pso;
+	}
+
+	ThrowIfFailed(mDevice->CreateComputePipelineState(&desc, IID_PPV_ARGS(&pso)));
+	++mCreatedCount;
+
+	if(cacheable)
+		Store(key, pso.Get());
+	return pso;
+}
+
+void PipelineLibrary::Save()
+{
+	if(mLibrary == nullptr || !mDirty)
+		return;
+
+	std::vector<char> data(mLibrary->GetSerializedSize());
+	ThrowIfFailed(mLibrary->Serialize(data.data(), data.size()));
+
+	std::ofstream fout(mFilename, std::ios::binary);
+	fout.write(data.data(), data.size());
+	fout.close();
+
+	mDirty = false;
+}
+
+std::wstring PipelineLibrary::MakeKey(const std::wstring& name, std::uint64_t hash)const
+{
+	std::wostringstream key;
+	key << name << L'_' << std::hex << std::setw(16) << std::setfill(L'0') << hash;
+	return key.str();
+}
+
+void PipelineLibrary::Store(const std::wstring& key, ID3D12PipelineState* pso)
+{
+	// Storing only fails if the name is taken, which the hash should rule out; the
+	// PSO is still usable, it just is not cached.
+	if(mLibrary != nullptr && SUCCEEDED(mLibrary->StorePipeline(key.c_str(), pso)))
+		mDirty = true;
+}
+
+bool PipelineLibrary::HashDesc(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, std::uint64_t& hash)const
+{
+	hash = d3dUtil::HashBytes(nullptr, 0);
+
+	auto rootSignature = mRootSignatureHashes.find(desc.pRootSignature);
+	if(rootSignature == mRootSignatureHashes.end())
+		return false;
+	hash = d3dUtil::HashBytes(&rootSignature->second, sizeof(rootSignature->second), hash);
+
+	// Shader bytecode is hashed by content; the pointers change every run.
+	const D3D12_SHADER_BYTECODE* shaders[] = { &desc.VS, &desc.PS, &desc.DS, &desc.HS, &desc.GS };
+	for(const D3D12_SHADER_BYTECODE* shader : shaders)
+	{
+		hash = d3dUtil::HashBytes(&shader->BytecodeLength, sizeof(shader->BytecodeLength), hash);
+		hash = d3dUtil::HashBytes(shader->pShaderBytecode, shader->BytecodeLength, hash);
+	}
+
+	for(UINT i = 0; i < desc.InputLayout.NumElements; ++i)
+	{
+		const D3D12_INPUT_ELEMENT_DESC& e = desc.InputLayout.pInputElementDescs[i];
+		hash = d3dUtil::HashBytes(e.SemanticName, strlen(e.SemanticName) + 1, hash);
+		hash = d3dUtil::HashBytes(&e.SemanticIndex, sizeof(e) - offsetof(D3D12_INPUT_ELEMENT_DESC, SemanticIndex), hash);
+	}
+
+	// The blend and depth stencil descs contain padding after their UINT8 members,
+	// which is not guaranteed to be zero, so those are hashed field by field.
+	hash = d3dUtil::HashBytes(&desc.BlendState.AlphaToCoverageEnable, sizeof(BOOL), hash);
+	hash = d3dUtil::HashBytes(&desc.BlendState.IndependentBlendEnable, sizeof(BOOL), hash);
+	for(const D3D12_RENDER_TARGET_BLEND_DESC& rt : desc.BlendState.RenderTarget)
+	{
+		hash = d3dUtil::HashBytes(&rt, offsetof(D3D12_RENDER_TARGET_BLEND_DESC, RenderTargetWriteMask), hash);
+		hash = d3dUtil::HashBytes(&rt.RenderTargetWriteMask, sizeof(rt.RenderTargetWriteMask), hash);
+	}
+
+	const D3D12_DEPTH_STENCIL_DESC& ds = desc.DepthStencilState;
+	hash = d3dUtil::HashBytes(&ds, offsetof(D3D12_DEPTH_STENCIL_DESC, StencilReadMask), hash);
+	hash = d3dUtil::HashBytes(&ds.StencilReadMask, sizeof(ds.StencilReadMask), hash);
+	hash = d3dUtil::HashBytes(&ds.StencilWriteMask, sizeof(ds.StencilWriteMask), hash);
+	hash = d3dUtil::HashBytes(&ds.FrontFace, sizeof(ds.FrontFace), hash);
+	hash = d3dUtil::HashBytes(&ds.BackFace, sizeof(ds.BackFace), hash);
+
+	hash = d3dUtil::HashBytes(&desc.SampleMask, sizeof(desc.SampleMask), hash);
+	hash = d3dUtil::HashBytes(&desc.RasterizerState, sizeof(desc.RasterizerState), hash);
+	hash = d3dUtil::HashBytes(&desc.IBStripCutValue, sizeof(desc.IBStripCutValue), hash);
+	hash = d3dUtil::HashBytes(&desc.PrimitiveTopologyType, sizeof(desc.PrimitiveTopologyType), hash);
+	hash = d3dUtil::HashBytes(&desc.NumRenderTargets, sizeof(desc.NumRenderTargets), hash);
+	hash = d3dUtil::HashBytes(desc.RTVFormats, sizeof(desc.RTVFormats), hash);
+	hash = d3dUtil::HashBytes(&desc.DSVFormat, sizeof(desc.DSVFormat), hash);
+	hash = d3dUtil::HashBytes(&desc.SampleDesc, sizeof(desc.SampleDesc), hash);
+	hash = d3dUtil::HashBytes(&desc.NodeMask, sizeof(desc.NodeMask), hash);
+	hash = d3dUtil::HashBytes(&desc.Flags, sizeof(desc.Flags), hash);
+
+	return true;
+}
+
+bool PipelineLibrary::HashDesc(const D3D12_COMPUTE_PIPELINE_STATE_DESC& desc, std::uint64_t& hash)const
+{
+	hash = d3dUtil::HashBytes(nullptr, 0);
+
+	auto rootSignature = mRootSignatureHashes.find(desc.pRootSignature);
+	if(rootSignature == mRootSignatureHashes.end())
+		return false;
+	hash = d3dUtil::HashBytes(&rootSignature->second, sizeof(rootSignature->second), hash);
+
+	hash = d3dUtil::HashBytes(&desc.CS.BytecodeLength, sizeof(desc.CS.BytecodeLength), hash);
+	hash = d3dUtil::HashBytes(desc.CS.pShaderBytecode, desc.CS.BytecodeLength, hash);
+	hash = d3dUtil::HashBytes(&desc.NodeMask, sizeof(desc.NodeMask), hash);
+	hash = d3dUtil::HashBytes(&desc.Flags, sizeof(desc.Flags), hash);
+
+	return true;
+}
@@ -0,0 +1,69 @@
+//***************************************************************************************
+// PipelineLibrary.h
+//
+// Persists compiled pipeline state objects across runs in an ID3D12PipelineLibrary.
+// CreateGraphicsPipeline() and CreateComputePipeline() load a PSO from the library
+// when a matching one was stored by an earlier run and only fall back to creating
+// it from scratch otherwise.  Save() writes the library back to disk if anything new was stored.
+//
+// Entries are named after the caller's name plus a hash of the description, so
+// editing a shader, a state block or the root signature creates a new entry
+// instead of failing to load a stale one.  Root signatures are hashed by their
+// serialized form, so register each with AddRootSignature() before creating the
+// PSOs that use it; PSOs with an unregistered root signature are not cached.  The serialized library is driver specific; if the driver
+// rejects it the library simply starts out empty.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+
+class PipelineLibrary
+{
+public:
+	PipelineLibrary(ID3D12Device* device, const std::wstring& filename);
+	PipelineLibrary(const PipelineLibrary& rhs) = delete;
+	PipelineLibrary& operator=(const PipelineLibrary& rhs) = delete;
+	~PipelineLibrary() = default;
+
+	// serialized is the blob rootSignature was created from.
+	void AddRootSignature(ID3D12RootSignature* rootSignature, ID3DBlob* serialized);
+
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> CreateGraphicsPipeline(
+		const std::wstring& name,
+		const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc);
+
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> CreateComputePipeline(
+		const std::wstring& name,
+		const D3D12_COMPUTE_PIPELINE_STATE_DESC& desc);
+
+	// Serializes the library to filename if new pipelines were stored.
+	void Save();
+
+	// Pipelines loaded from the library / created from scratch so far.
+	UINT GetLoadedCount()const { return mLoadedCount; }
+	UINT GetCreatedCount()const { return mCreatedCount; }
+
+private:
+	// False if the root signature was not registered.
+	bool HashDesc(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, std::uint64_t& hash)const;
+	bool HashDesc(const D3D12_COMPUTE_PIPELINE_STATE_DESC& desc, std::uint64_t& hash)const;
+
+	std::wstring MakeKey(const std::wstring& name, std::uint64_t hash)const;
+	void Store(const std::wstring& key, ID3D12PipelineState* pso);
+
+	ID3D12Device* mDevice = nullptr;
+	std::wstring mFilename;
+
+	// The library reads from the serialized data in place, so it has to outlive
+	// mLibrary.
+	std::vector<char> mFileData;
+	Microsoft::WRL::ComPtr<ID3D12PipelineLibrary> mLibrary;
+
+	// Hash of the serialized form of every registered root signature.
+	std::unordered_map<ID3D12RootSignature*, std::uint64_t> mRootSignatureHashes;
+
+	bool mDirty = false;
+	UINT mLoadedCount = 0;
+	UINT mCreatedCount = 0;
+};
@@ -0,0 +1,297 @@
+//***************************************************************************************
+// Profiler.cpp
+//***************************************************************************************
+
+#include "Profiler.h"
+
+#include <iomanip>
+
+using Microsoft::WRL::ComPtr;
+
+Profiler::Profiler(ID3D12Device* device, ID3D12CommandQueue* queue, UINT frameResourceCount) :
+	mQueue(queue),
+	mFrameResourceCount(frameResourceCount)
+{
+	const UINT queryCount = mFrameResourceCount * MaxGpuScopes * 2;
+
+	D3D12_QUERY_HEAP_DESC heapDesc = {};
+	heapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+	heapDesc.Count = queryCount;
+	heapDesc.NodeMask = 0;
+	ThrowIfFailed(device->CreateQueryHeap(&heapDesc, IID_PPV_ARGS(&mQueryHeap)));
+
+	ThrowIfFailed(device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(queryCount * sizeof(UINT64)),
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		nullptr,
+		IID_PPV_ARGS(&mReadback)));
+
+	ThrowIfFailed(mQueue->GetTimestampFrequency(&mGpuFrequency));
+
+	LARGE_INTEGER frequency, now;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&now);
+	mCpuFrequency = frequency.QuadPart;
+	mCpuStart = now.QuadPart;
+
+	mRegionFrame.assign(mFrameResourceCount, 0);
+}
+
+void Profiler::BeginFrame()
+{
+	++mFrame;
+
+	mCpuStack.clear();
+	BeginCpuScope("CpuFrame");
+}
+
+void Profiler::BeginGpuFrame(UINT frameResourceIndex)
+{
+	const UINT64 frame = mRegionFrame[frameResourceIndex];
+	if(frame != 0 && !mGpuScopes.empty())
+	{
+		const UINT firstQuery = frameResourceIndex * MaxGpuScopes * 2;
+
+		// Lines the GPU timestamps up with the CPU timeline for the trace.  Without a
+		// calibration the GPU events start at zero.
+		UINT64 gpuCalibration = 0, cpuCalibration = 0;
+		bool calibrated = SUCCEEDED(mQueue->GetClockCalibration(&gpuCalibration, &cpuCalibration));
+
+		D3D12_RANGE readRange = { firstQuery * sizeof(UINT64), (firstQuery + mGpuScopes.size() * 2) * sizeof(UINT64) };
+		UINT64* timestamps = nullptr;
+		ThrowIfFailed(mReadback->Map(0, &readRange, reinterpret_cast<void**>(&timestamps)));
+
+		for(UINT g = 0; g < (UINT)mGpuScopes.size(); ++g)
+		{
+			UINT64 begin = timestamps[firstQuery + 2*g];
+			UINT64 end = timestamps[firstQuery + 2*g + 1];
+			if(end < begin)
+				continue;
+
+			double startUs = 0.0;
+			if(calibrated)
+				startUs = TicksToUs((INT64)cpuCalibration) + ((double)begin - (double)gpuCalibration) * 1e6 / mGpuFrequency;
+
+			const double durationUs = (double)(end - begin) * 1e6 / mGpuFrequency;
+			AddEvent(frame, mGpuScopes[g], startUs, durationUs);
+			mLastGpuTimes[g] = (float)(durationUs / 1000.0);
+		}
+
+		// Nothing was written by the CPU.
+		D3D12_RANGE writeRange = { 0, 0 };
+		mReadback->Unmap(0, &writeRange);
+	}
+
+	mCurrRegion = frameResourceIndex;
+	mRegionFrame[frameResourceIndex] = mFrame;
+}
+
+void Profiler::EndFrame()
+{
+	// Close the frame scope and anything left open.
+	while(!mCpuStack.empty())
+		EndCpuScope();
+
+	while(!mHistory.empty() && mHistory.front().Frame + MaxHistoryFrames < mFrame)
+		mHistory.pop_front();
+}
+
+void Profiler::BeginCpuScope(const char* name)
+{
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+
+	mCpuStack.push_back(std::make_pair(FindOrAddScope(name, false), now.QuadPart));
+}
+
+void Profiler::EndCpuScope()
+{
+	assert(!mCpuStack.empty());
+
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+
+	UINT scope = mCpuStack.back().first;
+	INT64 start = mCpuStack.back().second;
+	mCpuStack.pop_back();
+
+	AddEvent(mFrame, scope, TicksToUs(start), (double)(now.QuadPart - start) * 1e6 / mCpuFrequency);
+}
+
+UINT Profiler::RegisterGpuScope(const char* name)
+{
+	assert(mGpuScopes.size() < MaxGpuScopes);
+
+	mGpuScopes.push_back(FindOrAddScope(name, true));
+	mLastGpuTimes.push_back(0.0f);
+	return (UINT)mGpuScopes.size() - 1;
+}
+
+float Profiler::GetLastGpuTime(UINT scope)const
+{
+	return mLastGpuTimes[scope];
+}
+
+void Profiler::BeginGpuScope(ID3D12GraphicsCommandList* cmdList, UINT scope)
+{
+	cmdList->EndQuery(mQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, (mCurrRegion * MaxGpuScopes + scope) * 2);
+}
+
+void Profiler::EndGpuScope(ID3D12GraphicsCommandList* cmdList, UINT scope)
+{
+	cmdList->EndQuery(mQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, (mCurrRegion * MaxGpuScopes + scope) * 2 + 1);
+}
+
+void Profiler::ResolveGpuScopes(ID3D12GraphicsCommandList* cmdList)
+{
+	if(mGpuScopes.empty())
+		return;
+
+	const UINT firstQuery = mCurrRegion * MaxGpuScopes * 2;
+	cmdList->ResolveQueryData(mQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP,
+		firstQuery, (UINT)mGpuScopes.size() * 2, mReadback.Get(), firstQuery * sizeof(UINT64));
+}
+
+std::wstring Profiler::GetSummary()const
+{
+	std::wostringstream text;
+	text << std::fixed << std::setprecision(2);
+
+	for(const Scope& scope : mScopes)
+	{
+		if(scope.Window.empty())
+			continue;
+
+		Stats stats = ComputeStats(scope);
+		text << L"   " << (scope.Gpu ? L"gpu:" : L"") << AnsiToWString(scope.Name)
+			<< L" " << stats.Avg << L"/" << stats.P99;
+	}
+
+	return text.str();
+}
+
+std::wstring Profiler::GetReport()const
+{
+	std::wostringstream text;
+	text << std::fixed << std::setprecision(3);
+	text << L"scope                  min      avg      p99   (ms, last " << WindowSize << L" frames)\n";
+
+	for(const Scope& scope : mScopes)
+	{
+		if(scope.Window.empty())
+			continue;
+
+		Stats stats = ComputeStats(scope);
+		text << std::left << std::setw(20) << AnsiToWString((scope.Gpu ? "gpu " : "cpu ") + scope.Name) << std::right
+			<< std::setw(9) << stats.Min << std::setw(9) << stats.Avg << std::setw(9) << stats.P99 << L"\n";
+	}
+
+	return text.str();
+}
+
+bool Profiler::WriteCsv(const std::wstring& filename)const
+{
+	std::ofstream fout(filename);
+	if(!fout)
+		return false;
+
+	fout << "frame,scope,timeline,start_us,duration_us\n";
+	fout << std::fixed << std::setprecision(3);
+	for(const Event& e : mHistory)
+	{
+		const Scope& scope = mScopes[e.Scope];
+		fout << e.Frame << ',' << scope.Name << ',' << (scope.Gpu ? "gpu" : "cpu") << ','
+			<< e.StartUs << ',' << e.DurationUs << '\n';
+	}
+
+	return true;
+}
+
+bool Profiler::WriteChromeTrace(const std::wstring& filename)const
+{
+	std::ofstream fout(filename);
+	if(!fout)
+		return false;
+
+	// Complete ("X") events in microseconds; the CPU and the GPU each get a thread.
+	fout << "{\"traceEvents\":[\n";
+	fout << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n";
+	fout << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+
+	fout << std::fixed << std::setprecision(3);
+	for(const Event& e : mHistory)
+	{
+		const Scope& scope = mScopes[e.Scope];
+		fout << ",\n{\"name\":\"" << scope.Name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << (scope.Gpu ? 2 : 1)
+			<< ",\"ts\":" << e.StartUs << ",\"dur\":" << e.DurationUs
+			<< ",\"args\":{\"frame\":" << e.Frame << "}}";
+	}
+
+	fout << "\n]}\n";
+	return true;
+}
+
+UINT Profiler::FindOrAddScope(const char* name, bool gpu)
+{
+	for(UINT i = 0; i < (UINT)mScopes.size(); ++i)
+	{
+		if(mScopes[i].Gpu == gpu && mScopes[i].Name == name)
+			return i;
+	}
+
+	Scope scope;
+	scope.Name = name;
+	scope.Gpu = gpu;
+	mScopes.push_back(std::move(scope));
+
+	return (UINT)mScopes.size() - 1;
+}
+
+void Profiler::AddEvent(UINT64 frame, UINT scope, double startUs, double durationUs)
+{
+	Event e;
+	e.Frame = frame;
+	e.Scope = scope;
+	e.StartUs = startUs;
+	e.DurationUs = durationUs;
+	mHistory.push_back(e);
+
+	Scope& s = mScopes[scope];
+	float ms = (float)(durationUs / 1000.0);
+	if(s.Window.size() < WindowSize)
+	{
+		s.Window.push_back(ms);
+	}
+	else
+	{
+		s.Window[s.WindowNext] = ms;
+		s.WindowNext = (s.WindowNext + 1) % WindowSize;
+	}
+}
+
+Profiler::Stats Profiler::ComputeStats(const Scope& scope)const
+{
+	Stats stats;
+	if(scope.Window.empty())
+		return stats;
+
+	std::vector<float> sorted = scope.Window;
+	std::sort(sorted.begin(), sorted.end());
+
+	float sum = 0.0f;
+	for(float ms : sorted)
+		sum += ms;
+
+	stats.Min = sorted.front();
+	stats.Avg = sum / sorted.size();
+	stats.P99 = sorted[MathHelper::Min(sorted.size() - 1, sorted.size() * 99 / 100)];
+
+	return stats;
+}
+
+double Profiler::TicksToUs(INT64 ticks)const
+{
+	return (double)(ticks - mCpuStart) * 1e6 / mCpuFrequency;
+}
@@ -0,0 +1,148 @@
+//***************************************************************************************
+// Profiler.h
+//
+// CPU and GPU frame profiler.  CPU scopes are timed with QueryPerformanceCounter;
+// GPU scopes write timestamp queries into a heap with one region per frame
+// resource.  Each region is resolved into a readback buffer at the end of its
+// frame and read once the app has waited on that frame resource's fence anyway,
+// so collecting results never stalls.
+//
+// Every scope keeps a rolling window of durations for min/avg/p99 readouts, and
+// the last MaxHistoryFrames frames of events can be written out as CSV or as a
+// Chrome trace (chrome://tracing, Perfetto) with GPU events on their own track.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+
+#include <deque>
+
+class Profiler
+{
+public:
+	Profiler(ID3D12Device* device, ID3D12CommandQueue* queue, UINT frameResourceCount);
+	Profiler(const Profiler& rhs) = delete;
+	Profiler& operator=(const Profiler& rhs) = delete;
+	~Profiler() = default;
+
+	// Starts the CPU side of a new frame.
+	void BeginFrame();
+
+	// Collects the GPU results last written to frameResourceIndex and makes it the
+	// region the current frame records into.  Call once the frame resource's fence
+	// has been reached.
+	void BeginGpuFrame(UINT frameResourceIndex);
+
+	void EndFrame();
+
+	// CPU scopes nest, and are main thread only.  Scopes are identified by name.
+	void BeginCpuScope(const char* name);
+	void EndCpuScope();
+
+	// GPU scopes are registered up front, and every registered scope has to be
+	// begun and ended exactly once per frame.  Begin/End may be recorded on any
+	// command list of the frame, from any thread, as long as the lists execute in
+	// order.
+	UINT RegisterGpuScope(const char* name);
+	void BeginGpuScope(ID3D12GraphicsCommandList* cmdList, UINT scope);
+	void EndGpuScope(ID3D12GraphicsCommandList* cmdList, UINT scope);
+
+	// Duration in milliseconds of a GPU scope in the latest frame collected by
+	// BeginGpuFrame, or 0 if none has been.  That frame is a few frames old.
+	float GetLastGpuTime(UINT scope)const;
+
+	// Resolves this frame's timestamps.  Record on the last command list of the
+	// frame, after every EndGpuScope.
+	void ResolveGpuScopes(ID3D12GraphicsCommandList* cmdList);
+
+	// One line of "name avg/p99" pairs, in milliseconds.
+	std::wstring GetSummary()const;
+
+	// Rolling min/avg/p99 of every scope, one scope per line.
+	std::wstring GetReport()const;
+
+	bool WriteCsv(const std::wstring& filename)const;
+	bool WriteChromeTrace(const std::wstring& filename)const;
+
+private:
+	static const UINT MaxGpuScopes = 16;
+	static const UINT WindowSize = 240;
+	static const UINT MaxHistoryFrames = 600;
+
+	struct Scope
+	{
+		std::string Name;
+		bool Gpu = false;
+
+		// Rolling window of durations in milliseconds.
+		std::vector<float> Window;
+		UINT WindowNext = 0;
+	};
+
+	struct Event
+	{
+		UINT64 Frame = 0;
+		UINT Scope = 0;
+		double StartUs = 0.0;
+		double DurationUs = 0.0;
+	};
+
+	struct Stats
+	{
+		float Min = 0.0f;
+		float Avg = 0.0f;
+		float P99 = 0.0f;
+	};
+
+	UINT FindOrAddScope(const char* name, bool gpu);
+	void AddEvent(UINT64 frame, UINT scope, double startUs, double durationUs);
+	Stats ComputeStats(const Scope& scope)const;
+	double TicksToUs(INT64 ticks)const;
+
+	Microsoft::WRL::ComPtr<ID3D12QueryHeap> mQueryHeap;
+	Microsoft::WRL::ComPtr<ID3D12Resource> mReadback;
+	ID3D12CommandQueue* mQueue = nullptr;
+	UINT64 mGpuFrequency = 1;
+	UINT mFrameResourceCount = 0;
+
+	// Frame recorded into each query region; 0 while a region is unused.
+	std::vector<UINT64> mRegionFrame;
+	UINT mCurrRegion = 0;
+
+	// Index into mScopes of each registered GPU scope, and its latest duration.
+	std::vector<UINT> mGpuScopes;
+	std::vector<float> mLastGpuTimes;
+
+	INT64 mCpuFrequency = 1;
+	INT64 mCpuStart = 0;
+
+	std::vector<Scope> mScopes;
+	std::vector<std::pair<UINT, INT64>> mCpuStack;
+	std::deque<Event> mHistory;
+	UINT64 mFrame = 0;
+};
+
+// Times the enclosing block as a CPU scope.
+class ScopedCpuTimer
+{
+public:
+	ScopedCpuTimer(Profiler* profiler, const char* name) :
+		mProfiler(profiler)
+	{
+		if(mProfiler != nullptr)
+			mProfiler->BeginCpuScope(name);
+	}
+
+	ScopedCpuTimer(const ScopedCpuTimer& rhs) = delete;
+	ScopedCpuTimer& operator=(const ScopedCpuTimer& rhs) = delete;
+
+	~ScopedCpuTimer()
+	{
+		if(mProfiler != nullptr)
+			mProfiler->EndCpuScope();
+	}
+
+private:
+	Profiler* mProfiler;
+};
@@ -0,0 +1,78 @@
+//***************************************************************************************
+// RenderQueue.cpp
+//***************************************************************************************
+
+#include "RenderQueue.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	const std::uint32_t DepthBucketBits = 4;
+	const std::uint32_t FineDepthBits = 64 - RenderQueue::LayerBits - DepthBucketBits - RenderQueue::GeometryBits;
+	const std::uint32_t SortedDepthBits = 64 - RenderQueue::LayerBits - RenderQueue::GeometryBits;
+
+	std::uint64_t Field(std::uint64_t value, std::uint32_t bits)
+	{
+		return value & ((1ull << bits) - 1);
+	}
+
+	std::uint64_t QuantizeDepth(float depth, std::uint32_t bits)
+	{
+		const double maxValue = (double)((1ull << bits) - 1);
+		return (std::uint64_t)(std::min(std::max((double)depth, 0.0), 1.0) * maxValue + 0.5);
+	}
+}
+
+RenderQueue::SubmitStats& RenderQueue::SubmitStats::operator+=(const SubmitStats& rhs)
+{
+	Draws += rhs.Draws;
+	GeometryBinds += rhs.GeometryBinds;
+	GeometrySkipped += rhs.GeometrySkipped;
+	TopologyBinds += rhs.TopologyBinds;
+	TopologySkipped += rhs.TopologySkipped;
+	return *this;
+}
+
+float RenderQueue::NormalizeDepth(float viewZ, float nearZ, float farZ)
+{
+	if(viewZ <= nearZ)
+		return 0.0f;
+
+	return std::min(std::log(viewZ / nearZ) / std::log(farZ / nearZ), 1.0f);
+}
+
+std::uint64_t RenderQueue::MakeKey(DepthOrder order, std::uint32_t layer, std::uint32_t geometry, float depth)
+{
+	std::uint64_t key = Field(layer, LayerBits);
+
+	if(order == DepthOrder::BackToFront)
+	{
+		const std::uint64_t inverted = QuantizeDepth(1.0f - depth, SortedDepthBits);
+		key = (key << SortedDepthBits) | inverted;
+		key = (key << GeometryBits) | Field(geometry, GeometryBits);
+		return key;
+	}
+
+	key = (key << DepthBucketBits) | QuantizeDepth(depth, DepthBucketBits);
+	key = (key << GeometryBits) | Field(geometry, GeometryBits);
+	key = (key << FineDepthBits) | QuantizeDepth(depth, FineDepthBits);
+	return key;
+}
+
+void RenderQueue::Push(std::uint64_t key, std::uint32_t item)
+{
+	Entry entry;
+	entry.Key = key;
+	entry.Item = item;
+	mEntries.push_back(entry);
+}
+
+void RenderQueue::Sort()
+{
+	std::stable_sort(mEntries.begin(), mEntries.end(), [](const Entry& a, const Entry& b)
+	{
+		return a.Key < b.Key;
+	});
+}
@@ -0,0 +1,80 @@
+//***************************************************************************************
+// RenderQueue.h
+//
+// Orders the draws of a layer by 64-bit sort keys.  From the most significant bit
+// down a key holds the layer, then the geometry and view depth in an order that
+// depends on the layer's DepthOrder:
+//
+//   FrontToBack: layer | depth bucket | geometry | depth
+//   BackToFront: layer | inverted depth | geometry
+//
+// PSOs and materials are not part of the key: every layer draws with one PSO,
+// and every instance reads its own material from the instance data, so draws
+// inside a layer never change either.
+//
+// Opaque draws go roughly front to back for early-Z, with the draws inside a
+// coarse depth bucket grouped by state.  Blended draws must be strictly back to
+// front, so their depth comes before any state.
+//
+// SubmitStats counts the state the submitting code set and the calls it skipped
+// because the state was already bound.
+//
+// This header only depends on the standard library.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class RenderQueue
+{
+public:
+	enum class DepthOrder
+	{
+		FrontToBack,
+		BackToFront
+	};
+
+	// Field widths; larger ids are masked.
+	static const std::uint32_t LayerBits = 4;
+	static const std::uint32_t GeometryBits = 12;
+
+	struct Entry
+	{
+		std::uint64_t Key = 0;
+		std::uint32_t Item = 0;
+	};
+
+	struct SubmitStats
+	{
+		std::uint32_t Draws = 0;
+		std::uint32_t GeometryBinds = 0;
+		std::uint32_t GeometrySkipped = 0;
+		std::uint32_t TopologyBinds = 0;
+		std::uint32_t TopologySkipped = 0;
+
+		std::uint32_t Skipped()const { return GeometrySkipped + TopologySkipped; }
+		SubmitStats& operator+=(const SubmitStats& rhs);
+	};
+
+	// Maps a view space depth between nearZ and farZ to [0, 1], logarithmically
+	// so near draws get most of the key's precision.
+	static float NormalizeDepth(float viewZ, float nearZ, float farZ);
+
+	// depth is a NormalizeDepth() value.
+	static std::uint64_t MakeKey(DepthOrder order, std::uint32_t layer, std::uint32_t geometry, float depth);
+
+	void Clear() { mEntries.clear(); }
+	void Push(std::uint64_t key, std::uint32_t item);
+
+	// Sorts by key; entries with the same key keep the order they were pushed in.
+	void Sort();
+
+	std::size_t Size()const { return mEntries.size(); }
+	std::uint32_t Item(std::size_t i)const { return mEntries[i].Item; }
+	const std::vector<Entry>& Entries()const { return mEntries; }
+
+private:
+	std::vector<Entry> mEntries;
+};
@@ -0,0 +1,140 @@
+//***************************************************************************************
+// ResourceRegistry.h
+//
+// Dense, name-addressable storage for materials, geometries, textures, PSOs and
+// submeshes.  Items live by value in one contiguous array and are referred to by
+// small typed handles, so per-frame code indexes an array instead of hashing a
+// string.  Names are only looked up at load time.
+//
+// Add() may reallocate the array: keep handles, not pointers or references, to
+// items in a registry that is still being filled.
+//***************************************************************************************
+
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+template<typename Tag>
+struct Handle
+{
+	static const std::uint32_t InvalidIndex = 0xffffffff;
+
+	std::uint32_t Index = InvalidIndex;
+
+	bool IsValid()const { return Index != InvalidIndex; }
+
+	bool operator==(Handle rhs)const { return Index == rhs.Index; }
+	bool operator!=(Handle rhs)const { return Index != rhs.Index; }
+};
+
+typedef Handle<struct MaterialHandleTag> MaterialHandle;
+typedef Handle<struct GeometryHandleTag> GeometryHandle;
+typedef Handle<struct TextureHandleTag> TextureHandle;
+typedef Handle<struct PsoHandleTag> PsoHandle;
+typedef Handle<struct SubmeshHandleTag> SubmeshHandle;
+
+template<typename T, typename HandleT>
+class ResourceRegistry
+{
+public:
+	typedef typename std::vector<T>::iterator iterator;
+	typedef typename std::vector<T>::const_iterator const_iterator;
+
+	// Registers item under name and returns its handle.  Adding a name twice
+	// replaces the item but keeps the handle.
+	HandleT Add(const std::string& name, T&& item)
+	{
+		// name may refer into item (e.g., Add(tex->Name, std::move(*tex))), so
+		// register it before item is moved from.
+		auto it = mLookup.find(name);
+		if(it != mLookup.end())
+		{
+			mItems[it->second.Index] = std::move(item);
+			return it->second;
+		}
+
+		HandleT handle;
+		handle.Index = (std::uint32_t)mItems.size();
+
+		mNames.push_back(name);
+		mLookup[name] = handle;
+		mItems.push_back(std::move(item));
+
+		return handle;
+	}
+
+	HandleT Add(const std::string& name, const T& item)
+	{
+		T copy = item;
+		return Add(name, std::move(copy));
+	}
+
+	// Load-time lookup.  Returns an invalid handle if name is not registered.
+	HandleT Find(const std::string& name)const
+	{
+		auto it = mLookup.find(name);
+		return it != mLookup.end() ? it->second : HandleT();
+	}
+
+	bool Contains(const std::string& name)const
+	{
+		return mLookup.find(name) != mLookup.end();
+	}
+
+	T& operator[](HandleT handle)
+	{
+		assert(handle.Index < mItems.size());
+		return mItems[handle.Index];
+	}
+
+	const T& operator[](HandleT handle)const
+	{
+		assert(handle.Index < mItems.size());
+		return mItems[handle.Index];
+	}
+
+	// Load-time convenience for Find() followed by operator[].
+	T& Get(const std::string& name)
+	{
+		HandleT handle = Find(name);
+		assert(handle.IsValid());
+		return mItems[handle.Index];
+	}
+
+	const T& Get(const std::string& name)const
+	{
+		HandleT handle = Find(name);
+		assert(handle.IsValid());
+		return mItems[handle.Index];
+	}
+
+	const std::string& GetName(HandleT handle)const
+	{
+		assert(handle.Index < mNames.size());
+		return mNames[handle.Index];
+	}
+
+	std::uint32_t Size()const { return (std::uint32_t)mItems.size(); }
+	bool Empty()const { return mItems.empty(); }
+
+	void Reserve(std::uint32_t count)
+	{
+		mItems.reserve(count);
+		mNames.reserve(count);
+	}
+
+	// Items are visited in handle order.
+	iterator begin() { return mItems.begin(); }
+	iterator end() { return mItems.end(); }
+	const_iterator begin()const { return mItems.begin(); }
+	const_iterator end()const { return mItems.end(); }
+
+private:
+	std::vector<T> mItems;
+	std::vector<std::string> mNames;
+	std::unordered_map<std::string, HandleT> mLookup;
+};
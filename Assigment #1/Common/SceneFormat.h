@@ -0,0 +1,104 @@
+//***************************************************************************************
+// SceneFormat.h
+//
+// On-disk layout of the binary scene description (.scene), compiled offline from
+// its text form by Tools/SceneCompiler.  The file is a header, the object records
+// of every chunk and a chunk table at the byte offset stored in the header.
+//
+// A chunk is a named group of objects loaded and reloaded as a unit.  Objects
+// refer to their geometry, submesh and material by name and carry their world
+// and texture transforms; object indices are not stored but handed out in file
+// order by the loader.
+//
+// This header only depends on the standard library so offline tools can share
+// it with the runtime loader.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace SceneFormat
+{
+	// 'S' 'C' 'N' 'E' read as a little-endian uint32.
+	const std::uint32_t Magic = 0x454E4353;
+	const std::uint32_t Version = 1;
+
+	// Object records are aligned to this many bytes.
+	const std::uint32_t RecordAlignment = 16;
+
+	const std::uint32_t MaxName = 32;
+
+	// Render layer of an object.
+	enum Layer : std::uint32_t
+	{
+		LayerOpaque = 0,
+		LayerAlphaTested,
+		LayerTransparent,
+		LayerCount
+	};
+
+	struct Header
+	{
+		std::uint32_t Magic;
+		std::uint32_t Version;
+
+		std::uint32_t ChunkCount;
+		std::uint32_t Reserved;
+
+		std::uint64_t ChunkTableOffset;
+	};
+
+	struct Chunk
+	{
+		char Name[MaxName];
+
+		std::uint32_t ObjectCount;
+		std::uint32_t Reserved;
+		std::uint64_t ObjectDataOffset;
+
+		// HashBytes of the chunk's object records, so a reload can skip the
+		// chunks that did not change.
+		std::uint64_t Hash;
+	};
+
+	struct Object
+	{
+		// Names are zero padded but not necessarily zero terminated.
+		char Geometry[MaxName];
+		char Submesh[MaxName];
+		char Material[MaxName];
+
+		std::uint32_t Layer;
+		std::uint32_t Reserved;
+
+		// Row-major, for row vectors, as DirectX::XMFLOAT4X4 stores them.
+		float World[16];
+		float TexTransform[16];
+	};
+
+	static_assert(sizeof(Header) == 24, "SceneFormat::Header layout changed.");
+	static_assert(sizeof(Chunk) == 56, "SceneFormat::Chunk layout changed.");
+	static_assert(sizeof(Object) == 232, "SceneFormat::Object layout changed.");
+
+	inline std::uint64_t AlignOffset(std::uint64_t offset)
+	{
+		return (offset + RecordAlignment - 1) & ~std::uint64_t(RecordAlignment - 1);
+	}
+
+	// 64-bit FNV-1a.
+	inline std::uint64_t HashBytes(const void* data, std::size_t byteSize)
+	{
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+
+		std::uint64_t hash = 14695981039346656037ull;
+		for(std::size_t i = 0; i < byteSize; ++i)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+
+		return hash;
+	}
+}
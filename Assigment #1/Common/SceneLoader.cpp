@@ -0,0 +1,139 @@
+//***************************************************************************************
+// SceneLoader.cpp
+//***************************************************************************************
+
+#include "SceneLoader.h"
+
+#include <windows.h>
+#include <cstring>
+
+using namespace DirectX;
+
+namespace
+{
+	std::string ReadName(const char (&name)[SceneFormat::MaxName])
+	{
+		size_t length = 0;
+		while(length < SceneFormat::MaxName && name[length] != '\0')
+			++length;
+
+		return std::string(name, length);
+	}
+
+	bool ReadFileBytes(const std::wstring& filename, std::vector<std::uint8_t>& bytes)
+	{
+		HANDLE file = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+			OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if(file == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER fileSize;
+		bool ok = GetFileSizeEx(file, &fileSize) && fileSize.QuadPart >= (LONGLONG)sizeof(SceneFormat::Header) &&
+			fileSize.QuadPart <= MAXDWORD;
+
+		if(ok)
+		{
+			bytes.resize((size_t)fileSize.QuadPart);
+
+			DWORD bytesRead = 0;
+			ok = ReadFile(file, bytes.data(), (DWORD)bytes.size(), &bytesRead, nullptr) && bytesRead == bytes.size();
+		}
+
+		CloseHandle(file);
+		return ok;
+	}
+
+	bool DecodeChunk(const std::uint8_t* data, const SceneFormat::Chunk& chunk, SceneChunkDesc& desc)
+	{
+		desc.Name = ReadName(chunk.Name);
+		desc.Hash = chunk.Hash;
+		desc.Objects.resize(chunk.ObjectCount);
+
+		// Records may not be aligned for the float members; copy each one out.
+		for(std::uint32_t i = 0; i < chunk.ObjectCount; ++i)
+		{
+			SceneFormat::Object record;
+			std::memcpy(&record, data + chunk.ObjectDataOffset + (std::uint64_t)i*sizeof(SceneFormat::Object), sizeof(record));
+
+			if(record.Layer >= SceneFormat::LayerCount)
+				return false;
+
+			SceneObjectDesc& object = desc.Objects[i];
+			object.Geometry = ReadName(record.Geometry);
+			object.Submesh = ReadName(record.Submesh);
+			object.Material = ReadName(record.Material);
+			object.Layer = (SceneFormat::Layer)record.Layer;
+			object.World = XMFLOAT4X4(record.World);
+			object.TexTransform = XMFLOAT4X4(record.TexTransform);
+		}
+
+		return true;
+	}
+}
+
+bool SceneLoader::Load(const std::wstring& filename, ThreadPool* pool, std::vector<SceneChunkDesc>& chunks)
+{
+	std::vector<std::uint8_t> bytes;
+	if(!ReadFileBytes(filename, bytes))
+		return false;
+
+	SceneFormat::Header header;
+	std::memcpy(&header, bytes.data(), sizeof(header));
+	if(header.Magic != SceneFormat::Magic || header.Version != SceneFormat::Version)
+		return false;
+
+	// Validate every extent before any job dereferences it.
+	const std::uint64_t fileSize = bytes.size();
+	if(header.ChunkTableOffset > fileSize ||
+		(std::uint64_t)header.ChunkCount*sizeof(SceneFormat::Chunk) > fileSize - header.ChunkTableOffset)
+		return false;
+
+	std::vector<SceneFormat::Chunk> table(header.ChunkCount);
+	if(header.ChunkCount > 0)
+		std::memcpy(table.data(), bytes.data() + header.ChunkTableOffset, table.size()*sizeof(SceneFormat::Chunk));
+
+	for(const SceneFormat::Chunk& chunk : table)
+	{
+		if(chunk.ObjectDataOffset > fileSize ||
+			(std::uint64_t)chunk.ObjectCount*sizeof(SceneFormat::Object) > fileSize - chunk.ObjectDataOffset)
+			return false;
+	}
+
+	// One job per chunk; each writes only its own entries.
+	std::vector<SceneChunkDesc> decoded(table.size());
+	std::vector<unsigned char> valid(table.size(), 0);
+	const std::uint8_t* data = bytes.data();
+	for(size_t i = 0; i < table.size(); ++i)
+	{
+		auto job = [data, &table, &decoded, &valid, i]()
+		{
+			valid[i] = DecodeChunk(data, table[i], decoded[i]) ? 1 : 0;
+		};
+
+		if(pool != nullptr)
+			pool->Enqueue(job);
+		else
+			job();
+	}
+
+	if(pool != nullptr)
+		pool->Wait();
+
+	for(unsigned char v : valid)
+	{
+		if(!v)
+			return false;
+	}
+
+	chunks.swap(decoded);
+	return true;
+}
+
+std::uint64_t SceneLoader::GetWriteTime(const std::wstring& filename)
+{
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	if(!GetFileAttributesExW(filename.c_str(), GetFileExInfoStandard, &attributes))
+		return 0;
+
+	return ((std::uint64_t)attributes.ftLastWriteTime.dwHighDateTime << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+}
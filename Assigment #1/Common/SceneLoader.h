@@ -0,0 +1,55 @@
+//***************************************************************************************
+// SceneLoader.h
+//
+// Reads binary scene descriptions (see SceneFormat.h).  The file is read in one
+// go and every chunk is decoded by its own job on a ThreadPool, so load time
+// scales with the worker count rather than the object count.
+//
+// Names are left unresolved; the app looks up the geometry, submesh and material
+// of every object and hands out the object indices, in file order.
+//***************************************************************************************
+
+#pragma once
+
+#include "SceneFormat.h"
+#include "ThreadPool.h"
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct SceneObjectDesc
+{
+	std::string Geometry;
+	std::string Submesh;
+	std::string Material;
+	SceneFormat::Layer Layer = SceneFormat::LayerOpaque;
+
+	DirectX::XMFLOAT4X4 World;
+	DirectX::XMFLOAT4X4 TexTransform;
+};
+
+struct SceneChunkDesc
+{
+	std::string Name;
+
+	// Hash of the chunk's records in the file: equal hashes mean the chunk is
+	// unchanged.
+	std::uint64_t Hash = 0;
+
+	std::vector<SceneObjectDesc> Objects;
+};
+
+class SceneLoader
+{
+public:
+	// Reads filename and decodes its chunks, on pool if it is not null.  Returns
+	// false if the file is missing or malformed, which includes a file that is
+	// still being written.
+	static bool Load(const std::wstring& filename, ThreadPool* pool, std::vector<SceneChunkDesc>& chunks);
+
+	// Last write time of filename, or 0 if it does not exist.  Polled to find out
+	// when the file has to be reloaded.
+	static std::uint64_t GetWriteTime(const std::wstring& filename);
+};
@@ -0,0 +1,117 @@
+//***************************************************************************************
+// SceneStorage.cpp
+//***************************************************************************************
+
+#include "SceneStorage.h"
+#include "MathHelper.h"
+
+#include <algorithm>
+
+using namespace DirectX;
+
+void SceneStorage::Resize(unsigned int count)
+{
+	unsigned int oldCount = Size();
+
+	World.resize(count, MathHelper::Identity4x4());
+	TexTransform.resize(count, MathHelper::Identity4x4());
+	LocalBounds.resize(count);
+	Material.resize(count, 0);
+	WorldBounds.resize(count);
+	Visible.resize(count, 1);
+	LodCount.resize(count, 1);
+	Lod.resize(count, 0);
+	mIsDirty.resize(count, 0);
+
+	// New objects have to reach the GPU at least once.
+	for(unsigned int i = oldCount; i < count; ++i)
+		MarkDirty(i);
+}
+
+void SceneStorage::SetWorld(unsigned int index, FXMMATRIX world)
+{
+	EnsureObject(index);
+	XMStoreFloat4x4(&World[index], world);
+	MarkDirty(index);
+}
+
+void SceneStorage::SetTexTransform(unsigned int index, FXMMATRIX texTransform)
+{
+	EnsureObject(index);
+	XMStoreFloat4x4(&TexTransform[index], texTransform);
+	MarkDirty(index);
+}
+
+void SceneStorage::SetLocalBounds(unsigned int index, const BoundingBox& bounds)
+{
+	EnsureObject(index);
+	LocalBounds[index] = bounds;
+	MarkDirty(index);
+}
+
+void SceneStorage::SetMaterial(unsigned int index, unsigned int material)
+{
+	EnsureObject(index);
+	if(Material[index] == material)
+		return;
+
+	Material[index] = material;
+	MarkDirty(index);
+}
+
+void SceneStorage::MarkDirty(unsigned int index)
+{
+	if(mIsDirty[index])
+		return;
+
+	if(!mDirtyList.empty() && mDirtyList.back() > index)
+		mDirtyListSorted = false;
+
+	mIsDirty[index] = 1;
+	mDirtyList.push_back(index);
+}
+
+void SceneStorage::MarkAllDirty()
+{
+	mDirtyList.clear();
+	for(unsigned int i = 0; i < Size(); ++i)
+	{
+		mIsDirty[i] = 1;
+		mDirtyList.push_back(i);
+	}
+
+	mDirtyListSorted = true;
+}
+
+const std::vector<unsigned int>& SceneStorage::GetDirtyList()
+{
+	// Only the changed objects are sorted, so this scales with the dirty count.
+	if(!mDirtyListSorted)
+	{
+		std::sort(mDirtyList.begin(), mDirtyList.end());
+		mDirtyListSorted = true;
+	}
+
+	return mDirtyList;
+}
+
+void SceneStorage::UpdateDirtyBounds()
+{
+	for(unsigned int index : mDirtyList)
+		LocalBounds[index].Transform(WorldBounds[index], XMLoadFloat4x4(&World[index]));
+}
+
+void SceneStorage::ClearDirty()
+{
+	for(unsigned int index : mDirtyList)
+		mIsDirty[index] = 0;
+
+	mDirtyList.clear();
+	mDirtyListSorted = true;
+}
+
+void SceneStorage::EnsureObject(unsigned int index)
+{
+	if(index >= Size())
+		Resize(index + 1);
+}
@@ -0,0 +1,70 @@
+//***************************************************************************************
+// SceneStorage.h
+//
+// Structure-of-arrays storage for the per-object scene state.  Transforms, bounds
+// and visibility live in separate contiguous arrays indexed by object index
+// (RenderItem::ObjCBIndex), so passes that only need one of them stream through
+// tightly packed memory.
+//
+// Every Set*() call puts the object on a compact dirty list; per-frame code walks
+// that list instead of the whole scene, so a static scene costs nothing to update.
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXCollision.h>
+#include <DirectXMath.h>
+#include <vector>
+
+struct SceneStorage
+{
+	// Read-only views; write transforms and bounds through the Set*() functions so
+	// the object is marked dirty.
+	std::vector<DirectX::XMFLOAT4X4> World;
+	std::vector<DirectX::XMFLOAT4X4> TexTransform;
+	std::vector<DirectX::BoundingBox> LocalBounds;
+
+	// Material constant index (Material::MatCBIndex) the object is drawn with.
+	std::vector<unsigned int> Material;
+
+	// LocalBounds transformed by World; refreshed by UpdateDirtyBounds().
+	std::vector<DirectX::BoundingBox> WorldBounds;
+
+	// Result of the frustum test for the current frame, one byte per object.
+	std::vector<unsigned char> Visible;
+
+	// Number of detail levels of the object's mesh, and the level drawn in the
+	// current frame (0 is full detail).  Lod is kept between frames so the
+	// selection can apply hysteresis.
+	std::vector<unsigned char> LodCount;
+	std::vector<unsigned char> Lod;
+
+	unsigned int Size()const { return (unsigned int)World.size(); }
+
+	// Objects are created on first use with identity transforms.
+	void Resize(unsigned int count);
+
+	void SetWorld(unsigned int index, DirectX::FXMMATRIX world);
+	void SetTexTransform(unsigned int index, DirectX::FXMMATRIX texTransform);
+	void SetLocalBounds(unsigned int index, const DirectX::BoundingBox& bounds);
+	void SetMaterial(unsigned int index, unsigned int material);
+
+	void MarkDirty(unsigned int index);
+	void MarkAllDirty();
+
+	// Objects changed since the last ClearDirty(), sorted by index so callers can
+	// batch contiguous runs.
+	const std::vector<unsigned int>& GetDirtyList();
+
+	// Recompute WorldBounds of every dirty object.
+	void UpdateDirtyBounds();
+
+	void ClearDirty();
+
+private:
+	void EnsureObject(unsigned int index);
+
+	std::vector<unsigned int> mDirtyList;
+	std::vector<unsigned char> mIsDirty;
+	bool mDirtyListSorted = true;
+};
@@ -0,0 +1,155 @@
+//***************************************************************************************
+// ShaderCache.cpp
+//***************************************************************************************
+
+#include "ShaderCache.h"
+
+#include <iomanip>
+#include <set>
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	void HashString(std::uint64_t& hash, const std::string& s)
+	{
+		// Include the terminator so "AB","C" and "A","BC" hash differently.
+		hash = d3dUtil::HashBytes(s.c_str(), s.size() + 1, hash);
+	}
+
+	std::wstring GetDirectory(const std::wstring& filename)
+	{
+		size_t slash = filename.find_last_of(L"\\/");
+		return slash == std::wstring::npos ? std::wstring() : filename.substr(0, slash + 1);
+	}
+
+	// Hashes the text of filename and, recursively, of every file it pulls in with
+	// #include "...".  Includes are resolved relative to the including file, the
+	// same way D3D_COMPILE_STANDARD_FILE_INCLUDE does.
+	void HashSourceFile(std::uint64_t& hash, const std::wstring& filename, std::set<std::wstring>& visited)
+	{
+		if(!visited.insert(filename).second)
+			return;
+
+		std::ifstream fin(filename, std::ios::binary);
+		if(!fin)
+			throw DxException(HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND), L"ShaderCache " + filename, AnsiToWString(__FILE__), __LINE__);
+
+		std::string source((std::istreambuf_iterator<char>(fin)), std::istreambuf_iterator<char>());
+		HashString(hash, source);
+
+		std::istringstream lines(source);
+		std::string line;
+		while(std::getline(lines, line))
+		{
+			size_t directive = line.find_first_not_of(" \t");
+			if(directive == std::string::npos || line.compare(directive, 8, "#include") != 0)
+				continue;
+
+			size_t open = line.find('"', directive);
+			size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+			if(close == std::string::npos)
+				continue;
+
+			std::string include = line.substr(open + 1, close - open - 1);
+			HashSourceFile(hash, GetDirectory(filename) + AnsiToWString(include), visited);
+		}
+	}
+}
+
+ShaderCache::ShaderCache(const std::wstring& cacheDirectory, UINT compileFlags, bool allowCompile) :
+	mCacheDirectory(cacheDirectory),
+	mCompileFlags(compileFlags),
+	mAllowCompile(allowCompile)
+{
+	if(!mCacheDirectory.empty() && mCacheDirectory.back() != L'\\' && mCacheDirectory.back() != L'/')
+		mCacheDirectory += L'\\';
+
+	if(mAllowCompile)
+		CreateDirectoryW(mCacheDirectory.c_str(), nullptr);
+}
+
+ComPtr<ID3DBlob> ShaderCache::GetShader(
+	const std::wstring& filename,
+	const D3D_SHADER_MACRO* defines,
+	const std::string& entrypoint,
+	const std::string& target)
+{
+	std::wstring blobPath = GetBlobPath(filename, defines, entrypoint, target);
+
+	if(GetFileAttributesW(blobPath.c_str()) != INVALID_FILE_ATTRIBUTES)
+		return d3dUtil::LoadBinary(blobPath);
+
+	if(!mAllowCompile)
+		throw DxException(HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND), L"ShaderCache::GetShader " + blobPath, AnsiToWString(__FILE__), __LINE__);
+
+	ComPtr<ID3DBlob> byteCode = nullptr;
+	ComPtr<ID3DBlob> errors;
+	HRESULT hr = D3DCompileFromFile(filename.c_str(), defines, D3D_COMPILE_STANDARD_FILE_INCLUDE,
+		entrypoint.c_str(), target.c_str(), mCompileFlags, 0, &byteCode, &errors);
+
+	if(errors != nullptr)
+		OutputDebugStringA((char*)errors->GetBufferPointer());
+
+	ThrowIfFailed(hr);
+
+	if(!d3dUtil::SaveBinary(blobPath, byteCode.Get()))
+	{
+		OutputDebugString((L"ShaderCache: could not write " + blobPath + L"\n").c_str());
+		++mStoreFailureCount;
+	}
+	++mCompileCount;
+
+	return byteCode;
+}
+
+std::wstring ShaderCache::GetBlobPath(
+	const std::wstring& filename,
+	const D3D_SHADER_MACRO* defines,
+	const std::string& entrypoint,
+	const std::string& target)const
+{
+	std::wstring stem = filename.substr(GetDirectory(filename).size());
+	stem = stem.substr(0, stem.find_last_of(L'.'));
+
+	std::wostringstream path;
+	path << mCacheDirectory << stem << L'_' << AnsiToWString(entrypoint) << L'_'
+		<< std::hex << std::setw(16) << std::setfill(L'0') << ComputeKey(filename, defines, entrypoint, target)
+		<< L".cso";
+
+	return path.str();
+}
+
+UINT ShaderCache::DefaultCompileFlags()
+{
+	UINT compileFlags = 0;
+#if defined(DEBUG) || defined(_DEBUG)
+	compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+#endif
+
+	return compileFlags;
+}
+
+std::uint64_t ShaderCache::ComputeKey(
+	const std::wstring& filename,
+	const D3D_SHADER_MACRO* defines,
+	const std::string& entrypoint,
+	const std::string& target)const
+{
+	std::uint64_t hash = d3dUtil::HashBytes(nullptr, 0);
+
+	std::set<std::wstring> visited;
+	HashSourceFile(hash, filename, visited);
+
+	for(const D3D_SHADER_MACRO* d = defines; d != nullptr && d->Name != nullptr; ++d)
+	{
+		HashString(hash, d->Name);
+		HashString(hash, d->Definition != nullptr ? d->Definition : "");
+	}
+
+	HashString(hash, entrypoint);
+	HashString(hash, target);
+	hash = d3dUtil::HashBytes(&mCompileFlags, sizeof(mCompileFlags), hash);
+
+	return hash;
+}
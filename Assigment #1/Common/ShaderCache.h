@@ -0,0 +1,72 @@
+//***************************************************************************************
+// ShaderCache.h
+//
+// Loads precompiled shader bytecode from a directory of .cso blobs.  Each blob is
+// named after a 64-bit key built from the source text (including every file it
+// #includes), the defines, the entry point, the target and the compile flags, so a
+// stale blob is never picked up after a shader is edited.
+//
+// The blobs are produced ahead of time by Tools/ShaderCompiler, which the Release
+// configuration runs as a pre-build step.  Release also defines
+// SHADER_CACHE_REQUIRE_PRECOMPILED, so a missing blob is an error there instead
+// of a compile on first launch.  Other builds compile and store a missing blob on
+// first use, so shader edits show up without rerunning the tool.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+
+#if defined(SHADER_CACHE_REQUIRE_PRECOMPILED)
+	#define SHADER_CACHE_ALLOW_RUNTIME_COMPILE 0
+#else
+	#define SHADER_CACHE_ALLOW_RUNTIME_COMPILE 1
+#endif
+
+class ShaderCache
+{
+public:
+	// compileFlags are part of the key; allowCompile lets GetShader compile and
+	// store missing blobs.
+	ShaderCache(const std::wstring& cacheDirectory, UINT compileFlags,
+		bool allowCompile = SHADER_CACHE_ALLOW_RUNTIME_COMPILE != 0);
+	ShaderCache(const ShaderCache& rhs) = delete;
+	ShaderCache& operator=(const ShaderCache& rhs) = delete;
+
+	// Returns the bytecode of the variant, loading it through d3dUtil::LoadBinary.
+	// Throws a DxException if the blob is missing and compiling is not allowed, or
+	// if the shader fails to compile.
+	Microsoft::WRL::ComPtr<ID3DBlob> GetShader(
+		const std::wstring& filename,
+		const D3D_SHADER_MACRO* defines,
+		const std::string& entrypoint,
+		const std::string& target);
+
+	// Path of the .cso blob GetShader would load for the variant.
+	std::wstring GetBlobPath(
+		const std::wstring& filename,
+		const D3D_SHADER_MACRO* defines,
+		const std::string& entrypoint,
+		const std::string& target)const;
+
+	// Number of GetShader calls that had to compile, and how many of those could
+	// not store the blob.  A blob that was not stored is still returned.
+	UINT GetCompileCount()const { return mCompileCount; }
+	UINT GetStoreFailureCount()const { return mStoreFailureCount; }
+
+	// Compile flags the app uses for the current build configuration.
+	static UINT DefaultCompileFlags();
+
+private:
+	std::uint64_t ComputeKey(
+		const std::wstring& filename,
+		const D3D_SHADER_MACRO* defines,
+		const std::string& entrypoint,
+		const std::string& target)const;
+
+	std::wstring mCacheDirectory;
+	UINT mCompileFlags = 0;
+	bool mAllowCompile = false;
+	UINT mCompileCount = 0;
+	UINT mStoreFailureCount = 0;
+};
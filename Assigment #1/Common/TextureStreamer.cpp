@@ -0,0 +1,306 @@
+//***************************************************************************************
+// TextureStreamer.cpp
+//***************************************************************************************
+
+#include "TextureStreamer.h"
+
+using Microsoft::WRL::ComPtr;
+
+TextureStreamer::TextureStreamer(ID3D12Device* device, unsigned int loadThreadCount) :
+	mDevice(device)
+{
+	D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+	queueDesc.Type = D3D12_COMMAND_LIST_TYPE_COPY;
+	queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+	ThrowIfFailed(mDevice->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&mCopyQueue)));
+
+	ComPtr<ID3D12CommandAllocator> alloc = AcquireAllocator();
+	ThrowIfFailed(mDevice->CreateCommandList(
+		0,
+		D3D12_COMMAND_LIST_TYPE_COPY,
+		alloc.Get(),
+		nullptr,
+		IID_PPV_ARGS(mCopyList.GetAddressOf())));
+
+	// Start off in a closed state; every batch resets the list first.
+	mCopyList->Close();
+	mFreeAllocators.push_back(alloc);
+
+	ThrowIfFailed(mDevice->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&mFence)));
+
+	mFenceEvent = CreateEventEx(nullptr, false, false, EVENT_ALL_ACCESS);
+
+	mLoadThreads = std::make_unique<ThreadPool>(loadThreadCount);
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	// Let the workers finish the file they are on before tearing anything down,
+	// then make sure the copy queue no longer references our buffers.
+	mLoadThreads.reset();
+	WaitForFence(mCurrentFence);
+
+	if(mFenceEvent != nullptr)
+		CloseHandle(mFenceEvent);
+}
+
+void TextureStreamer::Request(Texture* tex)
+{
+	++mOutstandingRequests;
+
+	mLoadThreads->Enqueue([this, tex]()
+	{
+		auto parsed = std::make_unique<ParsedTexture>();
+		parsed->Tex = tex;
+		parsed->Result = StageTexture(*parsed);
+
+		std::lock_guard<std::mutex> lock(mParsedMutex);
+		mParsed.push_back(std::move(parsed));
+	});
+}
+
+std::vector<Texture*> TextureStreamer::Update()
+{
+	std::vector<Texture*> resident;
+
+	if(mOutstandingRequests == 0)
+		return resident;
+
+	RetireBatches(resident);
+	SubmitParsedTextures();
+
+	// Once everything has landed there is no reason to keep the staging memory.
+	if(mOutstandingRequests == 0)
+	{
+		std::lock_guard<std::mutex> lock(mUploadBufferMutex);
+		mFreeUploadBuffers.clear();
+		if(mFreeAllocators.size() > 1)
+			mFreeAllocators.resize(1);
+	}
+
+	return resident;
+}
+
+bool TextureStreamer::IsBusy()const
+{
+	return mOutstandingRequests > 0;
+}
+
+void TextureStreamer::Flush()
+{
+	std::vector<Texture*> resident;
+	while(mOutstandingRequests > 0)
+	{
+		// Let the workers drain the request queue, then wait out the copies.
+		mLoadThreads->Wait();
+		SubmitParsedTextures();
+		WaitForFence(mCurrentFence);
+		RetireBatches(resident);
+	}
+}
+
+void TextureStreamer::RetireBatches(std::vector<Texture*>& resident)
+{
+	const UINT64 completedFence = mFence->GetCompletedValue();
+
+	auto firstPending = std::stable_partition(mInFlight.begin(), mInFlight.end(),
+		[completedFence](const UploadBatch& b) { return b.Fence <= completedFence; });
+
+	for(auto it = mInFlight.begin(); it != firstPending; ++it)
+	{
+		for(size_t i = 0; i < it->Textures.size(); ++i)
+		{
+			it->Textures[i]->Resource = it->Resources[i];
+			resident.push_back(it->Textures[i]);
+		}
+
+		mOutstandingRequests -= (UINT)it->Textures.size();
+
+		ThrowIfFailed(it->CmdListAlloc->Reset());
+		mFreeAllocators.push_back(it->CmdListAlloc);
+
+		std::lock_guard<std::mutex> lock(mUploadBufferMutex);
+		for(auto& buffer : it->UploadBuffers)
+			mFreeUploadBuffers.push_back(buffer);
+	}
+
+	mInFlight.erase(mInFlight.begin(), firstPending);
+}
+
+void TextureStreamer::SubmitParsedTextures()
+{
+	std::vector<std::unique_ptr<ParsedTexture>> parsed;
+	{
+		std::lock_guard<std::mutex> lock(mParsedMutex);
+		parsed.swap(mParsed);
+	}
+
+	if(parsed.empty())
+		return;
+
+	UploadBatch batch;
+	batch.CmdListAlloc = AcquireAllocator();
+	ThrowIfFailed(mCopyList->Reset(batch.CmdListAlloc.Get(), nullptr));
+
+	UINT64 submittedBytes = 0;
+	size_t next = 0;
+	try
+	{
+		for(; next < parsed.size(); ++next)
+		{
+			ParsedTexture& p = *parsed[next];
+
+			// Surface load failures on the main thread, the same way the synchronous
+			// loader did.
+			if(FAILED(p.Result))
+				throw DxException(p.Result, L"MapDDSTextureDataFromFile12", AnsiToWString(__FILE__), __LINE__);
+
+			if(!batch.Textures.empty() && submittedBytes + p.UploadByteSize > MaxUploadBytesPerUpdate)
+				break;
+
+			ComPtr<ID3D12Resource> texture;
+			ThrowIfFailed(mDevice->CreateCommittedResource(
+				&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+				D3D12_HEAP_FLAG_NONE,
+				&p.Desc,
+				D3D12_RESOURCE_STATE_COMMON,
+				nullptr,
+				IID_PPV_ARGS(&texture)));
+
+			// The worker already laid the texels out in the upload buffer.
+			for(UINT i = 0; i < (UINT)p.Layouts.size(); ++i)
+			{
+				CD3DX12_TEXTURE_COPY_LOCATION dst(texture.Get(), i);
+				CD3DX12_TEXTURE_COPY_LOCATION src(p.UploadBuffer.Get(), p.Layouts[i]);
+				mCopyList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+			}
+
+			batch.Textures.push_back(p.Tex);
+			batch.Resources.push_back(texture);
+			batch.UploadBuffers.push_back(p.UploadBuffer);
+			submittedBytes += p.UploadByteSize;
+		}
+	}
+	catch(...)
+	{
+		// Leave the list closed, so the next Reset of it succeeds, and the
+		// allocator reusable; none of this batch was submitted.
+		mCopyList->Close();
+		batch.CmdListAlloc->Reset();
+		mFreeAllocators.push_back(batch.CmdListAlloc);
+		throw;
+	}
+
+	ThrowIfFailed(mCopyList->Close());
+	ID3D12CommandList* cmdsLists[] = { mCopyList.Get() };
+	mCopyQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+
+	batch.Fence = ++mCurrentFence;
+	ThrowIfFailed(mCopyQueue->Signal(mFence.Get(), batch.Fence));
+	mInFlight.push_back(std::move(batch));
+
+	// Whatever did not fit in the budget goes back to the front of the queue.
+	if(next < parsed.size())
+	{
+		std::lock_guard<std::mutex> lock(mParsedMutex);
+		mParsed.insert(mParsed.begin(),
+			std::make_move_iterator(parsed.begin() + next),
+			std::make_move_iterator(parsed.end()));
+	}
+}
+
+HRESULT TextureStreamer::StageTexture(ParsedTexture& parsed)
+{
+	// Mapped rather than read, so the copy below is the only pass over the texels
+	// and the file never sits in a heap allocation.  The view is released on
+	// return.
+	DirectX::DDSTextureData12 data;
+	HRESULT hr = DirectX::MapDDSTextureDataFromFile12(parsed.Tex->Filename.c_str(), data);
+	if(FAILED(hr))
+		return hr;
+
+	const UINT subresourceCount = (UINT)data.Subresources.size();
+	parsed.Desc = data.Desc;
+	parsed.Layouts.resize(subresourceCount);
+	std::vector<UINT> numRows(subresourceCount);
+	std::vector<UINT64> rowSizes(subresourceCount);
+	mDevice->GetCopyableFootprints(&parsed.Desc, 0, subresourceCount, 0,
+		parsed.Layouts.data(), numRows.data(), rowSizes.data(), &parsed.UploadByteSize);
+
+	hr = AcquireUploadBuffer(parsed.UploadByteSize, parsed.UploadBuffer);
+	if(FAILED(hr))
+		return hr;
+
+	BYTE* mappedUpload = nullptr;
+	hr = parsed.UploadBuffer->Map(0, nullptr, reinterpret_cast<void**>(&mappedUpload));
+	if(FAILED(hr))
+		return hr;
+
+	for(UINT i = 0; i < subresourceCount; ++i)
+	{
+		const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& layout = parsed.Layouts[i];
+		D3D12_MEMCPY_DEST dest = { mappedUpload + layout.Offset, layout.Footprint.RowPitch,
+			(SIZE_T)layout.Footprint.RowPitch * numRows[i] };
+		MemcpySubresource(&dest, &data.Subresources[i], (SIZE_T)rowSizes[i], numRows[i], layout.Footprint.Depth);
+	}
+
+	parsed.UploadBuffer->Unmap(0, nullptr);
+	return S_OK;
+}
+
+void TextureStreamer::WaitForFence(UINT64 fence)
+{
+	if(mFence == nullptr || mFence->GetCompletedValue() >= fence)
+		return;
+
+	ThrowIfFailed(mFence->SetEventOnCompletion(fence, mFenceEvent));
+	WaitForSingleObject(mFenceEvent, INFINITE);
+}
+
+ComPtr<ID3D12CommandAllocator> TextureStreamer::AcquireAllocator()
+{
+	if(!mFreeAllocators.empty())
+	{
+		ComPtr<ID3D12CommandAllocator> alloc = mFreeAllocators.back();
+		mFreeAllocators.pop_back();
+		return alloc;
+	}
+
+	ComPtr<ID3D12CommandAllocator> alloc;
+	ThrowIfFailed(mDevice->CreateCommandAllocator(
+		D3D12_COMMAND_LIST_TYPE_COPY,
+		IID_PPV_ARGS(alloc.GetAddressOf())));
+	return alloc;
+}
+
+HRESULT TextureStreamer::AcquireUploadBuffer(UINT64 byteSize, ComPtr<ID3D12Resource>& buffer)
+{
+	{
+		std::lock_guard<std::mutex> lock(mUploadBufferMutex);
+
+		// Best fit from the recycled buffers.
+		size_t best = mFreeUploadBuffers.size();
+		for(size_t i = 0; i < mFreeUploadBuffers.size(); ++i)
+		{
+			UINT64 width = mFreeUploadBuffers[i]->GetDesc().Width;
+			if(width >= byteSize && (best == mFreeUploadBuffers.size() || width < mFreeUploadBuffers[best]->GetDesc().Width))
+				best = i;
+		}
+
+		if(best != mFreeUploadBuffers.size())
+		{
+			buffer = mFreeUploadBuffers[best];
+			mFreeUploadBuffers.erase(mFreeUploadBuffers.begin() + best);
+			return S_OK;
+		}
+	}
+
+	// The device is free threaded, so the workers create their own.
+	return mDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(byteSize),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&buffer));
+}
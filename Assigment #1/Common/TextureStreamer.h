@@ -0,0 +1,114 @@
+//***************************************************************************************
+// TextureStreamer.h
+//
+// Streams DDS textures in the background.  Worker threads memory-map and parse
+// the files and copy the texels straight from the mapped file into an upload
+// buffer, in the layout GetCopyableFootprints gives; that is the only time the
+// texels are copied on the CPU.  The main thread then only records the
+// CopyTextureRegion calls on a D3D12_COMMAND_LIST_TYPE_COPY queue, and completion
+// is tracked with a fence.  Update() is called once per frame on the
+// main thread and returns the textures that became resident since the last call,
+// so the app can point their descriptors at the real resource.
+//
+// Textures are created in D3D12_RESOURCE_STATE_COMMON; the copy queue promotes
+// them to COPY_DEST implicitly, and they decay back to COMMON once the copy work
+// completes, which lets the direct queue promote them to a shader resource state
+// on first use without any cross-queue barriers.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "DDSTextureLoader.h"
+#include "ThreadPool.h"
+
+class TextureStreamer
+{
+public:
+	TextureStreamer(ID3D12Device* device, unsigned int loadThreadCount);
+	TextureStreamer(const TextureStreamer& rhs) = delete;
+	TextureStreamer& operator=(const TextureStreamer& rhs) = delete;
+	~TextureStreamer();
+
+	// Queue tex->Filename for loading.  tex must stay alive until it is returned by
+	// Update() or the streamer is destroyed.  tex->Resource is assigned on the main
+	// thread once the texture is resident; tex->UploadHeap is never used because
+	// upload memory is recycled by the streamer.
+	void Request(Texture* tex);
+
+	// Retire finished uploads and submit newly parsed textures.  Returns the
+	// textures that became resident.  Throws a DxException if a texture could not
+	// be loaded.
+	std::vector<Texture*> Update();
+
+	// True while there are requests that are not yet resident.
+	bool IsBusy()const;
+
+	// Block until every request is resident.
+	void Flush();
+
+private:
+	// A texture whose texels are staged in UploadBuffer, one footprint per
+	// subresource, waiting for its copy to be recorded.
+	struct ParsedTexture
+	{
+		Texture* Tex = nullptr;
+		HRESULT Result = S_OK;
+		D3D12_RESOURCE_DESC Desc = {};
+		std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> Layouts;
+		UINT64 UploadByteSize = 0;
+		Microsoft::WRL::ComPtr<ID3D12Resource> UploadBuffer;
+	};
+
+	struct UploadBatch
+	{
+		UINT64 Fence = 0;
+		Microsoft::WRL::ComPtr<ID3D12CommandAllocator> CmdListAlloc;
+		std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> UploadBuffers;
+		std::vector<Texture*> Textures;
+		std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> Resources;
+	};
+
+	// Worker threads.  Reports failures through the result rather than throwing,
+	// so they reach the main thread with the texture.
+	HRESULT StageTexture(ParsedTexture& parsed);
+	HRESULT AcquireUploadBuffer(UINT64 byteSize, Microsoft::WRL::ComPtr<ID3D12Resource>& buffer);
+
+	void RetireBatches(std::vector<Texture*>& resident);
+	void SubmitParsedTextures();
+	void WaitForFence(UINT64 fence);
+
+	Microsoft::WRL::ComPtr<ID3D12CommandAllocator> AcquireAllocator();
+
+private:
+	// Upper bound on the upload bytes submitted per Update() so one batch of copy
+	// work never grows too large.  At least one texture is always submitted.
+	static const UINT64 MaxUploadBytesPerUpdate = 32 * 1024 * 1024;
+
+	ID3D12Device* mDevice = nullptr;
+
+	Microsoft::WRL::ComPtr<ID3D12CommandQueue> mCopyQueue;
+	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> mCopyList;
+	Microsoft::WRL::ComPtr<ID3D12Fence> mFence;
+	UINT64 mCurrentFence = 0;
+	HANDLE mFenceEvent = nullptr;
+
+	// Number of requested textures that are not resident yet.  Main thread only.
+	UINT mOutstandingRequests = 0;
+
+	// Filled by the worker threads, drained by SubmitParsedTextures().
+	std::mutex mParsedMutex;
+	std::vector<std::unique_ptr<ParsedTexture>> mParsed;
+
+	std::vector<UploadBatch> mInFlight;
+
+	// Recycled once the fence of the batch that used them has passed.  The upload
+	// buffers are taken by the workers, hence the mutex.
+	std::vector<Microsoft::WRL::ComPtr<ID3D12CommandAllocator>> mFreeAllocators;
+	std::mutex mUploadBufferMutex;
+	std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> mFreeUploadBuffers;
+
+	// Declared last so the workers are joined before the state they write to is
+	// destroyed.
+	std::unique_ptr<ThreadPool> mLoadThreads;
+};
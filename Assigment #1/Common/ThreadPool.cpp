@@ -0,0 +1,97 @@
+//***************************************************************************************
+// ThreadPool.cpp
+//***************************************************************************************
+
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned int threadCount)
+{
+	if(threadCount == 0)
+		threadCount = 1;
+
+	mThreads.reserve(threadCount);
+	for(unsigned int i = 0; i < threadCount; ++i)
+		mThreads.emplace_back(&ThreadPool::WorkerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mShutdown = true;
+	}
+	mJobAvailable.notify_all();
+
+	for(auto& t : mThreads)
+		t.join();
+}
+
+unsigned int ThreadPool::ThreadCount()const
+{
+	return (unsigned int)mThreads.size();
+}
+
+void ThreadPool::Enqueue(std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mJobs.push(std::move(job));
+		++mPendingJobs;
+	}
+	mJobAvailable.notify_one();
+}
+
+void ThreadPool::Wait()
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	mJobsDone.wait(lock, [this] { return mPendingJobs == 0; });
+
+	if(mFirstError != nullptr)
+	{
+		std::exception_ptr error = mFirstError;
+		mFirstError = nullptr;
+		std::rethrow_exception(error);
+	}
+}
+
+void ThreadPool::WorkerLoop()
+{
+	for(;;)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mJobAvailable.wait(lock, [this] { return mShutdown || !mJobs.empty(); });
+
+			if(mShutdown && mJobs.empty())
+				return;
+
+			job = std::move(mJobs.front());
+			mJobs.pop();
+		}
+
+		// Jobs may throw (e.g., ThrowIfFailed), so hand the error back to Wait()
+		// instead of letting it terminate the worker thread.
+		std::exception_ptr error = nullptr;
+		try
+		{
+			job();
+		}
+		catch(...)
+		{
+			error = std::current_exception();
+		}
+
+		bool allDone = false;
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			if(error != nullptr && mFirstError == nullptr)
+				mFirstError = error;
+
+			allDone = (--mPendingJobs == 0);
+		}
+
+		if(allDone)
+			mJobsDone.notify_all();
+	}
+}
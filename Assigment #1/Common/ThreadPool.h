@@ -0,0 +1,52 @@
+//***************************************************************************************
+// ThreadPool.h
+//
+// Persistent pool of worker threads.  Jobs are queued with Enqueue() and the
+// caller blocks in Wait() until every queued job has finished.  The threads are
+// created once and sleep on a condition variable between batches, so the pool
+// can be used every frame without paying thread creation costs.
+//***************************************************************************************
+
+#pragma once
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+	explicit ThreadPool(unsigned int threadCount);
+	ThreadPool(const ThreadPool& rhs) = delete;
+	ThreadPool& operator=(const ThreadPool& rhs) = delete;
+	~ThreadPool();
+
+	unsigned int ThreadCount()const;
+
+	// Queue a job to run on one of the worker threads.
+	void Enqueue(std::function<void()> job);
+
+	// Block until all queued jobs have completed.  If a job threw, the first
+	// exception is rethrown here on the calling thread.
+	void Wait();
+
+private:
+	void WorkerLoop();
+
+	std::vector<std::thread> mThreads;
+	std::queue<std::function<void()>> mJobs;
+
+	std::mutex mMutex;
+	std::condition_variable mJobAvailable;
+	std::condition_variable mJobsDone;
+
+	// Number of jobs queued or running.
+	unsigned int mPendingJobs = 0;
+	bool mShutdown = false;
+
+	std::exception_ptr mFirstError = nullptr;
+};
@@ -0,0 +1,136 @@
+//***************************************************************************************
+// UploadRingBuffer.cpp
+//***************************************************************************************
+
+#include "UploadRingBuffer.h"
+
+UploadRingBuffer::UploadRingBuffer(ID3D12Device* device, UINT64 byteSize) :
+	mCapacity(byteSize)
+{
+	ThrowIfFailed(device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(mCapacity),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&mUploadBuffer)));
+
+	// Stays mapped for the lifetime of the ring.  Upload heaps are write-combined,
+	// so the CPU should only ever write to (never read from) this memory.
+	ThrowIfFailed(mUploadBuffer->Map(0, nullptr, reinterpret_cast<void**>(&mMappedData)));
+
+	mBaseAddress = mUploadBuffer->GetGPUVirtualAddress();
+}
+
+UploadRingBuffer::~UploadRingBuffer()
+{
+	if(mUploadBuffer != nullptr)
+		mUploadBuffer->Unmap(0, nullptr);
+
+	mMappedData = nullptr;
+}
+
+ID3D12Resource* UploadRingBuffer::Resource()const
+{
+	return mUploadBuffer.Get();
+}
+
+UploadRingBuffer::Allocation UploadRingBuffer::Allocate(UINT64 byteSize, UINT64 alignment)
+{
+	Allocation alloc;
+	if(!TryAllocate(byteSize, alignment, alloc))
+		throw DxException(E_OUTOFMEMORY, L"UploadRingBuffer::Allocate", AnsiToWString(__FILE__), __LINE__);
+
+	return alloc;
+}
+
+bool UploadRingBuffer::TryAllocate(UINT64 byteSize, UINT64 alignment, Allocation& alloc)
+{
+	assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+	UINT64 offset = (mHead + alignment - 1) & ~(alignment - 1);
+	bool fits = false;
+
+	if(mUsedBytes == 0 || mHead > mTail)
+	{
+		// Free space is [mHead, mCapacity) followed by [0, mTail).
+		if(offset + byteSize <= mCapacity)
+		{
+			fits = true;
+		}
+		else if(byteSize <= mTail || mUsedBytes == 0)
+		{
+			// Skip the end of the buffer and wrap around.
+			offset = 0;
+			fits = byteSize <= (mUsedBytes == 0 ? mCapacity : mTail);
+		}
+	}
+	else if(mHead < mTail)
+	{
+		// Free space is [mHead, mTail).
+		fits = offset + byteSize <= mTail;
+	}
+
+	if(!fits)
+		return false;
+
+	// Padding, including a skipped end of the buffer, stays allocated until the
+	// frame retires.
+	UINT64 consumed = (offset >= mHead) ? (offset + byteSize - mHead) : (mCapacity - mHead + offset + byteSize);
+	if(mUsedBytes == 0)
+	{
+		mTail = offset;
+		consumed = byteSize;
+	}
+
+	mHead = offset + byteSize;
+	mUsedBytes += consumed;
+	mCurrentFrameBytes += consumed;
+
+	alloc.CPU = mMappedData + offset;
+	alloc.GPU = mBaseAddress + offset;
+	alloc.Offset = offset;
+	return true;
+}
+
+void UploadRingBuffer::FinishFrame(UINT64 fenceValue)
+{
+	FrameMarker marker;
+	marker.Fence = fenceValue;
+	marker.Head = mHead;
+	marker.ByteSize = mCurrentFrameBytes;
+	mFrames.push(marker);
+
+	mCurrentFrameBytes = 0;
+}
+
+void UploadRingBuffer::Retire(UINT64 completedFenceValue)
+{
+	while(!mFrames.empty() && mFrames.front().Fence <= completedFenceValue)
+	{
+		mTail = mFrames.front().Head;
+		mUsedBytes -= mFrames.front().ByteSize;
+		mFrames.pop();
+	}
+
+	if(mUsedBytes == 0)
+	{
+		mHead = 0;
+		mTail = 0;
+	}
+}
+
+UINT64 UploadRingBuffer::Capacity()const
+{
+	return mCapacity;
+}
+
+UINT64 UploadRingBuffer::UsedBytes()const
+{
+	return mUsedBytes;
+}
+
+UINT64 UploadRingBuffer::CurrentFrameBytes()const
+{
+	return mCurrentFrameBytes;
+}
@@ -0,0 +1,110 @@
+//***************************************************************************************
+// UploadRingBuffer.h
+//
+// Linear sub-allocator over one large, persistently mapped upload heap.  Every
+// frame bump-allocates its constant and structured buffer data from the head of
+// the ring; FinishFrame() tags those allocations with the frame's fence value and
+// Retire() hands the space back once the GPU has passed that fence.
+//
+// Replaces one committed UploadBuffer<T> per data type per frame resource, so
+// the amount of per-frame data can change without recreating any resources.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+
+#include <queue>
+
+class UploadRingBuffer
+{
+public:
+	struct Allocation
+	{
+		BYTE* CPU = nullptr;
+		D3D12_GPU_VIRTUAL_ADDRESS GPU = 0;
+
+		// Byte offset into Resource(), for use as a copy source.
+		UINT64 Offset = 0;
+	};
+
+	UploadRingBuffer(ID3D12Device* device, UINT64 byteSize);
+	UploadRingBuffer(const UploadRingBuffer& rhs) = delete;
+	UploadRingBuffer& operator=(const UploadRingBuffer& rhs) = delete;
+	~UploadRingBuffer();
+
+	ID3D12Resource* Resource()const;
+
+	// Bump-allocate byteSize bytes aligned to alignment (a power of two).  Throws a
+	// DxException if the ring has no room left, which means it is too small for
+	// the frames in flight.
+	Allocation Allocate(UINT64 byteSize, UINT64 alignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+
+	// Like Allocate(), but returns false instead of throwing when there is no room.
+	bool TryAllocate(UINT64 byteSize, UINT64 alignment, Allocation& alloc);
+
+	// Copy count elements into one allocation at the 256-byte constant buffer
+	// stride, so element i can be bound as a root CBV at GPU + i*stride.
+	template<typename T>
+	D3D12_GPU_VIRTUAL_ADDRESS AllocateConstantBuffers(const T* data, UINT count)
+	{
+		const UINT stride = d3dUtil::CalcConstantBufferByteSize(sizeof(T));
+
+		Allocation alloc = Allocate((UINT64)stride * MathHelper::Max(count, 1u));
+		for(UINT i = 0; i < count; ++i)
+			memcpy(alloc.CPU + (UINT64)i*stride, &data[i], sizeof(T));
+
+		return alloc.GPU;
+	}
+
+	// Copy count tightly packed elements for use as a StructuredBuffer<T>.
+	template<typename T>
+	D3D12_GPU_VIRTUAL_ADDRESS AllocateStructuredBuffer(const T* data, UINT count)
+	{
+		Allocation alloc = Allocate(sizeof(T) * (UINT64)MathHelper::Max(count, 1u), StructuredAlignment);
+		if(count > 0)
+			memcpy(alloc.CPU, data, sizeof(T) * (size_t)count);
+
+		return alloc.GPU;
+	}
+
+	// Everything allocated since the last call belongs to the frame that signals
+	// fenceValue.
+	void FinishFrame(UINT64 fenceValue);
+
+	// Free the allocations of every finished frame with a fence value at or below
+	// completedFenceValue.
+	void Retire(UINT64 completedFenceValue);
+
+	UINT64 Capacity()const;
+	UINT64 UsedBytes()const;
+
+	// Bytes allocated since the last FinishFrame(), including alignment padding.
+	UINT64 CurrentFrameBytes()const;
+
+private:
+	static const UINT64 StructuredAlignment = 16;
+
+	struct FrameMarker
+	{
+		UINT64 Fence = 0;
+		UINT64 Head = 0;
+		UINT64 ByteSize = 0;
+	};
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> mUploadBuffer;
+	BYTE* mMappedData = nullptr;
+	D3D12_GPU_VIRTUAL_ADDRESS mBaseAddress = 0;
+
+	UINT64 mCapacity = 0;
+
+	// Allocations live in [mTail, mHead), wrapping around the end of the buffer.
+	UINT64 mHead = 0;
+	UINT64 mTail = 0;
+	UINT64 mUsedBytes = 0;
+
+	// Bytes allocated since the last FinishFrame(), including alignment padding.
+	UINT64 mCurrentFrameBytes = 0;
+
+	std::queue<FrameMarker> mFrames;
+};
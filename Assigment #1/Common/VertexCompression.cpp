@@ -0,0 +1,126 @@
+//***************************************************************************************
+// VertexCompression.cpp
+//***************************************************************************************
+
+#include "VertexCompression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	const float* Element(const float* first, std::size_t stride, std::size_t index)
+	{
+		return reinterpret_cast<const float*>(reinterpret_cast<const char*>(first) + index*stride);
+	}
+
+	std::int16_t FloatToSnorm16(float value)
+	{
+		value = std::min(std::max(value, -1.0f), 1.0f);
+		return (std::int16_t)std::lround(value * 32767.0f);
+	}
+}
+
+std::uint16_t VertexCompression::FloatToHalf(float value)
+{
+	std::uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+
+	const std::uint32_t sign = (bits >> 16) & 0x8000;
+	const std::uint32_t floatExponent = (bits >> 23) & 0xff;
+	std::uint32_t mantissa = bits & 0x7fffff;
+
+	// Infinity and NaN.
+	if(floatExponent == 0xff)
+		return (std::uint16_t)(sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0));
+
+	const std::int32_t exponent = (std::int32_t)floatExponent - 127 + 15;
+	if(exponent >= 31)
+		return (std::uint16_t)(sign | 0x7c00);
+
+	std::uint32_t shift = 13;
+	std::uint32_t half = 0;
+	if(exponent <= 0)
+	{
+		// Denormal, or too small for even that.
+		if(exponent < -10)
+			return (std::uint16_t)sign;
+
+		mantissa |= 0x800000;
+		shift = 14 - exponent;
+		half = mantissa >> shift;
+	}
+	else
+	{
+		half = ((std::uint32_t)exponent << 10) | (mantissa >> shift);
+	}
+
+	// A carry out of the mantissa correctly moves on to the next exponent.
+	const std::uint32_t remainder = mantissa & ((1u << shift) - 1);
+	const std::uint32_t halfway = 1u << (shift - 1);
+	if(remainder > halfway || (remainder == halfway && (half & 1) != 0))
+		++half;
+
+	return (std::uint16_t)(sign | half);
+}
+
+void VertexCompression::EncodeOctahedral(const float normal[3], std::int16_t encoded[2])
+{
+	float x = normal[0], y = normal[1], z = normal[2];
+
+	// Project onto the octahedron |x| + |y| + |z| = 1 and fold the lower half
+	// over the upper one.
+	const float l1 = std::fabs(x) + std::fabs(y) + std::fabs(z);
+	if(l1 <= 0.0f)
+	{
+		encoded[0] = 0;
+		encoded[1] = 0;
+		return;
+	}
+
+	x /= l1;
+	y /= l1;
+	if(z < 0.0f)
+	{
+		const float foldedX = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		const float foldedY = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = foldedX;
+		y = foldedY;
+	}
+
+	encoded[0] = FloatToSnorm16(x);
+	encoded[1] = FloatToSnorm16(y);
+}
+
+void VertexCompression::Compress(
+	const float* positions,
+	const float* normals,
+	const float* texCoords,
+	std::size_t stride,
+	std::size_t count,
+	const float center[3],
+	const float extents[3],
+	CompressedVertex* compressed)
+{
+	for(std::size_t i = 0; i < count; ++i)
+	{
+		CompressedVertex& v = compressed[i];
+
+		const float* p = Element(positions, stride, i);
+		for(int j = 0; j < 3; ++j)
+		{
+			// Flat boxes decode to the center whatever is stored.
+			const float size = 2.0f * extents[j];
+			const float unorm = size > 0.0f ? (p[j] - (center[j] - extents[j])) / size : 0.0f;
+			v.Pos[j] = (std::uint16_t)std::lround(std::min(std::max(unorm, 0.0f), 1.0f) * 65535.0f);
+		}
+		v.Pos[3] = 0;
+
+		EncodeOctahedral(Element(normals, stride, i), v.Normal);
+
+		const float* uv = texCoords != nullptr ? Element(texCoords, stride, i) : nullptr;
+		v.TexC[0] = FloatToHalf(uv != nullptr ? uv[0] : 0.0f);
+		v.TexC[1] = FloatToHalf(uv != nullptr ? uv[1] : 0.0f);
+	}
+}
@@ -0,0 +1,56 @@
+//***************************************************************************************
+// VertexCompression.h
+//
+// The 16 byte vertex format shared by the shape geometry, the .mesh files and
+// Default.hlsl.  Positions are quantized to 16 bits per axis within the bounding
+// box of their submesh, normals are octahedral encoded into two 16-bit snorms and
+// texture coordinates are stored as half floats.
+//
+// A position is decoded as unorm * 2 * extents + (center - extents), with the
+// center and extents of the box it was quantized in, which the runtime keeps as
+// SubmeshGeometry::Bounds.
+//
+// This header only depends on the standard library so offline tools can use it.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace VertexCompression
+{
+	struct CompressedVertex
+	{
+		// DXGI_FORMAT_R16G16B16A16_UNORM; w is unused.
+		std::uint16_t Pos[4];
+
+		// DXGI_FORMAT_R16G16_SNORM.
+		std::int16_t Normal[2];
+
+		// DXGI_FORMAT_R16G16_FLOAT.
+		std::uint16_t TexC[2];
+	};
+
+	static_assert(sizeof(CompressedVertex) == 16, "CompressedVertex layout changed.");
+
+	// Nearest half float, rounding ties to even.
+	std::uint16_t FloatToHalf(float value);
+
+	// Octahedral encoding of a unit vector into two snorms.
+	void EncodeOctahedral(const float normal[3], std::int16_t encoded[2]);
+
+	// Compresses count vertices whose position, normal and texture coordinate floats
+	// are all stride bytes apart.  texCoords may be null for zero coordinates.  The
+	// positions are quantized within the box given by center and extents, which
+	// should contain them all.
+	void Compress(
+		const float* positions,
+		const float* normals,
+		const float* texCoords,
+		std::size_t stride,
+		std::size_t count,
+		const float center[3],
+		const float extents[3],
+		CompressedVertex* compressed);
+}
@@ -35,6 +35,24 @@ D3DApp::~D3DApp()
 {
 	if(md3dDevice != nullptr)
 		FlushCommandQueue();
+
+	if(mFrameLatencyWaitable != nullptr)
+		CloseHandle(mFrameLatencyWaitable);
+	if(mFenceEvent != nullptr)
+		CloseHandle(mFenceEvent);
+}
+
+void FramePacingSettings::Parse(CommandLine& args)
+{
+	args.GetUint("-frameresources", 1, 16, FrameResourceCount);
+	args.GetUint("-latency", 1, 16, MaxFrameLatency);
+
+	if(args.HasFlag("-vsync"))
+		SyncInterval = 1;
+	if(args.HasFlag("-blt"))
+		FlipModel = false;
+	if(args.HasFlag("-tearing"))
+		AllowTearing = true;
 }
 
 HINSTANCE D3DApp::AppInst()const
@@ -86,6 +104,12 @@ int D3DApp::Run()
 		// Otherwise, do animation/game stuff.
 		else
         {	
+			if( !mAppPaused )
+			{
+				ScopedPhaseTimer latencyTimer(mTelemetry, FramePhase::LatencyWait);
+				WaitForFrameLatency();
+			}
+
 			mTimer.Tick();
 
 			if( !mAppPaused )
@@ -154,12 +178,12 @@ void D3DApp::OnResize()
 		mSwapChainBuffer[i].Reset();
     mDepthStencilBuffer.Reset();
 	
-	// Resize the swap chain.
+	// Resize the swap chain.  The flags have to match the ones it was created with.
     ThrowIfFailed(mSwapChain->ResizeBuffers(
 		SwapChainBufferCount, 
 		mClientWidth, mClientHeight, 
 		mBackBufferFormat, 
-		DXGI_SWAP_CHAIN_FLAG_ALLOW_MODE_SWITCH));
+		mSwapChainFlags));
 
 	mCurrBackBuffer = 0;
  
@@ -446,6 +470,11 @@ bool D3DApp::InitDirect3D()
 	ThrowIfFailed(md3dDevice->CreateFence(0, D3D12_FENCE_FLAG_NONE,
 		IID_PPV_ARGS(&mFence)));
 
+	// Reused by every FlushCommandQueue().
+	mFenceEvent = CreateEventEx(nullptr, false, false, EVENT_ALL_ACCESS);
+	if(mFenceEvent == nullptr)
+		ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+
 	mRtvDescriptorSize = md3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
 	mDsvDescriptorSize = md3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_DSV);
 	mCbvSrvUavDescriptorSize = md3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
@@ -507,6 +536,29 @@ void D3DApp::CreateSwapChain()
     // Release the previous swapchain we will be recreating.
     mSwapChain.Reset();
 
+	if(mFrameLatencyWaitable != nullptr)
+	{
+		CloseHandle(mFrameLatencyWaitable);
+		mFrameLatencyWaitable = nullptr;
+	}
+
+	mSwapChainFlags = DXGI_SWAP_CHAIN_FLAG_ALLOW_MODE_SWITCH;
+	if(mFramePacing.FlipModel)
+	{
+		mSwapChainFlags |= DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT;
+
+		// Tearing needs DXGI 1.5 and display support.
+		ComPtr<IDXGIFactory5> factory5;
+		BOOL tearingSupported = FALSE;
+		if(mFramePacing.AllowTearing &&
+			SUCCEEDED(mdxgiFactory.As(&factory5)) &&
+			SUCCEEDED(factory5->CheckFeatureSupport(DXGI_FEATURE_PRESENT_ALLOW_TEARING, &tearingSupported, sizeof(tearingSupported))) &&
+			tearingSupported)
+		{
+			mSwapChainFlags |= DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING;
+		}
+	}
+
     DXGI_SWAP_CHAIN_DESC sd;
     sd.BufferDesc.Width = mClientWidth;
     sd.BufferDesc.Height = mClientHeight;
@@ -521,14 +573,27 @@ void D3DApp::CreateSwapChain()
     sd.BufferCount = SwapChainBufferCount;
     sd.OutputWindow = mhMainWnd;
     sd.Windowed = true;
-	sd.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
-    sd.Flags = DXGI_SWAP_CHAIN_FLAG_ALLOW_MODE_SWITCH;
+	sd.SwapEffect = mFramePacing.FlipModel ? DXGI_SWAP_EFFECT_FLIP_DISCARD : DXGI_SWAP_EFFECT_FLIP_SEQUENTIAL;
+    sd.Flags = mSwapChainFlags;
 
 	// Note: Swap chain uses queue to perform flush.
     ThrowIfFailed(mdxgiFactory->CreateSwapChain(
 		mCommandQueue.Get(),
 		&sd, 
 		mSwapChain.GetAddressOf()));
+
+	// DXGI's alt-enter switches to exclusive fullscreen, where tearing presents
+	// are not allowed.
+	if(mSwapChainFlags & DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING)
+		ThrowIfFailed(mdxgiFactory->MakeWindowAssociation(mhMainWnd, DXGI_MWA_NO_ALT_ENTER));
+
+	if(mSwapChainFlags & DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT)
+	{
+		ComPtr<IDXGISwapChain2> swapChain2;
+		ThrowIfFailed(mSwapChain.As(&swapChain2));
+		ThrowIfFailed(swapChain2->SetMaximumFrameLatency(mFramePacing.MaxFrameLatency));
+		mFrameLatencyWaitable = swapChain2->GetFrameLatencyWaitableObject();
+	}
 }
 
 void D3DApp::FlushCommandQueue()
@@ -542,19 +607,40 @@ void D3DApp::FlushCommandQueue()
     ThrowIfFailed(mCommandQueue->Signal(mFence.Get(), mCurrentFence));
 
 	// Wait until the GPU has completed commands up to this fence point.
-    if(mFence->GetCompletedValue() < mCurrentFence)
-	{
-		HANDLE eventHandle = CreateEventEx(nullptr, false, false, EVENT_ALL_ACCESS);
+	WaitForFence(mCurrentFence, mFenceEvent);
+}
 
-        // Fire event when GPU hits current fence.  
-        ThrowIfFailed(mFence->SetEventOnCompletion(mCurrentFence, eventHandle));
+void D3DApp::WaitForFence(UINT64 fenceValue, HANDLE eventHandle)
+{
+    if(mFence->GetCompletedValue() < fenceValue)
+	{
+        // Fire event when GPU hits the fence.  
+        ThrowIfFailed(mFence->SetEventOnCompletion(fenceValue, eventHandle));
 
-        // Wait until the GPU hits current fence event is fired.
+        // Wait until the GPU hits the fence and the event is fired.
 		WaitForSingleObject(eventHandle, INFINITE);
-        CloseHandle(eventHandle);
 	}
 }
 
+void D3DApp::WaitForFrameLatency()
+{
+	// Time out rather than hang if presents stop completing, e.g. while the
+	// window is occluded.
+	if(mFrameLatencyWaitable != nullptr)
+		WaitForSingleObjectEx(mFrameLatencyWaitable, 1000, TRUE);
+}
+
+HRESULT D3DApp::Present()
+{
+	// Tearing is only allowed with a zero sync interval in windowed mode.
+	UINT flags = 0;
+	if((mSwapChainFlags & DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING) && mFramePacing.SyncInterval == 0 && !mFullscreenState)
+		flags |= DXGI_PRESENT_ALLOW_TEARING;
+
+	ScopedPhaseTimer presentTimer(mTelemetry, FramePhase::Present);
+	return mSwapChain->Present(mFramePacing.SyncInterval, flags);
+}
+
 ID3D12Resource* D3DApp::CurrentBackBuffer()const
 {
 	return mSwapChainBuffer[mCurrBackBuffer].Get();
@@ -577,31 +663,33 @@ void D3DApp::CalculateFrameStats()
 {
 	// Code computes the average frames per second, and also the 
 	// average time it takes to render one frame.  These stats 
-	// are appended to the window caption bar.
+	// are appended to the window caption bar, with the longest frame
+	// of the second, which the average hides.
     
-	static int frameCnt = 0;
-	static float timeElapsed = 0.0f;
-
-	frameCnt++;
+	mFrameStatsCount++;
+	mFrameStatsWorst = MathHelper::Max(mFrameStatsWorst, (float)(1000.0*mTimer.PreciseDeltaTime()));
 
 	// Compute averages over one second period.
-	if( (mTimer.TotalTime() - timeElapsed) >= 1.0f )
+	if( (mTimer.TotalTime() - mFrameStatsTime) >= 1.0f )
 	{
-		float fps = (float)frameCnt; // fps = frameCnt / 1
+		float fps = (float)mFrameStatsCount; // fps = frameCnt / 1
 		float mspf = 1000.0f / fps;
 
         wstring fpsStr = to_wstring(fps);
         wstring mspfStr = to_wstring(mspf);
+        wstring worstStr = to_wstring(mFrameStatsWorst);
 
         wstring windowText = mMainWndCaption +
             L"    fps: " + fpsStr +
-            L"   mspf: " + mspfStr;
+            L"   mspf: " + mspfStr +
+            L"   worst: " + worstStr;
 
         SetWindowText(mhMainWnd, windowText.c_str());
 		
 		// Reset for next average.
-		frameCnt = 0;
-		timeElapsed += 1.0f;
+		mFrameStatsCount = 0;
+		mFrameStatsWorst = 0.0f;
+		mFrameStatsTime += 1.0f;
 	}
 }
 
@@ -10,13 +10,45 @@
 #endif
 
 #include "d3dUtil.h"
+#include "CommandLine.h"
+#include "FrameTelemetry.h"
 #include "GameTimer.h"
 
+#include <dxgi1_5.h>
+
 // Link necessary d3d12 libraries.
 #pragma comment(lib,"d3dcompiler.lib")
 #pragma comment(lib, "D3D12.lib")
 #pragma comment(lib, "dxgi.lib")
 
+// How far the CPU runs ahead of the GPU and the display.  The derived class sets
+// mFramePacing in its constructor.
+struct FramePacingSettings
+{
+	// Frames the CPU may record ahead of the GPU; the app keeps one FrameResource
+	// per frame.
+	UINT FrameResourceCount = 3;
+
+	// Presents that may be queued before WaitForFrameLatency() blocks.  Lower
+	// values cut input-to-photon latency at the cost of GPU idle time.
+	UINT MaxFrameLatency = 2;
+
+	// 0 presents immediately, 1 waits for the next vblank.
+	UINT SyncInterval = 0;
+
+	// Flip-discard presents with the frame latency waitable object and, if
+	// allowed, tearing.  D3D12 swap chains only support flip effects, so turning
+	// this off (-blt) selects plain flip-sequential presents without either.
+	bool FlipModel = true;
+
+	// Lets presents with a zero sync interval tear in windowed mode, where the
+	// display supports it.
+	bool AllowTearing = false;
+
+	// Reads -frameresources N, -latency N, -vsync, -blt and -tearing.
+	void Parse(CommandLine& args);
+};
+
 class D3DApp
 {
 protected:
@@ -62,6 +94,16 @@ protected:
 
 	void FlushCommandQueue();
 
+	// Blocks until mFence reaches fenceValue, using eventHandle to sleep on.
+	void WaitForFence(UINT64 fenceValue, HANDLE eventHandle);
+
+	// Blocks until the swap chain is ready to queue another frame.  Run() calls it
+	// before every Update() so a frame's input is sampled as late as possible.
+	void WaitForFrameLatency();
+
+	// Presents with the sync interval and flags chosen by mFramePacing.
+	HRESULT Present();
+
 	ID3D12Resource* CurrentBackBuffer()const;
 	D3D12_CPU_DESCRIPTOR_HANDLE CurrentBackBufferView()const;
 	D3D12_CPU_DESCRIPTOR_HANDLE DepthStencilView()const;
@@ -90,6 +132,15 @@ protected:
 
 	// Used to keep track of the delta-time and game time (4.4).
 	GameTimer mTimer;
+
+	// Per-frame phase times; Run() and Present() time the waits and the present,
+	// the derived class the rest, and ends each frame.
+	FrameTelemetry mTelemetry;
+
+	// Frames and longest frame time since CalculateFrameStats last refreshed.
+	int mFrameStatsCount = 0;
+	float mFrameStatsTime = 0.0f;
+	float mFrameStatsWorst = 0.0f;
 	
     Microsoft::WRL::ComPtr<IDXGIFactory4> mdxgiFactory;
     Microsoft::WRL::ComPtr<IDXGISwapChain> mSwapChain;
@@ -97,6 +148,11 @@ protected:
 
     Microsoft::WRL::ComPtr<ID3D12Fence> mFence;
     UINT64 mCurrentFence = 0;
+	HANDLE mFenceEvent = nullptr;
+
+	FramePacingSettings mFramePacing;
+	UINT mSwapChainFlags = 0;
+	HANDLE mFrameLatencyWaitable = nullptr;
 	
     Microsoft::WRL::ComPtr<ID3D12CommandQueue> mCommandQueue;
     Microsoft::WRL::ComPtr<ID3D12CommandAllocator> mDirectCmdListAlloc;
@@ -35,6 +35,25 @@ ComPtr<ID3DBlob> d3dUtil::LoadBinary(const std::wstring& filename)
     return blob;
 }
 
+bool d3dUtil::SaveBinary(const std::wstring& filename, ID3DBlob* blob)
+{
+    // Per process, so concurrent writers of the same file do not share one.
+    const std::wstring tempName = filename + L"." + std::to_wstring(GetCurrentProcessId()) + L".tmp";
+
+    std::ofstream fout(tempName, std::ios::binary | std::ios::trunc);
+    fout.write((const char*)blob->GetBufferPointer(), blob->GetBufferSize());
+    fout.close();
+
+    if(fout.fail() ||
+        !MoveFileExW(tempName.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+    {
+        DeleteFileW(tempName.c_str());
+        return false;
+    }
+
+    return true;
+}
+
 Microsoft::WRL::ComPtr<ID3D12Resource> d3dUtil::CreateDefaultBuffer(
     ID3D12Device* device,
     ID3D12GraphicsCommandList* cmdList,
@@ -28,8 +28,7 @@
 #include "d3dx12.h"
 #include "DDSTextureLoader.h"
 #include "MathHelper.h"
-
-extern const int gNumFrameResources;
+#include "ResourceRegistry.h"
 
 inline void d3dSetDebugName(IDXGIObject* obj, const char* name)
 {
@@ -112,8 +111,25 @@ public:
         return (byteSize + 255) & ~255;
     }
 
+    // 64-bit FNV-1a.  Pass the previous result as hash to chain several buffers.
+    static std::uint64_t HashBytes(const void* data, size_t byteSize, std::uint64_t hash = 14695981039346656037ull)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for(size_t i = 0; i < byteSize; ++i)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+
+        return hash;
+    }
+
     static Microsoft::WRL::ComPtr<ID3DBlob> LoadBinary(const std::wstring& filename);
 
+    // Writes blob to a temporary file and moves it over filename, so filename is
+    // either the whole blob or left as it was.  Returns false if either step fails.
+    static bool SaveBinary(const std::wstring& filename, ID3DBlob* blob);
+
     static Microsoft::WRL::ComPtr<ID3D12Resource> CreateDefaultBuffer(
         ID3D12Device* device,
         ID3D12GraphicsCommandList* cmdList,
@@ -142,6 +158,14 @@ public:
     int LineNumber = -1;
 };
 
+// Draw arguments of one of the coarser detail levels of a submesh.
+struct SubmeshLod
+{
+	UINT IndexCount = 0;
+	UINT StartIndexLocation = 0;
+	INT BaseVertexLocation = 0;
+};
+
 // Defines a subrange of geometry in a MeshGeometry.  This is for when multiple
 // geometries are stored in one vertex and index buffer.  It provides the offsets
 // and data needed to draw a subset of geometry stores in the vertex and index 
@@ -155,6 +179,10 @@ struct SubmeshGeometry
     // Bounding box of the geometry defined by this submesh. 
     // This is used in later chapters of the book.
 	DirectX::BoundingBox Bounds;
+
+	// Coarser versions of the submesh in the same buffers, from most to least
+	// detailed, for distant instances.  They share Bounds.
+	std::vector<SubmeshLod> Lods;
 };
 
 struct MeshGeometry
@@ -170,9 +198,6 @@ struct MeshGeometry
 	Microsoft::WRL::ComPtr<ID3D12Resource> VertexBufferGPU = nullptr;
 	Microsoft::WRL::ComPtr<ID3D12Resource> IndexBufferGPU = nullptr;
 
-	Microsoft::WRL::ComPtr<ID3D12Resource> VertexBufferUploader = nullptr;
-	Microsoft::WRL::ComPtr<ID3D12Resource> IndexBufferUploader = nullptr;
-
     // Data about the buffers.
 	UINT VertexByteStride = 0;
 	UINT VertexBufferByteSize = 0;
@@ -181,8 +206,9 @@ struct MeshGeometry
 
 	// A MeshGeometry may store multiple geometries in one vertex/index buffer.
 	// Use this container to define the Submesh geometries so we can draw
-	// the Submeshes individually.
-	std::unordered_map<std::string, SubmeshGeometry> DrawArgs;
+	// the Submeshes individually.  Look submeshes up by name at load time and keep
+	// the SubmeshHandle (or the copied draw arguments) for per-frame use.
+	ResourceRegistry<SubmeshGeometry, SubmeshHandle> DrawArgs;
 
 	D3D12_VERTEX_BUFFER_VIEW VertexBufferView()const
 	{
@@ -203,13 +229,6 @@ struct MeshGeometry
 
 		return ibv;
 	}
-
-	// We can free this memory after we finish upload to the GPU.
-	void DisposeUploaders()
-	{
-		VertexBufferUploader = nullptr;
-		IndexBufferUploader = nullptr;
-	}
 };
 
 struct Light
@@ -222,8 +241,6 @@ struct Light
     float SpotPower = 64.0f;                            // spot light only
 };
 
-#define MaxLights 16
-
 struct MaterialConstants
 {
 	DirectX::XMFLOAT4 DiffuseAlbedo = { 1.0f, 1.0f, 1.0f, 1.0f };
@@ -247,14 +264,17 @@ struct Material
 	// Index into SRV heap for diffuse texture.
 	int DiffuseSrvHeapIndex = -1;
 
+	// Slice of the diffuse texture when it is an array packed by
+	// Tools/TexturePacker.
+	int DiffuseSlice = 0;
+
 	// Index into SRV heap for normal texture.
 	int NormalSrvHeapIndex = -1;
 
 	// Dirty flag indicating the material has changed and we need to update the constant buffer.
-	// Because we have a material constant buffer for each FrameResource, we have to apply the
-	// update to each FrameResource.  Thus, when we modify a material we should set 
-	// NumFramesDirty = gNumFrameResources so that each frame resource gets the update.
-	int NumFramesDirty = gNumFrameResources;
+	// The constants are kept in one CPU array that is copied to every frame's upload
+	// allocation, so a change only has to be applied once.
+	int NumFramesDirty = 1;
 
 	// Material constant buffer data used for shading.
 	DirectX::XMFLOAT4 DiffuseAlbedo = { 1.0f, 1.0f, 1.0f, 1.0f };
@@ -1,18 +1,37 @@
 #include "FrameResource.h"
 
-FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount)
+FrameResource::FrameResource(ID3D12Device* device, UINT recordThreadCount)
 {
+    FenceEvent = CreateEventEx(nullptr, false, false, EVENT_ALL_ACCESS);
+    if(FenceEvent == nullptr)
+        ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+
     ThrowIfFailed(device->CreateCommandAllocator(
         D3D12_COMMAND_LIST_TYPE_DIRECT,
 		IID_PPV_ARGS(CmdListAlloc.GetAddressOf())));
 
-  //  FrameCB = std::make_unique<UploadBuffer<FrameConstants>>(device, 1, true);
-    PassCB = std::make_unique<UploadBuffer<PassConstants>>(device, passCount, true);
-    MaterialCB = std::make_unique<UploadBuffer<MaterialConstants>>(device, materialCount, true);
-    ObjectCB = std::make_unique<UploadBuffer<ObjectConstants>>(device, objectCount, true);
+    WorkerCmdListAllocs.resize(recordThreadCount);
+    WorkerCmdLists.resize(recordThreadCount);
+    for(UINT i = 0; i < recordThreadCount; ++i)
+    {
+        ThrowIfFailed(device->CreateCommandAllocator(
+            D3D12_COMMAND_LIST_TYPE_DIRECT,
+            IID_PPV_ARGS(WorkerCmdListAllocs[i].GetAddressOf())));
+
+        ThrowIfFailed(device->CreateCommandList(
+            0,
+            D3D12_COMMAND_LIST_TYPE_DIRECT,
+            WorkerCmdListAllocs[i].Get(),
+            nullptr,
+            IID_PPV_ARGS(WorkerCmdLists[i].GetAddressOf())));
+
+        // Start off closed like D3DApp::mCommandList; Draw resets it each frame.
+        ThrowIfFailed(WorkerCmdLists[i]->Close());
+    }
 }
 
 FrameResource::~FrameResource()
 {
-
+    if(FenceEvent != nullptr)
+        CloseHandle(FenceEvent);
 }
\ No newline at end of file
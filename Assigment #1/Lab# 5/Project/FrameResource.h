@@ -2,54 +2,144 @@
 
 #include "../../Common/d3dUtil.h"
 #include "../../Common/MathHelper.h"
-#include "../../Common/UploadBuffer.h"
+#include "../../Common/UploadRingBuffer.h"
+#include "../../Common/VertexCompression.h"
+#include "Shaders/PassConstants.h"
 
-struct ObjectConstants
+// Per-instance data read by the instanced Default.hlsl vertex shader, indexed by
+// RenderItem::ObjCBIndex.  The material is per instance too, so objects that
+// only differ in material share an instance group.
+struct InstanceData
 {
     DirectX::XMFLOAT4X4 World = MathHelper::Identity4x4();
-	DirectX::XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
+    DirectX::XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
+
+    // Decodes the quantized vertex positions of the object's mesh; derived from
+    // its local bounds (see VertexCompression.h).
+    DirectX::XMFLOAT3 PosScale = { 1.0f, 1.0f, 1.0f };
+    UINT MaterialIndex = 0;
+    DirectX::XMFLOAT3 PosBias = { 0.0f, 0.0f, 0.0f };
+    float InstPad1 = 0.0f;
 };
 
-struct PassConstants
+// Per-material data read from a structured buffer by both pipelines.  Indexed
+// by Material::MatCBIndex; DiffuseMapIndex is a descriptor index into the
+// shader-visible heap and DiffuseSlice the slice of that texture array.
+struct MaterialData
 {
-    DirectX::XMFLOAT4X4 View = MathHelper::Identity4x4();
-    DirectX::XMFLOAT4X4 InvView = MathHelper::Identity4x4();
-    DirectX::XMFLOAT4X4 Proj = MathHelper::Identity4x4();
-    DirectX::XMFLOAT4X4 InvProj = MathHelper::Identity4x4();
-    DirectX::XMFLOAT4X4 ViewProj = MathHelper::Identity4x4();
-    DirectX::XMFLOAT4X4 InvViewProj = MathHelper::Identity4x4();
+    DirectX::XMFLOAT4 DiffuseAlbedo = { 1.0f, 1.0f, 1.0f, 1.0f };
+    DirectX::XMFLOAT3 FresnelR0 = { 0.01f, 0.01f, 0.01f };
+    float Roughness = 0.25f;
+    DirectX::XMFLOAT4X4 MatTransform = MathHelper::Identity4x4();
+    UINT DiffuseMapIndex = 0;
+    UINT DiffuseSlice = 0;
+    UINT MatPad1 = 0;
+    UINT MatPad2 = 0;
+};
+
+// Per-object input of the GPU culling pass (Cull.hlsl): the world space bounds,
+// the draw command of the object's full detail level, or NoDrawCommand, and the
+// number of detail levels.
+struct CullObject
+{
+    static const UINT NoDrawCommand = 0xffffffff;
+
+    DirectX::XMFLOAT3 Center = { 0.0f, 0.0f, 0.0f };
+    UINT DrawCommand = NoDrawCommand;
+    DirectX::XMFLOAT3 Extents = { 0.0f, 0.0f, 0.0f };
+    UINT LodCount = 1;
+};
+
+// Shared by Cull.hlsl and SpriteCull.hlsl.
+struct CullConstants
+{
+    // World space frustum planes, normals pointing inwards.
+    DirectX::XMFLOAT4 FrustumPlanes[6];
     DirectX::XMFLOAT3 EyePosW = { 0.0f, 0.0f, 0.0f };
-    float cbPerObjectPad1 = 0.0f;
-    DirectX::XMFLOAT2 RenderTargetSize = { 0.0f, 0.0f };
-    DirectX::XMFLOAT2 InvRenderTargetSize = { 0.0f, 0.0f };
-    float NearZ = 0.0f;
-    float FarZ = 0.0f;
-    float TotalTime = 0.0f;
-    float DeltaTime = 0.0f;
+    UINT CullingEnabled = 1;
+    UINT ObjectCount = 0;
+    UINT SpriteCount = 0;
+
+    // Tree sprites thin out from SpriteLodStart and are gone at SpriteLodEnd.
+    float SpriteLodStart = 0.0f;
+    float SpriteLodEnd = 0.0f;
 
-    DirectX::XMFLOAT4 AmbientLight = { 0.0f, 0.0f, 0.0f, 1.0f };
+    // Mesh detail level selection; see gLodScreenSizes in LitColumnsApp.cpp.
+    // LodScale takes a bounding sphere radius to a fraction of half the screen
+    // height at distance 1.
+    DirectX::XMFLOAT4 LodScreenSizes = { 0.0f, 0.0f, 0.0f, 0.0f };
+    float LodScale = 1.0f;
+    float LodHysteresis = 0.0f;
+    float CullPad0 = 0.0f;
+    float CullPad1 = 0.0f;
 
-    // Indices [0, NUM_DIR_LIGHTS) are directional lights;
-    // indices [NUM_DIR_LIGHTS, NUM_DIR_LIGHTS+NUM_POINT_LIGHTS) are point lights;
-    // indices [NUM_DIR_LIGHTS+NUM_POINT_LIGHTS, NUM_DIR_LIGHTS+NUM_POINT_LIGHT+NUM_SPOT_LIGHTS)
-    // are spot lights for a maximum of MaxLights per object.
-    Light Lights[MaxLights];
+    // Occlusion test against the previous frame's hierarchical-Z pyramid, which
+    // was built with HiZViewProj from a HiZRenderWidth x HiZRenderHeight depth
+    // buffer.  HiZMipCount is 0 while there is no pyramid yet.
+    DirectX::XMFLOAT4X4 HiZViewProj = MathHelper::Identity4x4();
+    UINT HiZRenderWidth = 0;
+    UINT HiZRenderHeight = 0;
+    UINT HiZMipCount = 0;
+    UINT CullPad2 = 0;
 };
 
-struct Vertex
+// Placement of one tree sprite; read by SpriteCull.hlsl and TreeSprite.hlsl.
+struct TreeSprite
 {
     DirectX::XMFLOAT3 Pos;
-    DirectX::XMFLOAT3 Normal;
-	DirectX::XMFLOAT2 TexC;
+    DirectX::XMFLOAT2 Size;
 };
 
+// One ExecuteIndirect command per instance group.  The layout matches the app's
+// command signature; Cull.hlsl bumps Draw.InstanceCount and reads InstanceStart
+// by byte offset, so keep the offsets below in sync with it.
+struct IndirectCommand
+{
+    D3D12_VERTEX_BUFFER_VIEW VertexBuffer;
+    D3D12_INDEX_BUFFER_VIEW IndexBuffer;
+
+    // Root constants of Default.hlsl's cbDraw.  Default.hlsl reads the material
+    // from the instance, so MaterialIndex is left at 0.
+    UINT MaterialIndex;
+    UINT InstanceStart;
+
+    D3D12_DRAW_INDEXED_ARGUMENTS Draw;
+};
+
+static_assert(sizeof(IndirectCommand) == 64, "Cull.hlsl assumes a 64 byte command stride");
+static_assert(offsetof(IndirectCommand, InstanceStart) == 36, "Cull.hlsl reads InstanceStart at byte 36");
+static_assert(offsetof(IndirectCommand, Draw) + offsetof(D3D12_DRAW_INDEXED_ARGUMENTS, InstanceCount) == 44,
+    "Cull.hlsl increments InstanceCount at byte 44");
+
+// Directional lights in the pass constants; see PassConstants.h.
+const UINT gMaxDirLights = MAX_DIR_LIGHTS;
+
+// Input of the light binning pass (LightCull.hlsl).
+struct LightCullConstants
+{
+    DirectX::XMFLOAT4X4 View = MathHelper::Identity4x4();
+    DirectX::XMFLOAT4X4 InvProj = MathHelper::Identity4x4();
+
+    // Size of a cluster's screen tile, in pixels.
+    DirectX::XMFLOAT2 TileSize = { 0.0f, 0.0f };
+    DirectX::XMFLOAT2 InvRenderTargetSize = { 0.0f, 0.0f };
+    float NearZ = 0.0f;
+    float FarZ = 0.0f;
+    UINT LightCount = 0;
+    UINT LightCullPad0 = 0;
+};
+
+// Quantized position, octahedral normal and half float texture coordinates; see
+// VertexCompression.h.
+using Vertex = VertexCompression::CompressedVertex;
+
 // Stores the resources needed for the CPU to build the command lists
 // for a frame.  
 struct FrameResource
 {
 public:
     
-    FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount);
+    FrameResource(ID3D12Device* device, UINT recordThreadCount);
     FrameResource(const FrameResource& rhs) = delete;
     FrameResource& operator=(const FrameResource& rhs) = delete;
     ~FrameResource();
@@ -58,14 +148,33 @@ public:
     // So each frame needs their own allocator.
     Microsoft::WRL::ComPtr<ID3D12CommandAllocator> CmdListAlloc;
 
-    // We cannot update a cbuffer until the GPU is done processing the commands
-    // that reference it.  So each frame needs their own cbuffers.
-   // std::unique_ptr<UploadBuffer<FrameConstants>> FrameCB = nullptr;
-    std::unique_ptr<UploadBuffer<PassConstants>> PassCB = nullptr;
-    std::unique_ptr<UploadBuffer<MaterialConstants>> MaterialCB = nullptr;
-    std::unique_ptr<UploadBuffer<ObjectConstants>> ObjectCB = nullptr;
+    // One allocator/command list pair per recording thread.  Allocators are not
+    // thread safe, so every worker records into its own pair.
+    std::vector<Microsoft::WRL::ComPtr<ID3D12CommandAllocator>> WorkerCmdListAllocs;
+    std::vector<Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList>> WorkerCmdLists;
+
+    // GPU addresses of this frame's constant and structured buffer data.  The data
+    // is sub-allocated from the app's UploadRingBuffer every frame, so it stays
+    // valid until Fence has been reached.  The camera and lighting blocks of the
+    // pass constants change rarely and live in a default heap buffer instead.
+    D3D12_GPU_VIRTUAL_ADDRESS TimeCB = 0;
+    D3D12_GPU_VIRTUAL_ADDRESS MaterialBuffer = 0;
+    D3D12_GPU_VIRTUAL_ADDRESS CullCB = 0;
+    D3D12_GPU_VIRTUAL_ADDRESS LightCullCB = 0;
+
+    // The point and spot lights, rewritten every frame as they animate.
+    D3D12_GPU_VIRTUAL_ADDRESS LightBuffer = 0;
+
+    // For each instance group, the contiguous list of object indices to draw this
+    // frame.  The per-object data itself persists across frames in the app's
+    // default heap scene buffers, and only changed objects are uploaded.  Not
+    // used when the GPU culls; the culling pass writes its own list.
+    D3D12_GPU_VIRTUAL_ADDRESS InstanceIndexBuffer = 0;
 
     // Fence value to mark commands up to this fence point.  This lets us
     // check if these frame resources are still in use by the GPU.
     UINT64 Fence = 0;
+
+    // Signaled when Fence is reached; created once and reused every frame.
+    HANDLE FenceEvent = nullptr;
 };
\ No newline at end of file
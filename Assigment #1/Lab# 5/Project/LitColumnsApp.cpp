@@ -4,9 +4,28 @@
 
 #include "../../Common/d3dApp.h"
 #include "../../Common/MathHelper.h"
-#include "../../Common/UploadBuffer.h"
+#include "../../Common/Benchmark.h"
+#include "../../Common/BoundingVolumeHierarchy.h"
+#include "../../Common/Camera.h"
+#include "../../Common/DescriptorHeapAllocator.h"
+#include "../../Common/DynamicResolution.h"
+#include "../../Common/UploadRingBuffer.h"
 #include "../../Common/GeometryGenerator.h"
+#include "../../Common/GpuMemoryAllocator.h"
+#include "../../Common/MeshLoader.h"
+#include "../../Common/MeshOptimizer.h"
+#include "../../Common/PipelineLibrary.h"
+#include "../../Common/Profiler.h"
+#include "../../Common/RenderQueue.h"
+#include "../../Common/SceneLoader.h"
+#include "../../Common/SceneStorage.h"
+#include "../../Common/ShaderCache.h"
+#include "../../Common/TextureStreamer.h"
+#include "../../Common/ThreadPool.h"
 #include "FrameResource.h"
+#include "ShaderVariants.h"
+
+#include <iomanip>
 
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
@@ -15,32 +34,144 @@ using namespace DirectX::PackedVector;
 #pragma comment(lib, "d3dcompiler.lib")
 #pragma comment(lib, "D3D12.lib")
 
-const int gNumFrameResources = 3;
+// Upload ring space budgeted for each frame in flight; all per-frame constant,
+// instance and light data is sub-allocated from the ring.
+const UINT64 gUploadRingBytesPerFrame = 1792 * 1024;
+
+// Upper bound on the number of threads recording draw commands in parallel.
+const int gMaxRecordThreads = 8;
+
+// Threads reading and parsing streamed textures.
+const int gNumTextureLoadThreads = 2;
+
+// Texture slots, which is what Material::DiffuseSrvHeapIndex refers to: the
+// streamed textures followed by the white texture.  mSrvHeapRemap turns a slot
+// into the descriptor actually sampled.  Every slot is viewed as a
+// Texture2DArray; Material::DiffuseSlice picks the slice.
+const UINT gNumStreamedTextures = 4;
+const UINT gWhiteTextureSlot = 4;
+const UINT gNumTextureSlots = 5;
+
+// Descriptors in the shader-visible heap shared by every texture.
+const UINT gSrvHeapCapacity = 4096;
+
+// Detail levels per mesh.  An object switches to level i + 1 once its bounding
+// sphere covers less than gLodScreenSizes[i] of half the screen height, and back
+// once it is gLodHysteresis past the threshold the other way.  Must match
+// MAX_LODS in Cull.hlsl.
+const UINT gMaxLods = 4;
+const float gLodScreenSizes[gMaxLods - 1] = { 0.3f, 0.12f, 0.05f };
+const float gLodHysteresis = 0.15f;
+
+// Light clusters: screen tiles by exponential depth slices, and the lights kept
+// per cluster.  Must match CLUSTER_COUNT_* and MAX_LIGHTS_PER_CLUSTER in
+// LightingUtil.hlsl.
+const UINT gClusterCountX = 16;
+const UINT gClusterCountY = 9;
+const UINT gClusterCountZ = 24;
+const UINT gClusterCount = gClusterCountX*gClusterCountY*gClusterCountZ;
+const UINT gMaxLightsPerCluster = 127;
+const UINT gClusterStride = gMaxLightsPerCluster + 1;
+
+// Point and spot lights the light buffer can hold.
+const UINT gMaxLights = 4096;
+
+// Levels the hierarchical-Z pyramid can have, enough for a 65536 pixel wide
+// depth buffer.
+const UINT gMaxHiZMips = 16;
+
+// Seconds between checks of the scene file for changes.
+const float gSceneCheckInterval = 0.5f;
+
+// Free-fly camera speed in units per second, for scenes up to this radius; larger
+// scenes cross in the same time.  Shift moves gCameraBoost times faster.
+const float gCameraSpeed = 20.0f;
+const float gCameraSpeedRadius = 200.0f;
+const float gCameraBoost = 5.0f;
+
+// Byte offset of the lighting block in the pass constant buffer, after the
+// camera block; see PassConstants.h.
+const UINT gLightingCBOffset = d3dUtil::CalcConstantBufferByteSize(sizeof(CameraConstants));
+const UINT gPassConstantBufferSize = gLightingCBOffset + d3dUtil::CalcConstantBufferByteSize(sizeof(LightingConstants));
+
+// Rendering options picked on the command line.
+//
+// Usage: [-gpudriven] [-trees N] [-treelod distance] [-lodbias scale] [-lights N]
+//        [-depthprepass] [-occlusion] [-dynres] [-frametarget ms] [-minres scale]
+//        [-scene file] [-noscenereload]
+struct RenderSettings
+{
+	// Cull the instanced layers in a compute pass and draw each layer with one
+	// ExecuteIndirect instead of one draw per instance group.
+	bool GpuDriven = false;
+
+	// Tree sprites scattered around the maze, and the distance at which they have
+	// all faded out.  They start thinning out at half that distance.
+	UINT TreeCount = 16;
+	float TreeLodDistance = 400.0f;
+
+	// Scales the screen size meshes pick their detail level by; above 1 keeps the
+	// full detail meshes farther out.
+	float LodBias = 1.0f;
+
+	// Torches placed on the scene's objects.
+	UINT LightCount = 256;
+
+	// Lay down the opaque layer's depth first, so the lit pass shades one
+	// fragment per pixel.
+	bool DepthPrepass = false;
+
+	// Also cull the GPU-driven objects hidden behind the previous frame's
+	// hierarchical-Z pyramid.  Needs both options above, and is off under 4x
+	// MSAA, which has no pyramid.
+	bool OcclusionCulling = false;
+
+	// Render below the native resolution whenever the GPU frame time goes over
+	// FrameTargetMs, down to MinResolutionScale of the width and height, and
+	// upscale into the back buffer.
+	bool DynamicResolution = false;
+	float FrameTargetMs = 16.6f;
+	float MinResolutionScale = 0.5f;
+
+	// Scene description to load (see Tools/SceneCompiler), and whether a new
+	// version of the file is applied while running.  Benchmarks never reload.
+	std::wstring SceneFile = L"Scenes/castle.scene";
+	bool SceneHotReload = true;
+
+	void Parse(CommandLine& args)
+	{
+		GpuDriven = args.HasFlag("-gpudriven");
+		DepthPrepass = args.HasFlag("-depthprepass");
+		OcclusionCulling = args.HasFlag("-occlusion") && GpuDriven && DepthPrepass;
+		DynamicResolution = args.HasFlag("-dynres");
+		args.GetFloat("-frametarget", 1.0f, 1000.0f, FrameTargetMs);
+		args.GetFloat("-minres", 0.25f, 1.0f, MinResolutionScale);
+		args.GetUint("-trees", 0, 4000000, TreeCount);
+		args.GetFloat("-treelod", 1.0f, 100000.0f, TreeLodDistance);
+		args.GetFloat("-lodbias", 0.01f, 100.0f, LodBias);
+		args.GetUint("-lights", 0, gMaxLights, LightCount);
+
+		std::string scene;
+		if(args.GetString("-scene", scene))
+			SceneFile = AnsiToWString(scene);
+		SceneHotReload = !args.HasFlag("-noscenereload");
+	}
+};
 
 // Lightweight structure stores parameters to draw a shape.  This will
 // vary from app-to-app.
+//
+// Only the draw arguments live here.  The object's transforms, bounds and
+// visibility are kept in SceneStorage at ObjCBIndex.
 struct RenderItem
 {
 	RenderItem() = default;
 
-    // World matrix of the shape that describes the object's local space
-    // relative to the world space, which defines the position, orientation,
-    // and scale of the object in the world.
-    XMFLOAT4X4 World = MathHelper::Identity4x4();
-
-	XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
-
-	// Dirty flag indicating the object data has changed and we need to update the constant buffer.
-	// Because we have an object cbuffer for each FrameResource, we have to apply the
-	// update to each FrameResource.  Thus, when we modify obect data we should set 
-	// NumFramesDirty = gNumFrameResources so that each frame resource gets the update.
-	int NumFramesDirty = gNumFrameResources;
-
-	// Index into GPU constant buffer corresponding to the ObjectCB for this render item.
+	// Index of the object in SceneStorage and in the GPU scene buffers.
 	UINT ObjCBIndex = -1;
 
-	Material* Mat = nullptr;
-	MeshGeometry* Geo = nullptr;
+	MaterialHandle Mat;
+	GeometryHandle Geo;
 
     // Primitive topology.
     D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
@@ -51,6 +182,58 @@ struct RenderItem
     int BaseVertexLocation = 0;
 };
 
+// Render items that share geometry and submesh are drawn together with one
+// DrawIndexedInstanced call, whatever their materials.  Each instance reads its
+// world and texture transforms and its material from the instance scene buffer
+// via the object index list that starts at VisibleStart in
+// FrameResource::InstanceIndexBuffer.
+struct InstanceGroup
+{
+	GeometryHandle Geo;
+
+	D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+
+	UINT IndexCount = 0;
+	UINT StartIndexLocation = 0;
+	int BaseVertexLocation = 0;
+
+	// Detail level of the submesh this group draws, and the number of levels of
+	// the submesh.  The groups of levels 1 to LodCount - 1 directly follow the
+	// level 0 group and list the same objects; each frame an object is drawn by
+	// the group of its SceneStorage::Lod only.
+	UINT Lod = 0;
+	UINT LodCount = 1;
+
+	// Object indices of the group's render items.
+	std::vector<UINT> Objects;
+
+	// Filled in every frame by UpdateInstanceIndices.  SortDepth is the view depth
+	// of the nearest visible instance, or of the farthest one in blended layers.
+	UINT VisibleStart = 0;
+	UINT VisibleCount = 0;
+	float SortDepth = 0.0f;
+};
+
+// Detail level for an object covering screenSize of half the screen height
+// that was drawn at level current last frame; see gLodScreenSizes.  Cull.hlsl
+// does the same on the GPU.
+UINT SelectLod(float screenSize, UINT current, UINT lodCount)
+{
+	// Levels picked with the thresholds moved to either edge of the hysteresis
+	// band.  The current level is kept while it lies between them.
+	UINT finest = 0;
+	UINT coarsest = 0;
+	for(UINT i = 0; i + 1 < lodCount; ++i)
+	{
+		if(screenSize < gLodScreenSizes[i]*(1.0f - gLodHysteresis))
+			finest++;
+		if(screenSize < gLodScreenSizes[i]*(1.0f + gLodHysteresis))
+			coarsest++;
+	}
+
+	return MathHelper::Clamp(current, finest, coarsest);
+}
+
 enum class RenderLayer : int
 {
 	Opaque = 0,
@@ -60,18 +243,43 @@ enum class RenderLayer : int
 	Count
 };
 
+// Order the layers are submitted in.  Parallel recording splits this sequence
+// into contiguous ranges so the command lists still execute in layer order.
+static const RenderLayer gLayerDrawOrder[] =
+{
+	RenderLayer::Opaque,
+	RenderLayer::AlphaTested,
+	RenderLayer::AlphaTestedTreeSprites,
+	RenderLayer::Transparent
+};
+
+// A chunk of the scene file and the render items made from its objects, in the
+// chunk's order, so a reloaded chunk can be applied to them in place.
+struct SceneChunk
+{
+	std::string Name;
+	std::uint64_t Hash = 0;
+
+	std::vector<RenderItem*> Items;
+	std::vector<RenderLayer> Layers;
+};
+
 class LitColumnsApp : public D3DApp
 {
 public:
-    LitColumnsApp(HINSTANCE hInstance);
+    LitColumnsApp(HINSTANCE hInstance, const BenchmarkSettings& benchmark, const FramePacingSettings& framePacing,
+		const RenderSettings& render);
     LitColumnsApp(const LitColumnsApp& rhs) = delete;
     LitColumnsApp& operator=(const LitColumnsApp& rhs) = delete;
     ~LitColumnsApp();
 
     virtual bool Initialize()override;
+	virtual LRESULT MsgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)override;
 
 private:
+    virtual void CreateRtvAndDsvDescriptorHeaps()override;
     virtual void OnResize()override;
+	void UpdateProjection();
     virtual void Update(const GameTimer& gt)override;
     virtual void Draw(const GameTimer& gt)override;
 
@@ -81,24 +289,62 @@ private:
 
     void OnKeyboardInput(const GameTimer& gt);
 	void UpdateCamera(const GameTimer& gt);
+	void PickObject(int x, int y);
 	void AnimateMaterials(const GameTimer& gt);
 	void UpdateObjectCBs(const GameTimer& gt);
+	void EnsureSceneBuffers();
+	void RecordSceneBufferCopies(ID3D12GraphicsCommandList* cmdList);
 	void UpdateMaterialCBs(const GameTimer& gt);
 	void UpdateMainPassCB(const GameTimer& gt);
+	void CullRenderItems(const GameTimer& gt);
+	void UpdateCaption(const GameTimer& gt);
+	void DumpProfile();
+	void UpdateInstanceIndices(const GameTimer& gt);
+	void UpdateCullConstants();
+	void RecordGpuCulling(ID3D12GraphicsCommandList* cmdList);
+	void RecordSpriteCulling(ID3D12GraphicsCommandList* cmdList);
+	void UpdateLights(const GameTimer& gt);
+	void RecordLightCulling(ID3D12GraphicsCommandList* cmdList);
+	void RecordDepthPrepass(ID3D12GraphicsCommandList* cmdList, RenderQueue::SubmitStats& stats);
+	void RecordHiZ(ID3D12GraphicsCommandList* cmdList);
+	void UpdateRenderResolution();
+	void RecordUpscale(ID3D12GraphicsCommandList* cmdList);
+	D3D12_CPU_DESCRIPTOR_HANDLE SceneRenderTargetView()const;
 
 	void LoadTextures();
+	void UpdateTextureStreaming();
+	void CreateTextureSrv(ID3D12Resource* resource, UINT heapIndex, bool isArray);
 	void BuildDescriptorHeaps();
+	void BuildHiZ();
+	void BuildSceneColor();
 
     void BuildRootSignature();
     void BuildShadersAndInputLayout();
     void BuildShapeGeometry();
 	void BuildSkullGeometry();
-	void BuildTreeSpritesGeometry();
+	void BuildTreeSprites();
+	void BuildLights();
     void BuildPSOs();
     void BuildFrameResources();
     void BuildMaterials();
-    void BuildRenderItems();
-    void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems);
+    bool BuildRenderItems();
+	bool ResolveSceneObject(const SceneObjectDesc& desc, RenderItem& ri, RenderLayer& layer)const;
+	void ReloadSceneChunks(const GameTimer& gt);
+	void ScaleScene(UINT copies);
+	void BuildInstanceGroups();
+	void BuildDrawCommands();
+	void SortInstanceGroups(RenderLayer layer);
+	void DrawInstanceGroups(ID3D12GraphicsCommandList* cmdList, RenderLayer layer, size_t begin, size_t end,
+		RenderQueue::SubmitStats& stats);
+	void DrawInstanceGroupsIndirect(ID3D12GraphicsCommandList* cmdList, RenderLayer layer);
+	void DrawTreeSprites(ID3D12GraphicsCommandList* cmdList);
+
+	UINT GetLayerDrawCount(RenderLayer layer)const;
+	UINT GetTotalDrawCount()const;
+	void BuildDrawWork(UINT totalDrawCount);
+	void SetPassRootArguments(ID3D12GraphicsCommandList* cmdList);
+	void RecordDrawRange(ID3D12GraphicsCommandList* cmdList, UINT begin, UINT end, RenderQueue::SubmitStats& stats);
+	void RecordWorkerCommandList(UINT worker, UINT begin, UINT end, bool lastList);
  
 	std::array<const CD3DX12_STATIC_SAMPLER_DESC, 6> GetStaticSamplers();
 
@@ -111,42 +357,276 @@ private:
     FrameResource* mCurrFrameResource = nullptr;
     int mCurrFrameResourceIndex = 0;
 
-    UINT mCbvSrvDescriptorSize = 0;
+	// Per-frame constant and structured buffer data for every frame resource.
+	std::unique_ptr<UploadRingBuffer> mUploadRing;
+
+	// Every default heap buffer, and the staging of their initial data.  Retired
+	// with mUploadRing.
+	std::unique_ptr<GpuMemoryAllocator> mGpuMemory;
+
+	// CPU copy of the material table, indexed by MatCBIndex.  Dirty materials
+	// refresh their entry and the table is copied to the upload ring in one go
+	// each frame.
+	std::vector<MaterialData> mMaterialData;
+
+	// Transforms, bounds and visibility of every object, indexed by ObjCBIndex.
+	SceneStorage mScene;
+
+	// GPU copies of mScene, shared by all frame resources.  mInstanceBuffer holds
+	// tightly packed InstanceData for the instanced path.  Only dirty objects are
+	// uploaded; the copies are recorded at the start of the frame, so earlier
+	// frames have finished reading by the time they run.
+	ComPtr<ID3D12Resource> mInstanceBuffer;
+	UINT mSceneBufferCapacity = 0;
+
+	struct SceneBufferCopy
+	{
+		ID3D12Resource* Dest = nullptr;
+		UINT64 DestOffset = 0;
+		UINT64 SrcOffset = 0;
+		UINT64 ByteSize = 0;
+	};
+
+	// Uploads staged by UpdateObjectCBs for the current frame.
+	std::vector<SceneBufferCopy> mSceneBufferCopies;
+
+	// Scratch list of visible object indices, rebuilt every frame.
+	std::vector<UINT> mInstanceIndices;
+
+	RenderSettings mRenderSettings;
+
+	// GPU-driven path; see RecordGpuCulling.  mCullObjectBuffer is another scene
+	// buffer, updated with mInstanceBuffer.  mDrawCommands is reset from
+	// mDrawCommandTemplates, which has every InstanceCount at zero, and filled in
+	// by the culling pass together with mGpuInstanceIndices.  mGpuObjectLods keeps
+	// every object's detail level from one frame to the next.  A single copy of
+	// each is enough as the frames execute in order on one queue.
+	ComPtr<ID3D12Resource> mCullObjectBuffer;
+	ComPtr<ID3D12Resource> mGpuInstanceIndices;
+	ComPtr<ID3D12Resource> mGpuObjectLods;
+	ComPtr<ID3D12Resource> mDrawCommands;
+	ComPtr<ID3D12Resource> mDrawCommandTemplates;
+	ComPtr<ID3D12RootSignature> mCullRootSignature;
+	ComPtr<ID3D12CommandSignature> mDrawCommandSignature;
+	ID3D12PipelineState* mCullPSO = nullptr;
+	ID3D12PipelineState* mCullOcclusionPSO = nullptr;
+	UINT mDrawCommandCount = 0;
+	UINT mCullGpuScope = 0;
+
+	// Slots of mGpuInstanceIndices taken by the draw commands; every detail level
+	// of a group has a range for all of the group's objects.
+	UINT mGpuInstanceSlotCount = 0;
+
+	// Draw command each object is an instance of, by ObjCBIndex.
+	std::vector<UINT> mObjectDrawCommand;
+
+	// First command and command count of each instanced layer in mDrawCommands.
+	UINT mLayerFirstCommand[(int)RenderLayer::Count] = { 0 };
+	UINT mLayerCommandCount[(int)RenderLayer::Count] = { 0 };
+
+	// Tree sprites; see RecordSpriteCulling.  The culling pass rewrites
+	// mTreeSpriteDrawArgs from mTreeSpriteDrawTemplate, which draws six vertices
+	// per instance and no instances, and lists the sprites to draw in
+	// mVisibleTreeSprites.  TreeSprite.hlsl turns every instance into a quad.
+	ComPtr<ID3D12Resource> mTreeSpriteBuffer;
+	ComPtr<ID3D12Resource> mVisibleTreeSprites;
+	ComPtr<ID3D12Resource> mTreeSpriteDrawArgs;
+	ComPtr<ID3D12Resource> mTreeSpriteDrawTemplate;
+	ComPtr<ID3D12CommandSignature> mTreeSpriteCommandSignature;
+	ID3D12PipelineState* mSpriteCullPSO = nullptr;
+	MaterialHandle mTreeSpriteMat;
+	UINT mTreeSpriteCount = 0;
+	UINT mSpriteCullGpuScope = 0;
+
+	// Point and spot lights; see RecordLightCulling.  mLights is mBaseLights with
+	// this frame's flicker applied.  LightCull.hlsl bins them into mClusterLights,
+	// gClusterStride uints per cluster.
+	std::vector<Light> mBaseLights;
+	std::vector<Light> mLights;
+	std::vector<float> mLightPhases;
+	ComPtr<ID3D12Resource> mClusterLights;
+	ID3D12PipelineState* mLightCullPSO = nullptr;
+	UINT mLightCullGpuScope = 0;
+
+	// Depth pre-pass and the hierarchical-Z pyramid built from it for occlusion
+	// culling; see RecordHiZ.  mHiZ rests in NON_PIXEL_SHADER_RESOURCE, and mHiZSrvIndex views
+	// all of its levels for the passes that test against it.  The descriptors are
+	// allocated once and rewritten when the window resizes.  mHiZViewProj and
+	// mHiZRenderWidth x mHiZRenderHeight are what the pyramid was last built
+	// with; mHiZValid goes false until one is built into a new mHiZ.
+	ID3D12PipelineState* mDepthPrepassPSO = nullptr;
+	ComPtr<ID3D12Resource> mHiZ;
+	ComPtr<ID3D12RootSignature> mHiZRootSignature;
+	ID3D12PipelineState* mHiZPSO = nullptr;
+	UINT mHiZMipCount = 0;
+	UINT mHiZWidth = 0;
+	UINT mHiZHeight = 0;
+	XMFLOAT4X4 mHiZViewProj = MathHelper::Identity4x4();
+	UINT mHiZRenderWidth = 0;
+	UINT mHiZRenderHeight = 0;
+	bool mHiZValid = false;
+	UINT mDepthSrvIndex = 0;
+	UINT mHiZSrvIndex = 0;
+	UINT mHiZMipSrvIndices[gMaxHiZMips] = { 0 };
+	UINT mHiZMipUavIndices[gMaxHiZMips] = { 0 };
+	UINT mDepthPrepassGpuScope = 0;
+	UINT mHiZGpuScope = 0;
+
+	// Dynamic resolution; see UpdateRenderResolution.  With it on the scene
+	// renders into the top left mRenderWidth x mRenderHeight of mSceneColor, which
+	// is native size and rests in PIXEL_SHADER_RESOURCE, and RecordUpscale
+	// stretches that over the back buffer.  Without it the render size is the
+	// native size and the scene goes straight to the back buffer.
+	std::unique_ptr<DynamicResolution> mDynamicResolution;
+	ComPtr<ID3D12Resource> mSceneColor;
+	ComPtr<ID3D12RootSignature> mUpscaleRootSignature;
+	ID3D12PipelineState* mUpscalePSO = nullptr;
+	UINT mSceneColorSrvIndex = 0;
+	UINT mRenderWidth = 0;
+	UINT mRenderHeight = 0;
+	D3D12_VIEWPORT mSceneViewport = {};
+	D3D12_RECT mSceneScissorRect = {};
+	UINT mUpscaleGpuScope = 0;
+
 
     ComPtr<ID3D12RootSignature> mRootSignature = nullptr;
 
-	ComPtr<ID3D12DescriptorHeap> mSrvDescriptorHeap = nullptr;
+	// Every texture descriptor; Default.hlsl indexes it directly.
+	std::unique_ptr<DescriptorHeapAllocator> mSrvHeap;
+
+	// Placeholder descriptor drawn until a streamed texture is resident.
+	UINT mWhiteArraySrvIndex = 0;
+
+	// Looked up by name at load time only; per-frame code uses handles.
+	ResourceRegistry<MeshGeometry, GeometryHandle> mGeometries;
+	ResourceRegistry<Material, MaterialHandle> mMaterials;
+	ResourceRegistry<Texture, TextureHandle> mTextures;
 
-	std::unordered_map<std::string, std::unique_ptr<MeshGeometry>> mGeometries;
-	std::unordered_map<std::string, std::unique_ptr<Material>> mMaterials;
-	std::unordered_map<std::string, std::unique_ptr<Texture>> mTextures;
+	// Streams mStreamedTextures; declared after mTextures so it is torn down first.
+	std::unique_ptr<TextureStreamer> mTextureStreamer;
+
+	// Streamed textures by SRV heap index.
+	TextureHandle mStreamedTextures[gNumStreamedTextures];
+
+	// Heap descriptor sampled for each texture slot.  Streamed slots point at a
+	// placeholder until their texture is resident.  Only written on the main thread
+	// before recording starts.
+	UINT mSrvHeapRemap[gNumTextureSlots];
 	std::unordered_map<std::string, ComPtr<ID3DBlob>> mShaders;
-	std::unordered_map<std::string, ComPtr<ID3D12PipelineState>> mPSOs;
+	ResourceRegistry<ComPtr<ID3D12PipelineState>, PsoHandle> mPSOs;
+
+	// PSOs cached across runs; see BuildPSOs.
+	std::unique_ptr<PipelineLibrary> mPipelineLibrary;
 
     std::vector<D3D12_INPUT_ELEMENT_DESC> mInputLayout;
-	std::vector<D3D12_INPUT_ELEMENT_DESC> mTreeSpriteInputLayout;
 
     ComPtr<ID3D12PipelineState> mOpaquePSO = nullptr;
+
+	// PSO each render layer is drawn with; filled in by BuildPSOs so recording
+	// threads never touch mPSOs.
+	ID3D12PipelineState* mLayerPSOs[(int)RenderLayer::Count] = { nullptr };
+
+	// Parallel command list recording.  Each FrameResource owns one allocator and
+	// command list per recording thread.
+	bool mParallelRecording = false;
+	UINT mNumRecordThreads = 1;
+	std::unique_ptr<ThreadPool> mRecordThreadPool;
+
+	// CPU scopes around Update and Draw, GPU timestamps around the frame and each
+	// render layer.  F3 dumps the recorded history.
+	std::unique_ptr<Profiler> mProfiler;
+	UINT mGpuFrameScope = 0;
+	UINT mLayerGpuScopes[(int)RenderLayer::Count] = { 0 };
+	bool mProfileKeyDown = false;
+	float mCaptionTime = 0.0f;
+
+	// Scripted camera, fixed time step and report; see Benchmark.h.
+	BenchmarkSettings mBenchmark;
+	std::unique_ptr<BenchmarkRecorder> mBenchmarkRecorder;
+	ComPtr<IDXGIAdapter3> mAdapter;
+	std::wstring mAdapterName;
+	bool mBenchmarkDone = false;
+
+	// Radius of a sphere around the origin holding the whole scene.
+	float mSceneRadius = 0.0f;
+	float mFarZ = 1000.0f;
+
+	// Draw calls recorded for the current frame.
+	UINT mDrawCallCount = 0;
  
 	// List of all the render items.
 	std::vector<std::unique_ptr<RenderItem>> mAllRitems;
 	
 
+	// Chunks of the loaded scene file, and its write time when it was last read.
+	std::vector<SceneChunk> mSceneChunks;
+	std::uint64_t mSceneWriteTime = 0;
+	bool mSceneHotReload = false;
+	float mNextSceneCheckTime = 0.0f;
+
 	// Render items divided by PSO.
 	std::vector<RenderItem*> mOpaqueRitems;
 	//new sol
 	std::vector<RenderItem*> mRitemLayer[(int)RenderLayer::Count];
 
-    PassConstants mMainPassCB;
+	// Instance groups built from mRitemLayer for the layers drawn with Default.hlsl.
+	std::vector<InstanceGroup> mInstanceGroups[(int)RenderLayer::Count];
+
+	// Submission order of every layer's instance groups, rebuilt each frame by
+	// SortInstanceGroups, and the state changes the draws made and skipped.  One
+	// SubmitStats per command list, as the lists are recorded in parallel.
+	RenderQueue mRenderQueues[(int)RenderLayer::Count];
+	RenderQueue::SubmitStats mListSubmitStats[gMaxRecordThreads];
+	RenderQueue::SubmitStats mSubmitStats;
+
+	// mDrawWork[i] is the number of draws in [0, i) that are recorded this frame,
+	// which the worker lists split evenly.  Rebuilt every frame.
+	std::vector<UINT> mDrawWork;
+
+	// The pass constants, in the blocks of PassConstants.h.  The camera and
+	// lighting blocks live in mPassConstantBuffer, shared by the frame resources,
+	// and are only recomputed and uploaded, with the scene buffer copies, when their
+	// inputs change.  The time block goes through the ring every frame.
+	ComPtr<ID3D12Resource> mPassConstantBuffer;
+	CameraConstants mCameraCB = {};
+	LightingConstants mLightingCB = {};
+	TimeConstants mTimeCB = {};
+
+	// What the uploaded camera block was computed from.
+	struct CameraInputs
+	{
+		XMFLOAT4X4 View;
+		XMFLOAT4X4 Proj;
+		XMFLOAT3 EyePos;
+		UINT RenderWidth;
+		UINT RenderHeight;
+	};
+	CameraInputs mCameraInputs = {};
+	bool mLightingDirty = true;
+
+	// View space camera frustum, rebuilt from mProj on resize.
+	BoundingFrustum mCamFrustum;
+	bool mFrustumCullingEnabled = true;
 
+	// Tree over mScene.WorldBounds, refit from the dirty list every frame; culling
+	// and picking query it rather than visiting every object.  mVisibleObjects is
+	// the last frustum query.
+	BoundingVolumeHierarchy mSceneBvh;
+	std::vector<UINT> mVisibleObjects;
+
+	// Object under the cursor at the last right click, or -1.
+	int mPickedObject = -1;
+
+	// Culling statistics of the last frame.
+	UINT mVisibleRitemCount = 0;
+	UINT mCulledRitemCount = 0;
+
+	// Free-fly camera; mEyePos, mView and mProj are copied from it once a frame.
+	Camera mCamera;
 	XMFLOAT3 mEyePos = { 0.0f, 0.0f, 0.0f };
 	XMFLOAT4X4 mView = MathHelper::Identity4x4();
 	XMFLOAT4X4 mProj = MathHelper::Identity4x4();
 
-    float mTheta = 1.5f*XM_PI;
-    float mPhi = 0.2f*XM_PI;
-    float mRadius = 15.0f;
-
     POINT mLastMousePos;
 };
 
@@ -160,7 +640,25 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
 
     try
     {
-        LitColumnsApp theApp(hInstance);
+		CommandLine args(cmdLine);
+
+		BenchmarkSettings benchmark;
+		benchmark.Parse(args);
+
+		FramePacingSettings framePacing;
+		framePacing.Parse(args);
+
+		RenderSettings render;
+		render.Parse(args);
+
+		std::wstring error;
+		if(!args.Validate(error))
+		{
+			MessageBox(nullptr, error.c_str(), L"Invalid command line", MB_OK);
+			return 1;
+		}
+
+        LitColumnsApp theApp(hInstance, benchmark, framePacing, render);
         if(!theApp.Initialize())
             return 0;
 
@@ -173,15 +671,42 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
     }
 }
 
-LitColumnsApp::LitColumnsApp(HINSTANCE hInstance)
-    : D3DApp(hInstance)
+LitColumnsApp::LitColumnsApp(HINSTANCE hInstance, const BenchmarkSettings& benchmark, const FramePacingSettings& framePacing,
+	const RenderSettings& render)
+    : D3DApp(hInstance), mRenderSettings(render), mBenchmark(benchmark)
 {
+	mFramePacing = framePacing;
+
+	// Where the old orbit camera started, looking at the castle's center.
+	mCamera.LookAt(XMFLOAT3(0.0f, 12.14f, -8.82f), XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(0.0f, 1.0f, 0.0f));
 }
 
 LitColumnsApp::~LitColumnsApp()
 {
     if(md3dDevice != nullptr)
         FlushCommandQueue();
+
+	// Hand the pooled buffers back so the allocator does not outlive entries for
+	// resources that are already gone.  The queue is idle, so they go at once.
+	if(mGpuMemory != nullptr)
+	{
+		for(MeshGeometry& geo : mGeometries)
+		{
+			mGpuMemory->Free(geo.VertexBufferGPU, mCurrentFence);
+			mGpuMemory->Free(geo.IndexBufferGPU, mCurrentFence);
+		}
+
+		ComPtr<ID3D12Resource>* buffers[] =
+		{
+			&mInstanceBuffer, &mCullObjectBuffer, &mGpuInstanceIndices, &mGpuObjectLods,
+			&mDrawCommands, &mDrawCommandTemplates, &mTreeSpriteBuffer, &mVisibleTreeSprites,
+			&mTreeSpriteDrawArgs, &mTreeSpriteDrawTemplate, &mClusterLights, &mPassConstantBuffer
+		};
+		for(ComPtr<ID3D12Resource>* buffer : buffers)
+			mGpuMemory->Free(*buffer, mCurrentFence);
+
+		mGpuMemory->Retire(mCurrentFence);
+	}
 }
 
 bool LitColumnsApp::Initialize()
@@ -189,23 +714,88 @@ bool LitColumnsApp::Initialize()
     if(!D3DApp::Initialize())
         return false;
 
+	if(mBenchmark.Enabled)
+	{
+		// Every run sees the same sequence of simulated times.
+		mTimer.SetFixedTimeStep(mBenchmark.TimeStep);
+		mBenchmarkRecorder = std::make_unique<BenchmarkRecorder>(mBenchmark);
+	}
+
+	// For the adapter name and the GPU memory readout.
+	ThrowIfFailed(mdxgiFactory->EnumAdapterByLuid(md3dDevice->GetAdapterLuid(), IID_PPV_ARGS(&mAdapter)));
+	DXGI_ADAPTER_DESC adapterDesc;
+	ThrowIfFailed(mAdapter->GetDesc(&adapterDesc));
+	mAdapterName = adapterDesc.Description;
+
+	// The material textures are one unbounded SRV table (see BuildRootSignature),
+	// which resource binding tier 1 hardware cannot bind.
+	D3D12_FEATURE_DATA_D3D12_OPTIONS options = {};
+	ThrowIfFailed(md3dDevice->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &options, sizeof(options)));
+	if(options.ResourceBindingTier < D3D12_RESOURCE_BINDING_TIER_2)
+	{
+		MessageBox(0, (mAdapterName + L" only supports resource binding tier 1; "
+			L"LitColumns needs tier 2 for its bindless texture table.").c_str(), 0, 0);
+		return false;
+	}
+
+	mGpuMemory = std::make_unique<GpuMemoryAllocator>(md3dDevice.Get(), mAdapter.Get());
+
     // Reset the command list to prep for initialization commands.
     ThrowIfFailed(mCommandList->Reset(mDirectCmdListAlloc.Get(), nullptr));
 
-    // Get the increment size of a descriptor in this heap type.  This is hardware specific, 
-	// so we have to query this information.
-    mCbvSrvDescriptorSize = md3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	// Record with one command list per hardware thread, up to gMaxRecordThreads.
+	mNumRecordThreads = MathHelper::Clamp(std::thread::hardware_concurrency(), 1u, (UINT)gMaxRecordThreads);
+	mParallelRecording = mNumRecordThreads > 1;
+	if(mParallelRecording)
+		mRecordThreadPool = std::make_unique<ThreadPool>(mNumRecordThreads);
+
+	mProfiler = std::make_unique<Profiler>(md3dDevice.Get(), mCommandQueue.Get(), mFramePacing.FrameResourceCount);
+	mGpuFrameScope = mProfiler->RegisterGpuScope("Frame");
+	mLayerGpuScopes[(int)RenderLayer::Opaque] = mProfiler->RegisterGpuScope("Opaque");
+	mLayerGpuScopes[(int)RenderLayer::AlphaTested] = mProfiler->RegisterGpuScope("AlphaTested");
+	mLayerGpuScopes[(int)RenderLayer::AlphaTestedTreeSprites] = mProfiler->RegisterGpuScope("TreeSprites");
+	mLayerGpuScopes[(int)RenderLayer::Transparent] = mProfiler->RegisterGpuScope("Transparent");
+	if(mRenderSettings.GpuDriven)
+		mCullGpuScope = mProfiler->RegisterGpuScope("Cull");
+	mSpriteCullGpuScope = mProfiler->RegisterGpuScope("SpriteCull");
+	mLightCullGpuScope = mProfiler->RegisterGpuScope("LightCull");
+	if(mRenderSettings.DepthPrepass)
+		mDepthPrepassGpuScope = mProfiler->RegisterGpuScope("DepthPrepass");
+	if(mRenderSettings.OcclusionCulling)
+		mHiZGpuScope = mProfiler->RegisterGpuScope("HiZ");
+	if(mRenderSettings.DynamicResolution)
+	{
+		mUpscaleGpuScope = mProfiler->RegisterGpuScope("Upscale");
+
+		DynamicResolution::Settings dynamicResolution;
+		dynamicResolution.TargetMs = mRenderSettings.FrameTargetMs;
+		dynamicResolution.MinScale = mRenderSettings.MinResolutionScale;
+		mDynamicResolution = std::make_unique<DynamicResolution>(dynamicResolution);
+	}
 
 	LoadTextures();
+
+	// PSOs stored by an earlier run are loaded instead of compiled.  Created ahead
+	// of the root signatures, which it keys the PSOs by.
+	mPipelineLibrary = std::make_unique<PipelineLibrary>(md3dDevice.Get(), L"LitColumns.psolib");
 	BuildRootSignature();
 	BuildDescriptorHeaps();
+	BuildHiZ();
+	BuildSceneColor();
     
     BuildShadersAndInputLayout();
     BuildShapeGeometry();
 	BuildSkullGeometry();
-	BuildTreeSpritesGeometry();
 	BuildMaterials();
-    BuildRenderItems();
+	BuildTreeSprites();
+    if(!BuildRenderItems())
+		return false;
+	ScaleScene(mBenchmark.Enabled ? mBenchmark.SceneScale : 1);
+	mSceneHotReload = mRenderSettings.SceneHotReload && !mBenchmark.Enabled;
+	BuildLights();
+	BuildInstanceGroups();
+	if(mRenderSettings.GpuDriven)
+		BuildDrawCommands();
     BuildFrameResources();
     BuildPSOs();
 
@@ -217,16 +807,72 @@ bool LitColumnsApp::Initialize()
     // Wait until initialization is complete.
     FlushCommandQueue();
 
+	// The placeholder texture and every buffer's initial data have been copied.
+	mTextures.Get("whiteTex").UploadHeap = nullptr;
+	mGpuMemory->FinishFrame(mCurrentFence);
+	mGpuMemory->Retire(mCurrentFence);
+
+	GpuMemoryAllocator::Stats memoryStats = mGpuMemory->GetStats();
+	std::wostringstream report;
+	report << L"GpuMemoryAllocator: " << memoryStats.BufferCount << L" buffers, "
+		<< memoryStats.RequestedBytes / 1024 << L" KB in " << memoryStats.BlockBytes / 1024 << L" KB of blocks, "
+		<< memoryStats.HeapCount << L" heaps, " << memoryStats.CommittedCount << L" committed\n";
+	OutputDebugString(report.str().c_str());
+
     return true;
 }
  
+LRESULT LitColumnsApp::MsgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
+{
+	// A benchmark keeps running when another window takes the focus.
+	if(mBenchmark.Enabled && msg == WM_ACTIVATE)
+		return 0;
+
+	return D3DApp::MsgProc(hwnd, msg, wParam, lParam);
+}
+
+void LitColumnsApp::CreateRtvAndDsvDescriptorHeaps()
+{
+	// One more RTV than D3DApp makes, for the offscreen scene target.
+	D3D12_DESCRIPTOR_HEAP_DESC rtvHeapDesc;
+	rtvHeapDesc.NumDescriptors = SwapChainBufferCount + 1;
+	rtvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
+	rtvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+	rtvHeapDesc.NodeMask = 0;
+	ThrowIfFailed(md3dDevice->CreateDescriptorHeap(
+		&rtvHeapDesc, IID_PPV_ARGS(mRtvHeap.GetAddressOf())));
+
+	D3D12_DESCRIPTOR_HEAP_DESC dsvHeapDesc;
+	dsvHeapDesc.NumDescriptors = 1;
+	dsvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_DSV;
+	dsvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+	dsvHeapDesc.NodeMask = 0;
+	ThrowIfFailed(md3dDevice->CreateDescriptorHeap(
+		&dsvHeapDesc, IID_PPV_ARGS(mDsvHeap.GetAddressOf())));
+}
+
 void LitColumnsApp::OnResize()
 {
     D3DApp::OnResize();
 
     // The window resized, so update the aspect ratio and recompute the projection matrix.
-    XMMATRIX P = XMMatrixPerspectiveFovLH(0.25f*MathHelper::Pi, AspectRatio(), 1.0f, 1000.0f);
-    XMStoreFloat4x4(&mProj, P);
+	UpdateProjection();
+
+	// The first resize comes before the descriptor heap exists; Initialize builds
+	// the pyramid then.
+	if(mSrvHeap != nullptr)
+	{
+		BuildHiZ();
+		BuildSceneColor();
+	}
+}
+
+void LitColumnsApp::UpdateProjection()
+{
+	mCamera.SetLens(0.25f*MathHelper::Pi, AspectRatio(), 1.0f, mFarZ);
+	mProj = mCamera.GetProj4x4f();
+
+	BoundingFrustum::CreateFromMatrix(mCamFrustum, mCamera.GetProj());
 }
 
 void LitColumnsApp::Update(const GameTimer& gt)
@@ -234,28 +880,64 @@ void LitColumnsApp::Update(const GameTimer& gt)
     OnKeyboardInput(gt);
 	UpdateCamera(gt);
 
+	mProfiler->BeginFrame();
+	ScopedCpuTimer updateTimer(mProfiler.get(), "Update");
+	ScopedPhaseTimer updatePhase(mTelemetry, FramePhase::Update);
+
     // Cycle through the circular frame resource array.
-    mCurrFrameResourceIndex = (mCurrFrameResourceIndex + 1) % gNumFrameResources;
+    mCurrFrameResourceIndex = (mCurrFrameResourceIndex + 1) % mFramePacing.FrameResourceCount;
     mCurrFrameResource = mFrameResources[mCurrFrameResourceIndex].get();
 
     // Has the GPU finished processing the commands of the current frame resource?
     // If not, wait until the GPU has completed commands up to this fence point.
     if(mCurrFrameResource->Fence != 0 && mFence->GetCompletedValue() < mCurrFrameResource->Fence)
     {
-        HANDLE eventHandle = CreateEventEx(nullptr, false, false, EVENT_ALL_ACCESS);
-        ThrowIfFailed(mFence->SetEventOnCompletion(mCurrFrameResource->Fence, eventHandle));
-        WaitForSingleObject(eventHandle, INFINITE);
-        CloseHandle(eventHandle);
+		ScopedCpuTimer waitTimer(mProfiler.get(), "FenceWait");
+		ScopedPhaseTimer waitPhase(mTelemetry, FramePhase::FenceWait);
+		WaitForFence(mCurrFrameResource->Fence, mCurrFrameResource->FenceEvent);
     }
 
+	// Everything up to the frame we just waited for is done with its upload data,
+	// and its timestamps have been resolved.
+	mUploadRing->Retire(mFence->GetCompletedValue());
+	mGpuMemory->Retire(mFence->GetCompletedValue());
+	mProfiler->BeginGpuFrame(mCurrFrameResourceIndex);
+
+	UpdateTextureStreaming();
+	UpdateRenderResolution();
+	ReloadSceneChunks(gt);
+
 	//AnimateMaterials(gt);
-	UpdateObjectCBs(gt);
-	UpdateMaterialCBs(gt);
-	UpdateMainPassCB(gt);
+	{
+		ScopedCpuTimer timer(mProfiler.get(), "UpdateObjectCBs");
+		UpdateObjectCBs(gt);
+	}
+	{
+		ScopedCpuTimer timer(mProfiler.get(), "UpdateMaterialCBs");
+		UpdateMaterialCBs(gt);
+	}
+	{
+		ScopedCpuTimer timer(mProfiler.get(), "UpdateMainPassCB");
+		UpdateMainPassCB(gt);
+	}
+	{
+		ScopedCpuTimer timer(mProfiler.get(), "UpdateLights");
+		UpdateLights(gt);
+	}
+	{
+		ScopedCpuTimer timer(mProfiler.get(), "Cull");
+		CullRenderItems(gt);
+		UpdateInstanceIndices(gt);
+	}
+
+	UpdateCaption(gt);
 }
 
 void LitColumnsApp::Draw(const GameTimer& gt)
 {
+	mProfiler->BeginCpuScope("Draw");
+	const __int64 recordStart = GameTimer::Now();
+
     auto cmdListAlloc = mCurrFrameResource->CmdListAlloc;
 
     // Reuse the memory associated with command recording.
@@ -264,55 +946,117 @@ void LitColumnsApp::Draw(const GameTimer& gt)
 
     // A command list can be reset after it has been added to the command queue via ExecuteCommandList.
     // Reusing the command list reuses memory.
-    ThrowIfFailed(mCommandList->Reset(cmdListAlloc.Get(), mPSOs["opaque"].Get()));
+    ThrowIfFailed(mCommandList->Reset(cmdListAlloc.Get(), mLayerPSOs[(int)RenderLayer::Opaque]));
+
+	mProfiler->BeginGpuScope(mCommandList.Get(), mGpuFrameScope);
 
-    mCommandList->RSSetViewports(1, &mScreenViewport);
-    mCommandList->RSSetScissorRects(1, &mScissorRect);
+	// Upload the objects that changed before anything reads the scene buffers.
+	RecordSceneBufferCopies(mCommandList.Get());
 
-    // Indicate a state transition on the resource usage.
-	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
-		D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET));
+	if(mRenderSettings.GpuDriven)
+		RecordGpuCulling(mCommandList.Get());
+	RecordSpriteCulling(mCommandList.Get());
+	RecordLightCulling(mCommandList.Get());
+
+    // Indicate a state transition on the resource usage.  With dynamic
+	// resolution the back buffer is only written by RecordUpscale.
+	if(mSceneColor != nullptr)
+		mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mSceneColor.Get(),
+			D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_RENDER_TARGET));
+	else
+		mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
+			D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET));
 
     // Clear the back buffer and depth buffer.
-    mCommandList->ClearRenderTargetView(CurrentBackBufferView(), Colors::LightSteelBlue, 0, nullptr);
+    mCommandList->ClearRenderTargetView(SceneRenderTargetView(), Colors::LightSteelBlue, 1, &mSceneScissorRect);
     mCommandList->ClearDepthStencilView(DepthStencilView(), D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
 
-    // Specify the buffers we are going to render to.
-    mCommandList->OMSetRenderTargets(1, &CurrentBackBufferView(), true, &DepthStencilView());
+	UINT totalDrawCount = GetTotalDrawCount();
 
-	ID3D12DescriptorHeap* descriptorHeaps[] = { mSrvDescriptorHeap.Get() };
-	mCommandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+	for(auto& stats : mListSubmitStats)
+		stats = RenderQueue::SubmitStats();
 
-	mCommandList->SetGraphicsRootSignature(mRootSignature.Get());
+	// The pre-pass goes on the main list, ahead of every draw list, and the
+	// pyramid is only built for next frame's occlusion test.
+	if(mRenderSettings.DepthPrepass)
+		RecordDepthPrepass(mCommandList.Get(), mListSubmitStats[0]);
+	if(mRenderSettings.OcclusionCulling)
+		RecordHiZ(mCommandList.Get());
 
-	auto passCB = mCurrFrameResource->PassCB->Resource();
-	mCommandList->SetGraphicsRootConstantBufferView(2, passCB->GetGPUVirtualAddress());
+	if(!mParallelRecording)
+	{
+		RecordDrawRange(mCommandList.Get(), 0, totalDrawCount, mListSubmitStats[0]);
+		RecordUpscale(mCommandList.Get());
 
-    DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Opaque]);
+		mProfiler->EndGpuScope(mCommandList.Get(), mGpuFrameScope);
+		mProfiler->ResolveGpuScopes(mCommandList.Get());
 
-	mCommandList->SetPipelineState(mPSOs["alphaTested"].Get());
-	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::AlphaTested]);
+		// Indicate a state transition on the resource usage.
+		mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
+			D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
 
-	mCommandList->SetPipelineState(mPSOs["treeSprites"].Get());
-	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::AlphaTestedTreeSprites]);
+		// Done recording commands.
+		ThrowIfFailed(mCommandList->Close());
+		mTelemetry.AddPhaseTime(FramePhase::Record, GameTimer::Now() - recordStart);
 
-	mCommandList->SetPipelineState(mPSOs["transparent"].Get());
-	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Transparent]);
+		// Add the command list to the queue for execution.
+		ScopedPhaseTimer submitPhase(mTelemetry, FramePhase::Submit);
+		ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
+		mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+	}
+	else
+	{
+		// The main list only holds the clears; the draws go to the worker lists.
+		ThrowIfFailed(mCommandList->Close());
+
+		// Split the draws into contiguous ranges, one per worker list, with about
+		// the same number of recorded draws each; most LOD groups have no visible
+		// instances and cost next to nothing.  The last list also ends the frame's
+		// timestamps and transitions the back buffer for present.
+		BuildDrawWork(totalDrawCount);
+		const UINT workCount = mDrawWork.back();
+		UINT listCount = MathHelper::Clamp(workCount, 1u, mNumRecordThreads);
+		auto splitPoint = [this, workCount, listCount, totalDrawCount](UINT list)
+		{
+			if(list == listCount)
+				return totalDrawCount;
 
+			const UINT target = workCount * list / listCount;
+			return (UINT)(std::lower_bound(mDrawWork.begin(), mDrawWork.end(), target) - mDrawWork.begin());
+		};
 
-    // Indicate a state transition on the resource usage.
-	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
-		D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
+		for(UINT i = 0; i < listCount; ++i)
+		{
+			UINT begin = i == 0 ? 0 : splitPoint(i);
+			UINT end = splitPoint(i + 1);
+			bool lastList = (i + 1 == listCount);
 
-    // Done recording commands.
-    ThrowIfFailed(mCommandList->Close());
+			mRecordThreadPool->Enqueue([this, i, begin, end, lastList]()
+			{
+				RecordWorkerCommandList(i, begin, end, lastList);
+			});
+		}
 
-    // Add the command list to the queue for execution.
-    ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
-    mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+		mRecordThreadPool->Wait();
+		mTelemetry.AddPhaseTime(FramePhase::Record, GameTimer::Now() - recordStart);
+
+		// Submit in order with a single call.
+		ScopedPhaseTimer submitPhase(mTelemetry, FramePhase::Submit);
+		std::vector<ID3D12CommandList*> cmdsLists;
+		cmdsLists.reserve(listCount + 1);
+		cmdsLists.push_back(mCommandList.Get());
+		for(UINT i = 0; i < listCount; ++i)
+			cmdsLists.push_back(mCurrFrameResource->WorkerCmdLists[i].Get());
+
+		mCommandQueue->ExecuteCommandLists((UINT)cmdsLists.size(), cmdsLists.data());
+	}
+
+	mSubmitStats = RenderQueue::SubmitStats();
+	for(const auto& stats : mListSubmitStats)
+		mSubmitStats += stats;
 
     // Swap the back and front buffers
-    ThrowIfFailed(mSwapChain->Present(0, 0));
+    ThrowIfFailed(Present());
 	mCurrBackBuffer = (mCurrBackBuffer + 1) % SwapChainBufferCount;
 
     // Advance the fence value to mark commands up to this fence point.
@@ -321,7 +1065,30 @@ void LitColumnsApp::Draw(const GameTimer& gt)
     // Add an instruction to the command queue to set a new fence point. 
     // Because we are on the GPU timeline, the new fence point won't be 
     // set until the GPU finishes processing all the commands prior to this Signal().
-    mCommandQueue->Signal(mFence.Get(), mCurrentFence);
+	{
+		ScopedPhaseTimer submitPhase(mTelemetry, FramePhase::Submit);
+		mCommandQueue->Signal(mFence.Get(), mCurrentFence);
+	}
+
+	UINT64 uploadBytes = mUploadRing->CurrentFrameBytes();
+	mUploadRing->FinishFrame(mCurrentFence);
+	mGpuMemory->FinishFrame(mCurrentFence);
+
+	mProfiler->EndCpuScope();
+	mProfiler->EndFrame();
+	mTelemetry.EndFrame(mDrawCallCount, uploadBytes);
+
+	if(mBenchmarkRecorder != nullptr && !mBenchmarkDone)
+	{
+		mBenchmarkRecorder->EndFrame(mDrawCallCount, uploadBytes, mGpuMemory->QueryBudget().Local.CurrentUsage);
+		if(mBenchmarkRecorder->IsDone())
+		{
+			mBenchmarkDone = true;
+
+			bool written = mBenchmarkRecorder->WriteReport(mAdapterName, mScene.Size());
+			PostQuitMessage(written ? 0 : 1);
+		}
+	}
 }
 
 void LitColumnsApp::OnMouseDown(WPARAM btnState, int x, int y)
@@ -329,6 +1096,9 @@ void LitColumnsApp::OnMouseDown(WPARAM btnState, int x, int y)
     mLastMousePos.x = x;
     mLastMousePos.y = y;
 
+	if((btnState & MK_RBUTTON) != 0)
+		PickObject(x, y);
+
     SetCapture(mhMainWnd);
 }
 
@@ -345,25 +1115,9 @@ void LitColumnsApp::OnMouseMove(WPARAM btnState, int x, int y)
         float dx = XMConvertToRadians(0.25f*static_cast<float>(x - mLastMousePos.x));
         float dy = XMConvertToRadians(0.25f*static_cast<float>(y - mLastMousePos.y));
 
-        // Update angles based on input to orbit camera around box.
-        mTheta += dx;
-        mPhi += dy;
-
-        // Restrict the angle mPhi.
-        mPhi = MathHelper::Clamp(mPhi, 0.1f, MathHelper::Pi - 0.1f);
-    }
-    else if((btnState & MK_RBUTTON) != 0)
-    {
-		//TODO
-        // Make each pixel correspond to 0.2 unit in the scene.
-        float dx = 0.05f*static_cast<float>(x - mLastMousePos.x);
-        float dy = 0.05f*static_cast<float>(y - mLastMousePos.y);
-
-        // Update the camera radius based on input.
-        mRadius += dx - dy;
-
-        // Restrict the radius.
-        mRadius = MathHelper::Clamp(mRadius, 5.0f, 150.0f);
+        // Look around; the view matrix is rebuilt in UpdateCamera.
+        mCamera.Pitch(dy);
+        mCamera.RotateY(dx);
     }
 
     mLastMousePos.x = x;
@@ -372,28 +1126,73 @@ void LitColumnsApp::OnMouseMove(WPARAM btnState, int x, int y)
  
 void LitColumnsApp::OnKeyboardInput(const GameTimer& gt)
 {
+	bool profileKeyDown = d3dUtil::IsKeyDown(VK_F3);
+	if(profileKeyDown && !mProfileKeyDown)
+		DumpProfile();
+	mProfileKeyDown = profileKeyDown;
+
+	if(mBenchmark.Enabled)
+		return;
+
+	// WASD flies the camera along its look and right vectors.
+	float speed = gCameraSpeed*MathHelper::Max(1.0f, mSceneRadius / gCameraSpeedRadius);
+	if(d3dUtil::IsKeyDown(VK_SHIFT))
+		speed *= gCameraBoost;
+
+	const float d = speed*gt.DeltaTime();
+	if(d3dUtil::IsKeyDown('W'))
+		mCamera.Walk(d);
+	if(d3dUtil::IsKeyDown('S'))
+		mCamera.Walk(-d);
+	if(d3dUtil::IsKeyDown('A'))
+		mCamera.Strafe(-d);
+	if(d3dUtil::IsKeyDown('D'))
+		mCamera.Strafe(d);
 }
  
 void LitColumnsApp::UpdateCamera(const GameTimer& gt)
 {
-	// Convert Spherical to Cartesian coordinates.
-	mEyePos.x = mRadius*sinf(mPhi)*cosf(mTheta);
-	mEyePos.z = mRadius*sinf(mPhi)*sinf(mTheta);
-	mEyePos.y = mRadius*cosf(mPhi);
+	if(mBenchmark.Enabled)
+	{
+		XMFLOAT3 eye, target;
+		EvaluateCameraPath(mBenchmark.Path, gt.TotalTime(), mSceneRadius, eye, target);
+		mCamera.LookAt(eye, target, XMFLOAT3(0.0f, 1.0f, 0.0f));
+	}
+
+	mCamera.UpdateViewMatrix();
+	mView = mCamera.GetView4x4f();
+	mEyePos = mCamera.GetPosition3f();
+}
+
+void LitColumnsApp::PickObject(int x, int y)
+{
+	// The cursor's ray in view space, through the near plane point under it, then
+	// in world space, where the tree is.
+	const float vx = (2.0f*x / mClientWidth - 1.0f) / mProj(0, 0);
+	const float vy = (-2.0f*y / mClientHeight + 1.0f) / mProj(1, 1);
+
+	XMMATRIX view = mCamera.GetView();
+	XMMATRIX invView = XMMatrixInverse(&XMMatrixDeterminant(view), view);
+
+	XMVECTOR origin = mCamera.GetPosition();
+	XMVECTOR direction = XMVector3Normalize(XMVector3TransformNormal(XMVectorSet(vx, vy, 1.0f, 0.0f), invView));
 
-	// Build the view matrix.
-	XMVECTOR pos = XMVectorSet(mEyePos.x, mEyePos.y, mEyePos.z, 1.0f);
-	XMVECTOR target = XMVectorZero();
-	XMVECTOR up = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+	// Bounding boxes are what is tested, which is as precise as the culling.
+	mPickedObject = -1;
 
-	XMMATRIX view = XMMatrixLookAtLH(pos, target, up);
-	XMStoreFloat4x4(&mView, view);
+	UINT object;
+	float distance;
+	if(mSceneBvh.ObjectCount() == mScene.Size() &&
+		mSceneBvh.RayCast(origin, direction, mScene.WorldBounds, object, distance))
+	{
+		mPickedObject = (int)object;
+	}
 }
 
 void LitColumnsApp::AnimateMaterials(const GameTimer& gt)
 {
 	// Scroll the water material texture coordinates.
-	auto waterMat = mMaterials["water"].get();
+	auto waterMat = &mMaterials.Get("water");
 
 	float& tu = waterMat->MatTransform(3, 0);
 	float& tv = waterMat->MatTransform(3, 1);
@@ -411,599 +1210,1364 @@ void LitColumnsApp::AnimateMaterials(const GameTimer& gt)
 	waterMat->MatTransform(3, 1) = tv;
 
 	// Material has changed, so need to update cbuffer.
-	waterMat->NumFramesDirty = gNumFrameResources;
+	waterMat->NumFramesDirty = 1;
 }
 
 void LitColumnsApp::UpdateObjectCBs(const GameTimer& gt)
 {
-	auto currObjectCB = mCurrFrameResource->ObjectCB.get();
-	for(auto& e : mAllRitems)
-	{
-		// Only update the cbuffer data if the constants have changed.  
-		// This needs to be tracked per frame resource.
-		if(e->NumFramesDirty > 0)
-		{
-			XMMATRIX world = XMLoadFloat4x4(&e->World);
-			XMMATRIX texTransform = XMLoadFloat4x4(&e->TexTransform);
+	EnsureSceneBuffers();
+
+	mSceneBufferCopies.clear();
 
-			ObjectConstants objConstants;
-			XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(world));
-			XMStoreFloat4x4(&objConstants.TexTransform, XMMatrixTranspose(texTransform));
+	// Only objects whose transforms changed are visited; a static scene does no
+	// work here at all.
+	const std::vector<UINT>& dirty = mScene.GetDirtyList();
+	if(dirty.empty())
+		return;
 
-			currObjectCB->CopyData(e->ObjCBIndex, objConstants);
+	mScene.UpdateDirtyBounds();
 
-			// Next FrameResource need to be updated too.
-			e->NumFramesDirty--;
-		}
-	}
-}
+	// New objects, or moves that loosened the tree too much, need a rebuild;
+	// otherwise only the moved objects' branches are refit.
+	if(mSceneBvh.ObjectCount() != mScene.Size() || mSceneBvh.NeedsRebuild())
+		mSceneBvh.Build(mScene.WorldBounds);
+	else
+		mSceneBvh.Refit(dirty, mScene.WorldBounds);
 
-void LitColumnsApp::UpdateMaterialCBs(const GameTimer& gt)
-{
-	auto currMaterialCB = mCurrFrameResource->MaterialCB.get();
-	for(auto& e : mMaterials)
+	// The dirty list is sorted, so consecutive objects form runs that are staged
+	// in one allocation and uploaded with one copy per buffer.
+	size_t runStart = 0;
+	while(runStart < dirty.size())
 	{
-		// Only update the cbuffer data if the constants have changed.  If the cbuffer
-		// data changes, it needs to be updated for each FrameResource.
-		Material* mat = e.second.get();
-		if(mat->NumFramesDirty > 0)
+		size_t runEnd = runStart + 1;
+		while(runEnd < dirty.size() && dirty[runEnd] == dirty[runEnd - 1] + 1)
+			++runEnd;
+
+		const UINT first = dirty[runStart];
+		const UINT count = (UINT)(runEnd - runStart);
+
+		auto instAlloc = mUploadRing->Allocate((UINT64)count*sizeof(InstanceData), 16);
+
+		// Transpose straight into the upload ring.  Upload heaps are write-combined,
+		// so the stores are sequential and nothing is read back.
+		auto instData = reinterpret_cast<InstanceData*>(instAlloc.CPU);
+		for(UINT i = 0; i < count; ++i)
 		{
-			XMMATRIX matTransform = XMLoadFloat4x4(&mat->MatTransform);
+			XMMATRIX world = XMMatrixTranspose(XMLoadFloat4x4(&mScene.World[first + i]));
+			XMMATRIX texTransform = XMMatrixTranspose(XMLoadFloat4x4(&mScene.TexTransform[first + i]));
+
+			XMStoreFloat4x4(&instData[i].World, world);
+			XMStoreFloat4x4(&instData[i].TexTransform, texTransform);
+
+			// Mesh positions are quantized within the mesh bounds.
+			const BoundingBox& bounds = mScene.LocalBounds[first + i];
+			instData[i].PosScale = XMFLOAT3(2.0f*bounds.Extents.x, 2.0f*bounds.Extents.y, 2.0f*bounds.Extents.z);
+			instData[i].PosBias = XMFLOAT3(bounds.Center.x - bounds.Extents.x,
+				bounds.Center.y - bounds.Extents.y, bounds.Center.z - bounds.Extents.z);
+			instData[i].MaterialIndex = mScene.Material[first + i];
+			instData[i].InstPad1 = 0.0f;
+		}
 
-			MaterialConstants matConstants;
-			matConstants.DiffuseAlbedo = mat->DiffuseAlbedo;
-			matConstants.FresnelR0 = mat->FresnelR0;
-			matConstants.Roughness = mat->Roughness;
-			XMStoreFloat4x4(&matConstants.MatTransform, XMMatrixTranspose(matTransform));
+		SceneBufferCopy instCopy;
+		instCopy.Dest = mInstanceBuffer.Get();
+		instCopy.DestOffset = (UINT64)first*sizeof(InstanceData);
+		instCopy.SrcOffset = instAlloc.Offset;
+		instCopy.ByteSize = (UINT64)count*sizeof(InstanceData);
+		mSceneBufferCopies.push_back(instCopy);
+
+		if(mCullObjectBuffer != nullptr)
+		{
+			auto cullAlloc = mUploadRing->Allocate((UINT64)count*sizeof(CullObject), 16);
 
-			currMaterialCB->CopyData(mat->MatCBIndex, matConstants);
+			auto cullObjects = reinterpret_cast<CullObject*>(cullAlloc.CPU);
+			for(UINT i = 0; i < count; ++i)
+			{
+				const BoundingBox& bounds = mScene.WorldBounds[first + i];
+				cullObjects[i].Center = bounds.Center;
+				cullObjects[i].DrawCommand = first + i < mObjectDrawCommand.size() ?
+					mObjectDrawCommand[first + i] : CullObject::NoDrawCommand;
+				cullObjects[i].Extents = bounds.Extents;
+				cullObjects[i].LodCount = mScene.LodCount[first + i];
+			}
 
-			// Next FrameResource need to be updated too.
-			mat->NumFramesDirty--;
+			SceneBufferCopy cullCopy;
+			cullCopy.Dest = mCullObjectBuffer.Get();
+			cullCopy.DestOffset = (UINT64)first*sizeof(CullObject);
+			cullCopy.SrcOffset = cullAlloc.Offset;
+			cullCopy.ByteSize = (UINT64)count*sizeof(CullObject);
+			mSceneBufferCopies.push_back(cullCopy);
 		}
+
+		runStart = runEnd;
 	}
+
+	mScene.ClearDirty();
 }
 
-void LitColumnsApp::UpdateMainPassCB(const GameTimer& gt)
+void LitColumnsApp::EnsureSceneBuffers()
 {
-	XMMATRIX view = XMLoadFloat4x4(&mView);
-	XMMATRIX proj = XMLoadFloat4x4(&mProj);
+	if(mScene.Size() <= mSceneBufferCapacity)
+		return;
 
-	XMMATRIX viewProj = XMMatrixMultiply(view, proj);
-	XMMATRIX invView = XMMatrixInverse(&XMMatrixDeterminant(view), view);
-	XMMATRIX invProj = XMMatrixInverse(&XMMatrixDeterminant(proj), proj);
-	XMMATRIX invViewProj = XMMatrixInverse(&XMMatrixDeterminant(viewProj), viewProj);
-
-	XMStoreFloat4x4(&mMainPassCB.View, XMMatrixTranspose(view));
-	XMStoreFloat4x4(&mMainPassCB.InvView, XMMatrixTranspose(invView));
-	XMStoreFloat4x4(&mMainPassCB.Proj, XMMatrixTranspose(proj));
-	XMStoreFloat4x4(&mMainPassCB.InvProj, XMMatrixTranspose(invProj));
-	XMStoreFloat4x4(&mMainPassCB.ViewProj, XMMatrixTranspose(viewProj));
-	XMStoreFloat4x4(&mMainPassCB.InvViewProj, XMMatrixTranspose(invViewProj));
-	mMainPassCB.EyePosW = mEyePos;
-	mMainPassCB.RenderTargetSize = XMFLOAT2((float)mClientWidth, (float)mClientHeight);
-	mMainPassCB.InvRenderTargetSize = XMFLOAT2(1.0f / mClientWidth, 1.0f / mClientHeight);
-	mMainPassCB.NearZ = 1.0f;
-	mMainPassCB.FarZ = 1000.0f;
-	mMainPassCB.TotalTime = gt.TotalTime();
-	mMainPassCB.DeltaTime = gt.DeltaTime();
-	mMainPassCB.AmbientLight = { 0.45f, 0.45f, 0.05f, 1.0f };
-	mMainPassCB.Lights[0].Direction = { 0.57735f, -0.57735f, 0.57735f };
-	mMainPassCB.Lights[0].Strength = { 0.6f, 0.6f, 0.6f };
-	mMainPassCB.Lights[1].Direction = { -0.57735f, -0.57735f, 0.57735f };
-	mMainPassCB.Lights[1].Strength = { 0.3f, 0.3f, 0.3f };
-	mMainPassCB.Lights[2].Direction = { 0.0f, -0.707f, -0.707f };
-	mMainPassCB.Lights[2].Strength = { 0.15f, 0.15f, 0.15f };
-
-	auto currPassCB = mCurrFrameResource->PassCB.get();
-	currPassCB->CopyData(0, mMainPassCB);
-}
+	// Only happens when objects are added.  The frames in flight may still read
+	// the old buffers, so they are released once the last of them is done.
+	mGpuMemory->Free(mInstanceBuffer, mCurrentFence);
+	mGpuMemory->Free(mCullObjectBuffer, mCurrentFence);
+	mGpuMemory->Free(mGpuInstanceIndices, mCurrentFence);
+	mGpuMemory->Free(mGpuObjectLods, mCurrentFence);
 
-void LitColumnsApp::LoadTextures()
-{
-	auto woodCrateTex = std::make_unique<Texture>();
-	woodCrateTex->Name = "woodCrateTex";
-	woodCrateTex->Filename = L"Textures/bricks2.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), woodCrateTex->Filename.c_str(),
-		woodCrateTex->Resource, woodCrateTex->UploadHeap));
+	mSceneBufferCapacity = MathHelper::Max(mScene.Size(), 2*mSceneBufferCapacity);
 
+	mInstanceBuffer = mGpuMemory->CreateBuffer((UINT64)mSceneBufferCapacity*sizeof(InstanceData),
+		D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_COMMON);
 
-	auto stoneTex = std::make_unique<Texture>();
-	stoneTex->Name = "stoneTex";
-	stoneTex->Filename = L"Textures/stone.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), stoneTex->Filename.c_str(),
-		stoneTex->Resource, stoneTex->UploadHeap));
+	if(mRenderSettings.GpuDriven)
+	{
+		mCullObjectBuffer = mGpuMemory->CreateBuffer((UINT64)mSceneBufferCapacity*sizeof(CullObject),
+			D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_COMMON);
+
+		mGpuInstanceIndices = mGpuMemory->CreateBuffer(
+			(UINT64)MathHelper::Max(mSceneBufferCapacity, mGpuInstanceSlotCount)*sizeof(UINT),
+			D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COMMON);
+
+		// Committed resources start out zeroed, unlike placed ones, so every object
+		// starts at full detail.
+		ThrowIfFailed(md3dDevice->CreateCommittedResource(
+			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+			D3D12_HEAP_FLAG_NONE,
+			&CD3DX12_RESOURCE_DESC::Buffer((UINT64)mSceneBufferCapacity*sizeof(UINT), D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS),
+			D3D12_RESOURCE_STATE_COMMON,
+			nullptr,
+			IID_PPV_ARGS(&mGpuObjectLods)));
+	}
 
-	auto waterTex = std::make_unique<Texture>();
-	waterTex->Name = "waterTex";
-	waterTex->Filename = L"Textures/water1.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), waterTex->Filename.c_str(),
-		waterTex->Resource, waterTex->UploadHeap));
+	// The new buffers start out empty.
+	mScene.MarkAllDirty();
+}
 
-	auto grassTex = std::make_unique<Texture>();
-	grassTex->Name = "grassTex";
-	grassTex->Filename = L"Textures/grass.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), grassTex->Filename.c_str(),
-		grassTex->Resource, grassTex->UploadHeap));
+void LitColumnsApp::RecordSceneBufferCopies(ID3D12GraphicsCommandList* cmdList)
+{
+	if(mSceneBufferCopies.empty())
+		return;
 
-	auto treeArrayTex = std::make_unique<Texture>();
-	treeArrayTex->Name = "treeArrayTex";
-	treeArrayTex->Filename = L"Textures/treeArray2.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), treeArrayTex->Filename.c_str(),
-		treeArrayTex->Resource, treeArrayTex->UploadHeap));
+	// Buffers decay to COMMON at the end of every ExecuteCommandLists and the
+	// first copy promotes them to COPY_DEST implicitly, so only the transition
+	// back to a shader readable state has to be spelled out, for the buffers
+	// that were actually written.
+	for(auto& c : mSceneBufferCopies)
+		cmdList->CopyBufferRegion(c.Dest, c.DestOffset, mUploadRing->Resource(), c.SrcOffset, c.ByteSize);
 
-	mTextures[woodCrateTex->Name] = std::move(woodCrateTex);
-	mTextures[stoneTex->Name] = std::move(stoneTex);
-	mTextures[waterTex->Name] = std::move(waterTex);
-	mTextures[grassTex->Name] = std::move(grassTex);
-	mTextures[treeArrayTex->Name] = std::move(treeArrayTex);
+	const struct { ID3D12Resource* Buffer; D3D12_RESOURCE_STATES ReadState; } dests[] =
+	{
+		{ mInstanceBuffer.Get(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE },
+		{ mCullObjectBuffer.Get(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE },
+		{ mPassConstantBuffer.Get(), D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER }
+	};
 
+	D3D12_RESOURCE_BARRIER barriers[_countof(dests)];
+	UINT barrierCount = 0;
+	for(const auto& d : dests)
+	{
+		bool written = std::any_of(mSceneBufferCopies.begin(), mSceneBufferCopies.end(),
+			[&](const SceneBufferCopy& c) { return c.Dest == d.Buffer && d.Buffer != nullptr; });
+		if(written)
+		{
+			barriers[barrierCount++] = CD3DX12_RESOURCE_BARRIER::Transition(d.Buffer,
+				D3D12_RESOURCE_STATE_COPY_DEST, d.ReadState);
+		}
+	}
+	cmdList->ResourceBarrier(barrierCount, barriers);
 }
 
-void LitColumnsApp::BuildRootSignature()
+void LitColumnsApp::UpdateMaterialCBs(const GameTimer& gt)
 {
-	CD3DX12_DESCRIPTOR_RANGE texTable;
-	texTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
+	if(mMaterialData.size() < mMaterials.Size())
+		mMaterialData.resize(mMaterials.Size());
 
-	// Root parameter can be a table, root descriptor or root constants.
-	CD3DX12_ROOT_PARAMETER slotRootParameter[4];
+	for(auto& mat : mMaterials)
+	{
+		// Only update the table entry if the material has changed.
+		if(mat.NumFramesDirty > 0)
+		{
+			XMMATRIX matTransform = XMLoadFloat4x4(&mat.MatTransform);
 
-	// Create root CBV.
-	slotRootParameter[0].InitAsDescriptorTable(1, &texTable, D3D12_SHADER_VISIBILITY_PIXEL);
-	slotRootParameter[1].InitAsConstantBufferView(0);
-	slotRootParameter[2].InitAsConstantBufferView(1);
-	slotRootParameter[3].InitAsConstantBufferView(2);
+			MaterialData& matData = mMaterialData[mat.MatCBIndex];
+			matData.DiffuseAlbedo = mat.DiffuseAlbedo;
+			matData.FresnelR0 = mat.FresnelR0;
+			matData.Roughness = mat.Roughness;
+			XMStoreFloat4x4(&matData.MatTransform, XMMatrixTranspose(matTransform));
+			matData.DiffuseMapIndex = mSrvHeapRemap[mat.DiffuseSrvHeapIndex];
+			matData.DiffuseSlice = (UINT)mat.DiffuseSlice;
 
-	auto staticSamplers = GetStaticSamplers();
+			mat.NumFramesDirty = 0;
+		}
+	}
 
-	// A root signature is an array of root parameters.
-	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(4, slotRootParameter,
-		(UINT)staticSamplers.size(), staticSamplers.data(),
-		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
+	mCurrFrameResource->MaterialBuffer = mUploadRing->AllocateStructuredBuffer(
+		mMaterialData.data(), (UINT)mMaterialData.size());
+}
 
-	// create a root signature with a single slot which points to a descriptor range consisting of a single constant buffer
-	ComPtr<ID3DBlob> serializedRootSig = nullptr;
-	ComPtr<ID3DBlob> errorBlob = nullptr;
-	HRESULT hr = D3D12SerializeRootSignature(&rootSigDesc, D3D_ROOT_SIGNATURE_VERSION_1,
-		serializedRootSig.GetAddressOf(), errorBlob.GetAddressOf());
+void LitColumnsApp::UpdateMainPassCB(const GameTimer& gt)
+{
+	// The clock is the only block that changes every frame.
+	mTimeCB.TotalTime = gt.TotalTime();
+	mTimeCB.DeltaTime = gt.DeltaTime();
+	mCurrFrameResource->TimeCB = mUploadRing->AllocateConstantBuffers(&mTimeCB, 1);
+
+	// The other blocks are staged in the ring and copied into mPassConstantBuffer
+	// by RecordSceneBufferCopies.
+	auto stagePassConstants = [this](const void* data, UINT byteSize, UINT destOffset)
+	{
+		auto alloc = mUploadRing->Allocate(byteSize, 16);
+		memcpy(alloc.CPU, data, byteSize);
+
+		SceneBufferCopy copy;
+		copy.Dest = mPassConstantBuffer.Get();
+		copy.DestOffset = destOffset;
+		copy.SrcOffset = alloc.Offset;
+		copy.ByteSize = byteSize;
+		mSceneBufferCopies.push_back(copy);
+	};
 
-	if(errorBlob != nullptr)
+	CameraInputs inputs;
+	inputs.View = mView;
+	inputs.Proj = mProj;
+	inputs.EyePos = mEyePos;
+	inputs.RenderWidth = mRenderWidth;
+	inputs.RenderHeight = mRenderHeight;
+	if(memcmp(&inputs, &mCameraInputs, sizeof(inputs)) != 0)
 	{
-		::OutputDebugStringA((char*)errorBlob->GetBufferPointer());
+		mCameraInputs = inputs;
+
+		XMMATRIX view = XMLoadFloat4x4(&mView);
+		XMMATRIX proj = XMLoadFloat4x4(&mProj);
+
+		XMMATRIX viewProj = XMMatrixMultiply(view, proj);
+		XMMATRIX invView = XMMatrixInverse(&XMMatrixDeterminant(view), view);
+		XMMATRIX invProj = XMMatrixInverse(&XMMatrixDeterminant(proj), proj);
+		XMMATRIX invViewProj = XMMatrixInverse(&XMMatrixDeterminant(viewProj), viewProj);
+
+		XMStoreFloat4x4(&mCameraCB.View, XMMatrixTranspose(view));
+		XMStoreFloat4x4(&mCameraCB.InvView, XMMatrixTranspose(invView));
+		XMStoreFloat4x4(&mCameraCB.Proj, XMMatrixTranspose(proj));
+		XMStoreFloat4x4(&mCameraCB.InvProj, XMMatrixTranspose(invProj));
+		XMStoreFloat4x4(&mCameraCB.ViewProj, XMMatrixTranspose(viewProj));
+		XMStoreFloat4x4(&mCameraCB.InvViewProj, XMMatrixTranspose(invViewProj));
+		mCameraCB.EyePosW = mEyePos;
+		mCameraCB.RenderTargetSize = XMFLOAT2((float)mRenderWidth, (float)mRenderHeight);
+		mCameraCB.InvRenderTargetSize = XMFLOAT2(1.0f / mRenderWidth, 1.0f / mRenderHeight);
+		mCameraCB.NearZ = 1.0f;
+		mCameraCB.FarZ = mFarZ;
+
+		// Pixel to cluster: whole tiles cover the screen, and depth slice k starts at
+		// NearZ*(FarZ/NearZ)^(k/gClusterCountZ), as in LightCull.hlsl.
+		const float logDepthRange = logf(mCameraCB.FarZ / mCameraCB.NearZ);
+		mCameraCB.ClusterTileScale = XMFLOAT2(
+			1.0f / ceilf((float)mRenderWidth / gClusterCountX),
+			1.0f / ceilf((float)mRenderHeight / gClusterCountY));
+		mCameraCB.ClusterDepthScale = gClusterCountZ / logDepthRange;
+		mCameraCB.ClusterDepthBias = -gClusterCountZ*logf(mCameraCB.NearZ) / logDepthRange;
+
+		stagePassConstants(&mCameraCB, sizeof(mCameraCB), 0);
 	}
-	ThrowIfFailed(hr);
 
-	ThrowIfFailed(md3dDevice->CreateRootSignature(
-		0,
-		serializedRootSig->GetBufferPointer(),
-		serializedRootSig->GetBufferSize(),
-		IID_PPV_ARGS(mRootSignature.GetAddressOf())));
+	if(mLightingDirty)
+	{
+		mLightingDirty = false;
+		stagePassConstants(&mLightingCB, sizeof(mLightingCB), gLightingCBOffset);
+	}
 }
 
-void LitColumnsApp::BuildShadersAndInputLayout()
+void LitColumnsApp::UpdateLights(const GameTimer& gt)
 {
-	
-	const D3D_SHADER_MACRO defines[] =
-	{
-		"FOG", "1",
-		NULL, NULL
-	};
-	const D3D_SHADER_MACRO alphaTestDefines[] =
+	// Torches flicker around their base strength, each at its own phase.
+	const float t = gt.TotalTime();
+	for(size_t i = 0; i < mBaseLights.size(); ++i)
 	{
-		"FOG", "1",
-		"ALPHA_TEST", "1",
-		NULL, NULL
-	};
+		const float phase = mLightPhases[i];
+		const float flicker = 0.85f + 0.1f*sinf(7.0f*t + phase) + 0.05f*sinf(23.0f*t + 2.0f*phase);
 
-	//TODO
-	mShaders["standardVS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl", nullptr, "VS", "vs_5_1");
-	mShaders["opaquePS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl", defines, "PS", "ps_5_1");
-	mShaders["alphaTestedPS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl", alphaTestDefines, "PS", "ps_5_1");
+		XMStoreFloat3(&mLights[i].Strength, flicker*XMLoadFloat3(&mBaseLights[i].Strength));
+	}
 
-	mShaders["treeSpriteVS"] = d3dUtil::CompileShader(L"Shaders\\TreeSprite.hlsl", nullptr, "VS", "vs_5_1");
-	mShaders["treeSpriteGS"] = d3dUtil::CompileShader(L"Shaders\\TreeSprite.hlsl", nullptr, "GS", "gs_5_1");
-	mShaders["treeSpritePS"] = d3dUtil::CompileShader(L"Shaders\\TreeSprite.hlsl", alphaTestDefines, "PS", "ps_5_1");
+	mCurrFrameResource->LightBuffer = mUploadRing->AllocateStructuredBuffer(mLights.data(), (UINT)mLights.size());
 
-    mInputLayout =
-    {
-        { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-        { "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-    };
+	LightCullConstants lightCullConstants;
+	lightCullConstants.View = mCameraCB.View;
+	lightCullConstants.InvProj = mCameraCB.InvProj;
+	lightCullConstants.TileSize = XMFLOAT2(1.0f / mCameraCB.ClusterTileScale.x, 1.0f / mCameraCB.ClusterTileScale.y);
+	lightCullConstants.InvRenderTargetSize = mCameraCB.InvRenderTargetSize;
+	lightCullConstants.NearZ = mCameraCB.NearZ;
+	lightCullConstants.FarZ = mCameraCB.FarZ;
+	lightCullConstants.LightCount = (UINT)mLights.size();
 
-	mTreeSpriteInputLayout =
-	{
-		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-		{ "SIZE", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-	};
+	mCurrFrameResource->LightCullCB = mUploadRing->AllocateConstantBuffers(&lightCullConstants, 1);
 }
 
-void LitColumnsApp::BuildShapeGeometry()
+void LitColumnsApp::CullRenderItems(const GameTimer& gt)
 {
-    GeometryGenerator geoGen;
-	GeometryGenerator::MeshData box = geoGen.CreateBox(1.0f, 1.0f, 1.0f, 3);
-	GeometryGenerator::MeshData cylinder = geoGen.CreateCylinder(0.5f, 0.45f, 5.0f, 20, 20);
-	GeometryGenerator::MeshData diamond = geoGen.CreateDiamond(1.0f, 1.0f, 1.0f, 3);
-	GeometryGenerator::MeshData cone = geoGen.CreateCone(1.0f, 1.0f, 20, 20);
-	GeometryGenerator::MeshData wedge = geoGen.CreateWedge(1.0f, 1.0f, 1.0f, 3);
-	GeometryGenerator::MeshData pyramid = geoGen.CreatePyramid(1.0f, 1.0f, 1.0f, 3);
-	GeometryGenerator::MeshData torus = geoGen.CreateTorus(10.0f, 1.0f,40, 40);
-	GeometryGenerator::MeshData grid = geoGen.CreateGrid(30.0f, 30.0f, 60, 40);
-	GeometryGenerator::MeshData sphere = geoGen.CreateSphere(0.5f, 20, 20);
-	//GeometryGenerator::MeshData cylinder = geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, 20, 20);
-
-	//
-	// We are concatenating all the geometry into one big vertex/index buffer.  So
-	// define the regions in the buffer each submesh covers.
-	//
-
-	// Cache the vertex offsets to each object in the concatenated vertex buffer.
-	UINT boxVertexOffset = 0;
-	UINT cylinderVertexOffset = (UINT)box.Vertices.size();
-	UINT diamondVertexOffset = cylinderVertexOffset + (UINT)cylinder.Vertices.size();
-	UINT coneVertexOffset = diamondVertexOffset + (UINT)diamond.Vertices.size();
-	UINT wedgeVertexOffset = coneVertexOffset + (UINT)cone.Vertices.size();
-	UINT pyramidVertexOffset = wedgeVertexOffset + (UINT)wedge.Vertices.size();
-	UINT torusVertexOffset = pyramidVertexOffset + (UINT)pyramid.Vertices.size();
-	UINT gridVertexOffset = torusVertexOffset + (UINT)torus.Vertices.size();
-	UINT sphereVertexOffset = gridVertexOffset + (UINT)grid.Vertices.size();
-	//UINT cylinderVertexOffset = sphereVertexOffset + (UINT)sphere.Vertices.size();
-
-	// Cache the starting index for each object in the concatenated index buffer.
-	UINT boxIndexOffset = 0;
-	UINT cylinderIndexOffset = (UINT)box.Indices32.size();
-	UINT diamondIndexOffset = cylinderIndexOffset + (UINT)cylinder.Indices32.size();
-	UINT coneIndexOffset = diamondIndexOffset + (UINT)diamond.Indices32.size();
-	UINT wedgeIndexOffset = coneIndexOffset + (UINT)cone.Indices32.size();
-	UINT pyramidIndexOffset = wedgeIndexOffset + (UINT)wedge.Indices32.size();
-	UINT torusIndexOffset = pyramidIndexOffset + (UINT)pyramid.Indices32.size();
-	UINT gridIndexOffset = torusIndexOffset + (UINT)torus.Indices32.size();
-	UINT sphereIndexOffset = gridIndexOffset + (UINT)grid.Indices32.size();
-	//UINT cylinderIndexOffset = sphereIndexOffset + (UINT)sphere.Indices32.size();
-
-	SubmeshGeometry boxSubmesh;
-	boxSubmesh.IndexCount = (UINT)box.Indices32.size();
-	boxSubmesh.StartIndexLocation = boxIndexOffset;
-	boxSubmesh.BaseVertexLocation = boxVertexOffset;
-
-	SubmeshGeometry cylinderSubmesh;
-	cylinderSubmesh.IndexCount = (UINT)cylinder.Indices32.size();
-	cylinderSubmesh.StartIndexLocation = cylinderIndexOffset;
-	cylinderSubmesh.BaseVertexLocation = cylinderVertexOffset;
-
-	SubmeshGeometry diamondSubmesh;
-	diamondSubmesh.IndexCount = (UINT)diamond.Indices32.size();
-	diamondSubmesh.StartIndexLocation = diamondIndexOffset;
-	diamondSubmesh.BaseVertexLocation = diamondVertexOffset;
-
-	SubmeshGeometry coneSubmesh;
-	coneSubmesh.IndexCount = (UINT)cone.Indices32.size();
-	coneSubmesh.StartIndexLocation = coneIndexOffset;
-	coneSubmesh.BaseVertexLocation = coneVertexOffset;
-
-	SubmeshGeometry wedgeSubmesh;
-	wedgeSubmesh.IndexCount = (UINT)wedge.Indices32.size();
-	wedgeSubmesh.StartIndexLocation = wedgeIndexOffset;
-	wedgeSubmesh.BaseVertexLocation = wedgeVertexOffset;
-
-	SubmeshGeometry pyramidSubmesh;
-	pyramidSubmesh.IndexCount = (UINT)pyramid.Indices32.size();
-	pyramidSubmesh.StartIndexLocation = pyramidIndexOffset;
-	pyramidSubmesh.BaseVertexLocation = pyramidVertexOffset;
-
-	SubmeshGeometry torusSubmesh;
-	torusSubmesh.IndexCount = (UINT)torus.Indices32.size();
-	torusSubmesh.StartIndexLocation = torusIndexOffset;
-	torusSubmesh.BaseVertexLocation = torusVertexOffset;
-
-	SubmeshGeometry gridSubmesh;
-	gridSubmesh.IndexCount = (UINT)grid.Indices32.size();
-	gridSubmesh.StartIndexLocation = gridIndexOffset;
-	gridSubmesh.BaseVertexLocation = gridVertexOffset;
-
-	SubmeshGeometry sphereSubmesh;
-	sphereSubmesh.IndexCount = (UINT)sphere.Indices32.size();
-	sphereSubmesh.StartIndexLocation = sphereIndexOffset;
-	sphereSubmesh.BaseVertexLocation = sphereVertexOffset;
-
-	
+	XMMATRIX view = XMLoadFloat4x4(&mView);
+	XMMATRIX invView = XMMatrixInverse(&XMMatrixDeterminant(view), view);
 
-	//
-	// Extract the vertex elements we are interested in and pack the
-	// vertices of all the meshes into one vertex buffer.
-	//
+	// Transform the camera frustum from view space to world space once, then
+	// walk the scene tree with it.
+	BoundingFrustum worldFrustum;
+	mCamFrustum.Transform(worldFrustum, invView);
 
-	auto totalVertexCount =
-		box.Vertices.size() +
-		cylinder.Vertices.size() +
-		diamond.Vertices.size() +
-		cone.Vertices.size() +
-		wedge.Vertices.size() +
-		pyramid.Vertices.size() +
-		torus.Vertices.size() +
-		grid.Vertices.size() +
-		sphere.Vertices.size();
-		
+	// The tree sprites are always culled on the GPU, and with -gpudriven so is
+	// everything else.
+	UpdateCullConstants();
+	if(mRenderSettings.GpuDriven)
+		return;
 
-	std::vector<Vertex> vertices(totalVertexCount);
+	// Bounding sphere radius to fraction of half the screen height at distance 1.
+	const float lodScale = mProj(1, 1) * mRenderSettings.LodBias;
+	XMVECTOR eyePos = XMLoadFloat3(&mEyePos);
 
-	UINT k = 0;
-	for(size_t i = 0; i < box.Vertices.size(); ++i, ++k)
+	// Subtrees outside the frustum are skipped and subtrees inside it taken whole,
+	// so only the objects near its planes are tested one by one.
+	const UINT objectCount = mScene.Size();
+	mVisibleObjects.clear();
+	if(mFrustumCullingEnabled)
 	{
-		vertices[k].Pos = box.Vertices[i].Position;
-		vertices[k].Normal = box.Vertices[i].Normal;
-		vertices[k].TexC = box.Vertices[i].TexC;
+		mSceneBvh.QueryFrustum(worldFrustum, mScene.WorldBounds, mVisibleObjects);
 	}
-
-	for (size_t i = 0; i < cylinder.Vertices.size(); ++i, ++k)
+	else
 	{
-		vertices[k].Pos = cylinder.Vertices[i].Position;
-		vertices[k].Normal = cylinder.Vertices[i].Normal;
-		vertices[k].TexC = cylinder.Vertices[i].TexC;
+		for(UINT i = 0; i < objectCount; ++i)
+			mVisibleObjects.push_back(i);
 	}
 
-	for (size_t i = 0; i < diamond.Vertices.size(); ++i, ++k)
+	std::fill(mScene.Visible.begin(), mScene.Visible.end(), (unsigned char)0);
+	for(UINT i : mVisibleObjects)
 	{
-		vertices[k].Pos = diamond.Vertices[i].Position;
-		vertices[k].Normal = diamond.Vertices[i].Normal;
-		vertices[k].TexC = diamond.Vertices[i].TexC;
-	}
+		const BoundingBox& bounds = mScene.WorldBounds[i];
+		mScene.Visible[i] = 1;
 
-	for (size_t i = 0; i < cone.Vertices.size(); ++i, ++k)
-	{
-		vertices[k].Pos = cone.Vertices[i].Position;
-		vertices[k].Normal = cone.Vertices[i].Normal;
-		vertices[k].TexC = cone.Vertices[i].TexC;
+		if(mScene.LodCount[i] > 1)
+		{
+			float radius = XMVectorGetX(XMVector3Length(XMLoadFloat3(&bounds.Extents)));
+			float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&bounds.Center), eyePos)));
+			float screenSize = radius * lodScale / MathHelper::Max(distance, 0.001f);
+
+			mScene.Lod[i] = (unsigned char)SelectLod(screenSize, mScene.Lod[i], mScene.LodCount[i]);
+		}
 	}
 
-	for (size_t i = 0; i < wedge.Vertices.size(); ++i, ++k)
+	mVisibleRitemCount = (UINT)mVisibleObjects.size();
+	mCulledRitemCount = objectCount - mVisibleRitemCount;
+}
+
+void LitColumnsApp::UpdateCullConstants()
+{
+	XMMATRIX viewProj = XMMatrixMultiply(XMLoadFloat4x4(&mView), XMLoadFloat4x4(&mProj));
+
+	// World space frustum planes straight from the view-projection matrix; with
+	// row vectors the clip space coordinates are dot products with its columns.
+	XMMATRIX cols = XMMatrixTranspose(viewProj);
+	XMVECTOR planes[6] =
 	{
-		vertices[k].Pos = wedge.Vertices[i].Position;
-		vertices[k].Normal = wedge.Vertices[i].Normal;
-		vertices[k].TexC = wedge.Vertices[i].TexC;
-	}
+		XMVectorAdd(cols.r[3], cols.r[0]),      // left
+		XMVectorSubtract(cols.r[3], cols.r[0]), // right
+		XMVectorAdd(cols.r[3], cols.r[1]),      // bottom
+		XMVectorSubtract(cols.r[3], cols.r[1]), // top
+		cols.r[2],                              // near
+		XMVectorSubtract(cols.r[3], cols.r[2])  // far
+	};
+
+	CullConstants cullConstants;
+	for(int i = 0; i < 6; ++i)
+		XMStoreFloat4(&cullConstants.FrustumPlanes[i], XMPlaneNormalize(planes[i]));
+	cullConstants.EyePosW = mEyePos;
+	cullConstants.CullingEnabled = mFrustumCullingEnabled ? 1 : 0;
+	cullConstants.ObjectCount = mScene.Size();
+	cullConstants.SpriteCount = mTreeSpriteCount;
+	cullConstants.SpriteLodStart = 0.5f*mRenderSettings.TreeLodDistance;
+	cullConstants.SpriteLodEnd = mRenderSettings.TreeLodDistance;
+	cullConstants.LodScreenSizes = XMFLOAT4(gLodScreenSizes[0], gLodScreenSizes[1], gLodScreenSizes[2], 0.0f);
+	cullConstants.LodScale = mProj(1, 1) * mRenderSettings.LodBias;
+	cullConstants.LodHysteresis = gLodHysteresis;
+	cullConstants.HiZViewProj = mHiZViewProj;
+	cullConstants.HiZRenderWidth = mHiZRenderWidth;
+	cullConstants.HiZRenderHeight = mHiZRenderHeight;
+	cullConstants.HiZMipCount = mHiZValid ? mHiZMipCount : 0;
+
+	mCurrFrameResource->CullCB = mUploadRing->AllocateConstantBuffers(&cullConstants, 1);
+}
 
-	for (size_t i = 0; i < pyramid.Vertices.size(); ++i, ++k)
+void LitColumnsApp::RecordGpuCulling(ID3D12GraphicsCommandList* cmdList)
+{
+	mProfiler->BeginGpuScope(cmdList, mCullGpuScope);
+	if(mDrawCommandCount == 0)
 	{
-		vertices[k].Pos = pyramid.Vertices[i].Position;
-		vertices[k].Normal = pyramid.Vertices[i].Normal;
-		vertices[k].TexC = pyramid.Vertices[i].TexC;
+		mProfiler->EndGpuScope(cmdList, mCullGpuScope);
+		return;
 	}
 
-	for (size_t i = 0; i < torus.Vertices.size(); ++i, ++k)
+	// Buffers are back in COMMON at the start of the frame.  Start from the
+	// templates, which have every InstanceCount at zero; the copy promotes the
+	// command buffer to COPY_DEST.
+	cmdList->CopyResource(mDrawCommands.Get(), mDrawCommandTemplates.Get());
+
+	D3D12_RESOURCE_BARRIER toUav[] =
 	{
-		vertices[k].Pos = torus.Vertices[i].Position;
-		vertices[k].Normal = torus.Vertices[i].Normal;
-		vertices[k].TexC = torus.Vertices[i].TexC;
-	}
+		CD3DX12_RESOURCE_BARRIER::Transition(mDrawCommands.Get(),
+			D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
+		CD3DX12_RESOURCE_BARRIER::Transition(mGpuInstanceIndices.Get(),
+			D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
+		CD3DX12_RESOURCE_BARRIER::Transition(mGpuObjectLods.Get(),
+			D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_UNORDERED_ACCESS)
+	};
+	cmdList->ResourceBarrier(_countof(toUav), toUav);
+
+	cmdList->SetComputeRootSignature(mCullRootSignature.Get());
+	cmdList->SetComputeRootConstantBufferView(0, mCurrFrameResource->CullCB);
+	cmdList->SetComputeRootShaderResourceView(1, mCullObjectBuffer->GetGPUVirtualAddress());
+	cmdList->SetComputeRootUnorderedAccessView(2, mDrawCommands->GetGPUVirtualAddress());
+	cmdList->SetComputeRootUnorderedAccessView(3, mGpuInstanceIndices->GetGPUVirtualAddress());
+	cmdList->SetComputeRootUnorderedAccessView(4, mGpuObjectLods->GetGPUVirtualAddress());
+
+	// The occlusion test reads the pyramid the previous frame left behind; this
+	// frame's is only built after the depth pre-pass.
+	if(mRenderSettings.OcclusionCulling && mHiZ != nullptr)
+	{
+		ID3D12DescriptorHeap* descriptorHeaps[] = { mSrvHeap->Heap() };
+		cmdList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
 
-	for(size_t i = 0; i < grid.Vertices.size(); ++i, ++k)
+		cmdList->SetPipelineState(mCullOcclusionPSO);
+		cmdList->SetComputeRootDescriptorTable(5, mSrvHeap->GpuHandle(mHiZSrvIndex));
+	}
+	else
 	{
-		vertices[k].Pos = grid.Vertices[i].Position;
-		vertices[k].Normal = grid.Vertices[i].Normal;
-		vertices[k].TexC = grid.Vertices[i].TexC;
+		cmdList->SetPipelineState(mCullPSO);
 	}
 
-	for(size_t i = 0; i < sphere.Vertices.size(); ++i, ++k)
+	// Cull.hlsl runs 64 threads per group, one object per thread.
+	cmdList->Dispatch((mScene.Size() + 63) / 64, 1, 1);
+
+	D3D12_RESOURCE_BARRIER toDraw[] =
 	{
-		vertices[k].Pos = sphere.Vertices[i].Position;
-		vertices[k].Normal = sphere.Vertices[i].Normal;
-		vertices[k].TexC = sphere.Vertices[i].TexC;
+		CD3DX12_RESOURCE_BARRIER::Transition(mDrawCommands.Get(),
+			D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT),
+		CD3DX12_RESOURCE_BARRIER::Transition(mGpuInstanceIndices.Get(),
+			D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE)
+	};
+	cmdList->ResourceBarrier(_countof(toDraw), toDraw);
+
+	mProfiler->EndGpuScope(cmdList, mCullGpuScope);
+}
+
+void LitColumnsApp::RecordSpriteCulling(ID3D12GraphicsCommandList* cmdList)
+{
+	mProfiler->BeginGpuScope(cmdList, mSpriteCullGpuScope);
+	if(mTreeSpriteCount == 0)
+	{
+		mProfiler->EndGpuScope(cmdList, mSpriteCullGpuScope);
+		return;
 	}
-	
-	
 
-	std::vector<std::uint16_t> indices;
-	indices.insert(indices.end(), std::begin(box.GetIndices16()), std::end(box.GetIndices16()));
-	indices.insert(indices.end(), std::begin(cylinder.GetIndices16()), std::end(cylinder.GetIndices16()));
-	indices.insert(indices.end(), std::begin(diamond.GetIndices16()), std::end(diamond.GetIndices16()));
-	indices.insert(indices.end(), std::begin(cone.GetIndices16()), std::end(cone.GetIndices16()));
-	indices.insert(indices.end(), std::begin(wedge.GetIndices16()), std::end(wedge.GetIndices16()));
-	indices.insert(indices.end(), std::begin(pyramid.GetIndices16()), std::end(pyramid.GetIndices16()));
-	indices.insert(indices.end(), std::begin(torus.GetIndices16()), std::end(torus.GetIndices16()));
-	indices.insert(indices.end(), std::begin(grid.GetIndices16()), std::end(grid.GetIndices16()));
-	indices.insert(indices.end(), std::begin(sphere.GetIndices16()), std::end(sphere.GetIndices16()));
-	
+	// Same pattern as RecordGpuCulling: reset the instance count from the
+	// template, then let SpriteCull.hlsl append the visible sprites.
+	cmdList->CopyResource(mTreeSpriteDrawArgs.Get(), mTreeSpriteDrawTemplate.Get());
 
-    const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
-    const UINT ibByteSize = (UINT)indices.size()  * sizeof(std::uint16_t);
+	D3D12_RESOURCE_BARRIER toUav[] =
+	{
+		CD3DX12_RESOURCE_BARRIER::Transition(mTreeSpriteDrawArgs.Get(),
+			D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
+		CD3DX12_RESOURCE_BARRIER::Transition(mVisibleTreeSprites.Get(),
+			D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_UNORDERED_ACCESS)
+	};
+	cmdList->ResourceBarrier(_countof(toUav), toUav);
 
-	auto geo = std::make_unique<MeshGeometry>();
-	geo->Name = "shapeGeo";
+	// SpriteCull.hlsl binds the same slots as Cull.hlsl.
+	cmdList->SetComputeRootSignature(mCullRootSignature.Get());
+	cmdList->SetPipelineState(mSpriteCullPSO);
+	cmdList->SetComputeRootConstantBufferView(0, mCurrFrameResource->CullCB);
+	cmdList->SetComputeRootShaderResourceView(1, mTreeSpriteBuffer->GetGPUVirtualAddress());
+	cmdList->SetComputeRootUnorderedAccessView(2, mTreeSpriteDrawArgs->GetGPUVirtualAddress());
+	cmdList->SetComputeRootUnorderedAccessView(3, mVisibleTreeSprites->GetGPUVirtualAddress());
 
-	ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
-	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
+	// 64 threads per group, one sprite per thread.
+	cmdList->Dispatch((mTreeSpriteCount + 63) / 64, 1, 1);
 
-	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
+	D3D12_RESOURCE_BARRIER toDraw[] =
+	{
+		CD3DX12_RESOURCE_BARRIER::Transition(mTreeSpriteDrawArgs.Get(),
+			D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT),
+		CD3DX12_RESOURCE_BARRIER::Transition(mVisibleTreeSprites.Get(),
+			D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE)
+	};
+	cmdList->ResourceBarrier(_countof(toDraw), toDraw);
 
-	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
+	mProfiler->EndGpuScope(cmdList, mSpriteCullGpuScope);
+}
 
-	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
+void LitColumnsApp::RecordLightCulling(ID3D12GraphicsCommandList* cmdList)
+{
+	mProfiler->BeginGpuScope(cmdList, mLightCullGpuScope);
 
-	geo->VertexByteStride = sizeof(Vertex);
-	geo->VertexBufferByteSize = vbByteSize;
-	geo->IndexFormat = DXGI_FORMAT_R16_UINT;
-	geo->IndexBufferByteSize = ibByteSize;
+	// Runs even without lights, so every cluster's count is rewritten.
+	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mClusterLights.Get(),
+		D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
 
-	geo->DrawArgs["box"] = boxSubmesh;
-	geo->DrawArgs["cylinder"] = cylinderSubmesh;
-	geo->DrawArgs["diamond"] = diamondSubmesh;
-	geo->DrawArgs["cone"] = coneSubmesh;
-	geo->DrawArgs["wedge"] = wedgeSubmesh;
-	geo->DrawArgs["pyramid"] = pyramidSubmesh;
-	geo->DrawArgs["torus"] = torusSubmesh;
-	geo->DrawArgs["grid"] = gridSubmesh;
-	geo->DrawArgs["sphere"] = sphereSubmesh;
-	
+	// LightCull.hlsl only uses the first three of the culling slots.
+	cmdList->SetComputeRootSignature(mCullRootSignature.Get());
+	cmdList->SetPipelineState(mLightCullPSO);
+	cmdList->SetComputeRootConstantBufferView(0, mCurrFrameResource->LightCullCB);
+	cmdList->SetComputeRootShaderResourceView(1, mCurrFrameResource->LightBuffer);
+	cmdList->SetComputeRootUnorderedAccessView(2, mClusterLights->GetGPUVirtualAddress());
 
-	mGeometries[geo->Name] = std::move(geo);
+	// 64 threads per group, one cluster per thread.
+	cmdList->Dispatch((gClusterCount + 63) / 64, 1, 1);
+
+	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mClusterLights.Get(),
+		D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+
+	mProfiler->EndGpuScope(cmdList, mLightCullGpuScope);
 }
 
-void LitColumnsApp::BuildSkullGeometry()
+void LitColumnsApp::RecordDepthPrepass(ID3D12GraphicsCommandList* cmdList, RenderQueue::SubmitStats& stats)
 {
-	std::ifstream fin("Models/skull.txt");
+	mProfiler->BeginGpuScope(cmdList, mDepthPrepassGpuScope);
+
+	// Depth only: the opaque layer, in the same front to back order as its lit
+	// pass, which then only shades the fragments whose depth is equal.
+	D3D12_CPU_DESCRIPTOR_HANDLE dsv = DepthStencilView();
+	cmdList->RSSetViewports(1, &mSceneViewport);
+	cmdList->RSSetScissorRects(1, &mSceneScissorRect);
+	cmdList->OMSetRenderTargets(0, nullptr, false, &dsv);
+
+	SetPassRootArguments(cmdList);
+	cmdList->SetPipelineState(mDepthPrepassPSO);
 
-	if(!fin)
+	if(mRenderSettings.GpuDriven)
+		DrawInstanceGroupsIndirect(cmdList, RenderLayer::Opaque);
+	else
+		DrawInstanceGroups(cmdList, RenderLayer::Opaque, 0, mRenderQueues[(int)RenderLayer::Opaque].Size(), stats);
+
+	mProfiler->EndGpuScope(cmdList, mDepthPrepassGpuScope);
+}
+
+void LitColumnsApp::RecordHiZ(ID3D12GraphicsCommandList* cmdList)
+{
+	// The scope is still written while 4x MSAA, toggled at run time, leaves no
+	// pyramid to build.
+	mProfiler->BeginGpuScope(cmdList, mHiZGpuScope);
+	if(mHiZ == nullptr)
 	{
-		MessageBox(0, L"Models/skull.txt not found.", 0, 0);
+		mProfiler->EndGpuScope(cmdList, mHiZGpuScope);
 		return;
 	}
 
-	UINT vcount = 0;
-	UINT tcount = 0;
-	std::string ignore;
+	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mDepthStencilBuffer.Get(),
+		D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE));
 
-	fin >> ignore >> vcount;
-	fin >> ignore >> tcount;
-	fin >> ignore >> ignore >> ignore >> ignore;
+	cmdList->SetComputeRootSignature(mHiZRootSignature.Get());
+	cmdList->SetPipelineState(mHiZPSO);
 
-	std::vector<Vertex> vertices(vcount);
-	for(UINT i = 0; i < vcount; ++i)
+	// Each level reads the one above it, the first one the depth buffer.  A level
+	// is only a UAV while it is written.  Under dynamic resolution only the top
+	// left corner of every level, below the render size, is built.
+	UINT srcWidth = mRenderWidth;
+	UINT srcHeight = mRenderHeight;
+	UINT dstWidth = MathHelper::Max((mRenderWidth + 1) / 2, 1u);
+	UINT dstHeight = MathHelper::Max((mRenderHeight + 1) / 2, 1u);
+	for(UINT mip = 0; mip < mHiZMipCount; ++mip)
 	{
-		fin >> vertices[i].Pos.x >> vertices[i].Pos.y >> vertices[i].Pos.z;
-		fin >> vertices[i].Normal.x >> vertices[i].Normal.y >> vertices[i].Normal.z;
+		cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mHiZ.Get(),
+			D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, mip));
+
+		UINT hiZConstants[] = { srcWidth, srcHeight, dstWidth, dstHeight };
+		cmdList->SetComputeRoot32BitConstants(0, _countof(hiZConstants), hiZConstants, 0);
+		cmdList->SetComputeRootDescriptorTable(1, mSrvHeap->GpuHandle(mip == 0 ? mDepthSrvIndex : mHiZMipSrvIndices[mip - 1]));
+		cmdList->SetComputeRootDescriptorTable(2, mSrvHeap->GpuHandle(mHiZMipUavIndices[mip]));
+
+		// HiZ.hlsl runs 8x8 threads per group, one texel per thread.
+		cmdList->Dispatch((dstWidth + 7) / 8, (dstHeight + 7) / 8, 1);
+
+		cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mHiZ.Get(),
+			D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, mip));
+
+		srcWidth = dstWidth;
+		srcHeight = dstHeight;
+		dstWidth = MathHelper::Max((dstWidth + 1) / 2, 1u);
+		dstHeight = MathHelper::Max((dstHeight + 1) / 2, 1u);
 	}
 
-	fin >> ignore;
-	fin >> ignore;
-	fin >> ignore;
+	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mDepthStencilBuffer.Get(),
+		D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_DEPTH_WRITE));
+
+	// Next frame's culling tests against this pyramid from this frame's view.
+	mHiZViewProj = mCameraCB.ViewProj;
+	mHiZRenderWidth = mRenderWidth;
+	mHiZRenderHeight = mRenderHeight;
+	mHiZValid = true;
 
-	std::vector<std::int32_t> indices(3 * tcount);
-	for(UINT i = 0; i < tcount; ++i)
+	mProfiler->EndGpuScope(cmdList, mHiZGpuScope);
+}
+
+void LitColumnsApp::UpdateRenderResolution()
+{
+	// The frame the profiler resolved last is a few frames old, which only delays
+	// the reaction by as much.
+	if(mSceneColor != nullptr)
+	{
+		mDynamicResolution->Update(mProfiler->GetLastGpuTime(mGpuFrameScope));
+		mRenderWidth = mDynamicResolution->Apply((UINT)mClientWidth);
+		mRenderHeight = mDynamicResolution->Apply((UINT)mClientHeight);
+	}
+	else
 	{
-		fin >> indices[i * 3 + 0] >> indices[i * 3 + 1] >> indices[i * 3 + 2];
+		mRenderWidth = (UINT)mClientWidth;
+		mRenderHeight = (UINT)mClientHeight;
 	}
 
-	fin.close();
+	mSceneViewport.TopLeftX = 0.0f;
+	mSceneViewport.TopLeftY = 0.0f;
+	mSceneViewport.Width = (float)mRenderWidth;
+	mSceneViewport.Height = (float)mRenderHeight;
+	mSceneViewport.MinDepth = 0.0f;
+	mSceneViewport.MaxDepth = 1.0f;
 
-	//
-	// Pack the indices of all the meshes into one index buffer.
-	//
+	mSceneScissorRect = { 0, 0, (LONG)mRenderWidth, (LONG)mRenderHeight };
+}
 
-	const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
+void LitColumnsApp::RecordUpscale(ID3D12GraphicsCommandList* cmdList)
+{
+	if(!mRenderSettings.DynamicResolution)
+		return;
 
-	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::int32_t);
+	// The scope is still written while 4x MSAA, toggled at run time, renders
+	// straight to the back buffer.
+	mProfiler->BeginGpuScope(cmdList, mUpscaleGpuScope);
+	if(mSceneColor == nullptr)
+	{
+		mProfiler->EndGpuScope(cmdList, mUpscaleGpuScope);
+		return;
+	}
 
-	auto geo = std::make_unique<MeshGeometry>();
-	geo->Name = "skullGeo";
+	D3D12_RESOURCE_BARRIER barriers[] =
+	{
+		CD3DX12_RESOURCE_BARRIER::Transition(mSceneColor.Get(),
+			D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE),
+		CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
+			D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET)
+	};
+	cmdList->ResourceBarrier(_countof(barriers), barriers);
 
-	ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
-	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
+	cmdList->RSSetViewports(1, &mScreenViewport);
+	cmdList->RSSetScissorRects(1, &mScissorRect);
+	cmdList->OMSetRenderTargets(1, &CurrentBackBufferView(), true, nullptr);
 
-	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
+	ID3D12DescriptorHeap* descriptorHeaps[] = { mSrvHeap->Heap() };
+	cmdList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
 
-	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
+	cmdList->SetGraphicsRootSignature(mUpscaleRootSignature.Get());
+	cmdList->SetPipelineState(mUpscalePSO);
 
-	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
+	// The rendered fraction of the scene target and one of its texels, in uv.
+	float upscaleConstants[] =
+	{
+		(float)mRenderWidth / mClientWidth, (float)mRenderHeight / mClientHeight,
+		1.0f / mClientWidth, 1.0f / mClientHeight
+	};
+	cmdList->SetGraphicsRoot32BitConstants(0, _countof(upscaleConstants), upscaleConstants, 0);
+	cmdList->SetGraphicsRootDescriptorTable(1, mSrvHeap->GpuHandle(mSceneColorSrvIndex));
 
-	geo->VertexByteStride = sizeof(Vertex);
-	geo->VertexBufferByteSize = vbByteSize;
-	geo->IndexFormat = DXGI_FORMAT_R32_UINT;
-	geo->IndexBufferByteSize = ibByteSize;
+	// One full screen triangle made up in the vertex shader.
+	cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	cmdList->DrawInstanced(3, 1, 0, 0);
 
-	SubmeshGeometry submesh;
-	submesh.IndexCount = (UINT)indices.size();
-	submesh.StartIndexLocation = 0;
-	submesh.BaseVertexLocation = 0;
+	mProfiler->EndGpuScope(cmdList, mUpscaleGpuScope);
+}
 
-	geo->DrawArgs["skull"] = submesh;
+D3D12_CPU_DESCRIPTOR_HANDLE LitColumnsApp::SceneRenderTargetView()const
+{
+	if(mSceneColor == nullptr)
+		return CurrentBackBufferView();
 
-	mGeometries[geo->Name] = std::move(geo);
+	return CD3DX12_CPU_DESCRIPTOR_HANDLE(mRtvHeap->GetCPUDescriptorHandleForHeapStart(),
+		SwapChainBufferCount, mRtvDescriptorSize);
 }
 
-void LitColumnsApp::BuildTreeSpritesGeometry()
+void LitColumnsApp::UpdateCaption(const GameTimer& gt)
 {
-	struct TreeSpriteVertex
+	// Refreshed at the rate CalculateFrameStats redraws the caption, which it
+	// prefixes to the fps readout.
+	if(gt.TotalTime() - mCaptionTime < 1.0f)
+		return;
+	mCaptionTime = gt.TotalTime();
+
+	// Video memory in use against the budget the OS gives the process, in MB.
+	GpuMemoryAllocator::Budget budget = mGpuMemory->QueryBudget();
+	const std::wstring memory = L"   vram: " + std::to_wstring(budget.Local.CurrentUsage >> 20) +
+		L"/" + std::to_wstring(budget.Local.Budget >> 20);
+
+	// The size the scene renders at, under dynamic resolution.
+	std::wstring resolution;
+	if(mSceneColor != nullptr)
 	{
-		XMFLOAT3 Pos;
-		XMFLOAT2 Size;
-	};
+		resolution = L"   res: " + std::to_wstring(mRenderWidth) + L"x" + std::to_wstring(mRenderHeight) +
+			L" (" + std::to_wstring((int)(mDynamicResolution->Scale()*100.0f + 0.5f)) + L"%)";
+	}
+
+	// The object picked with the right mouse button, by geometry and material.
+	std::wstring picked;
+	for(const auto& ri : mAllRitems)
+	{
+		if(mPickedObject >= 0 && ri->ObjCBIndex == (UINT)mPickedObject)
+		{
+			picked = L"   picked: " + AnsiToWString(mGeometries[ri->Geo].Name) + L"/" +
+				AnsiToWString(mMaterials[ri->Mat].Name) + L" #" + std::to_wstring(mPickedObject);
+			break;
+		}
+	}
 
-	static const int treeCount = 16;
-	std::array<TreeSpriteVertex, 16> vertices;
-	for (UINT i = 0; i < treeCount; ++i)
+	// The GPU-driven path never reads its culling results back.
+	if(mRenderSettings.GpuDriven)
 	{
-		int left = MathHelper::Rand(0, 1);
-		int top = MathHelper::Rand(0, 1);
-		float x;
-		float z;
+		mMainWndCaption = L"LitColumns    objects: " + std::to_wstring(mScene.Size()) +
+			L" (gpu culled)" + resolution + memory + picked + mProfiler->GetSummary();
+		return;
+	}
+
+	// State the last frame's draws set, and the calls skipped as redundant.
+	const std::wstring state = L"   binds: " +
+		std::to_wstring(mSubmitStats.GeometryBinds + mSubmitStats.TopologyBinds) +
+		L" (" + std::to_wstring(mSubmitStats.Skipped()) + L" skipped)";
 
-		if (left == 0)
+	mMainWndCaption = L"LitColumns    visible: " + std::to_wstring(mVisibleRitemCount) +
+		L"   culled: " + std::to_wstring(mCulledRitemCount) + state + resolution + memory + picked + mProfiler->GetSummary();
+}
+
+void LitColumnsApp::DumpProfile()
+{
+	std::wstring report = mProfiler->GetReport() + mTelemetry.GetReport();
+	OutputDebugString(report.c_str());
+
+	if(!mProfiler->WriteCsv(L"profile.csv") || !mProfiler->WriteChromeTrace(L"profile_trace.json"))
+		OutputDebugString(L"Could not write profile.csv / profile_trace.json\n");
+
+	if(!mTelemetry.WriteCsv(L"frames.csv"))
+		OutputDebugString(L"Could not write frames.csv\n");
+}
+
+void LitColumnsApp::UpdateInstanceIndices(const GameTimer& gt)
+{
+	// The tree sprites are one indirect draw whatever SpriteCull.hlsl keeps.
+	mDrawCallCount = GetLayerDrawCount(RenderLayer::AlphaTestedTreeSprites);
+
+	// Cull.hlsl writes the index lists instead, and every instanced layer is a
+	// single ExecuteIndirect.
+	if(mRenderSettings.GpuDriven)
+	{
+		for(RenderLayer layer : gLayerDrawOrder)
 		{
-			x = MathHelper::RandF(15.0f, 45.0f);
-			
+			if(layer != RenderLayer::AlphaTestedTreeSprites)
+				mDrawCallCount += GetLayerDrawCount(layer);
 		}
-		else
+		return;
+	}
+
+	// View depth of an object's bounds center.
+	const XMFLOAT4X4& v = mView;
+	auto viewDepth = [&](UINT obj)
+	{
+		const XMFLOAT3& c = mScene.WorldBounds[obj].Center;
+		return c.x*v._13 + c.y*v._23 + c.z*v._33 + v._43;
+	};
+
+	// Pack the object indices of the visible instances of every group back to
+	// back so each group can bind its own contiguous range of the index buffer.
+	mInstanceIndices.clear();
+	for(int layer = 0; layer < (int)RenderLayer::Count; ++layer)
+	{
+		const bool blended = (layer == (int)RenderLayer::Transparent);
+
+		for(auto& group : mInstanceGroups[layer])
 		{
-			x = MathHelper::RandF(-45.0f, -15.0f);
+			group.VisibleStart = (UINT)mInstanceIndices.size();
+			group.SortDepth = blended ? 0.0f : MathHelper::Infinity;
+			for(UINT obj : group.Objects)
+			{
+				if(mScene.Visible[obj] && mScene.Lod[obj] == group.Lod)
+				{
+					mInstanceIndices.push_back(obj);
+
+					float depth = viewDepth(obj);
+					group.SortDepth = blended ? MathHelper::Max(group.SortDepth, depth) : MathHelper::Min(group.SortDepth, depth);
+				}
+			}
+
+			group.VisibleCount = (UINT)mInstanceIndices.size() - group.VisibleStart;
+			if(group.VisibleCount > 0)
+				mDrawCallCount++;
+
+			// Instances of one draw are blended in order, so blended groups also
+			// sort their own instances back to front.
+			if(blended && group.VisibleCount > 1)
+			{
+				auto first = mInstanceIndices.begin() + group.VisibleStart;
+				std::sort(first, first + group.VisibleCount, [&](UINT a, UINT b)
+				{
+					return viewDepth(a) > viewDepth(b);
+				});
+			}
 		}
-		if (top == 0)
+
+		SortInstanceGroups((RenderLayer)layer);
+	}
+
+	mCurrFrameResource->InstanceIndexBuffer = mUploadRing->AllocateStructuredBuffer(
+		mInstanceIndices.data(), (UINT)mInstanceIndices.size());
+}
+
+void LitColumnsApp::LoadTextures()
+{
+	// The placeholder is tiny, so load it synchronously with the other
+	// initialization commands; everything else streams in the background.
+	auto whiteTex = std::make_unique<Texture>();
+	whiteTex->Name = "whiteTex";
+	whiteTex->Filename = L"Textures/white1x1.dds";
+	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
+		mCommandList.Get(), whiteTex->Filename.c_str(),
+		whiteTex->Resource, whiteTex->UploadHeap));
+
+	// bricks2.dds and grass.dds packed by Tools/TexturePacker:
+	//   TexturePacker materialArray0.dds bricks2.dds grass.dds
+	// Slice 0 is the bricks, slice 1 the grass.
+	auto materialArrayTex = std::make_unique<Texture>();
+	materialArrayTex->Name = "materialArrayTex";
+	materialArrayTex->Filename = L"Textures/materialArray0.dds";
+
+	auto stoneTex = std::make_unique<Texture>();
+	stoneTex->Name = "stoneTex";
+	stoneTex->Filename = L"Textures/stone.dds";
+
+	auto waterTex = std::make_unique<Texture>();
+	waterTex->Name = "waterTex";
+	waterTex->Filename = L"Textures/water1.dds";
+
+	auto treeArrayTex = std::make_unique<Texture>();
+	treeArrayTex->Name = "treeArrayTex";
+	treeArrayTex->Filename = L"Textures/treeArray2.dds";
+
+	mTextures.Add(whiteTex->Name, std::move(*whiteTex));
+
+	// Heap order; see BuildMaterials.
+	mStreamedTextures[0] = mTextures.Add(materialArrayTex->Name, std::move(*materialArrayTex));
+	mStreamedTextures[1] = mTextures.Add(stoneTex->Name, std::move(*stoneTex));
+	mStreamedTextures[2] = mTextures.Add(waterTex->Name, std::move(*waterTex));
+	mStreamedTextures[3] = mTextures.Add(treeArrayTex->Name, std::move(*treeArrayTex));
+
+	// The streamer keeps pointers to the textures, so nothing may be added to
+	// mTextures past this point.
+	mTextureStreamer = std::make_unique<TextureStreamer>(md3dDevice.Get(), gNumTextureLoadThreads);
+	for(UINT i = 0; i < gNumStreamedTextures; ++i)
+		mTextureStreamer->Request(&mTextures[mStreamedTextures[i]]);
+
+}
+
+void LitColumnsApp::UpdateTextureStreaming()
+{
+	std::vector<Texture*> resident = mTextureStreamer->Update();
+
+	for(Texture* tex : resident)
+	{
+		for(UINT i = 0; i < gNumStreamedTextures; ++i)
 		{
-			z = MathHelper::RandF(15.0f, 45.0f);
+			if(&mTextures[mStreamedTextures[i]] != tex)
+				continue;
+
+			// The descriptor is fresh, so no frame in flight references it and it
+			// is safe to write while the GPU is busy.
+			UINT heapIndex = mSrvHeap->Allocate();
+			CreateTextureSrv(tex->Resource.Get(), heapIndex, true);
+			mSrvHeapRemap[i] = heapIndex;
+
+			// Point the material table at the new descriptor.
+			for(auto& mat : mMaterials)
+			{
+				if(mat.DiffuseSrvHeapIndex == (int)i)
+					mat.NumFramesDirty = 1;
+			}
 		}
-		else
+	}
+}
+
+void LitColumnsApp::BuildRootSignature()
+{
+	CD3DX12_DESCRIPTOR_RANGE texTable;
+	texTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
+
+	// The whole heap, for Default.hlsl's unbounded texture array.
+	CD3DX12_DESCRIPTOR_RANGE bindlessTable;
+	bindlessTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, UINT_MAX, 0, 2);
+
+	// Root parameter can be a table, root descriptor or root constants.
+	CD3DX12_ROOT_PARAMETER slotRootParameter[13];
+
+	// Tree array, and the camera block of the pass constants.
+	slotRootParameter[0].InitAsDescriptorTable(1, &texTable, D3D12_SHADER_VISIBILITY_PIXEL);
+	slotRootParameter[1].InitAsConstantBufferView(1);
+
+	// Material index and first instance index of the current draw.
+	slotRootParameter[2].InitAsConstants(2, 3);
+
+	// Instance data and instance index list for the instanced path.
+	slotRootParameter[3].InitAsShaderResourceView(0, 1, D3D12_SHADER_VISIBILITY_VERTEX);
+	slotRootParameter[4].InitAsShaderResourceView(1, 1, D3D12_SHADER_VISIBILITY_VERTEX);
+
+	// Material table, and every texture descriptor.
+	slotRootParameter[5].InitAsShaderResourceView(2, 1);
+	slotRootParameter[6].InitAsDescriptorTable(1, &bindlessTable, D3D12_SHADER_VISIBILITY_PIXEL);
+
+	// Tree sprites and the list of visible ones.
+	slotRootParameter[7].InitAsShaderResourceView(3, 1, D3D12_SHADER_VISIBILITY_VERTEX);
+	slotRootParameter[8].InitAsShaderResourceView(4, 1, D3D12_SHADER_VISIBILITY_VERTEX);
+
+	// Point and spot lights, and the lights of every cluster.
+	slotRootParameter[9].InitAsShaderResourceView(5, 1, D3D12_SHADER_VISIBILITY_PIXEL);
+	slotRootParameter[10].InitAsShaderResourceView(6, 1, D3D12_SHADER_VISIBILITY_PIXEL);
+
+	// The lighting and time blocks of the pass constants; see PassConstants.h.
+	slotRootParameter[11].InitAsConstantBufferView(2);
+	slotRootParameter[12].InitAsConstantBufferView(4);
+
+	auto staticSamplers = GetStaticSamplers();
+
+	// A root signature is an array of root parameters.
+	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(13, slotRootParameter,
+		(UINT)staticSamplers.size(), staticSamplers.data(),
+		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
+
+	auto createRootSignature = [this](const CD3DX12_ROOT_SIGNATURE_DESC& desc, ComPtr<ID3D12RootSignature>& rootSig)
+	{
+		ComPtr<ID3DBlob> serializedRootSig = nullptr;
+		ComPtr<ID3DBlob> errorBlob = nullptr;
+		HRESULT hr = D3D12SerializeRootSignature(&desc, D3D_ROOT_SIGNATURE_VERSION_1,
+			serializedRootSig.GetAddressOf(), errorBlob.GetAddressOf());
+
+		if(errorBlob != nullptr)
 		{
-			z = MathHelper::RandF(-45.0f, -15.0f);
+			::OutputDebugStringA((char*)errorBlob->GetBufferPointer());
 		}
-		
-		float y = -5.5f;
-			//GetHillsHeight(x, z);
+		ThrowIfFailed(hr);
 
-		// Move tree slightly above land height.
-		y += 8.0f;
+		ThrowIfFailed(md3dDevice->CreateRootSignature(
+			0,
+			serializedRootSig->GetBufferPointer(),
+			serializedRootSig->GetBufferSize(),
+			IID_PPV_ARGS(rootSig.GetAddressOf())));
 
-		vertices[i].Pos = XMFLOAT3(x, y, z);
-		vertices[i].Size = XMFLOAT2(5.0f, 5.0f);
-	}
+		mPipelineLibrary->AddRootSignature(rootSig.Get(), serializedRootSig.Get());
+	};
+
+	createRootSignature(rootSigDesc, mRootSignature);
+
+	//
+	// Culling passes: constants, object or sprite bounds, the draw commands and
+	// index list they write, the detail level of every object, and the
+	// hierarchical-Z pyramid for the occlusion test.  The light binning pass uses
+	// the first three slots for its lights and clusters.
+	//
+	CD3DX12_DESCRIPTOR_RANGE cullHiZTable;
+	cullHiZTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 1);
+
+	CD3DX12_ROOT_PARAMETER cullRootParameter[6];
+	cullRootParameter[0].InitAsConstantBufferView(0);
+	cullRootParameter[1].InitAsShaderResourceView(0);
+	cullRootParameter[2].InitAsUnorderedAccessView(0);
+	cullRootParameter[3].InitAsUnorderedAccessView(1);
+	cullRootParameter[4].InitAsUnorderedAccessView(2);
+	cullRootParameter[5].InitAsDescriptorTable(1, &cullHiZTable);
+
+	CD3DX12_ROOT_SIGNATURE_DESC cullRootSigDesc(6, cullRootParameter, 0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_NONE);
+	createRootSignature(cullRootSigDesc, mCullRootSignature);
 
-	std::array<std::uint16_t, 16> indices =
+	//
+	// Hierarchical-Z: the level sizes, the level read and the level written.
+	// Texture views cannot be root descriptors, so both are tables.
+	//
+	CD3DX12_DESCRIPTOR_RANGE hiZSrcTable;
+	hiZSrcTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
+	CD3DX12_DESCRIPTOR_RANGE hiZDstTable;
+	hiZDstTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 0);
+
+	CD3DX12_ROOT_PARAMETER hiZRootParameter[3];
+	hiZRootParameter[0].InitAsConstants(4, 0);
+	hiZRootParameter[1].InitAsDescriptorTable(1, &hiZSrcTable);
+	hiZRootParameter[2].InitAsDescriptorTable(1, &hiZDstTable);
+
+	CD3DX12_ROOT_SIGNATURE_DESC hiZRootSigDesc(3, hiZRootParameter, 0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_NONE);
+	createRootSignature(hiZRootSigDesc, mHiZRootSignature);
+
+	//
+	// Upscale: the scale constants and the scene target, filtered by a static
+	// linear clamp sampler.
+	//
+	CD3DX12_DESCRIPTOR_RANGE upscaleSrcTable;
+	upscaleSrcTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
+
+	CD3DX12_ROOT_PARAMETER upscaleRootParameter[2];
+	upscaleRootParameter[0].InitAsConstants(4, 0);
+	upscaleRootParameter[1].InitAsDescriptorTable(1, &upscaleSrcTable, D3D12_SHADER_VISIBILITY_PIXEL);
+
+	const CD3DX12_STATIC_SAMPLER_DESC linearClamp(
+		0, // shaderRegister
+		D3D12_FILTER_MIN_MAG_MIP_LINEAR, // filter
+		D3D12_TEXTURE_ADDRESS_MODE_CLAMP,  // addressU
+		D3D12_TEXTURE_ADDRESS_MODE_CLAMP,  // addressV
+		D3D12_TEXTURE_ADDRESS_MODE_CLAMP); // addressW
+
+	CD3DX12_ROOT_SIGNATURE_DESC upscaleRootSigDesc(2, upscaleRootParameter, 1, &linearClamp, D3D12_ROOT_SIGNATURE_FLAG_NONE);
+	createRootSignature(upscaleRootSigDesc, mUpscaleRootSignature);
+
+	//
+	// An IndirectCommand binds the group's geometry and draw constants, then draws.
+	//
+	D3D12_INDIRECT_ARGUMENT_DESC commandArgs[4] = {};
+	commandArgs[0].Type = D3D12_INDIRECT_ARGUMENT_TYPE_VERTEX_BUFFER_VIEW;
+	commandArgs[0].VertexBuffer.Slot = 0;
+	commandArgs[1].Type = D3D12_INDIRECT_ARGUMENT_TYPE_INDEX_BUFFER_VIEW;
+	commandArgs[2].Type = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT;
+	commandArgs[2].Constant.RootParameterIndex = 2;
+	commandArgs[2].Constant.DestOffsetIn32BitValues = 0;
+	commandArgs[2].Constant.Num32BitValuesToSet = 2;
+	commandArgs[3].Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED;
+
+	D3D12_COMMAND_SIGNATURE_DESC commandSigDesc = {};
+	commandSigDesc.ByteStride = sizeof(IndirectCommand);
+	commandSigDesc.NumArgumentDescs = _countof(commandArgs);
+	commandSigDesc.pArgumentDescs = commandArgs;
+	ThrowIfFailed(md3dDevice->CreateCommandSignature(&commandSigDesc, mRootSignature.Get(),
+		IID_PPV_ARGS(&mDrawCommandSignature)));
+
+	// The tree sprite draw only changes the instance count, so it needs no root
+	// signature.
+	D3D12_INDIRECT_ARGUMENT_DESC spriteArgs[1] = {};
+	spriteArgs[0].Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW;
+
+	D3D12_COMMAND_SIGNATURE_DESC spriteSigDesc = {};
+	spriteSigDesc.ByteStride = sizeof(D3D12_DRAW_ARGUMENTS);
+	spriteSigDesc.NumArgumentDescs = _countof(spriteArgs);
+	spriteSigDesc.pArgumentDescs = spriteArgs;
+	ThrowIfFailed(md3dDevice->CreateCommandSignature(&spriteSigDesc, nullptr,
+		IID_PPV_ARGS(&mTreeSpriteCommandSignature)));
+}
+
+void LitColumnsApp::BuildShadersAndInputLayout()
+{
+	// Precompiled by Tools/ShaderCompiler before every Release build, which fails
+	// on a missing blob; Debug compiles and caches whatever is missing.
+	ShaderCache shaderCache(gShaderCacheDirectory, ShaderCache::DefaultCompileFlags());
+
+	for(const ShaderVariant& v : gShaderVariants)
+		mShaders[v.Name] = shaderCache.GetShader(v.Filename, v.Defines, v.EntryPoint, v.Target);
+
+    mInputLayout =
+    {
+        { "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+        { "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, 8, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+    };
+}
+
+void LitColumnsApp::BuildShapeGeometry()
+{
+    GeometryGenerator geoGen;
+
+	using ShapeType = GeometryGenerator::ShapeType;
+
+	struct Shape
 	{
-		0, 1, 2, 3, 4, 5, 6, 7,
-		8, 9, 10, 11, 12, 13, 14, 15
+		std::string Name;
+		GeometryGenerator::ShapeDesc Desc;
 	};
 
-	const UINT vbByteSize = (UINT)vertices.size() * sizeof(TreeSpriteVertex);
-	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
+	const Shape shapes[] =
+	{
+		{ "box",      { ShapeType::Box,      { 1.0f, 1.0f, 1.0f },   { 3, 0 } } },
+		{ "cylinder", { ShapeType::Cylinder, { 0.5f, 0.45f, 5.0f },  { 20, 20 } } },
+		{ "diamond",  { ShapeType::Diamond,  { 1.0f, 1.0f, 1.0f },   { 3, 0 } } },
+		{ "cone",     { ShapeType::Cone,     { 1.0f, 1.0f, 0.0f },   { 20, 20 } } },
+		{ "wedge",    { ShapeType::Wedge,    { 1.0f, 1.0f, 1.0f },   { 3, 0 } } },
+		{ "pyramid",  { ShapeType::Pyramid,  { 1.0f, 1.0f, 1.0f },   { 3, 0 } } },
+		{ "torus",    { ShapeType::Torus,    { 10.0f, 1.0f, 0.0f },  { 40, 40 } } },
+		{ "grid",     { ShapeType::Grid,     { 30.0f, 30.0f, 0.0f }, { 60, 40 } } },
+		{ "sphere",   { ShapeType::Sphere,   { 0.5f, 0.0f, 0.0f },   { 20, 20 } } }
+	};
+
+	//
+	// We are concatenating all the geometry into one big vertex/index buffer, one
+	// detail level after the other.  Each shape's submesh covers its full detail
+	// level and lists where the coarser levels are.
+	//
+
+	std::vector<GeometryGenerator::ShapeDesc> levels;
+	std::vector<UINT> levelCounts;
+	for(const Shape& shape : shapes)
+		levelCounts.push_back(geoGen.AppendLods(shape.Desc, gMaxLods, levels));
+
+	std::vector<GeometryGenerator::BatchRange> ranges;
+	GeometryGenerator::uint32 vertexCount = 0;
+	GeometryGenerator::uint32 indexCount = 0;
+	// Every shape is indexed with 16 bits from its BaseVertex.
+	if(!geoGen.MeasureBatch(levels, ranges, vertexCount, indexCount))
+		throw DxException(E_INVALIDARG, L"GeometryGenerator::MeasureBatch", AnsiToWString(__FILE__), __LINE__);
+
+    const UINT ibByteSize = indexCount * sizeof(std::uint16_t);
 
 	auto geo = std::make_unique<MeshGeometry>();
-	geo->Name = "treeSpritesGeo";
+	geo->Name = "shapeGeo";
+
+	// The indices are generated straight into the CPU copy of the index buffer.
+	// The vertices go to a float staging arena first and are compressed into the
+	// CPU copy of the vertex buffer once they are optimized and the bounds of each
+	// shape are known.
+	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
+
+	struct StagingVertex
+	{
+		XMFLOAT3 Pos;
+		XMFLOAT3 Normal;
+		XMFLOAT2 TexC;
+	};
+
+	GeometryGenerator::VertexLayout layout;
+	layout.Stride = sizeof(StagingVertex);
+	layout.PositionOffset = offsetof(StagingVertex, Pos);
+	layout.NormalOffset = offsetof(StagingVertex, Normal);
+	layout.TangentOffset = GeometryGenerator::VertexLayout::NoElement;
+	layout.TexCOffset = offsetof(StagingVertex, TexC);
+
+	std::vector<StagingVertex> staging(vertexCount);
+	std::uint16_t* indices16 = static_cast<std::uint16_t*>(geo->IndexBufferCPU->GetBufferPointer());
+	geoGen.CreateBatch(levels, ranges, layout, staging.data(), indices16, mRecordThreadPool.get());
+
+	// Weld, reorder and renumber every level for the vertex cache, overdraw and
+	// vertex fetch.  Welding shrinks the vertex ranges, so the levels are packed
+	// down over the gaps it leaves.
+	UINT packedCount = 0;
+	double acmrBefore = 0.0, acmrAfter = 0.0;
+	for(GeometryGenerator::BatchRange& range : ranges)
+	{
+		std::vector<std::uint32_t> indices(indices16 + range.StartIndex, indices16 + range.StartIndex + range.IndexCount);
+
+		MeshOptimizer::Stats stats = MeshOptimizer::OptimizeMesh(indices, &staging[range.BaseVertex],
+			range.VertexCount, sizeof(StagingVertex), offsetof(StagingVertex, Pos), MeshOptimizer::DefaultOverdrawThreshold);
+
+		// The packed range starts at or below the level's own, so the two can overlap.
+		memmove(&staging[packedCount], &staging[range.BaseVertex], stats.VertexCountAfter * sizeof(StagingVertex));
+		range.BaseVertex = packedCount;
+		range.VertexCount = (UINT)stats.VertexCountAfter;
+		packedCount += range.VertexCount;
+
+		for(size_t i = 0; i < indices.size(); ++i)
+			indices16[range.StartIndex + i] = (std::uint16_t)indices[i];
+
+		acmrBefore += stats.AcmrBefore * (range.IndexCount / 3);
+		acmrAfter += stats.AcmrAfter * (range.IndexCount / 3);
+	}
 
+	std::wostringstream report;
+	report << std::fixed << std::setprecision(3) << L"shapeGeo: " << vertexCount << L" -> " << packedCount
+		<< L" vertices, ACMR " << acmrBefore / (indexCount / 3) << L" -> " << acmrAfter / (indexCount / 3) << L"\n";
+	OutputDebugString(report.str().c_str());
+
+	const UINT vbByteSize = packedCount * sizeof(Vertex);
 	ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
-	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
+	Vertex* vertices = static_cast<Vertex*>(geo->VertexBufferCPU->GetBufferPointer());
 
-	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
+	UINT level = 0;
+	for(size_t s = 0; s < _countof(shapes); ++s)
+	{
+		// The levels of a shape are consecutive in the arena.  Its bounds cover all
+		// of them, as every level is quantized within them.
+		const GeometryGenerator::BatchRange& first = ranges[level];
+		const GeometryGenerator::BatchRange& last = ranges[level + levelCounts[s] - 1];
+		const UINT shapeVertexCount = last.BaseVertex + last.VertexCount - first.BaseVertex;
+
+		SubmeshGeometry submesh;
+		BoundingBox::CreateFromPoints(submesh.Bounds, shapeVertexCount,
+			&staging[first.BaseVertex].Pos, sizeof(StagingVertex));
+
+		VertexCompression::Compress(&staging[first.BaseVertex].Pos.x, &staging[first.BaseVertex].Normal.x,
+			&staging[first.BaseVertex].TexC.x, sizeof(StagingVertex), shapeVertexCount,
+			&submesh.Bounds.Center.x, &submesh.Bounds.Extents.x, &vertices[first.BaseVertex]);
 
-	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
+		for(UINT lod = 0; lod < levelCounts[s]; ++lod, ++level)
+		{
+			const GeometryGenerator::BatchRange& range = ranges[level];
 
-	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
+			SubmeshLod args;
+			args.IndexCount = range.IndexCount;
+			args.StartIndexLocation = range.StartIndex;
+			args.BaseVertexLocation = (INT)range.BaseVertex;
 
-	geo->VertexByteStride = sizeof(TreeSpriteVertex);
+			if(lod == 0)
+			{
+				submesh.IndexCount = args.IndexCount;
+				submesh.StartIndexLocation = args.StartIndexLocation;
+				submesh.BaseVertexLocation = args.BaseVertexLocation;
+			}
+			else
+			{
+				submesh.Lods.push_back(args);
+			}
+		}
+
+		geo->DrawArgs.Add(shapes[s].Name, submesh);
+	}
+
+	geo->VertexBufferGPU = mGpuMemory->CreateBuffer(mCommandList.Get(),
+		geo->VertexBufferCPU->GetBufferPointer(), vbByteSize);
+
+	geo->IndexBufferGPU = mGpuMemory->CreateBuffer(mCommandList.Get(),
+		geo->IndexBufferCPU->GetBufferPointer(), ibByteSize);
+
+	geo->VertexByteStride = sizeof(Vertex);
 	geo->VertexBufferByteSize = vbByteSize;
 	geo->IndexFormat = DXGI_FORMAT_R16_UINT;
 	geo->IndexBufferByteSize = ibByteSize;
 
-	SubmeshGeometry submesh;
-	submesh.IndexCount = (UINT)indices.size();
-	submesh.StartIndexLocation = 0;
-	submesh.BaseVertexLocation = 0;
+	mGeometries.Add(geo->Name, std::move(*geo));
+}
+
+void LitColumnsApp::BuildSkullGeometry()
+{
+	// Models/skull.mesh is produced offline from Models/skull.txt by
+	// Tools/MeshConverter.  The file is memory mapped and its streams are
+	// uploaded in place, so there is no parsing at startup.
+	auto geo = MeshLoader::LoadMeshGeometry(mGpuMemory.get(),
+		mCommandList.Get(), L"Models/skull.mesh", "skullGeo", sizeof(Vertex));
+
+	if(geo == nullptr || !geo->DrawArgs.Contains("skull"))
+	{
+		MessageBox(0, L"Models/skull.mesh not found or invalid.", 0, 0);
+		return;
+	}
+
+	mGeometries.Add(geo->Name, std::move(*geo));
+}
+
+void LitColumnsApp::BuildTreeSprites()
+{
+	mTreeSpriteMat = mMaterials.Find("treeSprites");
+	mTreeSpriteCount = mRenderSettings.TreeCount;
+	if(mTreeSpriteCount == 0)
+		return;
+
+	// Scatter the trees over the four corners of the maze; the field grows with
+	// the tree count so the density stays that of the original 16 trees.
+	const float spread = sqrtf(mTreeSpriteCount / 16.0f);
+	const float nearEdge = 15.0f;
+	const float farEdge = nearEdge + 30.0f*spread;
+
+	std::vector<TreeSprite> sprites(mTreeSpriteCount);
+	for(auto& sprite : sprites)
+	{
+		float x = MathHelper::RandF(nearEdge, farEdge);
+		float z = MathHelper::RandF(nearEdge, farEdge);
+
+		if(MathHelper::Rand(0, 1) == 1)
+			x = -x;
+		if(MathHelper::Rand(0, 1) == 1)
+			z = -z;
+
+		// Slightly above land height.
+		sprite.Pos = XMFLOAT3(x, -5.5f + 8.0f, z);
+		sprite.Size = XMFLOAT2(5.0f, 5.0f);
+	}
+
+	mTreeSpriteBuffer = mGpuMemory->CreateBuffer(mCommandList.Get(),
+		sprites.data(), (UINT64)mTreeSpriteCount*sizeof(TreeSprite));
+
+	mVisibleTreeSprites = mGpuMemory->CreateBuffer((UINT64)mTreeSpriteCount*sizeof(UINT),
+		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COMMON);
+
+	// Six vertices, two triangles, per sprite; SpriteCull.hlsl fills in the
+	// instance count.
+	D3D12_DRAW_ARGUMENTS drawArgs = {};
+	drawArgs.VertexCountPerInstance = 6;
+	drawArgs.InstanceCount = 0;
+	drawArgs.StartVertexLocation = 0;
+	drawArgs.StartInstanceLocation = 0;
+
+	mTreeSpriteDrawTemplate = mGpuMemory->CreateBuffer(mCommandList.Get(), &drawArgs, sizeof(drawArgs));
+
+	mTreeSpriteDrawArgs = mGpuMemory->CreateBuffer(sizeof(drawArgs),
+		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COMMON);
+}
+
+void LitColumnsApp::BuildLights()
+{
+	// The ambient light, fog and three directional lights never change.  The
+	// fog fades the distant tree sprites into the clear color.
+	mLightingCB.AmbientLight = { 0.45f, 0.45f, 0.05f, 1.0f };
+	XMStoreFloat4(&mLightingCB.FogColor, Colors::LightSteelBlue);
+	mLightingCB.FogStart = 0.25f*mFarZ;
+	mLightingCB.FogRange = 0.75f*mFarZ;
+	mLightingCB.DirLightCount = gMaxDirLights;
+	mLightingCB.DirLights[0].Direction = { 0.57735f, -0.57735f, 0.57735f };
+	mLightingCB.DirLights[0].Strength = { 0.6f, 0.6f, 0.6f };
+	mLightingCB.DirLights[1].Direction = { -0.57735f, -0.57735f, 0.57735f };
+	mLightingCB.DirLights[1].Strength = { 0.3f, 0.3f, 0.3f };
+	mLightingCB.DirLights[2].Direction = { 0.0f, -0.707f, -0.707f };
+	mLightingCB.DirLights[2].Strength = { 0.15f, 0.15f, 0.15f };
+	mLightingDirty = true;
+
+	mClusterLights = mGpuMemory->CreateBuffer((UINT64)gClusterCount*gClusterStride*sizeof(UINT),
+		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COMMON);
+
+	// Torches go on top of the castle's walls, towers and props: any opaque
+	// object, apart from the ground and moat, which are too large to hold one.
+	mScene.UpdateDirtyBounds();
+
+	std::vector<UINT> holders;
+	for(const RenderItem* ri : mRitemLayer[(int)RenderLayer::Opaque])
+	{
+		const BoundingBox& bounds = mScene.WorldBounds[ri->ObjCBIndex];
+		if(MathHelper::Max(bounds.Extents.x, bounds.Extents.z) < 20.0f)
+			holders.push_back(ri->ObjCBIndex);
+	}
+
+	const UINT lightCount = holders.empty() ? 0 : mRenderSettings.LightCount;
+	mBaseLights.resize(lightCount);
+	mLightPhases.resize(lightCount);
+	for(UINT i = 0; i < lightCount; ++i)
+	{
+		const BoundingBox& bounds = mScene.WorldBounds[holders[MathHelper::Rand(0, (int)holders.size() - 1)]];
+
+		float x = bounds.Center.x + MathHelper::RandF(-bounds.Extents.x, bounds.Extents.x);
+		float z = bounds.Center.z + MathHelper::RandF(-bounds.Extents.z, bounds.Extents.z);
+		float top = bounds.Center.y + bounds.Extents.y;
+
+		float warmth = MathHelper::RandF(0.0f, 0.2f);
+
+		Light& light = mBaseLights[i];
+		light.Strength = { 1.0f, 0.55f + warmth, 0.2f + 0.5f*warmth };
+		light.FalloffStart = 1.0f;
+
+		// Every fourth light is a spot hanging above its holder and pointing down.
+		if(i % 4 == 3)
+		{
+			light.Position = { x, top + 6.0f, z };
+			light.Direction = { 0.0f, -1.0f, 0.0f };
+			light.FalloffEnd = MathHelper::RandF(12.0f, 20.0f);
+			light.SpotPower = 8.0f;
+		}
+		else
+		{
+			light.Position = { x, top + 0.5f, z };
+			light.FalloffEnd = MathHelper::RandF(6.0f, 12.0f);
+			light.SpotPower = 0.0f;
+		}
 
-	geo->DrawArgs["points"] = submesh;
+		mLightPhases[i] = MathHelper::RandF(0.0f, 2.0f*MathHelper::Pi);
+	}
 
-	mGeometries["treeSpritesGeo"] = std::move(geo);
+	mLights = mBaseLights;
 }
 
 void LitColumnsApp::BuildPSOs()
@@ -1036,9 +2600,32 @@ void LitColumnsApp::BuildPSOs()
 	opaquePsoDesc.SampleDesc.Count = m4xMsaaState ? 4 : 1;
 	opaquePsoDesc.SampleDesc.Quality = m4xMsaaState ? (m4xMsaaQuality - 1) : 0;
 	opaquePsoDesc.DSVFormat = mDepthStencilFormat;
-	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&opaquePsoDesc, IID_PPV_ARGS(&mPSOs["opaque"])));
+	ComPtr<ID3D12PipelineState> opaquePso = mPipelineLibrary->CreateGraphicsPipeline(L"opaque", opaquePsoDesc);
+	mPSOs.Add("opaque", std::move(opaquePso));
     //ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&opaquePsoDesc, IID_PPV_ARGS(&mOpaquePSO)));
 
+	//
+	// PSOs for the depth pre-pass: depth only, then the lit opaque pass shading
+	// just the fragments that match it.  Same vertex shader, so the depths are
+	// bit identical.
+	//
+	if(mRenderSettings.DepthPrepass)
+	{
+		D3D12_GRAPHICS_PIPELINE_STATE_DESC depthPrepassPsoDesc = opaquePsoDesc;
+		depthPrepassPsoDesc.PS = { nullptr, 0 };
+		depthPrepassPsoDesc.NumRenderTargets = 0;
+		depthPrepassPsoDesc.RTVFormats[0] = DXGI_FORMAT_UNKNOWN;
+		ComPtr<ID3D12PipelineState> depthPrepassPso = mPipelineLibrary->CreateGraphicsPipeline(L"depthPrepass", depthPrepassPsoDesc);
+		mDepthPrepassPSO = depthPrepassPso.Get();
+		mPSOs.Add("depthPrepass", std::move(depthPrepassPso));
+
+		D3D12_GRAPHICS_PIPELINE_STATE_DESC opaqueEqualPsoDesc = opaquePsoDesc;
+		opaqueEqualPsoDesc.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_EQUAL;
+		opaqueEqualPsoDesc.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ZERO;
+		ComPtr<ID3D12PipelineState> opaqueEqualPso = mPipelineLibrary->CreateGraphicsPipeline(L"opaqueEqual", opaqueEqualPsoDesc);
+		mPSOs.Add("opaqueEqual", std::move(opaqueEqualPso));
+	}
+
 	//
 	// PSO for transparent objects
 	//
@@ -1058,7 +2645,8 @@ void LitColumnsApp::BuildPSOs()
 	transparencyBlendDesc.RenderTargetWriteMask = D3D12_COLOR_WRITE_ENABLE_ALL;
 
 	transparentPsoDesc.BlendState.RenderTarget[0] = transparencyBlendDesc;
-	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&transparentPsoDesc, IID_PPV_ARGS(&mPSOs["transparent"])));
+	ComPtr<ID3D12PipelineState> transparentPso = mPipelineLibrary->CreateGraphicsPipeline(L"transparent", transparentPsoDesc);
+	mPSOs.Add("transparent", std::move(transparentPso));
 	
 	//
 	// PSO for alpha tested objects
@@ -1071,7 +2659,8 @@ void LitColumnsApp::BuildPSOs()
 		mShaders["alphaTestedPS"]->GetBufferSize()
 	};
 	alphaTestedPsoDesc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
-	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&alphaTestedPsoDesc, IID_PPV_ARGS(&mPSOs["alphaTested"])));
+	ComPtr<ID3D12PipelineState> alphaTestedPso = mPipelineLibrary->CreateGraphicsPipeline(L"alphaTested", alphaTestedPsoDesc);
+	mPSOs.Add("alphaTested", std::move(alphaTestedPso));
 
 	//
 	// PSO for tree sprites
@@ -1082,30 +2671,130 @@ void LitColumnsApp::BuildPSOs()
 		reinterpret_cast<BYTE*>(mShaders["treeSpriteVS"]->GetBufferPointer()),
 		mShaders["treeSpriteVS"]->GetBufferSize()
 	};
-	treeSpritePsoDesc.GS =
-	{
-		reinterpret_cast<BYTE*>(mShaders["treeSpriteGS"]->GetBufferPointer()),
-		mShaders["treeSpriteGS"]->GetBufferSize()
-	};
 	treeSpritePsoDesc.PS =
 	{
 		reinterpret_cast<BYTE*>(mShaders["treeSpritePS"]->GetBufferPointer()),
 		mShaders["treeSpritePS"]->GetBufferSize()
 	};
-	treeSpritePsoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_POINT;
-	treeSpritePsoDesc.InputLayout = { mTreeSpriteInputLayout.data(), (UINT)mTreeSpriteInputLayout.size() };
+	// The vertex shader reads the sprites itself.
+	treeSpritePsoDesc.InputLayout = { nullptr, 0 };
 	treeSpritePsoDesc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
 
-	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&treeSpritePsoDesc, IID_PPV_ARGS(&mPSOs["treeSprites"])));
+	ComPtr<ID3D12PipelineState> treeSpritesPso = mPipelineLibrary->CreateGraphicsPipeline(L"treeSprites", treeSpritePsoDesc);
+	mPSOs.Add("treeSprites", std::move(treeSpritesPso));
+
+	//
+	// PSO for the GPU culling pass
+	//
+	D3D12_COMPUTE_PIPELINE_STATE_DESC cullPsoDesc = {};
+	cullPsoDesc.pRootSignature = mCullRootSignature.Get();
+	cullPsoDesc.CS =
+	{
+		reinterpret_cast<BYTE*>(mShaders["cullCS"]->GetBufferPointer()),
+		mShaders["cullCS"]->GetBufferSize()
+	};
+	ComPtr<ID3D12PipelineState> cullPso = mPipelineLibrary->CreateComputePipeline(L"cull", cullPsoDesc);
+	mCullPSO = cullPso.Get();
+	mPSOs.Add("cull", std::move(cullPso));
+
+	D3D12_COMPUTE_PIPELINE_STATE_DESC cullOcclusionPsoDesc = cullPsoDesc;
+	cullOcclusionPsoDesc.CS =
+	{
+		reinterpret_cast<BYTE*>(mShaders["cullOcclusionCS"]->GetBufferPointer()),
+		mShaders["cullOcclusionCS"]->GetBufferSize()
+	};
+	ComPtr<ID3D12PipelineState> cullOcclusionPso = mPipelineLibrary->CreateComputePipeline(L"cullOcclusion", cullOcclusionPsoDesc);
+	mCullOcclusionPSO = cullOcclusionPso.Get();
+	mPSOs.Add("cullOcclusion", std::move(cullOcclusionPso));
+
+	D3D12_COMPUTE_PIPELINE_STATE_DESC spriteCullPsoDesc = cullPsoDesc;
+	spriteCullPsoDesc.CS =
+	{
+		reinterpret_cast<BYTE*>(mShaders["spriteCullCS"]->GetBufferPointer()),
+		mShaders["spriteCullCS"]->GetBufferSize()
+	};
+	ComPtr<ID3D12PipelineState> spriteCullPso = mPipelineLibrary->CreateComputePipeline(L"spriteCull", spriteCullPsoDesc);
+	mSpriteCullPSO = spriteCullPso.Get();
+	mPSOs.Add("spriteCull", std::move(spriteCullPso));
+
+	D3D12_COMPUTE_PIPELINE_STATE_DESC lightCullPsoDesc = cullPsoDesc;
+	lightCullPsoDesc.CS =
+	{
+		reinterpret_cast<BYTE*>(mShaders["lightCullCS"]->GetBufferPointer()),
+		mShaders["lightCullCS"]->GetBufferSize()
+	};
+	ComPtr<ID3D12PipelineState> lightCullPso = mPipelineLibrary->CreateComputePipeline(L"lightCull", lightCullPsoDesc);
+	mLightCullPSO = lightCullPso.Get();
+	mPSOs.Add("lightCull", std::move(lightCullPso));
+
+	D3D12_COMPUTE_PIPELINE_STATE_DESC hiZPsoDesc = {};
+	hiZPsoDesc.pRootSignature = mHiZRootSignature.Get();
+	hiZPsoDesc.CS =
+	{
+		reinterpret_cast<BYTE*>(mShaders["hiZCS"]->GetBufferPointer()),
+		mShaders["hiZCS"]->GetBufferSize()
+	};
+	ComPtr<ID3D12PipelineState> hiZPso = mPipelineLibrary->CreateComputePipeline(L"hiZ", hiZPsoDesc);
+	mHiZPSO = hiZPso.Get();
+	mPSOs.Add("hiZ", std::move(hiZPso));
+
+	//
+	// PSO for the upscale into the back buffer: no vertex input and no depth.
+	//
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC upscalePsoDesc = {};
+	upscalePsoDesc.pRootSignature = mUpscaleRootSignature.Get();
+	upscalePsoDesc.VS =
+	{
+		reinterpret_cast<BYTE*>(mShaders["upscaleVS"]->GetBufferPointer()),
+		mShaders["upscaleVS"]->GetBufferSize()
+	};
+	upscalePsoDesc.PS =
+	{
+		reinterpret_cast<BYTE*>(mShaders["upscalePS"]->GetBufferPointer()),
+		mShaders["upscalePS"]->GetBufferSize()
+	};
+	upscalePsoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
+	upscalePsoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
+	upscalePsoDesc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
+	upscalePsoDesc.DepthStencilState.DepthEnable = false;
+	upscalePsoDesc.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ZERO;
+	upscalePsoDesc.SampleMask = UINT_MAX;
+	upscalePsoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+	upscalePsoDesc.NumRenderTargets = 1;
+	upscalePsoDesc.RTVFormats[0] = mBackBufferFormat;
+	upscalePsoDesc.SampleDesc.Count = 1;
+	upscalePsoDesc.SampleDesc.Quality = 0;
+	upscalePsoDesc.DSVFormat = DXGI_FORMAT_UNKNOWN;
+	ComPtr<ID3D12PipelineState> upscalePso = mPipelineLibrary->CreateGraphicsPipeline(L"upscale", upscalePsoDesc);
+	mUpscalePSO = upscalePso.Get();
+	mPSOs.Add("upscale", std::move(upscalePso));
+
+	mLayerPSOs[(int)RenderLayer::Opaque] = mPSOs.Get(mRenderSettings.DepthPrepass ? "opaqueEqual" : "opaque").Get();
+	mLayerPSOs[(int)RenderLayer::AlphaTested] = mPSOs.Get("alphaTested").Get();
+	mLayerPSOs[(int)RenderLayer::AlphaTestedTreeSprites] = mPSOs.Get("treeSprites").Get();
+	mLayerPSOs[(int)RenderLayer::Transparent] = mPSOs.Get("transparent").Get();
+
+	mPipelineLibrary->Save();
 }
 
 void LitColumnsApp::BuildFrameResources()
 {
-    for(int i = 0; i < gNumFrameResources; ++i)
+    for(UINT i = 0; i < mFramePacing.FrameResourceCount; ++i)
     {
         mFrameResources.push_back(std::make_unique<FrameResource>(md3dDevice.Get(),
-            1, (UINT)mAllRitems.size(), (UINT)mMaterials.size()));
+            mParallelRecording ? mNumRecordThreads : 0));
     }
+
+	// The first frame uploads every object; leave room for that on top of the
+	// usual per-frame data.
+	const UINT64 sceneUploadBytes = (UINT64)mScene.Size() *
+		(sizeof(InstanceData) + sizeof(CullObject));
+
+	mUploadRing = std::make_unique<UploadRingBuffer>(md3dDevice.Get(),
+		gUploadRingBytesPerFrame*mFramePacing.FrameResourceCount + sceneUploadBytes);
+
+	mPassConstantBuffer = mGpuMemory->CreateBuffer(gPassConstantBufferSize,
+		D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_COMMON);
 }
 
 void LitColumnsApp::BuildDescriptorHeaps()
@@ -1113,69 +2802,155 @@ void LitColumnsApp::BuildDescriptorHeaps()
 	//
 	// Create the SRV heap.
 	//
-	D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
-	srvHeapDesc.NumDescriptors = 5;
-	srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-	srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-	ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&mSrvDescriptorHeap)));
+	mSrvHeap = std::make_unique<DescriptorHeapAllocator>(md3dDevice.Get(), gSrvHeapCapacity);
 
 	//
-	// Fill out the heap with actual descriptors.
+	// Fill out the placeholders.  The streamed texture descriptors are allocated
+	// by UpdateTextureStreaming once each texture is resident.
 	//
-	CD3DX12_CPU_DESCRIPTOR_HANDLE hDescriptor(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
+	auto whiteTex = mTextures.Get("whiteTex").Resource;
+	mWhiteArraySrvIndex = mSrvHeap->Allocate();
+	CreateTextureSrv(whiteTex.Get(), mWhiteArraySrvIndex, true);
+
+	// Both shaders sample arrays, and the white texture has one slice, so any
+	// DiffuseSlice reads it while the real texture streams in.
+	for(UINT i = 0; i < gNumTextureSlots; ++i)
+		mSrvHeapRemap[i] = mWhiteArraySrvIndex;
+
+	// Views of the depth buffer and the hierarchical-Z pyramid; see BuildHiZ.
+	if(mRenderSettings.OcclusionCulling)
+	{
+		mDepthSrvIndex = mSrvHeap->Allocate();
+		mHiZSrvIndex = mSrvHeap->Allocate();
+		for(UINT mip = 0; mip < gMaxHiZMips; ++mip)
+		{
+			mHiZMipSrvIndices[mip] = mSrvHeap->Allocate();
+			mHiZMipUavIndices[mip] = mSrvHeap->Allocate();
+		}
+	}
+
+	// View of the offscreen scene target; see BuildSceneColor.
+	if(mRenderSettings.DynamicResolution)
+		mSceneColorSrvIndex = mSrvHeap->Allocate();
+}
+
+void LitColumnsApp::BuildHiZ()
+{
+	// D3DApp::OnResize has flushed the queue, so the old pyramid can go at once.
+	mHiZ = nullptr;
+	mHiZMipCount = 0;
+	mHiZValid = false;
+
+	// Only occlusion culling reads the pyramid, which reads the depth buffer as
+	// a plain Texture2D.
+	if(!mRenderSettings.OcclusionCulling || m4xMsaaState)
+		return;
+
+	// Level 0 is half the depth buffer, rounded up, down to a single texel.
+	mHiZWidth = MathHelper::Max((UINT)(mClientWidth + 1) / 2, 1u);
+	mHiZHeight = MathHelper::Max((UINT)(mClientHeight + 1) / 2, 1u);
+	for(UINT size = MathHelper::Max(mHiZWidth, mHiZHeight); ; size = (size + 1) / 2)
+	{
+		mHiZMipCount++;
+		if(size == 1 || mHiZMipCount == gMaxHiZMips)
+			break;
+	}
+
+	D3D12_RESOURCE_DESC hiZDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R32_FLOAT,
+		mHiZWidth, mHiZHeight, 1, (UINT16)mHiZMipCount, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+	ThrowIfFailed(md3dDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&hiZDesc,
+		D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+		nullptr,
+		IID_PPV_ARGS(&mHiZ)));
+
+	D3D12_SHADER_RESOURCE_VIEW_DESC depthSrvDesc = {};
+	depthSrvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	depthSrvDesc.Format = DXGI_FORMAT_R24_UNORM_X8_TYPELESS;
+	depthSrvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+	depthSrvDesc.Texture2D.MipLevels = 1;
+	md3dDevice->CreateShaderResourceView(mDepthStencilBuffer.Get(), &depthSrvDesc, mSrvHeap->CpuHandle(mDepthSrvIndex));
+
+	D3D12_SHADER_RESOURCE_VIEW_DESC hiZSrvDesc = {};
+	hiZSrvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	hiZSrvDesc.Format = DXGI_FORMAT_R32_FLOAT;
+	hiZSrvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+	hiZSrvDesc.Texture2D.MostDetailedMip = 0;
+	hiZSrvDesc.Texture2D.MipLevels = mHiZMipCount;
+	md3dDevice->CreateShaderResourceView(mHiZ.Get(), &hiZSrvDesc, mSrvHeap->CpuHandle(mHiZSrvIndex));
+
+	for(UINT mip = 0; mip < mHiZMipCount; ++mip)
+	{
+		hiZSrvDesc.Texture2D.MostDetailedMip = mip;
+		hiZSrvDesc.Texture2D.MipLevels = 1;
+		md3dDevice->CreateShaderResourceView(mHiZ.Get(), &hiZSrvDesc, mSrvHeap->CpuHandle(mHiZMipSrvIndices[mip]));
+
+		D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+		uavDesc.Format = DXGI_FORMAT_R32_FLOAT;
+		uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
+		uavDesc.Texture2D.MipSlice = mip;
+		md3dDevice->CreateUnorderedAccessView(mHiZ.Get(), nullptr, &uavDesc, mSrvHeap->CpuHandle(mHiZMipUavIndices[mip]));
+	}
+}
+
+void LitColumnsApp::BuildSceneColor()
+{
+	// D3DApp::OnResize has flushed the queue, so the old target can go at once.
+	mSceneColor = nullptr;
+
+	// The upscale reads the scene as a plain Texture2D.
+	if(!mRenderSettings.DynamicResolution || m4xMsaaState)
+		return;
+
+	// Native size, so a new scale never reallocates; the scene only uses the top
+	// left corner.
+	D3D12_RESOURCE_DESC sceneColorDesc = CD3DX12_RESOURCE_DESC::Tex2D(mBackBufferFormat,
+		mClientWidth, mClientHeight, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET);
+
+	D3D12_CLEAR_VALUE optClear;
+	optClear.Format = mBackBufferFormat;
+	memcpy(optClear.Color, Colors::LightSteelBlue, sizeof(optClear.Color));
+
+	ThrowIfFailed(md3dDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&sceneColorDesc,
+		D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
+		&optClear,
+		IID_PPV_ARGS(&mSceneColor)));
+
+	md3dDevice->CreateRenderTargetView(mSceneColor.Get(), nullptr, SceneRenderTargetView());
+	md3dDevice->CreateShaderResourceView(mSceneColor.Get(), nullptr, mSrvHeap->CpuHandle(mSceneColorSrvIndex));
+}
+
+void LitColumnsApp::CreateTextureSrv(ID3D12Resource* resource, UINT heapIndex, bool isArray)
+{
+	D3D12_CPU_DESCRIPTOR_HANDLE hDescriptor = mSrvHeap->CpuHandle(heapIndex);
 
-	auto woodCrateTex = mTextures["woodCrateTex"]->Resource;
-	auto stoneTex = mTextures["stoneTex"]->Resource;
-	auto waterTex = mTextures["waterTex"]->Resource;
-	auto grassTex = mTextures["grassTex"]->Resource;
-	auto treeArrayTex = mTextures["treeArrayTex"]->Resource;
+	D3D12_RESOURCE_DESC texDesc = resource->GetDesc();
 
 	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
 	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc.Format = woodCrateTex->GetDesc().Format;
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MostDetailedMip = 0;
-	srvDesc.Texture2D.MipLevels = woodCrateTex->GetDesc().MipLevels;
-	srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
-	md3dDevice->CreateShaderResourceView(woodCrateTex.Get(), &srvDesc, hDescriptor);
-
-	// next descriptor
-	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
-	//desc
-	srvDesc.Texture2D.MipLevels = stoneTex->GetDesc().MipLevels;
-	srvDesc.Format = stoneTex->GetDesc().Format;
-	//upload
-	md3dDevice->CreateShaderResourceView(stoneTex.Get(), &srvDesc, hDescriptor);
-	
-	// next descriptor
-	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
-	//desc
-	srvDesc.Texture2D.MipLevels = waterTex->GetDesc().MipLevels;
-	srvDesc.Format = waterTex->GetDesc().Format;
-	//upload
-	md3dDevice->CreateShaderResourceView(waterTex.Get(), &srvDesc, hDescriptor);
-
-	// next descriptor
-	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
-	//desc
-	srvDesc.Texture2D.MipLevels = grassTex->GetDesc().MipLevels;
-	srvDesc.Format = grassTex->GetDesc().Format;
-	//upload
-	md3dDevice->CreateShaderResourceView(grassTex.Get(), &srvDesc, hDescriptor);
-
-	// next descriptor
-	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
-	//desc
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
-	srvDesc.Format = treeArrayTex->GetDesc().Format;
-	srvDesc.Texture2DArray.MostDetailedMip = 0;
-	srvDesc.Texture2DArray.MipLevels = -1;
-	srvDesc.Texture2DArray.FirstArraySlice = 0;
-	srvDesc.Texture2DArray.ArraySize = treeArrayTex->GetDesc().DepthOrArraySize;
-	//upload
-	md3dDevice->CreateShaderResourceView(treeArrayTex.Get(), &srvDesc, hDescriptor);
-	
-	
+	srvDesc.Format = texDesc.Format;
+	if(isArray)
+	{
+		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
+		srvDesc.Texture2DArray.MostDetailedMip = 0;
+		srvDesc.Texture2DArray.MipLevels = -1;
+		srvDesc.Texture2DArray.FirstArraySlice = 0;
+		srvDesc.Texture2DArray.ArraySize = texDesc.DepthOrArraySize;
+	}
+	else
+	{
+		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+		srvDesc.Texture2D.MostDetailedMip = 0;
+		srvDesc.Texture2D.MipLevels = texDesc.MipLevels;
+		srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
+	}
+
+	md3dDevice->CreateShaderResourceView(resource, &srvDesc, hDescriptor);
 }
 
 void LitColumnsApp::BuildMaterials()
@@ -1184,6 +2959,7 @@ void LitColumnsApp::BuildMaterials()
 	bricks0->Name = "bricks0";
 	bricks0->MatCBIndex = 0;
 	bricks0->DiffuseSrvHeapIndex = 0;
+	bricks0->DiffuseSlice = 0;
 	bricks0->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 	bricks0->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
 	bricks0->Roughness = 0.1f;
@@ -1224,7 +3000,7 @@ void LitColumnsApp::BuildMaterials()
 	auto skullMat = std::make_unique<Material>();
 	skullMat->Name = "skullMat";
 	skullMat->MatCBIndex = 5;
-	skullMat->DiffuseSrvHeapIndex = 5;
+	skullMat->DiffuseSrvHeapIndex = gWhiteTextureSlot;
 	skullMat->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 	skullMat->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05);
 	skullMat->Roughness = 0.3f;*/
@@ -1232,7 +3008,8 @@ void LitColumnsApp::BuildMaterials()
 	auto grassMat = std::make_unique<Material>();
 	grassMat->Name = "grassMat";
 	grassMat->MatCBIndex = 3;
-	grassMat->DiffuseSrvHeapIndex = 3;
+	grassMat->DiffuseSrvHeapIndex = 0;
+	grassMat->DiffuseSlice = 1;
 	grassMat->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 	grassMat->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05);
 	grassMat->Roughness = 0.3f;
@@ -1240,819 +3017,626 @@ void LitColumnsApp::BuildMaterials()
 	auto treeSprites = std::make_unique<Material>();
 	treeSprites->Name = "treeSprites";
 	treeSprites->MatCBIndex = 4;
-	treeSprites->DiffuseSrvHeapIndex = 4;
+	treeSprites->DiffuseSrvHeapIndex = 3;
 	treeSprites->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 	treeSprites->FresnelR0 = XMFLOAT3(0.01f, 0.01f, 0.01f);
 	treeSprites->Roughness = 0.125f;
 	
-	mMaterials["bricks0"] = std::move(bricks0);
-	mMaterials["stone0"] = std::move(stone0);
-	mMaterials["tile0"] = std::move(tile0);
-	//mMaterials["diamondMat"] = std::move(diamondMat);
-	//mMaterials["diamondMatRed"] = std::move(diamondMatRed);
-	//mMaterials["skullMat"] = std::move(skullMat);
-	mMaterials["grassMat"] = std::move(grassMat);
-	mMaterials["treeSprites"] = std::move(treeSprites);
-}
-
-void LitColumnsApp::BuildRenderItems()
-{
-	auto boxRitem = std::make_unique<RenderItem>();
-	XMStoreFloat4x4(&boxRitem->World, XMMatrixScaling(10.0f, 4.0f, 10.0f)*XMMatrixTranslation(0.0f, 2.0f, 0.0f));
-	XMStoreFloat4x4(&boxRitem->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
-	boxRitem->ObjCBIndex = 0;
-	boxRitem->Mat = mMaterials["bricks0"].get();
-	boxRitem->Geo = mGeometries["shapeGeo"].get();
-	boxRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	boxRitem->IndexCount = boxRitem->Geo->DrawArgs["box"].IndexCount;
-	boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs["box"].StartIndexLocation;
-	boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs["box"].BaseVertexLocation;
-	mRitemLayer[(int)RenderLayer::Opaque].push_back(boxRitem.get());
-	mAllRitems.push_back(std::move(boxRitem));
-
-	auto moatRitem = std::make_unique<RenderItem>();
-	XMStoreFloat4x4(&moatRitem->World, XMMatrixScaling(1.f, 1.f, .1f)*XMMatrixRotationX(XM_PI / 2)*XMMatrixTranslation(0.0f, 0.0f, 0.0f));
-	XMStoreFloat4x4(&moatRitem->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
-	moatRitem->ObjCBIndex = 1;
-	moatRitem->Mat = mMaterials["tile0"].get();
-	moatRitem->Geo = mGeometries["shapeGeo"].get();
-	moatRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	moatRitem->IndexCount = moatRitem->Geo->DrawArgs["torus"].IndexCount;
-	moatRitem->StartIndexLocation = moatRitem->Geo->DrawArgs["torus"].StartIndexLocation;
-	moatRitem->BaseVertexLocation = moatRitem->Geo->DrawArgs["torus"].BaseVertexLocation;
-	mRitemLayer[(int)RenderLayer::AlphaTested].push_back(moatRitem.get());
-	mAllRitems.push_back(std::move(moatRitem));
-
-	auto gridRitem = std::make_unique<RenderItem>();
-	//gridRitem->World = MathHelper::Identity4x4();
-	XMStoreFloat4x4(&gridRitem->World, XMMatrixScaling(4.0f, 1.0f, 4.0f)*XMMatrixRotationX(0.0f)*XMMatrixTranslation(0.0f, 0.0f, 0.0f));
-	XMStoreFloat4x4(&gridRitem->TexTransform, XMMatrixScaling(4.0f, 1.0f, 4.0f));
-	gridRitem->ObjCBIndex = 2;
-	gridRitem->Mat = mMaterials["grassMat"].get();
-	gridRitem->Geo = mGeometries["shapeGeo"].get();
-	gridRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	gridRitem->IndexCount = gridRitem->Geo->DrawArgs["grid"].IndexCount;
-	gridRitem->StartIndexLocation = gridRitem->Geo->DrawArgs["grid"].StartIndexLocation;
-	gridRitem->BaseVertexLocation = gridRitem->Geo->DrawArgs["grid"].BaseVertexLocation;
-	mRitemLayer[(int)RenderLayer::Opaque].push_back(gridRitem.get());
-	mAllRitems.push_back(std::move(gridRitem));
-
-	auto centerCylinderRitem = std::make_unique<RenderItem>();
-	XMStoreFloat4x4(&centerCylinderRitem->World, XMMatrixScaling(50.0f, 1.0f, 2.0f)*XMMatrixRotationX(0.0f)*XMMatrixTranslation(0.0f, 50.0f, 0.0f));
-	XMStoreFloat4x4(&centerCylinderRitem->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
-	centerCylinderRitem->ObjCBIndex = 3;
-	centerCylinderRitem->Mat = mMaterials["stone0"].get();
-	centerCylinderRitem->Geo = mGeometries["shapeGeo"].get();
-	centerCylinderRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	centerCylinderRitem->IndexCount = centerCylinderRitem->Geo->DrawArgs["cylinder"].IndexCount;
-	centerCylinderRitem->StartIndexLocation = centerCylinderRitem->Geo->DrawArgs["cylinder"].StartIndexLocation;
-	centerCylinderRitem->BaseVertexLocation = centerCylinderRitem->Geo->DrawArgs["cylinder"].BaseVertexLocation;
-	mRitemLayer[(int)RenderLayer::Opaque].push_back(centerCylinderRitem.get());
-	mAllRitems.push_back(std::move(centerCylinderRitem));
-
-	auto diamondRitem = std::make_unique<RenderItem>();
-	XMStoreFloat4x4(&diamondRitem->World, XMMatrixScaling(0.2f, 0.2f, 0.2f)*XMMatrixRotationX(80.5)*XMMatrixTranslation(-0.7f, 2.5f, -0.7f));
-	XMStoreFloat4x4(&diamondRitem->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
-	diamondRitem->ObjCBIndex = 4;
-	diamondRitem->Mat = mMaterials["stone0"].get();
-	diamondRitem->Geo = mGeometries["shapeGeo"].get();
-	diamondRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	diamondRitem->IndexCount = diamondRitem->Geo->DrawArgs["diamond"].IndexCount;
-	diamondRitem->StartIndexLocation = diamondRitem->Geo->DrawArgs["diamond"].StartIndexLocation;
-	diamondRitem->BaseVertexLocation = diamondRitem->Geo->DrawArgs["diamond"].BaseVertexLocation;
-	mRitemLayer[(int)RenderLayer::Opaque].push_back(diamondRitem.get());
-	mAllRitems.push_back(std::move(diamondRitem));
-
-	auto diamondLeftRitem = std::make_unique<RenderItem>();
-	XMStoreFloat4x4(&diamondLeftRitem->World, XMMatrixScaling(0.2f, 0.2f, 0.2f)*XMMatrixRotationX(80.5)*XMMatrixTranslation(0.7f, 2.5f, -0.7f));
-	XMStoreFloat4x4(&diamondLeftRitem->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
-	diamondLeftRitem->ObjCBIndex = 5;
-	diamondLeftRitem->Mat = mMaterials["stone0"].get();
-	diamondLeftRitem->Geo = mGeometries["shapeGeo"].get();
-	diamondLeftRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	diamondLeftRitem->IndexCount = diamondLeftRitem->Geo->DrawArgs["diamond"].IndexCount;
-	diamondLeftRitem->StartIndexLocation = diamondLeftRitem->Geo->DrawArgs["diamond"].StartIndexLocation;
-	diamondLeftRitem->BaseVertexLocation = diamondLeftRitem->Geo->DrawArgs["diamond"].BaseVertexLocation;
-	mRitemLayer[(int)RenderLayer::Opaque].push_back(diamondLeftRitem.get());
-	mAllRitems.push_back(std::move(diamondLeftRitem));
-
-	auto coneRitem = std::make_unique<RenderItem>();
-	XMStoreFloat4x4(&coneRitem->World, XMMatrixScaling(1.0f, 1.0f, 1.0f)*XMMatrixRotationX(0.0f)*XMMatrixTranslation(0.0f, 6.0f, 0.0f));
-	XMStoreFloat4x4(&coneRitem->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
-	coneRitem->ObjCBIndex = 6;
-	coneRitem->Mat = mMaterials["stone0"].get();
-	coneRitem->Geo = mGeometries["shapeGeo"].get();
-	coneRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	coneRitem->IndexCount = coneRitem->Geo->DrawArgs["cone"].IndexCount;
-	coneRitem->StartIndexLocation = coneRitem->Geo->DrawArgs["cone"].StartIndexLocation;
-	coneRitem->BaseVertexLocation = coneRitem->Geo->DrawArgs["cone"].BaseVertexLocation;
-	mRitemLayer[(int)RenderLayer::Opaque].push_back(coneRitem.get());
-	mAllRitems.push_back(std::move(coneRitem));
-
-	auto flagCylinderRitem = std::make_unique<RenderItem>();
-	XMStoreFloat4x4(&flagCylinderRitem->World, XMMatrixScaling(.1f, 1.0f, .1f)*XMMatrixRotationX(0.0f)*XMMatrixTranslation(0.0f, 5.0f, 0.0f));
-	XMStoreFloat4x4(&flagCylinderRitem->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
-	flagCylinderRitem->ObjCBIndex = 7;
-	flagCylinderRitem->Mat = mMaterials["stone0"].get();
-	flagCylinderRitem->Geo = mGeometries["shapeGeo"].get();
-	flagCylinderRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	flagCylinderRitem->IndexCount = flagCylinderRitem->Geo->DrawArgs["cylinder"].IndexCount;
-	flagCylinderRitem->StartIndexLocation = flagCylinderRitem->Geo->DrawArgs["cylinder"].StartIndexLocation;
-	flagCylinderRitem->BaseVertexLocation = flagCylinderRitem->Geo->DrawArgs["cylinder"].BaseVertexLocation;
-	mRitemLayer[(int)RenderLayer::Opaque].push_back(flagCylinderRitem.get());
-	mAllRitems.push_back(std::move(flagCylinderRitem));
-
-	auto flagBoxRitem = std::make_unique<RenderItem>();
-	XMStoreFloat4x4(&flagBoxRitem->World, XMMatrixScaling(1.0f, .4f, .1f)*XMMatrixRotationX(0.0f)*XMMatrixTranslation(-.5f, 7.25f, 0.0f));
-	XMStoreFloat4x4(&flagBoxRitem->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
-	flagBoxRitem->ObjCBIndex = 8;
-	flagBoxRitem->Mat = mMaterials["stone0"].get();
-	flagBoxRitem->Geo = mGeometries["shapeGeo"].get();
-	flagBoxRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	flagBoxRitem->IndexCount = flagBoxRitem->Geo->DrawArgs["box"].IndexCount;
-	flagBoxRitem->StartIndexLocation = flagBoxRitem->Geo->DrawArgs["box"].StartIndexLocation;
-	flagBoxRitem->BaseVertexLocation = flagBoxRitem->Geo->DrawArgs["box"].BaseVertexLocation;
-	mRitemLayer[(int)RenderLayer::Opaque].push_back(flagBoxRitem.get());
-	mAllRitems.push_back(std::move(flagBoxRitem));
-
-	auto doorRitem = std::make_unique<RenderItem>();
-	XMStoreFloat4x4(&doorRitem->World, XMMatrixScaling(1.f, .01, 4.f)*XMMatrixRotationX(XM_PI/2)*XMMatrixTranslation(0.0f, 0.0f, -5.0f));
-	XMStoreFloat4x4(&doorRitem->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
-	doorRitem->ObjCBIndex = 9;
-	doorRitem->Mat = mMaterials["tile0"].get();
-	doorRitem->Geo = mGeometries["shapeGeo"].get();
-	doorRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	doorRitem->IndexCount = doorRitem->Geo->DrawArgs["cylinder"].IndexCount;
-	doorRitem->StartIndexLocation = doorRitem->Geo->DrawArgs["cylinder"].StartIndexLocation;
-	doorRitem->BaseVertexLocation = doorRitem->Geo->DrawArgs["cylinder"].BaseVertexLocation;
-	mRitemLayer[(int)RenderLayer::Opaque].push_back(doorRitem.get());
-	mAllRitems.push_back(std::move(doorRitem));
-
-	auto bridgeRitem = std::make_unique<RenderItem>();
-	XMStoreFloat4x4(&bridgeRitem->World, XMMatrixScaling(1.0f, 0.04f, 10.0f)*XMMatrixRotationX(0.0f)*XMMatrixTranslation(0.0f, 0.1f, -6.0f));
-	XMStoreFloat4x4(&bridgeRitem->TexTransform, XMMatrixScaling(1.0f, .04f, 10.0f));
-	bridgeRitem->ObjCBIndex = 10;
-	bridgeRitem->Mat = mMaterials["bricks0"].get();
-	bridgeRitem->Geo = mGeometries["shapeGeo"].get();
-	bridgeRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	bridgeRitem->IndexCount = bridgeRitem->Geo->DrawArgs["box"].IndexCount;
-	bridgeRitem->StartIndexLocation = bridgeRitem->Geo->DrawArgs["box"].StartIndexLocation;
-	bridgeRitem->BaseVertexLocation = bridgeRitem->Geo->DrawArgs["box"].BaseVertexLocation;
-	mRitemLayer[(int)RenderLayer::Opaque].push_back(bridgeRitem.get());
-	mAllRitems.push_back(std::move(bridgeRitem));
-
-	auto skullRitem = std::make_unique<RenderItem>();
-	XMStoreFloat4x4(&skullRitem->World, XMMatrixScaling(0.5f, 0.5f, 0.5f)*XMMatrixTranslation(0.0f, .5f, 0.0f));
-	skullRitem->TexTransform = MathHelper::Identity4x4();
-	skullRitem->ObjCBIndex = 11;
-	skullRitem->Mat = mMaterials["stone0"].get();
-	skullRitem->Geo = mGeometries["skullGeo"].get();
-	skullRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	skullRitem->IndexCount = skullRitem->Geo->DrawArgs["skull"].IndexCount;
-	skullRitem->StartIndexLocation = skullRitem->Geo->DrawArgs["skull"].StartIndexLocation;
-	skullRitem->BaseVertexLocation = skullRitem->Geo->DrawArgs["skull"].BaseVertexLocation;
-	mRitemLayer[(int)RenderLayer::Opaque].push_back(skullRitem.get());
-	mAllRitems.push_back(std::move(skullRitem));
-
-	XMMATRIX brickTexTransform = XMMatrixScaling(1.0f, 1.0f, 1.0f);
-	UINT objCBIndex = 12;
-	for (int i = 0; i < 8; ++i)
-	{
-		auto leftPyramidRitem = std::make_unique<RenderItem>();
-		auto rightPyramidRitem = std::make_unique<RenderItem>();
-		auto backPyramidRitem = std::make_unique<RenderItem>();
-		auto frontPyramidRitem = std::make_unique<RenderItem>();
-
-		XMMATRIX leftPyramidWorld =  XMMatrixScaling(1.f, 1.f, 1.f)*XMMatrixRotationY(0.0)*XMMatrixTranslation(-4.5f, 4.5f, 3.5f - (i* 1.0f));
-		XMMATRIX rightPyramidWorld = XMMatrixScaling(1.f, 1.f, 1.f)*XMMatrixRotationY(0.0)*XMMatrixTranslation(4.5f , 4.5f, -3.5f + (i* 1.0f));
-		XMMATRIX backPyramidWorld =  XMMatrixScaling(1.f, 1.f, 1.f)*XMMatrixRotationY(0.0)*XMMatrixTranslation( -3.5f + (i* 1.0f), 4.5f, 4.5f );
-		XMMATRIX frontPyramidWorld = XMMatrixScaling(1.f, 1.f, 1.f)*XMMatrixRotationY(0.0)*XMMatrixTranslation( 3.5f - (i* 1.0f), 4.5f, -4.5f);
-		
-		XMStoreFloat4x4(&leftPyramidRitem->World, leftPyramidWorld);
-		XMStoreFloat4x4(&leftPyramidRitem->TexTransform, brickTexTransform);
-		leftPyramidRitem->ObjCBIndex = objCBIndex++;
-		leftPyramidRitem->Mat = mMaterials["stone0"].get();
-		leftPyramidRitem->Geo = mGeometries["shapeGeo"].get();
-		leftPyramidRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		leftPyramidRitem->IndexCount = leftPyramidRitem->Geo->DrawArgs["pyramid"].IndexCount;
-		leftPyramidRitem->StartIndexLocation = leftPyramidRitem->Geo->DrawArgs["pyramid"].StartIndexLocation;
-		leftPyramidRitem->BaseVertexLocation = leftPyramidRitem->Geo->DrawArgs["pyramid"].BaseVertexLocation;
-		mRitemLayer[(int)RenderLayer::Opaque].push_back(leftPyramidRitem.get());
-
-		XMStoreFloat4x4(&rightPyramidRitem->World, rightPyramidWorld);
-		XMStoreFloat4x4(&rightPyramidRitem->TexTransform, brickTexTransform);
-		rightPyramidRitem->ObjCBIndex = objCBIndex++;
-		rightPyramidRitem->Mat = mMaterials["stone0"].get();
-		rightPyramidRitem->Geo = mGeometries["shapeGeo"].get();
-		rightPyramidRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		rightPyramidRitem->IndexCount = rightPyramidRitem->Geo->DrawArgs["pyramid"].IndexCount;
-		rightPyramidRitem->StartIndexLocation = rightPyramidRitem->Geo->DrawArgs["pyramid"].StartIndexLocation;
-		rightPyramidRitem->BaseVertexLocation = rightPyramidRitem->Geo->DrawArgs["pyramid"].BaseVertexLocation;
-		mRitemLayer[(int)RenderLayer::Opaque].push_back(rightPyramidRitem.get());
-
-		XMStoreFloat4x4(&backPyramidRitem->World, backPyramidWorld);
-		XMStoreFloat4x4(&backPyramidRitem->TexTransform, brickTexTransform);
-		backPyramidRitem->ObjCBIndex = objCBIndex++;
-		backPyramidRitem->Mat = mMaterials["stone0"].get();
-		backPyramidRitem->Geo = mGeometries["shapeGeo"].get();
-		backPyramidRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		backPyramidRitem->IndexCount = backPyramidRitem->Geo->DrawArgs["pyramid"].IndexCount;
-		backPyramidRitem->StartIndexLocation = backPyramidRitem->Geo->DrawArgs["pyramid"].StartIndexLocation;
-		backPyramidRitem->BaseVertexLocation = backPyramidRitem->Geo->DrawArgs["pyramid"].BaseVertexLocation;
-		mRitemLayer[(int)RenderLayer::Opaque].push_back(backPyramidRitem.get());
-
-		XMStoreFloat4x4(&frontPyramidRitem->World, frontPyramidWorld);
-		XMStoreFloat4x4(&frontPyramidRitem->TexTransform, brickTexTransform);
-		frontPyramidRitem->ObjCBIndex = objCBIndex++;
-		frontPyramidRitem->Mat = mMaterials["stone0"].get();
-		frontPyramidRitem->Geo = mGeometries["shapeGeo"].get();
-		frontPyramidRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		frontPyramidRitem->IndexCount = frontPyramidRitem->Geo->DrawArgs["pyramid"].IndexCount;
-		frontPyramidRitem->StartIndexLocation = frontPyramidRitem->Geo->DrawArgs["pyramid"].StartIndexLocation;
-		frontPyramidRitem->BaseVertexLocation = frontPyramidRitem->Geo->DrawArgs["pyramid"].BaseVertexLocation;
-		mRitemLayer[(int)RenderLayer::Opaque].push_back(frontPyramidRitem.get());
-
-		mAllRitems.push_back(std::move(leftPyramidRitem));
-		mAllRitems.push_back(std::move(rightPyramidRitem));
-		mAllRitems.push_back(std::move(backPyramidRitem));
-		mAllRitems.push_back(std::move(frontPyramidRitem));
-	}
-
-
-//	XMMATRIX brickTexTransform = XMMatrixScaling(1.0f, 1.0f, 1.0f);
-	objCBIndex = 44;
-	for (int i = 0; i < 2; ++i)
-	{
-		auto leftCylRitem = std::make_unique<RenderItem>();
-		auto rightCylRitem = std::make_unique<RenderItem>();
-
-		auto rightWedge1Ritem = std::make_unique<RenderItem>();
-		auto rightWedge2Ritem = std::make_unique<RenderItem>();
-		auto rightWedge3Ritem = std::make_unique<RenderItem>();
-		auto rightWedge4Ritem = std::make_unique<RenderItem>();
-
-		auto leftWedge1Ritem = std::make_unique<RenderItem>();
-		auto leftWedge2Ritem = std::make_unique<RenderItem>();
-		auto leftWedge3Ritem = std::make_unique<RenderItem>();
-		auto leftWedge4Ritem = std::make_unique<RenderItem>();
-
-		auto leftSpire1Ritem = std::make_unique<RenderItem>();
-		auto leftSpire2Ritem = std::make_unique<RenderItem>();
-		auto leftSpire3Ritem = std::make_unique<RenderItem>();
-		auto leftSpire4Ritem = std::make_unique<RenderItem>();
-		auto leftSpire5Ritem = std::make_unique<RenderItem>();
-		auto leftSpire6Ritem = std::make_unique<RenderItem>();
-		auto leftSpire7Ritem = std::make_unique<RenderItem>();
-		auto leftSpire8Ritem = std::make_unique<RenderItem>();
-
-		auto rightSpire1Ritem = std::make_unique<RenderItem>();
-		auto rightSpire2Ritem = std::make_unique<RenderItem>();
-		auto rightSpire3Ritem = std::make_unique<RenderItem>();
-		auto rightSpire4Ritem = std::make_unique<RenderItem>();
-		auto rightSpire5Ritem = std::make_unique<RenderItem>();
-		auto rightSpire6Ritem = std::make_unique<RenderItem>();
-		auto rightSpire7Ritem = std::make_unique<RenderItem>();
-		auto rightSpire8Ritem = std::make_unique<RenderItem>();
-
-		XMMATRIX leftCylWorld = XMMatrixTranslation(-5.0f, 2.0f, -5.0f + i*10.0f);
-		XMMATRIX rightCylWorld = XMMatrixTranslation(+5.0f, 2.0f, -5.0f + i*10.0f);
-
-		XMMATRIX rightWedge1World = XMMatrixScaling(1.f, 1.f, 1.f)*XMMatrixRotationY(0.0f)*				XMMatrixTranslation(-5.5f, 4.0f, -5.0f + i*10.0f);
-		XMMATRIX rightWedge2World = XMMatrixScaling(1.f, 1.f, 1.f)*XMMatrixRotationY(XM_PI / 2)*		XMMatrixTranslation(-5.0f, 4.0f, -4.5f + i*10.0f);
-		XMMATRIX rightWedge3World = XMMatrixScaling(1.f, 1.f, 1.f)*XMMatrixRotationY(XM_PI)*			XMMatrixTranslation(-4.5f, 4.0f, -5.0f + i*10.0f);
-		XMMATRIX rightWedge4World = XMMatrixScaling(1.f, 1.f, 1.f)*XMMatrixRotationY(XM_PI + XM_PI / 2)*XMMatrixTranslation(-5.0f, 4.0f, -5.5f + i*10.0f);
-
-		XMMATRIX leftWedge1World = XMMatrixScaling(1.f, 1.f, 1.f)*XMMatrixRotationY(0.0f)*XMMatrixTranslation(4.5f, 4.0f, -5.0f + i*10.0f);
-		XMMATRIX leftWedge2World = XMMatrixScaling(1.f, 1.f, 1.f)*XMMatrixRotationY(XM_PI / 2)*XMMatrixTranslation(5.0f, 4.0f, -4.5f + i*10.0f);
-		XMMATRIX leftWedge3World = XMMatrixScaling(1.f, 1.f, 1.f)*XMMatrixRotationY(XM_PI)*XMMatrixTranslation(5.5f, 4.0f, -5.0f + i*10.0f);
-		XMMATRIX leftWedge4World = XMMatrixScaling(1.f, 1.f, 1.f)*XMMatrixRotationY(XM_PI + XM_PI / 2)*XMMatrixTranslation(5.0f, 4.0f, -5.5f + i*10.0f);
-
-		XMMATRIX rightSpire1World = XMMatrixScaling(.25f, .5f, .25f)*XMMatrixRotationY(0.0f)*XMMatrixTranslation(-4.25f, 4.75f, -5.25f + i*10.0f);
-		XMMATRIX rightSpire2World = XMMatrixScaling(.25f, .5f, .25f)*XMMatrixRotationY(0.0f)*XMMatrixTranslation(-4.25f, 4.75f, -4.75f + i*10.0f);
-		XMMATRIX rightSpire3World = XMMatrixScaling(.25f, .5f, .25f)*XMMatrixRotationY(0.0f)*XMMatrixTranslation(-5.25f, 4.75f, -5.75f + i*10.0f);
-		XMMATRIX rightSpire4World = XMMatrixScaling(.25f, .5f, .25f)*XMMatrixRotationY(0.0f)*XMMatrixTranslation(-4.75f, 4.75f, -5.75f + i*10.0f);
-		XMMATRIX rightSpire5World = XMMatrixScaling(.25f, .5f, .25f)*XMMatrixRotationY(0.0f)*XMMatrixTranslation(-5.75f, 4.75f, -5.25f + i*10.0f);
-		XMMATRIX rightSpire6World = XMMatrixScaling(.25f, .5f, .25f)*XMMatrixRotationY(0.0f)*XMMatrixTranslation(-5.75f, 4.75f, -4.75f + i*10.0f);
-		XMMATRIX rightSpire7World = XMMatrixScaling(.25f, .5f, .25f)*XMMatrixRotationY(0.0f)*XMMatrixTranslation(-5.25f, 4.75f, -4.25f + i*10.0f);
-		XMMATRIX rightSpire8World = XMMatrixScaling(.25f, .5f, .25f)*XMMatrixRotationY(0.0f)*XMMatrixTranslation(-4.75f, 4.75f, -4.25f + i*10.0f);
-
-		XMMATRIX leftSpire1World = XMMatrixScaling(.25f, .5f, .25f)*XMMatrixRotationY(0.0f)*XMMatrixTranslation(4.25f, 4.75f, -5.25f + i*10.0f);
-		XMMATRIX leftSpire2World = XMMatrixScaling(.25f, .5f, .25f)*XMMatrixRotationY(0.0f)*XMMatrixTranslation(4.25f, 4.75f, -4.75f + i*10.0f);
-		XMMATRIX leftSpire3World = XMMatrixScaling(.25f, .5f, .25f)*XMMatrixRotationY(0.0f)*XMMatrixTranslation(5.25f, 4.75f, -5.75f + i*10.0f);
-		XMMATRIX leftSpire4World = XMMatrixScaling(.25f, .5f, .25f)*XMMatrixRotationY(0.0f)*XMMatrixTranslation(4.75f, 4.75f, -5.75f + i*10.0f);
-		XMMATRIX leftSpire5World = XMMatrixScaling(.25f, .5f, .25f)*XMMatrixRotationY(0.0f)*XMMatrixTranslation(5.75f, 4.75f, -5.25f + i*10.0f);
-		XMMATRIX leftSpire6World = XMMatrixScaling(.25f, .5f, .25f)*XMMatrixRotationY(0.0f)*XMMatrixTranslation(5.75f, 4.75f, -4.75f + i*10.0f);
-		XMMATRIX leftSpire7World = XMMatrixScaling(.25f, .5f, .25f)*XMMatrixRotationY(0.0f)*XMMatrixTranslation(5.25f, 4.75f, -4.25f + i*10.0f);
-		XMMATRIX leftSpire8World = XMMatrixScaling(.25f, .5f, .25f)*XMMatrixRotationY(0.0f)*XMMatrixTranslation(4.75f, 4.75f, -4.25f + i*10.0f);
-
-
-		XMStoreFloat4x4(&rightWedge1Ritem->World, rightWedge1World);
-		XMStoreFloat4x4(&rightWedge1Ritem->TexTransform, brickTexTransform);
-		rightWedge1Ritem->ObjCBIndex = objCBIndex++;
-		rightWedge1Ritem->Mat = mMaterials["stone0"].get();
-		rightWedge1Ritem->Geo = mGeometries["shapeGeo"].get();
-		rightWedge1Ritem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		rightWedge1Ritem->IndexCount = rightWedge1Ritem->Geo->DrawArgs["wedge"].IndexCount;
-		rightWedge1Ritem->StartIndexLocation = rightWedge1Ritem->Geo->DrawArgs["wedge"].StartIndexLocation;
-		rightWedge1Ritem->BaseVertexLocation = rightWedge1Ritem->Geo->DrawArgs["wedge"].BaseVertexLocation;
-		mRitemLayer[(int)RenderLayer::Opaque].push_back(rightWedge1Ritem.get());
-
-		XMStoreFloat4x4(&rightWedge2Ritem->World, rightWedge2World);
-		XMStoreFloat4x4(&rightWedge2Ritem->TexTransform, brickTexTransform);
-		rightWedge2Ritem->ObjCBIndex = objCBIndex++;
-		rightWedge2Ritem->Mat = mMaterials["stone0"].get();
-		rightWedge2Ritem->Geo = mGeometries["shapeGeo"].get();
-		rightWedge2Ritem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		rightWedge2Ritem->IndexCount = rightWedge2Ritem->Geo->DrawArgs["wedge"].IndexCount;
-		rightWedge2Ritem->StartIndexLocation = rightWedge2Ritem->Geo->DrawArgs["wedge"].StartIndexLocation;
-		rightWedge2Ritem->BaseVertexLocation = rightWedge2Ritem->Geo->DrawArgs["wedge"].BaseVertexLocation;
-		mRitemLayer[(int)RenderLayer::Opaque].push_back(rightWedge2Ritem.get());
-
-		XMStoreFloat4x4(&rightWedge3Ritem->World, rightWedge3World);
-		XMStoreFloat4x4(&rightWedge3Ritem->TexTransform, brickTexTransform);
-		rightWedge3Ritem->ObjCBIndex = objCBIndex++;
-		rightWedge3Ritem->Mat = mMaterials["stone0"].get();
-		rightWedge3Ritem->Geo = mGeometries["shapeGeo"].get();
-		rightWedge3Ritem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		rightWedge3Ritem->IndexCount = rightWedge3Ritem->Geo->DrawArgs["wedge"].IndexCount;
-		rightWedge3Ritem->StartIndexLocation = rightWedge3Ritem->Geo->DrawArgs["wedge"].StartIndexLocation;
-		rightWedge3Ritem->BaseVertexLocation = rightWedge3Ritem->Geo->DrawArgs["wedge"].BaseVertexLocation;
-		mRitemLayer[(int)RenderLayer::Opaque].push_back(rightWedge3Ritem.get());
-
-		XMStoreFloat4x4(&rightWedge4Ritem->World, rightWedge4World);
-		XMStoreFloat4x4(&rightWedge4Ritem->TexTransform, brickTexTransform);
-		rightWedge4Ritem->ObjCBIndex = objCBIndex++;
-		rightWedge4Ritem->Mat = mMaterials["stone0"].get();
-		rightWedge4Ritem->Geo = mGeometries["shapeGeo"].get();
-		rightWedge4Ritem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		rightWedge4Ritem->IndexCount = rightWedge4Ritem->Geo->DrawArgs["wedge"].IndexCount;
-		rightWedge4Ritem->StartIndexLocation = rightWedge4Ritem->Geo->DrawArgs["wedge"].StartIndexLocation;
-		rightWedge4Ritem->BaseVertexLocation = rightWedge4Ritem->Geo->DrawArgs["wedge"].BaseVertexLocation;
-		mRitemLayer[(int)RenderLayer::Opaque].push_back(rightWedge4Ritem.get());
-
-		XMStoreFloat4x4(&leftWedge1Ritem->World, leftWedge1World);
-		XMStoreFloat4x4(&leftWedge1Ritem->TexTransform, brickTexTransform);
-		leftWedge1Ritem->ObjCBIndex = objCBIndex++;
-		leftWedge1Ritem->Mat = mMaterials["stone0"].get();
-		leftWedge1Ritem->Geo = mGeometries["shapeGeo"].get();
-		leftWedge1Ritem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		leftWedge1Ritem->IndexCount = leftWedge1Ritem->Geo->DrawArgs["wedge"].IndexCount;
-		leftWedge1Ritem->StartIndexLocation = leftWedge1Ritem->Geo->DrawArgs["wedge"].StartIndexLocation;
-		leftWedge1Ritem->BaseVertexLocation = leftWedge1Ritem->Geo->DrawArgs["wedge"].BaseVertexLocation;
-		mRitemLayer[(int)RenderLayer::Opaque].push_back(leftWedge1Ritem.get());
-
-		XMStoreFloat4x4(&leftWedge2Ritem->World, leftWedge2World);
-		XMStoreFloat4x4(&leftWedge2Ritem->TexTransform, brickTexTransform);
-		leftWedge2Ritem->ObjCBIndex = objCBIndex++;
-		leftWedge2Ritem->Mat = mMaterials["stone0"].get();
-		leftWedge2Ritem->Geo = mGeometries["shapeGeo"].get();
-		leftWedge2Ritem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		leftWedge2Ritem->IndexCount = leftWedge2Ritem->Geo->DrawArgs["wedge"].IndexCount;
-		leftWedge2Ritem->StartIndexLocation = leftWedge2Ritem->Geo->DrawArgs["wedge"].StartIndexLocation;
-		leftWedge2Ritem->BaseVertexLocation = leftWedge2Ritem->Geo->DrawArgs["wedge"].BaseVertexLocation;
-		mRitemLayer[(int)RenderLayer::Opaque].push_back(leftWedge2Ritem.get());
-
-		XMStoreFloat4x4(&leftWedge3Ritem->World, leftWedge3World);
-		XMStoreFloat4x4(&leftWedge3Ritem->TexTransform, brickTexTransform);
-		leftWedge3Ritem->ObjCBIndex = objCBIndex++;
-		leftWedge3Ritem->Mat = mMaterials["stone0"].get();
-		leftWedge3Ritem->Geo = mGeometries["shapeGeo"].get();
-		leftWedge3Ritem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		leftWedge3Ritem->IndexCount = leftWedge3Ritem->Geo->DrawArgs["wedge"].IndexCount;
-		leftWedge3Ritem->StartIndexLocation = leftWedge3Ritem->Geo->DrawArgs["wedge"].StartIndexLocation;
-		leftWedge3Ritem->BaseVertexLocation = leftWedge3Ritem->Geo->DrawArgs["wedge"].BaseVertexLocation;
-		mRitemLayer[(int)RenderLayer::Opaque].push_back(leftWedge3Ritem.get());
-
-		XMStoreFloat4x4(&leftWedge4Ritem->World, leftWedge4World);
-		XMStoreFloat4x4(&leftWedge4Ritem->TexTransform, brickTexTransform);
-		leftWedge4Ritem->ObjCBIndex = objCBIndex++;
-		leftWedge4Ritem->Mat = mMaterials["stone0"].get();
-		leftWedge4Ritem->Geo = mGeometries["shapeGeo"].get();
-		leftWedge4Ritem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		leftWedge4Ritem->IndexCount = leftWedge4Ritem->Geo->DrawArgs["wedge"].IndexCount;
-		leftWedge4Ritem->StartIndexLocation = leftWedge4Ritem->Geo->DrawArgs["wedge"].StartIndexLocation;
-		leftWedge4Ritem->BaseVertexLocation = leftWedge4Ritem->Geo->DrawArgs["wedge"].BaseVertexLocation;
-		mRitemLayer[(int)RenderLayer::Opaque].push_back(leftWedge4Ritem.get());
-
-		XMStoreFloat4x4(&leftSpire1Ritem->World, leftSpire1World);
-		XMStoreFloat4x4(&leftSpire1Ritem->TexTransform, brickTexTransform);
-		leftSpire1Ritem->ObjCBIndex = objCBIndex++;
-		leftSpire1Ritem->Mat = mMaterials["stone0"].get();
-		leftSpire1Ritem->Geo = mGeometries["shapeGeo"].get();
-		leftSpire1Ritem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		leftSpire1Ritem->IndexCount = leftSpire1Ritem->Geo->DrawArgs["box"].IndexCount;
-		leftSpire1Ritem->StartIndexLocation = leftSpire1Ritem->Geo->DrawArgs["box"].StartIndexLocation;
-		leftSpire1Ritem->BaseVertexLocation = leftSpire1Ritem->Geo->DrawArgs["box"].BaseVertexLocation;
-		mRitemLayer[(int)RenderLayer::Opaque].push_back(leftSpire1Ritem.get());
-
-		XMStoreFloat4x4(&leftSpire2Ritem->World, leftSpire2World);
-		XMStoreFloat4x4(&leftSpire2Ritem->TexTransform, brickTexTransform);
-		leftSpire2Ritem->ObjCBIndex = objCBIndex++;
-		leftSpire2Ritem->Mat = mMaterials["stone0"].get();
-		leftSpire2Ritem->Geo = mGeometries["shapeGeo"].get();
-		leftSpire2Ritem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		leftSpire2Ritem->IndexCount = leftSpire2Ritem->Geo->DrawArgs["box"].IndexCount;
-		leftSpire2Ritem->StartIndexLocation = leftSpire2Ritem->Geo->DrawArgs["box"].StartIndexLocation;
-		leftSpire2Ritem->BaseVertexLocation = leftSpire2Ritem->Geo->DrawArgs["box"].BaseVertexLocation;
-		mRitemLayer[(int)RenderLayer::Opaque].push_back(leftSpire2Ritem.get());
-
-		XMStoreFloat4x4(&leftSpire3Ritem->World, leftSpire3World);
-		XMStoreFloat4x4(&leftSpire3Ritem->TexTransform, brickTexTransform);
-		leftSpire3Ritem->ObjCBIndex = objCBIndex++;
-		leftSpire3Ritem->Mat = mMaterials["stone0"].get();
-		leftSpire3Ritem->Geo = mGeometries["shapeGeo"].get();
-		leftSpire3Ritem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		leftSpire3Ritem->IndexCount = leftSpire3Ritem->Geo->DrawArgs["box"].IndexCount;
-		leftSpire3Ritem->StartIndexLocation = leftSpire3Ritem->Geo->DrawArgs["box"].StartIndexLocation;
-		leftSpire3Ritem->BaseVertexLocation = leftSpire3Ritem->Geo->DrawArgs["box"].BaseVertexLocation;
-		mRitemLayer[(int)RenderLayer::Opaque].push_back(leftSpire3Ritem.get());
-
-		XMStoreFloat4x4(&leftSpire4Ritem->World, leftSpire4World);
-		XMStoreFloat4x4(&leftSpire4Ritem->TexTransform, brickTexTransform);
-		leftSpire4Ritem->ObjCBIndex = objCBIndex++;
-		leftSpire4Ritem->Mat = mMaterials["stone0"].get();
-		leftSpire4Ritem->Geo = mGeometries["shapeGeo"].get();
-		leftSpire4Ritem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		leftSpire4Ritem->IndexCount = leftSpire4Ritem->Geo->DrawArgs["box"].IndexCount;
-		leftSpire4Ritem->StartIndexLocation = leftSpire4Ritem->Geo->DrawArgs["box"].StartIndexLocation;
-		leftSpire4Ritem->BaseVertexLocation = leftSpire4Ritem->Geo->DrawArgs["box"].BaseVertexLocation;
-		mRitemLayer[(int)RenderLayer::Opaque].push_back(leftSpire4Ritem.get());
-
-		XMStoreFloat4x4(&leftSpire5Ritem->World, leftSpire5World);
-		XMStoreFloat4x4(&leftSpire5Ritem->TexTransform, brickTexTransform);
-		leftSpire5Ritem->ObjCBIndex = objCBIndex++;
-		leftSpire5Ritem->Mat = mMaterials["stone0"].get();
-		leftSpire5Ritem->Geo = mGeometries["shapeGeo"].get();
-		leftSpire5Ritem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		leftSpire5Ritem->IndexCount = leftSpire5Ritem->Geo->DrawArgs["box"].IndexCount;
-		leftSpire5Ritem->StartIndexLocation = leftSpire5Ritem->Geo->DrawArgs["box"].StartIndexLocation;
-		leftSpire5Ritem->BaseVertexLocation = leftSpire5Ritem->Geo->DrawArgs["box"].BaseVertexLocation;
-		mRitemLayer[(int)RenderLayer::Opaque].push_back(leftSpire5Ritem.get());
-
-		XMStoreFloat4x4(&leftSpire6Ritem->World, leftSpire6World);
-		XMStoreFloat4x4(&leftSpire6Ritem->TexTransform, brickTexTransform);
-		leftSpire6Ritem->ObjCBIndex = objCBIndex++;
-		leftSpire6Ritem->Mat = mMaterials["stone0"].get();
-		leftSpire6Ritem->Geo = mGeometries["shapeGeo"].get();
-		leftSpire6Ritem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		leftSpire6Ritem->IndexCount = leftSpire6Ritem->Geo->DrawArgs["box"].IndexCount;
-		leftSpire6Ritem->StartIndexLocation = leftSpire6Ritem->Geo->DrawArgs["box"].StartIndexLocation;
-		leftSpire6Ritem->BaseVertexLocation = leftSpire6Ritem->Geo->DrawArgs["box"].BaseVertexLocation;
-		mRitemLayer[(int)RenderLayer::Opaque].push_back(leftSpire6Ritem.get());
-
-		XMStoreFloat4x4(&leftSpire7Ritem->World, leftSpire7World);
-		XMStoreFloat4x4(&leftSpire7Ritem->TexTransform, brickTexTransform);
-		leftSpire7Ritem->ObjCBIndex = objCBIndex++;
-		leftSpire7Ritem->Mat = mMaterials["stone0"].get();
-		leftSpire7Ritem->Geo = mGeometries["shapeGeo"].get();
-		leftSpire7Ritem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		leftSpire7Ritem->IndexCount = leftSpire7Ritem->Geo->DrawArgs["box"].IndexCount;
-		leftSpire7Ritem->StartIndexLocation = leftSpire7Ritem->Geo->DrawArgs["box"].StartIndexLocation;
-		leftSpire7Ritem->BaseVertexLocation = leftSpire7Ritem->Geo->DrawArgs["box"].BaseVertexLocation;
-		mRitemLayer[(int)RenderLayer::Opaque].push_back(leftSpire7Ritem.get());
-
-		XMStoreFloat4x4(&leftSpire8Ritem->World, leftSpire8World);
-		XMStoreFloat4x4(&leftSpire8Ritem->TexTransform, brickTexTransform);
-		leftSpire8Ritem->ObjCBIndex = objCBIndex++;
-		leftSpire8Ritem->Mat = mMaterials["stone0"].get();
-		leftSpire8Ritem->Geo = mGeometries["shapeGeo"].get();
-		leftSpire8Ritem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		leftSpire8Ritem->IndexCount = leftSpire8Ritem->Geo->DrawArgs["box"].IndexCount;
-		leftSpire8Ritem->StartIndexLocation = leftSpire8Ritem->Geo->DrawArgs["box"].StartIndexLocation;
-		leftSpire8Ritem->BaseVertexLocation = leftSpire8Ritem->Geo->DrawArgs["box"].BaseVertexLocation;
-		mRitemLayer[(int)RenderLayer::Opaque].push_back(leftSpire8Ritem.get());
-
-		XMStoreFloat4x4(&rightSpire1Ritem->World, rightSpire1World);
-		XMStoreFloat4x4(&rightSpire1Ritem->TexTransform, brickTexTransform);
-		rightSpire1Ritem->ObjCBIndex = objCBIndex++;
-		rightSpire1Ritem->Mat = mMaterials["stone0"].get();
-		rightSpire1Ritem->Geo = mGeometries["shapeGeo"].get();
-		rightSpire1Ritem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		rightSpire1Ritem->IndexCount = rightSpire1Ritem->Geo->DrawArgs["box"].IndexCount;
-		rightSpire1Ritem->StartIndexLocation = rightSpire1Ritem->Geo->DrawArgs["box"].StartIndexLocation;
-		rightSpire1Ritem->BaseVertexLocation = rightSpire1Ritem->Geo->DrawArgs["box"].BaseVertexLocation;
-		mRitemLayer[(int)RenderLayer::Opaque].push_back(rightSpire1Ritem.get());
-
-		XMStoreFloat4x4(&rightSpire2Ritem->World, rightSpire2World);
-		XMStoreFloat4x4(&rightSpire2Ritem->TexTransform, brickTexTransform);
-		rightSpire2Ritem->ObjCBIndex = objCBIndex++;
-		rightSpire2Ritem->Mat = mMaterials["stone0"].get();
-		rightSpire2Ritem->Geo = mGeometries["shapeGeo"].get();
-		rightSpire2Ritem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		rightSpire2Ritem->IndexCount = rightSpire2Ritem->Geo->DrawArgs["box"].IndexCount;
-		rightSpire2Ritem->StartIndexLocation = rightSpire2Ritem->Geo->DrawArgs["box"].StartIndexLocation;
-		rightSpire2Ritem->BaseVertexLocation = rightSpire2Ritem->Geo->DrawArgs["box"].BaseVertexLocation;
-		mRitemLayer[(int)RenderLayer::Opaque].push_back(rightSpire2Ritem.get());
-
-		XMStoreFloat4x4(&rightSpire3Ritem->World, rightSpire3World);
-		XMStoreFloat4x4(&rightSpire3Ritem->TexTransform, brickTexTransform);
-		rightSpire3Ritem->ObjCBIndex = objCBIndex++;
-		rightSpire3Ritem->Mat = mMaterials["stone0"].get();
-		rightSpire3Ritem->Geo = mGeometries["shapeGeo"].get();
-		rightSpire3Ritem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		rightSpire3Ritem->IndexCount = rightSpire3Ritem->Geo->DrawArgs["box"].IndexCount;
-		rightSpire3Ritem->StartIndexLocation = rightSpire3Ritem->Geo->DrawArgs["box"].StartIndexLocation;
-		rightSpire3Ritem->BaseVertexLocation = rightSpire3Ritem->Geo->DrawArgs["box"].BaseVertexLocation;
-		mRitemLayer[(int)RenderLayer::Opaque].push_back(rightSpire3Ritem.get());
-
-		XMStoreFloat4x4(&rightSpire4Ritem->World, rightSpire4World);
-		XMStoreFloat4x4(&rightSpire4Ritem->TexTransform, brickTexTransform);
-		rightSpire4Ritem->ObjCBIndex = objCBIndex++;
-		rightSpire4Ritem->Mat = mMaterials["stone0"].get();
-		rightSpire4Ritem->Geo = mGeometries["shapeGeo"].get();
-		rightSpire4Ritem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		rightSpire4Ritem->IndexCount = rightSpire4Ritem->Geo->DrawArgs["box"].IndexCount;
-		rightSpire4Ritem->StartIndexLocation = rightSpire4Ritem->Geo->DrawArgs["box"].StartIndexLocation;
-		rightSpire4Ritem->BaseVertexLocation = rightSpire4Ritem->Geo->DrawArgs["box"].BaseVertexLocation;
-		mRitemLayer[(int)RenderLayer::Opaque].push_back(rightSpire4Ritem.get());
-
-		XMStoreFloat4x4(&rightSpire5Ritem->World, rightSpire5World);
-		XMStoreFloat4x4(&rightSpire5Ritem->TexTransform, brickTexTransform);
-		rightSpire5Ritem->ObjCBIndex = objCBIndex++;
-		rightSpire5Ritem->Mat = mMaterials["stone0"].get();
-		rightSpire5Ritem->Geo = mGeometries["shapeGeo"].get();
-		rightSpire5Ritem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		rightSpire5Ritem->IndexCount = rightSpire5Ritem->Geo->DrawArgs["box"].IndexCount;
-		rightSpire5Ritem->StartIndexLocation = rightSpire5Ritem->Geo->DrawArgs["box"].StartIndexLocation;
-		rightSpire5Ritem->BaseVertexLocation = rightSpire5Ritem->Geo->DrawArgs["box"].BaseVertexLocation;
-		mRitemLayer[(int)RenderLayer::Opaque].push_back(rightSpire5Ritem.get());
-
-		XMStoreFloat4x4(&rightSpire6Ritem->World, rightSpire6World);
-		XMStoreFloat4x4(&rightSpire6Ritem->TexTransform, brickTexTransform);
-		rightSpire6Ritem->ObjCBIndex = objCBIndex++;
-		rightSpire6Ritem->Mat = mMaterials["stone0"].get();
-		rightSpire6Ritem->Geo = mGeometries["shapeGeo"].get();
-		rightSpire6Ritem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		rightSpire6Ritem->IndexCount = rightSpire6Ritem->Geo->DrawArgs["box"].IndexCount;
-		rightSpire6Ritem->StartIndexLocation = rightSpire6Ritem->Geo->DrawArgs["box"].StartIndexLocation;
-		rightSpire6Ritem->BaseVertexLocation = rightSpire6Ritem->Geo->DrawArgs["box"].BaseVertexLocation;
-		mRitemLayer[(int)RenderLayer::Opaque].push_back(rightSpire6Ritem.get());
-
-		XMStoreFloat4x4(&rightSpire7Ritem->World, rightSpire7World);
-		XMStoreFloat4x4(&rightSpire7Ritem->TexTransform, brickTexTransform);
-		rightSpire7Ritem->ObjCBIndex = objCBIndex++;
-		rightSpire7Ritem->Mat = mMaterials["stone0"].get();
-		rightSpire7Ritem->Geo = mGeometries["shapeGeo"].get();
-		rightSpire7Ritem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		rightSpire7Ritem->IndexCount = rightSpire7Ritem->Geo->DrawArgs["box"].IndexCount;
-		rightSpire7Ritem->StartIndexLocation = rightSpire7Ritem->Geo->DrawArgs["box"].StartIndexLocation;
-		rightSpire7Ritem->BaseVertexLocation = rightSpire7Ritem->Geo->DrawArgs["box"].BaseVertexLocation;
-		mRitemLayer[(int)RenderLayer::Opaque].push_back(rightSpire7Ritem.get());
-
-		XMStoreFloat4x4(&rightSpire8Ritem->World, rightSpire8World);
-		XMStoreFloat4x4(&rightSpire8Ritem->TexTransform, brickTexTransform);
-		rightSpire8Ritem->ObjCBIndex = objCBIndex++;
-		rightSpire8Ritem->Mat = mMaterials["stone0"].get();
-		rightSpire8Ritem->Geo = mGeometries["shapeGeo"].get();
-		rightSpire8Ritem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		rightSpire8Ritem->IndexCount = rightSpire8Ritem->Geo->DrawArgs["box"].IndexCount;
-		rightSpire8Ritem->StartIndexLocation = rightSpire8Ritem->Geo->DrawArgs["box"].StartIndexLocation;
-		rightSpire8Ritem->BaseVertexLocation = rightSpire8Ritem->Geo->DrawArgs["box"].BaseVertexLocation;
-		mRitemLayer[(int)RenderLayer::Opaque].push_back(rightSpire8Ritem.get());
-
-		XMStoreFloat4x4(&leftCylRitem->World, rightCylWorld);
-		XMStoreFloat4x4(&leftCylRitem->TexTransform, brickTexTransform);
-		leftCylRitem->ObjCBIndex = objCBIndex++;
-		leftCylRitem->Mat = mMaterials["stone0"].get();
-		leftCylRitem->Geo = mGeometries["shapeGeo"].get();
-		leftCylRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		leftCylRitem->IndexCount = leftCylRitem->Geo->DrawArgs["cylinder"].IndexCount;
-		leftCylRitem->StartIndexLocation = leftCylRitem->Geo->DrawArgs["cylinder"].StartIndexLocation;
-		leftCylRitem->BaseVertexLocation = leftCylRitem->Geo->DrawArgs["cylinder"].BaseVertexLocation;
-		mRitemLayer[(int)RenderLayer::Opaque].push_back(leftCylRitem.get());
-
-		XMStoreFloat4x4(&rightCylRitem->World, leftCylWorld);
-		XMStoreFloat4x4(&rightCylRitem->TexTransform, brickTexTransform);
-		rightCylRitem->ObjCBIndex = objCBIndex++;
-		rightCylRitem->Mat = mMaterials["stone0"].get();
-		rightCylRitem->Geo = mGeometries["shapeGeo"].get();
-		rightCylRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		rightCylRitem->IndexCount = rightCylRitem->Geo->DrawArgs["cylinder"].IndexCount;
-		rightCylRitem->StartIndexLocation = rightCylRitem->Geo->DrawArgs["cylinder"].StartIndexLocation;
-		rightCylRitem->BaseVertexLocation = rightCylRitem->Geo->DrawArgs["cylinder"].BaseVertexLocation;
-		mRitemLayer[(int)RenderLayer::Opaque].push_back(rightCylRitem.get());
-
-		mAllRitems.push_back(std::move(rightWedge1Ritem));
-		mAllRitems.push_back(std::move(rightWedge2Ritem));
-		mAllRitems.push_back(std::move(rightWedge3Ritem));
-		mAllRitems.push_back(std::move(rightWedge4Ritem));
-		mAllRitems.push_back(std::move(leftWedge1Ritem));
-		mAllRitems.push_back(std::move(leftWedge2Ritem));
-		mAllRitems.push_back(std::move(leftWedge3Ritem));
-		mAllRitems.push_back(std::move(leftWedge4Ritem));
-		mAllRitems.push_back(std::move(leftSpire1Ritem));
-		mAllRitems.push_back(std::move(leftSpire2Ritem));
-		mAllRitems.push_back(std::move(leftSpire3Ritem));
-		mAllRitems.push_back(std::move(leftSpire4Ritem));
-		mAllRitems.push_back(std::move(leftSpire5Ritem));
-		mAllRitems.push_back(std::move(leftSpire6Ritem));
-		mAllRitems.push_back(std::move(leftSpire7Ritem));
-		mAllRitems.push_back(std::move(leftSpire8Ritem));
-		mAllRitems.push_back(std::move(rightSpire1Ritem));
-		mAllRitems.push_back(std::move(rightSpire2Ritem));
-		mAllRitems.push_back(std::move(rightSpire3Ritem));
-		mAllRitems.push_back(std::move(rightSpire4Ritem));
-		mAllRitems.push_back(std::move(rightSpire5Ritem));
-		mAllRitems.push_back(std::move(rightSpire6Ritem));
-		mAllRitems.push_back(std::move(rightSpire7Ritem));
-		mAllRitems.push_back(std::move(rightSpire8Ritem));
-		mAllRitems.push_back(std::move(leftCylRitem));
-		mAllRitems.push_back(std::move(rightCylRitem));
-	}
-
-	objCBIndex = 44 + 52;
-	float offset = 0;
-	
-	float scale = 5.0f;
-	float wallWidth = 0.5f;
-	int steps = 6;
-	float outterOffset = scale * steps;
-	
-	float vert;
-	float hor;
+	mMaterials.Add("bricks0", std::move(*bricks0));
+	mMaterials.Add("stone0", std::move(*stone0));
+	mMaterials.Add("tile0", std::move(*tile0));
+	//mMaterials.Add("diamondMat", std::move(*diamondMat));
+	//mMaterials.Add("diamondMatRed", std::move(*diamondMatRed));
+	//mMaterials.Add("skullMat", std::move(*skullMat));
+	mMaterials.Add("grassMat", std::move(*grassMat));
+	mMaterials.Add("treeSprites", std::move(*treeSprites));
+}
 
-	
-	///border
-	for (int i = 0; i < steps; ++i)
-	{
-		auto MazeWallTop = std::make_unique<RenderItem>();
-
-		XMStoreFloat4x4(&MazeWallTop->World, XMMatrixScaling(scale, wallWidth, wallWidth)*XMMatrixTranslation(offset + scale/2 - outterOffset / 2, 0.0f, 0.0f - outterOffset / 2));
-		XMStoreFloat4x4(&MazeWallTop->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
-		MazeWallTop->ObjCBIndex = objCBIndex;
-		MazeWallTop->Mat = mMaterials["stone0"].get();
-		MazeWallTop->Geo = mGeometries["shapeGeo"].get();
-		MazeWallTop->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		MazeWallTop->IndexCount = MazeWallTop->Geo->DrawArgs["box"].IndexCount;
-		MazeWallTop->StartIndexLocation = MazeWallTop->Geo->DrawArgs["box"].StartIndexLocation;
-		MazeWallTop->BaseVertexLocation = MazeWallTop->Geo->DrawArgs["box"].BaseVertexLocation;
-		mRitemLayer[(int)RenderLayer::Opaque].push_back(MazeWallTop.get());
-		mAllRitems.push_back(std::move(MazeWallTop));
-
-		objCBIndex++;
-
-		auto MazeWallBot = std::make_unique<RenderItem>();
-		
-		XMStoreFloat4x4(&MazeWallBot->World, XMMatrixScaling(scale, wallWidth, wallWidth)*XMMatrixTranslation(offset + scale/2 - outterOffset / 2, 0.0f, outterOffset - outterOffset / 2));
-		XMStoreFloat4x4(&MazeWallBot->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
-		MazeWallBot->ObjCBIndex = objCBIndex;
-		MazeWallBot->Mat = mMaterials["stone0"].get();
-		MazeWallBot->Geo = mGeometries["shapeGeo"].get();
-		MazeWallBot->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		MazeWallBot->IndexCount = MazeWallBot->Geo->DrawArgs["box"].IndexCount;
-		MazeWallBot->StartIndexLocation = MazeWallBot->Geo->DrawArgs["box"].StartIndexLocation;
-		MazeWallBot->BaseVertexLocation = MazeWallBot->Geo->DrawArgs["box"].BaseVertexLocation;
-		mRitemLayer[(int)RenderLayer::Opaque].push_back(MazeWallBot.get());
-		mAllRitems.push_back(std::move(MazeWallBot));
-
-		offset += scale;
-		objCBIndex++;
-	}
-
-	offset = 0.0f;
-
-	for (int i = 0; i < steps; ++i)
-	{
-		auto MazeWallRight = std::make_unique<RenderItem>();
-
-		XMStoreFloat4x4(&MazeWallRight->World, XMMatrixScaling(wallWidth, wallWidth, scale)*XMMatrixTranslation(0.0f - outterOffset / 2.0f, 0.0f, offset + scale/2.0f - outterOffset / 2.0f));
-		XMStoreFloat4x4(&MazeWallRight->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
-		MazeWallRight->ObjCBIndex = objCBIndex;
-		MazeWallRight->Mat = mMaterials["stone0"].get();
-		MazeWallRight->Geo = mGeometries["shapeGeo"].get();
-		MazeWallRight->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		MazeWallRight->IndexCount = MazeWallRight->Geo->DrawArgs["box"].IndexCount;
-		MazeWallRight->StartIndexLocation = MazeWallRight->Geo->DrawArgs["box"].StartIndexLocation;
-		MazeWallRight->BaseVertexLocation = MazeWallRight->Geo->DrawArgs["box"].BaseVertexLocation;
-		mRitemLayer[(int)RenderLayer::Opaque].push_back(MazeWallRight.get());
-		mAllRitems.push_back(std::move(MazeWallRight));
-
-		objCBIndex++;
-
-		auto MazeWallLeft = std::make_unique<RenderItem>();
-
-		XMStoreFloat4x4(&MazeWallLeft->World, XMMatrixScaling(wallWidth, wallWidth, scale)*XMMatrixTranslation(outterOffset - outterOffset/2.0f, 0.0f, offset + scale/2.0f - outterOffset / 2.0f));
-		XMStoreFloat4x4(&MazeWallLeft->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
-		MazeWallLeft->ObjCBIndex = objCBIndex;
-		MazeWallLeft->Mat = mMaterials["stone0"].get();
-		MazeWallLeft->Geo = mGeometries["shapeGeo"].get();
-		MazeWallLeft->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		MazeWallLeft->IndexCount = MazeWallLeft->Geo->DrawArgs["box"].IndexCount;
-		MazeWallLeft->StartIndexLocation = MazeWallLeft->Geo->DrawArgs["box"].StartIndexLocation;
-		MazeWallLeft->BaseVertexLocation = MazeWallLeft->Geo->DrawArgs["box"].BaseVertexLocation;
-		mRitemLayer[(int)RenderLayer::Opaque].push_back(MazeWallLeft.get());
-		mAllRitems.push_back(std::move(MazeWallLeft));
-
-		offset += scale;
-		objCBIndex++;
+bool LitColumnsApp::BuildRenderItems()
+{
+	// The scene is data: mRenderSettings.SceneFile is compiled by
+	// Tools/SceneCompiler from its text form (Scenes/castle.scene.txt), and
+	// its chunks are decoded on the worker threads.  Objects get their indices
+	// in file order, so none are numbered by hand.
+	std::vector<SceneChunkDesc> chunks;
+	mSceneWriteTime = SceneLoader::GetWriteTime(mRenderSettings.SceneFile);
+	if(!SceneLoader::Load(mRenderSettings.SceneFile, mRecordThreadPool.get(), chunks))
+	{
+		MessageBox(0, (mRenderSettings.SceneFile + L" not found or invalid.").c_str(), 0, 0);
+		return false;
 	}
-	
-	//nested for loop horizontal then verticle
 
-	int num;
+	for(const SceneChunkDesc& chunk : chunks)
+	{
+		SceneChunk sceneChunk;
+		sceneChunk.Name = chunk.Name;
+		sceneChunk.Hash = chunk.Hash;
+
+		for(const SceneObjectDesc& desc : chunk.Objects)
+		{
+			auto ri = std::make_unique<RenderItem>();
+			RenderLayer layer;
+			if(!ResolveSceneObject(desc, *ri, layer))
+			{
+				MessageBox(0, AnsiToWString("Scene object " + desc.Geometry + "/" + desc.Submesh + " (" + desc.Material +
+					") in chunk \"" + chunk.Name + "\" refers to an unknown geometry, submesh or material.").c_str(), 0, 0);
+				return false;
+			}
+
+			ri->ObjCBIndex = mScene.Size();
+			mScene.SetWorld(ri->ObjCBIndex, XMLoadFloat4x4(&desc.World));
+			mScene.SetTexTransform(ri->ObjCBIndex, XMLoadFloat4x4(&desc.TexTransform));
+			mScene.SetLocalBounds(ri->ObjCBIndex, mGeometries[ri->Geo].DrawArgs.Get(desc.Submesh).Bounds);
+
+			sceneChunk.Items.push_back(ri.get());
+			sceneChunk.Layers.push_back(layer);
+			mRitemLayer[(int)layer].push_back(ri.get());
+			mAllRitems.push_back(std::move(ri));
+		}
+
+		mSceneChunks.push_back(std::move(sceneChunk));
+	}
+
+	if(mScene.Size() == 0)
+	{
+		MessageBox(0, (mRenderSettings.SceneFile + L" has no objects.").c_str(), 0, 0);
+		return false;
+	}
+
+	// All the render items are opaque.
+	for(auto& e : mAllRitems)
+		mOpaqueRitems.push_back(e.get());
+
+	return true;
+}
+
+bool LitColumnsApp::ResolveSceneObject(const SceneObjectDesc& desc, RenderItem& ri, RenderLayer& layer)const
+{
+	ri.Geo = mGeometries.Find(desc.Geometry);
+	ri.Mat = mMaterials.Find(desc.Material);
+	if(!ri.Geo.IsValid() || !ri.Mat.IsValid())
+		return false;
+
+	const MeshGeometry& geo = mGeometries[ri.Geo];
+	SubmeshHandle submeshHandle = geo.DrawArgs.Find(desc.Submesh);
+	if(!submeshHandle.IsValid())
+		return false;
+
+	const SubmeshGeometry& submesh = geo.DrawArgs[submeshHandle];
+	ri.PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	ri.IndexCount = submesh.IndexCount;
+	ri.StartIndexLocation = submesh.StartIndexLocation;
+	ri.BaseVertexLocation = submesh.BaseVertexLocation;
+
+	switch(desc.Layer)
+	{
+	case SceneFormat::LayerAlphaTested: layer = RenderLayer::AlphaTested; break;
+	case SceneFormat::LayerTransparent: layer = RenderLayer::Transparent; break;
+	default: layer = RenderLayer::Opaque; break;
+	}
+
+	return true;
+}
+
+void LitColumnsApp::ReloadSceneChunks(const GameTimer& gt)
+{
+	if(!mSceneHotReload || gt.TotalTime() < mNextSceneCheckTime)
+		return;
+
+	mNextSceneCheckTime = gt.TotalTime() + gSceneCheckInterval;
+
+	const std::uint64_t writeTime = SceneLoader::GetWriteTime(mRenderSettings.SceneFile);
+	if(writeTime == 0 || writeTime == mSceneWriteTime)
+		return;
+
+	// A file that does not load may still be being replaced; the write time is
+	// only taken once it does, so the next check tries again.
+	std::vector<SceneChunkDesc> chunks;
+	if(!SceneLoader::Load(mRenderSettings.SceneFile, mRecordThreadPool.get(), chunks))
+		return;
+
+	mSceneWriteTime = writeTime;
+
+	std::wostringstream report;
+	UINT updatedChunks = 0;
+	for(const SceneChunkDesc& chunk : chunks)
+	{
+		auto it = std::find_if(mSceneChunks.begin(), mSceneChunks.end(),
+			[&chunk](const SceneChunk& c) { return c.Name == chunk.Name; });
+
+		if(it == mSceneChunks.end())
+		{
+			report << L"Scene reload: new chunk \"" << AnsiToWString(chunk.Name) << L"\" needs a restart.\n";
+			continue;
+		}
+
+		SceneChunk& sceneChunk = *it;
+		if(sceneChunk.Hash == chunk.Hash)
+			continue;
+
+		// Transforms and materials change in place; the geometry and the layer of
+		// an object decide its instance group and draw commands, so changing them,
+		// or the number of objects, needs a restart.
+		bool inPlace = chunk.Objects.size() == sceneChunk.Items.size();
+		std::vector<RenderItem> resolved(chunk.Objects.size());
+		for(size_t i = 0; inPlace && i < chunk.Objects.size(); ++i)
+		{
+			const RenderItem& current = *sceneChunk.Items[i];
+
+			RenderLayer layer;
+			inPlace = ResolveSceneObject(chunk.Objects[i], resolved[i], layer) &&
+				layer == sceneChunk.Layers[i] &&
+				resolved[i].Geo == current.Geo &&
+				resolved[i].IndexCount == current.IndexCount &&
+				resolved[i].StartIndexLocation == current.StartIndexLocation &&
+				resolved[i].BaseVertexLocation == current.BaseVertexLocation;
+		}
+
+		if(!inPlace)
+		{
+			report << L"Scene reload: chunk \"" << AnsiToWString(chunk.Name)
+				<< L"\" changed its objects, geometry or layers and needs a restart.\n";
+			continue;
+		}
+
+		// Only the objects that changed go on the dirty list, so the upload is as
+		// small as the edit.
+		for(size_t i = 0; i < chunk.Objects.size(); ++i)
+		{
+			const SceneObjectDesc& desc = chunk.Objects[i];
+			RenderItem* ri = sceneChunk.Items[i];
+
+			if(memcmp(&desc.World, &mScene.World[ri->ObjCBIndex], sizeof(XMFLOAT4X4)) != 0)
+				mScene.SetWorld(ri->ObjCBIndex, XMLoadFloat4x4(&desc.World));
+
+			if(memcmp(&desc.TexTransform, &mScene.TexTransform[ri->ObjCBIndex], sizeof(XMFLOAT4X4)) != 0)
+				mScene.SetTexTransform(ri->ObjCBIndex, XMLoadFloat4x4(&desc.TexTransform));
+
+			ri->Mat = resolved[i].Mat;
+			mScene.SetMaterial(ri->ObjCBIndex, (UINT)mMaterials[ri->Mat].MatCBIndex);
+		}
+
+		sceneChunk.Hash = chunk.Hash;
+		updatedChunks++;
+	}
+
+	report << L"Scene reload: " << updatedChunks << L" chunks updated.\n";
+	OutputDebugString(report.str().c_str());
+}
+
+void LitColumnsApp::ScaleScene(UINT copies)
+{
+	mScene.UpdateDirtyBounds();
+
+	BoundingBox bounds = mScene.WorldBounds[0];
+	for(UINT i = 1; i < mScene.Size(); ++i)
+		BoundingBox::CreateMerged(bounds, bounds, mScene.WorldBounds[i]);
+
+	// Lay the copies out on a square grid, nearest rings first, with the original
+	// in the center cell.
+	const float spacing = 2.0f*MathHelper::Max(fabsf(bounds.Center.x) + bounds.Extents.x, fabsf(bounds.Center.z) + bounds.Extents.z);
+	int halfSide = 0;
+	while((UINT)((2*halfSide + 1)*(2*halfSide + 1)) < copies)
+		halfSide++;
+
+	std::vector<XMINT2> cells;
+	for(int z = -halfSide; z <= halfSide; ++z)
+	{
+		for(int x = -halfSide; x <= halfSide; ++x)
+			cells.push_back(XMINT2(x, z));
+	}
+	std::stable_sort(cells.begin(), cells.end(), [](const XMINT2& a, const XMINT2& b)
+	{
+		return MathHelper::Max(abs(a.x), abs(a.y)) < MathHelper::Max(abs(b.x), abs(b.y));
+	});
+
+	XMFLOAT3 extents = bounds.Extents;
+	extents.x = fabsf(bounds.Center.x) + extents.x + halfSide*spacing;
+	extents.y = fabsf(bounds.Center.y) + extents.y;
+	extents.z = fabsf(bounds.Center.z) + extents.z + halfSide*spacing;
+	mSceneRadius = XMVectorGetX(XMVector3Length(XMLoadFloat3(&extents)));
+
+	// Keep the whole grid inside the far plane.
+	mFarZ = MathHelper::Max(1000.0f, 3.0f*mSceneRadius);
+	UpdateProjection();
+
+	if(copies <= 1)
+		return;
+
+	for(int layer = 0; layer < (int)RenderLayer::Count; ++layer)
+	{
+		const size_t baseItems = mRitemLayer[layer].size();
+		for(UINT copy = 1; copy < copies; ++copy)
+		{
+			XMMATRIX offset = XMMatrixTranslation(cells[copy].x*spacing, 0.0f, cells[copy].y*spacing);
+
+			for(size_t i = 0; i < baseItems; ++i)
+			{
+				const RenderItem* src = mRitemLayer[layer][i];
+
+				auto ri = std::make_unique<RenderItem>(*src);
+				ri->ObjCBIndex = mScene.Size();
+
+				BoundingBox localBounds = mScene.LocalBounds[src->ObjCBIndex];
+				mScene.SetWorld(ri->ObjCBIndex, XMLoadFloat4x4(&mScene.World[src->ObjCBIndex])*offset);
+				mScene.SetTexTransform(ri->ObjCBIndex, XMLoadFloat4x4(&mScene.TexTransform[src->ObjCBIndex]));
+				mScene.SetLocalBounds(ri->ObjCBIndex, localBounds);
+
+				mRitemLayer[layer].push_back(ri.get());
+				mOpaqueRitems.push_back(ri.get());
+				mAllRitems.push_back(std::move(ri));
+			}
+		}
+	}
+}
+
+void LitColumnsApp::BuildInstanceGroups()
+{
+	// Tree sprites are not render items; see BuildTreeSprites.
+	const RenderLayer instancedLayers[] =
+	{
+		RenderLayer::Opaque,
+		RenderLayer::AlphaTested,
+		RenderLayer::Transparent
+	};
 
-	for (int row = 0; row < steps; row++)
+	for(RenderLayer layer : instancedLayers)
 	{
-		for (int col = 0; col < steps; col++)
+		auto& groups = mInstanceGroups[(int)layer];
+		for(auto ri : mRitemLayer[(int)layer])
 		{
-			num = rand() % 5;
-			if (num > 1) {
-				auto MazeWallVert = std::make_unique<RenderItem>();
-
-				//row * scale, 0.0f, col * scale
-				//XMMatrixTranslation(0.0f - outterOffset / 2, 0.0f, offset + scale / 2 - outterOffset / 2)
-
-				XMStoreFloat4x4(&MazeWallVert->World, XMMatrixScaling(wallWidth, wallWidth, scale)*XMMatrixTranslation(row * scale - outterOffset / 2.0f + scale / 2.0f, 0.0f, col * scale - outterOffset / 2.0f + scale / 2.0f));
-				XMStoreFloat4x4(&MazeWallVert->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
-				MazeWallVert->ObjCBIndex = objCBIndex;
-				MazeWallVert->Mat = mMaterials["stone0"].get();
-				MazeWallVert->Geo = mGeometries["shapeGeo"].get();
-				MazeWallVert->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-				MazeWallVert->IndexCount = MazeWallVert->Geo->DrawArgs["box"].IndexCount;
-				MazeWallVert->StartIndexLocation = MazeWallVert->Geo->DrawArgs["box"].StartIndexLocation;
-				MazeWallVert->BaseVertexLocation = MazeWallVert->Geo->DrawArgs["box"].BaseVertexLocation;
-				mRitemLayer[(int)RenderLayer::Opaque].push_back(MazeWallVert.get());
-				mAllRitems.push_back(std::move(MazeWallVert));
-
-				objCBIndex++;
+			auto it = std::find_if(groups.begin(), groups.end(), [ri](const InstanceGroup& g)
+			{
+				return g.Lod == 0 && g.Geo == ri->Geo &&
+					g.PrimitiveType == ri->PrimitiveType &&
+					g.IndexCount == ri->IndexCount &&
+					g.StartIndexLocation == ri->StartIndexLocation &&
+					g.BaseVertexLocation == ri->BaseVertexLocation;
+			});
+
+			if(it == groups.end())
+			{
+				InstanceGroup group;
+				group.Geo = ri->Geo;
+				group.PrimitiveType = ri->PrimitiveType;
+				group.IndexCount = ri->IndexCount;
+				group.StartIndexLocation = ri->StartIndexLocation;
+				group.BaseVertexLocation = ri->BaseVertexLocation;
+
+				// Render items only carry the draw arguments, so look up the submesh
+				// they came from for its detail levels.
+				const std::vector<SubmeshLod>* lods = nullptr;
+				for(const SubmeshGeometry& submesh : mGeometries[ri->Geo].DrawArgs)
+				{
+					if(submesh.IndexCount == ri->IndexCount &&
+						submesh.StartIndexLocation == ri->StartIndexLocation &&
+						submesh.BaseVertexLocation == ri->BaseVertexLocation)
+					{
+						lods = &submesh.Lods;
+						break;
+					}
+				}
+
+				group.LodCount = lods != nullptr ? MathHelper::Min((UINT)lods->size() + 1, gMaxLods) : 1;
+				groups.push_back(group);
+
+				for(UINT lod = 1; lod < group.LodCount; ++lod)
+				{
+					InstanceGroup lodGroup = group;
+					lodGroup.Lod = lod;
+					lodGroup.IndexCount = (*lods)[lod - 1].IndexCount;
+					lodGroup.StartIndexLocation = (*lods)[lod - 1].StartIndexLocation;
+					lodGroup.BaseVertexLocation = (*lods)[lod - 1].BaseVertexLocation;
+					groups.push_back(std::move(lodGroup));
+				}
+
+				it = groups.end() - group.LodCount;
 			}
 
-			num = rand() % 5;
-			if(num > 1)
+			// The material travels with the instance rather than the group.
+			mScene.SetMaterial(ri->ObjCBIndex, (UINT)mMaterials[ri->Mat].MatCBIndex);
+
+			mScene.LodCount[ri->ObjCBIndex] = (unsigned char)it->LodCount;
+			for(UINT lod = 0; lod < it->LodCount; ++lod)
+				(it + lod)->Objects.push_back(ri->ObjCBIndex);
+		}
+	}
+}
+
+void LitColumnsApp::BuildDrawCommands()
+{
+	// One command per instance group, laid out layer by layer in draw order so
+	// every layer is one contiguous ExecuteIndirect.  Each group owns a range of
+	// the GPU instance index list as large as its object count.  The detail level
+	// groups follow their level 0 group, so Cull.hlsl finds the command of level
+	// l at DrawCommand + l.
+	std::vector<IndirectCommand> commands;
+	mObjectDrawCommand.assign(mScene.Size(), CullObject::NoDrawCommand);
+
+	UINT instanceStart = 0;
+	for(RenderLayer layer : gLayerDrawOrder)
+	{
+		mLayerFirstCommand[(int)layer] = (UINT)commands.size();
+
+		for(const InstanceGroup& g : mInstanceGroups[(int)layer])
+		{
+			const MeshGeometry& geo = mGeometries[g.Geo];
+
+			IndirectCommand command;
+			command.VertexBuffer = geo.VertexBufferView();
+			command.IndexBuffer = geo.IndexBufferView();
+			command.MaterialIndex = 0;
+			command.InstanceStart = instanceStart;
+			command.Draw.IndexCountPerInstance = g.IndexCount;
+			command.Draw.InstanceCount = 0;
+			command.Draw.StartIndexLocation = g.StartIndexLocation;
+			command.Draw.BaseVertexLocation = g.BaseVertexLocation;
+			command.Draw.StartInstanceLocation = 0;
+
+			if(g.Lod == 0)
 			{
-				auto MazeWallHor = std::make_unique<RenderItem>();
-
-				XMStoreFloat4x4(&MazeWallHor->World, XMMatrixScaling(scale, wallWidth, wallWidth)*XMMatrixTranslation(row * scale - outterOffset / 2.0f + scale / 2.0f, 0.0f, col * scale - outterOffset / 2.0f + scale / 2.0f));
-				XMStoreFloat4x4(&MazeWallHor->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
-				MazeWallHor->ObjCBIndex = objCBIndex;
-				MazeWallHor->Mat = mMaterials["stone0"].get();
-				MazeWallHor->Geo = mGeometries["shapeGeo"].get();
-				MazeWallHor->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-				MazeWallHor->IndexCount = MazeWallHor->Geo->DrawArgs["box"].IndexCount;
-				MazeWallHor->StartIndexLocation = MazeWallHor->Geo->DrawArgs["box"].StartIndexLocation;
-				MazeWallHor->BaseVertexLocation = MazeWallHor->Geo->DrawArgs["box"].BaseVertexLocation;
-				mRitemLayer[(int)RenderLayer::Opaque].push_back(MazeWallHor.get());
-				mAllRitems.push_back(std::move(MazeWallHor));
-
-				objCBIndex++;
+				for(UINT obj : g.Objects)
+					mObjectDrawCommand[obj] = (UINT)commands.size();
 			}
 
+			instanceStart += (UINT)g.Objects.size();
+			commands.push_back(command);
 		}
 
+		mLayerCommandCount[(int)layer] = (UINT)commands.size() - mLayerFirstCommand[(int)layer];
 	}
 
-	objCBIndex++;
+	mDrawCommandCount = (UINT)commands.size();
+	mGpuInstanceSlotCount = instanceStart;
+	if(mDrawCommandCount == 0)
+		return;
+
+	const UINT64 byteSize = (UINT64)mDrawCommandCount*sizeof(IndirectCommand);
 
-	auto treeSpritesRitem = std::make_unique<RenderItem>();
-	treeSpritesRitem->World = MathHelper::Identity4x4();
-	treeSpritesRitem->ObjCBIndex = 3;
-	treeSpritesRitem->Mat = mMaterials["treeSprites"].get();
-	treeSpritesRitem->Geo = mGeometries["treeSpritesGeo"].get();
-	treeSpritesRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_POINTLIST;
-	treeSpritesRitem->IndexCount = treeSpritesRitem->Geo->DrawArgs["points"].IndexCount;
-	treeSpritesRitem->StartIndexLocation = treeSpritesRitem->Geo->DrawArgs["points"].StartIndexLocation;
-	treeSpritesRitem->BaseVertexLocation = treeSpritesRitem->Geo->DrawArgs["points"].BaseVertexLocation;
-	mRitemLayer[(int)RenderLayer::AlphaTestedTreeSprites].push_back(treeSpritesRitem.get());
-	mAllRitems.push_back(std::move(treeSpritesRitem));
+	mDrawCommandTemplates = mGpuMemory->CreateBuffer(mCommandList.Get(), commands.data(), byteSize);
 
-	// All the render items are opaque.
-	for(auto& e : mAllRitems)
-		mOpaqueRitems.push_back(e.get());
+	mDrawCommands = mGpuMemory->CreateBuffer(byteSize,
+		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COMMON);
 }
 
-void LitColumnsApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems)
+void LitColumnsApp::SortInstanceGroups(RenderLayer layer)
 {
-    UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
-    UINT matCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(MaterialConstants));
- 
-	auto objectCB = mCurrFrameResource->ObjectCB->Resource();
-	auto matCB = mCurrFrameResource->MaterialCB->Resource();
+	// Every group of a layer uses the layer's PSO.  Opaque and alpha tested
+	// groups go front to back for early-Z, blended ones back to front.
+	const RenderQueue::DepthOrder order = (layer == RenderLayer::Transparent) ?
+		RenderQueue::DepthOrder::BackToFront : RenderQueue::DepthOrder::FrontToBack;
 
-    // For each render item...
-    for(size_t i = 0; i < ritems.size(); ++i)
-    {
-        auto ri = ritems[i];
+	const std::vector<InstanceGroup>& groups = mInstanceGroups[(int)layer];
+	RenderQueue& queue = mRenderQueues[(int)layer];
+	queue.Clear();
+
+	for(UINT i = 0; i < (UINT)groups.size(); ++i)
+	{
+		const InstanceGroup& g = groups[i];
+		float depth = g.VisibleCount > 0 ? RenderQueue::NormalizeDepth(g.SortDepth, mCameraCB.NearZ, mCameraCB.FarZ) : 1.0f;
+
+		// Groups carry no material, and the layer has one PSO; see RenderQueue.h.
+		queue.Push(RenderQueue::MakeKey(order, (UINT)layer, g.Geo.Index, depth), i);
+	}
+
+	queue.Sort();
+}
 
-        cmdList->IASetVertexBuffers(0, 1, &ri->Geo->VertexBufferView());
-        cmdList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
-        cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
+void LitColumnsApp::DrawInstanceGroups(ID3D12GraphicsCommandList* cmdList, RenderLayer layer, size_t begin, size_t end,
+	RenderQueue::SubmitStats& stats)
+{
+	// Materials and textures are looked up in the shader per instance, so a draw
+	// only changes the vertex/index buffers when the geometry does, plus one root
+	// constant.  The queue keeps draws of the same geometry together.
+	const std::vector<InstanceGroup>& groups = mInstanceGroups[(int)layer];
+	const RenderQueue& queue = mRenderQueues[(int)layer];
+
+	GeometryHandle boundGeo;
+	D3D_PRIMITIVE_TOPOLOGY boundTopology = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+
+    // For each instance group, in queue order...
+    for(size_t i = begin; i < end; ++i)
+    {
+        auto& g = groups[queue.Item(i)];
+		if(g.VisibleCount == 0)
+			continue;
 
-		CD3DX12_GPU_DESCRIPTOR_HANDLE tex(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-		tex.Offset(ri->Mat->DiffuseSrvHeapIndex, mCbvSrvDescriptorSize);
+		if(g.Geo != boundGeo)
+		{
+			const MeshGeometry& geo = mGeometries[g.Geo];
+			cmdList->IASetVertexBuffers(0, 1, &geo.VertexBufferView());
+			cmdList->IASetIndexBuffer(&geo.IndexBufferView());
+			boundGeo = g.Geo;
+			stats.GeometryBinds++;
+		}
+		else
+		{
+			stats.GeometrySkipped++;
+		}
 
-        D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = objectCB->GetGPUVirtualAddress() + ri->ObjCBIndex*objCBByteSize;
-		D3D12_GPU_VIRTUAL_ADDRESS matCBAddress = matCB->GetGPUVirtualAddress() + ri->Mat->MatCBIndex*matCBByteSize;
+		if(g.PrimitiveType != boundTopology)
+		{
+			cmdList->IASetPrimitiveTopology(g.PrimitiveType);
+			boundTopology = g.PrimitiveType;
+			stats.TopologyBinds++;
+		}
+		else
+		{
+			stats.TopologySkipped++;
+		}
 
-		
-		cmdList->SetGraphicsRootDescriptorTable(0, tex);
-        cmdList->SetGraphicsRootConstantBufferView(1, objCBAddress);
-		cmdList->SetGraphicsRootConstantBufferView(3, matCBAddress);
-		
+		// The group's slice of the index list; SV_InstanceID is relative to it.
+		cmdList->SetGraphicsRoot32BitConstant(2, g.VisibleStart, 1);
 
-        cmdList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+        cmdList->DrawIndexedInstanced(g.IndexCount, g.VisibleCount, g.StartIndexLocation, g.BaseVertexLocation, 0);
+		stats.Draws++;
     }
 }
 
+void LitColumnsApp::DrawInstanceGroupsIndirect(ID3D12GraphicsCommandList* cmdList, RenderLayer layer)
+{
+	// Every command of the layer is submitted; the ones the culling pass left at
+	// zero instances only cost the GPU's command processor.
+	cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	cmdList->ExecuteIndirect(mDrawCommandSignature.Get(), mLayerCommandCount[(int)layer],
+		mDrawCommands.Get(), (UINT64)mLayerFirstCommand[(int)layer]*sizeof(IndirectCommand), nullptr, 0);
+}
+
+void LitColumnsApp::DrawTreeSprites(ID3D12GraphicsCommandList* cmdList)
+{
+	const Material& mat = mMaterials[mTreeSpriteMat];
+
+	cmdList->SetGraphicsRootDescriptorTable(0, mSrvHeap->GpuHandle(mSrvHeapRemap[mat.DiffuseSrvHeapIndex]));
+	cmdList->SetGraphicsRoot32BitConstant(2, mat.MatCBIndex, 0);
+
+	cmdList->SetGraphicsRootShaderResourceView(7, mTreeSpriteBuffer->GetGPUVirtualAddress());
+	cmdList->SetGraphicsRootShaderResourceView(8, mVisibleTreeSprites->GetGPUVirtualAddress());
+
+	cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	cmdList->ExecuteIndirect(mTreeSpriteCommandSignature.Get(), 1, mTreeSpriteDrawArgs.Get(), 0, nullptr, 0);
+}
+
+UINT LitColumnsApp::GetLayerDrawCount(RenderLayer layer)const
+{
+	// Tree sprites are a single ExecuteIndirect; every other layer is drawn per
+	// instance group, or with one ExecuteIndirect when the GPU culls.
+	if(layer == RenderLayer::AlphaTestedTreeSprites)
+		return mTreeSpriteCount > 0 ? 1 : 0;
+
+	if(mRenderSettings.GpuDriven)
+		return mLayerCommandCount[(int)layer] > 0 ? 1 : 0;
+
+	return (UINT)mInstanceGroups[(int)layer].size();
+}
+
+UINT LitColumnsApp::GetTotalDrawCount()const
+{
+	UINT count = 0;
+	for(RenderLayer layer : gLayerDrawOrder)
+		count += GetLayerDrawCount(layer);
+
+	return count;
+}
+
+void LitColumnsApp::BuildDrawWork(UINT totalDrawCount)
+{
+	mDrawWork.resize(totalDrawCount + 1);
+	mDrawWork[0] = 0;
+
+	// Draws are numbered as in RecordDrawRange: the layers in draw order, and the
+	// instance groups of a layer in queue order.
+	UINT draw = 0;
+	for(RenderLayer layer : gLayerDrawOrder)
+	{
+		const UINT layerDrawCount = GetLayerDrawCount(layer);
+		const bool perGroup = layer != RenderLayer::AlphaTestedTreeSprites && !mRenderSettings.GpuDriven;
+		for(UINT i = 0; i < layerDrawCount; ++i, ++draw)
+		{
+			const bool recorded = !perGroup ||
+				mInstanceGroups[(int)layer][mRenderQueues[(int)layer].Item(i)].VisibleCount > 0;
+			mDrawWork[draw + 1] = mDrawWork[draw] + (recorded ? 1 : 0);
+		}
+	}
+}
+
+void LitColumnsApp::SetPassRootArguments(ID3D12GraphicsCommandList* cmdList)
+{
+	ID3D12DescriptorHeap* descriptorHeaps[] = { mSrvHeap->Heap() };
+	cmdList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+
+	cmdList->SetGraphicsRootSignature(mRootSignature.Get());
+
+	cmdList->SetGraphicsRootConstantBufferView(1, mPassConstantBuffer->GetGPUVirtualAddress());
+	cmdList->SetGraphicsRootShaderResourceView(3, mInstanceBuffer->GetGPUVirtualAddress());
+	cmdList->SetGraphicsRootShaderResourceView(4, mRenderSettings.GpuDriven ?
+		mGpuInstanceIndices->GetGPUVirtualAddress() : mCurrFrameResource->InstanceIndexBuffer);
+	cmdList->SetGraphicsRootShaderResourceView(5, mCurrFrameResource->MaterialBuffer);
+	cmdList->SetGraphicsRootDescriptorTable(6, mSrvHeap->GpuHandle(0));
+	cmdList->SetGraphicsRootShaderResourceView(9, mCurrFrameResource->LightBuffer);
+	cmdList->SetGraphicsRootShaderResourceView(10, mClusterLights->GetGPUVirtualAddress());
+	cmdList->SetGraphicsRootConstantBufferView(11, mPassConstantBuffer->GetGPUVirtualAddress() + gLightingCBOffset);
+	cmdList->SetGraphicsRootConstantBufferView(12, mCurrFrameResource->TimeCB);
+}
+
+void LitColumnsApp::RecordDrawRange(ID3D12GraphicsCommandList* cmdList, UINT begin, UINT end,
+	RenderQueue::SubmitStats& stats)
+{
+	// Command lists do not inherit state, so every list sets up the pass itself.
+    cmdList->RSSetViewports(1, &mSceneViewport);
+    cmdList->RSSetScissorRects(1, &mSceneScissorRect);
+
+    // Specify the buffers we are going to render to.
+    cmdList->OMSetRenderTargets(1, &SceneRenderTargetView(), true, &DepthStencilView());
+
+	SetPassRootArguments(cmdList);
+
+	// A layer's timestamps are written by the list whose range contains the
+	// layer's first and one-past-last draw; boundaries at the very end of the
+	// frame belong to the last list.  That way every layer, empty or not, gets
+	// exactly one begin and one end however the draws are split.
+	UINT totalDrawCount = GetTotalDrawCount();
+	auto ownsBoundary = [=](UINT boundary)
+	{
+		return (begin <= boundary && boundary < end) || (boundary == totalDrawCount && end == totalDrawCount);
+	};
+
+	// Walk the layers in draw order and draw the part of [begin, end) that
+	// falls inside each one.
+	UINT layerStart = 0;
+	for(RenderLayer layer : gLayerDrawOrder)
+	{
+		UINT layerEnd = layerStart + GetLayerDrawCount(layer);
+		UINT first = MathHelper::Max(begin, layerStart);
+		UINT last = MathHelper::Min(end, layerEnd);
+
+		if(ownsBoundary(layerStart))
+			mProfiler->BeginGpuScope(cmdList, mLayerGpuScopes[(int)layer]);
+
+		if(first < last)
+		{
+			cmdList->SetPipelineState(mLayerPSOs[(int)layer]);
+
+			if(layer == RenderLayer::AlphaTestedTreeSprites)
+				DrawTreeSprites(cmdList);
+			else if(mRenderSettings.GpuDriven)
+				DrawInstanceGroupsIndirect(cmdList, layer);
+			else
+				DrawInstanceGroups(cmdList, layer, first - layerStart, last - layerStart, stats);
+		}
+
+		if(ownsBoundary(layerEnd))
+			mProfiler->EndGpuScope(cmdList, mLayerGpuScopes[(int)layer]);
+
+		layerStart = layerEnd;
+	}
+}
+
+void LitColumnsApp::RecordWorkerCommandList(UINT worker, UINT begin, UINT end, bool lastList)
+{
+	auto& cmdListAlloc = mCurrFrameResource->WorkerCmdListAllocs[worker];
+	auto& cmdList = mCurrFrameResource->WorkerCmdLists[worker];
+
+	// Safe to reset: Update() has already waited on this frame resource's fence.
+	ThrowIfFailed(cmdListAlloc->Reset());
+	ThrowIfFailed(cmdList->Reset(cmdListAlloc.Get(), mLayerPSOs[(int)RenderLayer::Opaque]));
+
+	RecordDrawRange(cmdList.Get(), begin, end, mListSubmitStats[worker]);
+
+	if(lastList)
+	{
+		RecordUpscale(cmdList.Get());
+
+		mProfiler->EndGpuScope(cmdList.Get(), mGpuFrameScope);
+		mProfiler->ResolveGpuScopes(cmdList.Get());
+
+		// Indicate a state transition on the resource usage.
+		cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
+			D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
+	}
+
+	ThrowIfFailed(cmdList->Close());
+}
+
 std::array<const CD3DX12_STATIC_SAMPLER_DESC, 6> LitColumnsApp::GetStaticSamplers()
 {
 	// Applications usually only need a handful of samplers.  So just define them all up front
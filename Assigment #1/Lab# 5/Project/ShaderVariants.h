@@ -0,0 +1,61 @@
+//***************************************************************************************
+// ShaderVariants.h
+//
+// Every shader variant the app uses.  Shared by BuildShadersAndInputLayout and the
+// offline Tools/ShaderCompiler, so the precompiled cache always covers exactly the
+// variants the app asks for.
+//***************************************************************************************
+
+#pragma once
+
+#include "../../Common/d3dUtil.h"
+
+struct ShaderVariant
+{
+	const char* Name;
+	const wchar_t* Filename;
+	const D3D_SHADER_MACRO* Defines;
+	const char* EntryPoint;
+	const char* Target;
+};
+
+// Relative to the working directory, like the shader sources themselves.
+static const wchar_t* const gShaderCacheDirectory = L"Shaders\\Compiled";
+
+static const D3D_SHADER_MACRO gFogDefines[] =
+{
+	"FOG", "1",
+	NULL, NULL
+};
+
+static const D3D_SHADER_MACRO gAlphaTestDefines[] =
+{
+	"FOG", "1",
+	"ALPHA_TEST", "1",
+	NULL, NULL
+};
+
+static const D3D_SHADER_MACRO gHiZOcclusionDefines[] =
+{
+	"HIZ_OCCLUSION", "1",
+	NULL, NULL
+};
+
+static const ShaderVariant gShaderVariants[] =
+{
+	{ "standardVS",      L"Shaders\\Default.hlsl",    nullptr,              "VS", "vs_5_1" },
+	{ "opaquePS",        L"Shaders\\Default.hlsl",    gFogDefines,          "PS", "ps_5_1" },
+	{ "alphaTestedPS",   L"Shaders\\Default.hlsl",    gAlphaTestDefines,    "PS", "ps_5_1" },
+
+	{ "treeSpriteVS",    L"Shaders\\TreeSprite.hlsl", nullptr,              "VS", "vs_5_1" },
+	{ "treeSpritePS",    L"Shaders\\TreeSprite.hlsl", gAlphaTestDefines,    "PS", "ps_5_1" },
+
+	{ "cullCS",          L"Shaders\\Cull.hlsl",       nullptr,              "CS", "cs_5_1" },
+	{ "cullOcclusionCS", L"Shaders\\Cull.hlsl",       gHiZOcclusionDefines, "CS", "cs_5_1" },
+	{ "spriteCullCS",    L"Shaders\\SpriteCull.hlsl", nullptr,              "CS", "cs_5_1" },
+	{ "lightCullCS",     L"Shaders\\LightCull.hlsl",  nullptr,              "CS", "cs_5_1" },
+	{ "hiZCS",           L"Shaders\\HiZ.hlsl",        nullptr,              "CS", "cs_5_1" },
+
+	{ "upscaleVS",       L"Shaders\\Upscale.hlsl",    nullptr,              "VS", "vs_5_1" },
+	{ "upscalePS",       L"Shaders\\Upscale.hlsl",    nullptr,              "PS", "ps_5_1" },
+};
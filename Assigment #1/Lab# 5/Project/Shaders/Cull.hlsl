@@ -0,0 +1,180 @@
+//***************************************************************************************
+// Cull.hlsl
+//
+// GPU-driven frustum culling.  One thread per object tests the object's world
+// space bounds against the camera frustum and picks the detail level to draw it
+// at.  A visible object bumps the instance count of the indirect draw command of
+// its group at that level and writes its index into that group's range of the
+// instance index list read by Default.hlsl.
+//
+// With HIZ_OCCLUSION the objects inside the frustum are also tested against the
+// hierarchical-Z pyramid (see HiZ.hlsl).  Culling runs before this frame's depth
+// pre-pass, so the pyramid is the previous frame's, and the boxes are projected
+// with the view-projection and render size it was built with.  An object that
+// comes out from behind an occluder therefore shows up a frame late.
+//***************************************************************************************
+
+// Must match IndirectCommand in FrameResource.h.
+#define COMMAND_STRIDE        64
+#define INSTANCE_START_OFFSET 36
+#define INSTANCE_COUNT_OFFSET 44
+
+#define NO_DRAW_COMMAND 0xffffffff
+
+// Must match gMaxLods in LitColumnsApp.cpp.
+#define MAX_LODS 4
+
+struct CullObject
+{
+    float3 Center;
+    uint   DrawCommand;
+    float3 Extents;
+    uint   LodCount;
+};
+
+cbuffer cbCull : register(b0)
+{
+    float4 gFrustumPlanes[6];
+    float3 gEyePosW;
+    uint   gCullingEnabled;
+    uint   gObjectCount;
+    uint   gSpriteCount;
+    float  gSpriteLodStart;
+    float  gSpriteLodEnd;
+    float4 gLodScreenSizes;
+    float  gLodScale;
+    float  gLodHysteresis;
+    float  cbCullPad0;
+    float  cbCullPad1;
+
+    // The previous frame's pyramid; gHiZMipCount is 0 while there is none.
+    float4x4 gHiZViewProj;
+    uint2    gHiZRenderSize;
+    uint     gHiZMipCount;
+    uint     cbCullPad2;
+};
+
+StructuredBuffer<CullObject> gCullObjects      : register(t0);
+RWByteAddressBuffer          gDrawCommands     : register(u0);
+RWStructuredBuffer<uint>     gInstanceIndices  : register(u1);
+RWStructuredBuffer<uint>     gObjectLods       : register(u2);
+
+#ifdef HIZ_OCCLUSION
+Texture2D<float>             gHiZ              : register(t1);
+
+// True if the box is behind the pyramid everywhere it covers on screen.  Boxes
+// that reach behind the camera or off screen are never occluded.
+bool IsOccluded(float3 center, float3 extents)
+{
+    float2 ndcMin = float2(1.0f, 1.0f);
+    float2 ndcMax = float2(-1.0f, -1.0f);
+    float nearestDepth = 1.0f;
+
+    [unroll]
+    for(uint i = 0; i < 8; ++i)
+    {
+        float3 corner = center + extents*float3((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : -1.0f);
+        float4 clip = mul(float4(corner, 1.0f), gHiZViewProj);
+        if(clip.w <= 1e-5f)
+            return false;
+
+        float3 ndc = clip.xyz / clip.w;
+        ndcMin = min(ndcMin, ndc.xy);
+        ndcMax = max(ndcMax, ndc.xy);
+        nearestDepth = min(nearestDepth, ndc.z);
+    }
+
+    if(any(ndcMin < -1.0f) || any(ndcMax > 1.0f))
+        return false;
+
+    // Level 0 texels cover 2x2 pixels of the depth buffer; texture rows go down.
+    float2 uvMin = float2(ndcMin.x, -ndcMax.y)*0.5f + 0.5f;
+    float2 uvMax = float2(ndcMax.x, -ndcMin.y)*0.5f + 0.5f;
+    float2 texelMin = uvMin*gHiZRenderSize*0.5f;
+    float2 texelMax = uvMax*gHiZRenderSize*0.5f;
+
+    // The finest level at which the rectangle spans at most two texels each way,
+    // so four loads cover it.
+    float2 extent = texelMax - texelMin;
+    uint mip = (uint)clamp(ceil(log2(max(max(extent.x, extent.y), 1.0f))), 0.0f, (float)(gHiZMipCount - 1));
+
+    // Only the top left corner of each level was built; see RecordHiZ.
+    uint2 levelSize = max(((gHiZRenderSize + 1) / 2 + (1u << mip) - 1) >> mip, uint2(1, 1));
+    float scale = 1.0f / (float)(1u << mip);
+    uint2 t0 = min((uint2)(texelMin*scale), levelSize - 1);
+    uint2 t1 = min((uint2)(texelMax*scale), levelSize - 1);
+
+    float farthest = max(max(gHiZ.Load(int3(t0, mip)), gHiZ.Load(int3(t1.x, t0.y, mip))),
+                         max(gHiZ.Load(int3(t0.x, t1.y, mip)), gHiZ.Load(int3(t1, mip))));
+
+    return nearestDepth > farthest;
+}
+#endif
+
+// Same as SelectLod in LitColumnsApp.cpp: the level only changes once the
+// screen size is gLodHysteresis past a threshold.
+uint SelectLod(float screenSize, uint current, uint lodCount)
+{
+    uint finest = 0;
+    uint coarsest = 0;
+
+    [unroll]
+    for(uint i = 0; i < MAX_LODS - 1; ++i)
+    {
+        if(i + 1 < lodCount)
+        {
+            finest   += screenSize < gLodScreenSizes[i]*(1.0f - gLodHysteresis) ? 1 : 0;
+            coarsest += screenSize < gLodScreenSizes[i]*(1.0f + gLodHysteresis) ? 1 : 0;
+        }
+    }
+
+    return clamp(current, finest, coarsest);
+}
+
+[numthreads(64, 1, 1)]
+void CS(uint3 dispatchThreadID : SV_DispatchThreadID)
+{
+    uint objectIndex = dispatchThreadID.x;
+    if(objectIndex >= gObjectCount)
+        return;
+
+    CullObject obj = gCullObjects[objectIndex];
+    if(obj.DrawCommand == NO_DRAW_COMMAND)
+        return;
+
+    // The box is outside if it lies entirely behind any plane.
+    if(gCullingEnabled)
+    {
+        [unroll]
+        for(int i = 0; i < 6; ++i)
+        {
+            float4 plane = gFrustumPlanes[i];
+            float radius = dot(obj.Extents, abs(plane.xyz));
+            if(dot(obj.Center, plane.xyz) + plane.w < -radius)
+                return;
+        }
+
+#ifdef HIZ_OCCLUSION
+        if(gHiZMipCount > 0 && IsOccluded(obj.Center, obj.Extents))
+            return;
+#endif
+    }
+
+    uint lod = 0;
+    if(obj.LodCount > 1)
+    {
+        float radius = length(obj.Extents);
+        float screenSize = radius * gLodScale / max(distance(obj.Center, gEyePosW), 0.001f);
+
+        lod = SelectLod(screenSize, gObjectLods[objectIndex], obj.LodCount);
+        gObjectLods[objectIndex] = lod;
+    }
+
+    uint commandOffset = (obj.DrawCommand + lod) * COMMAND_STRIDE;
+
+    uint slot;
+    gDrawCommands.InterlockedAdd(commandOffset + INSTANCE_COUNT_OFFSET, 1, slot);
+
+    uint instanceStart = gDrawCommands.Load(commandOffset + INSTANCE_START_OFFSET);
+    gInstanceIndices[instanceStart + slot] = objectIndex;
+}
@@ -4,71 +4,66 @@
 // Default shader, currently supports lighting.
 //***************************************************************************************
 
-// Defaults for number of lights.
-#ifndef NUM_DIR_LIGHTS
-    #define NUM_DIR_LIGHTS 3
-#endif
-
-#ifndef NUM_POINT_LIGHTS
-    #define NUM_POINT_LIGHTS 0
-#endif
-
-#ifndef NUM_SPOT_LIGHTS
-    #define NUM_SPOT_LIGHTS 0
-#endif
-
 // Include structures and functions for lighting.
 #include "LightingUtil.hlsl"
 
-Texture2D    gDiffuseMap : register(t0);
-SamplerState gsamLinear  : register(s0);
-
-
-// Constant data that varies per frame.
-cbuffer cbPerObject : register(b0)
+struct InstanceData
 {
-    float4x4 gWorld;
-    float4x4 gTexTransform;
+    float4x4 World;
+    float4x4 TexTransform;
+    float3   PosScale;
+    uint     MaterialIndex;
+    float3   PosBias;
+    float    InstPad1;
 };
 
-// Constant data that varies per material.
-cbuffer cbPass : register(b1)
+struct MaterialData
 {
-    float4x4 gView;
-    float4x4 gInvView;
-    float4x4 gProj;
-    float4x4 gInvProj;
-    float4x4 gViewProj;
-    float4x4 gInvViewProj;
-    float3 gEyePosW;
-    float cbPerObjectPad1;
-    float2 gRenderTargetSize;
-    float2 gInvRenderTargetSize;
-    float gNearZ;
-    float gFarZ;
-    float gTotalTime;
-    float gDeltaTime;
-    float4 gAmbientLight;
-
-    // Indices [0, NUM_DIR_LIGHTS) are directional lights;
-    // indices [NUM_DIR_LIGHTS, NUM_DIR_LIGHTS+NUM_POINT_LIGHTS) are point lights;
-    // indices [NUM_DIR_LIGHTS+NUM_POINT_LIGHTS, NUM_DIR_LIGHTS+NUM_POINT_LIGHT+NUM_SPOT_LIGHTS)
-    // are spot lights for a maximum of MaxLights per object.
-    Light gLights[MaxLights];
+    float4   DiffuseAlbedo;
+    float3   FresnelR0;
+    float    Roughness;
+    float4x4 MatTransform;
+    uint     DiffuseMapIndex;
+    uint     DiffuseSlice;
+    uint     MatPad1;
+    uint     MatPad2;
 };
 
-cbuffer cbMaterial : register(b2)
+// Every texture in the shader-visible heap, indexed by descriptor index.  All
+// material textures are viewed as arrays, so textures packed together by
+// Tools/TexturePacker are one descriptor and a slice.
+Texture2DArray gTextureMaps[] : register(t0, space2);
+SamplerState   gsamLinear     : register(s0);
+
+// Per-object data for every render item, the object indices drawn this frame
+// and every material.  Kept in space1 so they do not overlap the texture
+// registers.
+StructuredBuffer<InstanceData> gInstanceData    : register(t0, space1);
+StructuredBuffer<uint>         gInstanceIndices : register(t1, space1);
+StructuredBuffer<MaterialData> gMaterialData    : register(t2, space1);
+
+// Root constants set per draw: the instance group's first entry in
+// gInstanceIndices.  The material comes from the instance; the first constant
+// is only used by TreeSprite.hlsl.
+cbuffer cbDraw : register(b3)
 {
-	float4 gDiffuseAlbedo;
-    float3 gFresnelR0;
-    float  gRoughness;
-    float4x4 gMatTransform;
+    uint cbDrawPad0;
+    uint gInstanceStart;
 };
 
+// Camera, lighting and time constants, shared with the C++ side.
+#include "PassConstants.h"
+
+// Point and spot lights, and the lights LightCull.hlsl binned into every cluster.
+StructuredBuffer<Light> gLights        : register(t5, space1);
+StructuredBuffer<uint>  gClusterLights : register(t6, space1);
+
+// Compressed vertex (VertexCompression.h): the position is a unorm within the
+// bounds of the mesh and the normal is octahedral encoded.
 struct VertexIn
 {
-	float3 PosL    : POSITION;
-    float3 NormalL : NORMAL;
+	float3 PosQ    : POSITION;
+    float2 NormalQ : NORMAL;
 	float2 TexC    : TEXCOORD;
 };
 
@@ -78,32 +73,58 @@ struct VertexOut
     float3 PosW    : POSITION;
     float3 NormalW : NORMAL;
 	float2 TexC    : TEXCOORD;
+    nointerpolation uint MatIndex : MATERIAL;
 };
 
-VertexOut VS(VertexIn vin)
+float3 DecodeOctahedral(float2 e)
+{
+    // Unfold the lower half of the octahedron.
+    float3 n = float3(e, 1.0f - abs(e.x) - abs(e.y));
+    float t = saturate(-n.z);
+    n.xy += n.xy >= 0.0f ? -t : t;
+
+    return normalize(n);
+}
+
+VertexOut VS(VertexIn vin, uint instanceID : SV_InstanceID)
 {
 	VertexOut vout = (VertexOut)0.0f;
+
+	// Fetch the instance and material data.
+	InstanceData instData = gInstanceData[gInstanceIndices[gInstanceStart + instanceID]];
+	MaterialData matData = gMaterialData[instData.MaterialIndex];
+	float4x4 world = instData.World;
+	float4x4 texTransform = instData.TexTransform;
 	
+    float3 posL = vin.PosQ*instData.PosScale + instData.PosBias;
+    float3 normalL = DecodeOctahedral(vin.NormalQ);
+
     // Transform to world space.
-    float4 posW = mul(float4(vin.PosL, 1.0f), gWorld);
+    float4 posW = mul(float4(posL, 1.0f), world);
     vout.PosW = posW.xyz;
 
     // Assumes nonuniform scaling; otherwise, need to use inverse-transpose of world matrix.
-    vout.NormalW = mul(vin.NormalL, (float3x3)gWorld);
+    vout.NormalW = mul(normalL, (float3x3)world);
 
     // Transform to homogeneous clip space.
     vout.PosH = mul(posW, gViewProj);
 	
 	// Output vertex attributes for interpolation across triangle.
-    float4 texC = mul(float4(vin.TexC, 0.0f, 1.0f), gTexTransform);
-    vout.TexC = mul(texC, gMatTransform).xy;
+    float4 texC = mul(float4(vin.TexC, 0.0f, 1.0f), texTransform);
+    vout.TexC = mul(texC, matData.MatTransform).xy;
+    vout.MatIndex = instData.MaterialIndex;
 
     return vout;
 }
 
 float4 PS(VertexOut pin) : SV_Target
 {
-    float4 diffuseAlbedo = gDiffuseMap.Sample(gsamLinear, pin.TexC) * gDiffuseAlbedo;
+	MaterialData matData = gMaterialData[pin.MatIndex];
+
+    // Instances of one draw can have different materials, so the texture index
+    // may vary within a wave.
+    float4 diffuseAlbedo = gTextureMaps[NonUniformResourceIndex(matData.DiffuseMapIndex)].Sample(gsamLinear,
+        float3(pin.TexC, matData.DiffuseSlice)) * matData.DiffuseAlbedo;
 
     // Interpolating normal can unnormalize it, so renormalize it.
     pin.NormalW = normalize(pin.NormalW);
@@ -114,11 +135,13 @@ float4 PS(VertexOut pin) : SV_Target
     // Light terms.
     float4 ambient = gAmbientLight*diffuseAlbedo;
 
-    const float shininess = 1.0f - gRoughness;
-    Material mat = { diffuseAlbedo, gFresnelR0, shininess };
+    const float shininess = 1.0f - matData.Roughness;
+    Material mat = { diffuseAlbedo, matData.FresnelR0, shininess };
     float3 shadowFactor = 1.0f;
-    float4 directLight = ComputeLighting(gLights, mat, pin.PosW,
-        pin.NormalW, toEyeW, shadowFactor);
+    float viewZ = mul(float4(pin.PosW, 1.0f), gView).z;
+    uint cluster = ComputeClusterIndex(pin.PosH.xy, viewZ, gClusterTileScale, gClusterDepthScale, gClusterDepthBias);
+    float4 directLight = ComputeLighting(gDirLights, gDirLightCount, gLights, gClusterLights, cluster,
+        mat, pin.PosW, pin.NormalW, toEyeW, shadowFactor);
 
     float4 litColor = ambient + directLight;
 
@@ -0,0 +1,38 @@
+//***************************************************************************************
+// HiZ.hlsl
+//
+// Builds one level of the hierarchical-Z pyramid.  Every texel keeps the farthest
+// depth of the 2x2 source texels under it, so a box whose nearest depth is
+// behind a pyramid texel is hidden everywhere that texel covers.  Level 0 reads
+// the depth buffer after the depth pre-pass; every later level reads the one
+// above it.
+//
+// Levels are ceil(size/2) of their source, so the last row and column of an odd
+// sized source still land in a texel.
+//***************************************************************************************
+
+cbuffer cbHiZ : register(b0)
+{
+    uint2 gSrcSize;
+    uint2 gDstSize;
+};
+
+Texture2D<float>   gSrc : register(t0);
+RWTexture2D<float> gDst : register(u0);
+
+[numthreads(8, 8, 1)]
+void CS(uint3 dispatchThreadID : SV_DispatchThreadID)
+{
+    if(any(dispatchThreadID.xy >= gDstSize))
+        return;
+
+    uint2 src = dispatchThreadID.xy*2;
+    uint2 last = gSrcSize - 1;
+
+    float d0 = gSrc[min(src, last)];
+    float d1 = gSrc[min(src + uint2(1, 0), last)];
+    float d2 = gSrc[min(src + uint2(0, 1), last)];
+    float d3 = gSrc[min(src + uint2(1, 1), last)];
+
+    gDst[dispatchThreadID.xy] = max(max(d0, d1), max(d2, d3));
+}
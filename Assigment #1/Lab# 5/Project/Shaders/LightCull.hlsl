@@ -0,0 +1,109 @@
+//***************************************************************************************
+// LightCull.hlsl
+//
+// Bins the point and spot lights into the view space clusters read by
+// ComputeLighting.  One thread per cluster builds the cluster's bounding box,
+// then the group walks the lights in batches staged in group shared memory and
+// every thread keeps the lights whose range sphere touches its box.
+//***************************************************************************************
+
+#include "LightingUtil.hlsl"
+
+#define GROUP_SIZE 64
+
+cbuffer cbLightCull : register(b0)
+{
+    float4x4 gView;
+    float4x4 gInvProj;
+    float2 gTileSize;
+    float2 gInvRenderTargetSize;
+    float gNearZ;
+    float gFarZ;
+    uint gLightCount;
+    uint cbLightCullPad0;
+};
+
+StructuredBuffer<Light>  gLights        : register(t0);
+RWStructuredBuffer<uint> gClusterLights : register(u0);
+
+// View space position and range of the lights of the current batch.
+groupshared float4 gsLightSpheres[GROUP_SIZE];
+
+// Direction through a pixel position, scaled to a view space depth of 1.
+float3 ScreenToViewRay(float2 screenPos)
+{
+    float2 ndc = float2(2.0f, -2.0f)*screenPos*gInvRenderTargetSize + float2(-1.0f, 1.0f);
+    float4 p = mul(float4(ndc, 1.0f, 1.0f), gInvProj);
+    p.xyz /= p.w;
+
+    return p.xyz / p.z;
+}
+
+[numthreads(GROUP_SIZE, 1, 1)]
+void CS(uint3 dispatchThreadID : SV_DispatchThreadID, uint groupIndex : SV_GroupIndex)
+{
+    const uint clusterCount = CLUSTER_COUNT_X*CLUSTER_COUNT_Y*CLUSTER_COUNT_Z;
+
+    // Threads past the last cluster still help stage the lights.
+    uint cluster = dispatchThreadID.x;
+    bool active = cluster < clusterCount;
+
+    uint tileX = cluster % CLUSTER_COUNT_X;
+    uint tileY = (cluster / CLUSTER_COUNT_X) % CLUSTER_COUNT_Y;
+    uint slice = cluster / (CLUSTER_COUNT_X*CLUSTER_COUNT_Y);
+
+    // The cluster's depth range, and the box around the four corner rays of its
+    // tile between those depths.
+    float sliceNear = gNearZ*pow(gFarZ / gNearZ, (float)slice / CLUSTER_COUNT_Z);
+    float sliceFar = gNearZ*pow(gFarZ / gNearZ, (float)(slice + 1) / CLUSTER_COUNT_Z);
+
+    float2 tileMin = float2(tileX, tileY)*gTileSize;
+    float2 tileMax = tileMin + gTileSize;
+
+    float3 boxMin = float3(1e30f, 1e30f, sliceNear);
+    float3 boxMax = float3(-1e30f, -1e30f, sliceFar);
+
+    [unroll]
+    for(uint c = 0; c < 4; ++c)
+    {
+        float2 corner = float2((c & 1) ? tileMax.x : tileMin.x, (c & 2) ? tileMax.y : tileMin.y);
+        float3 ray = ScreenToViewRay(corner);
+
+        boxMin.xy = min(boxMin.xy, min(ray.xy*sliceNear, ray.xy*sliceFar));
+        boxMax.xy = max(boxMax.xy, max(ray.xy*sliceNear, ray.xy*sliceFar));
+    }
+
+    uint base = cluster*CLUSTER_STRIDE;
+    uint count = 0;
+
+    for(uint batch = 0; batch < gLightCount; batch += GROUP_SIZE)
+    {
+        uint lightIndex = batch + groupIndex;
+        if(lightIndex < gLightCount)
+        {
+            Light light = gLights[lightIndex];
+            gsLightSpheres[groupIndex] = float4(mul(float4(light.Position, 1.0f), gView).xyz, light.FalloffEnd);
+        }
+
+        GroupMemoryBarrierWithGroupSync();
+
+        uint batchSize = min(GROUP_SIZE, gLightCount - batch);
+        for(uint i = 0; active && i < batchSize; ++i)
+        {
+            // Sphere against box: the squared distance from the center to the
+            // nearest point of the box.
+            float4 sphere = gsLightSpheres[i];
+            float3 d = max(max(boxMin - sphere.xyz, 0.0f), sphere.xyz - boxMax);
+            if(dot(d, d) <= sphere.w*sphere.w && count < MAX_LIGHTS_PER_CLUSTER)
+            {
+                gClusterLights[base + 1 + count] = batch + i;
+                ++count;
+            }
+        }
+
+        GroupMemoryBarrierWithGroupSync();
+    }
+
+    if(active)
+        gClusterLights[base] = count;
+}
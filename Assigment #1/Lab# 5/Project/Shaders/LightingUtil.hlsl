@@ -4,7 +4,22 @@
 // Contains API for shader lighting.
 //***************************************************************************************
 
-#define MaxLights 16
+// Directional lights live in the pass constants.  Point and spot lights live in
+// a structured buffer, binned by LightCull.hlsl into a grid of view space
+// clusters: CLUSTER_COUNT_X by CLUSTER_COUNT_Y screen tiles, each cut into
+// CLUSTER_COUNT_Z depth slices that grow exponentially from the near plane to the
+// far plane.  Must match gMaxDirLights and gCluster* in the app.
+#define MAX_DIR_LIGHTS 3
+
+#define CLUSTER_COUNT_X 16
+#define CLUSTER_COUNT_Y 9
+#define CLUSTER_COUNT_Z 24
+
+// Every cluster owns CLUSTER_STRIDE uints of the cluster light buffer: the number
+// of lights touching it followed by their indices.  Lights past the cap are
+// dropped.
+#define MAX_LIGHTS_PER_CLUSTER 127
+#define CLUSTER_STRIDE (MAX_LIGHTS_PER_CLUSTER + 1)
 
 struct Light
 {
@@ -13,7 +28,7 @@ struct Light
     float3 Direction;   // directional/spot light only
     float FalloffEnd;   // point/spot light only
     float3 Position;    // point light only
-    float SpotPower;    // spot light only
+    float SpotPower;    // spot light only; 0 makes a point light
 };
 
 struct Material
@@ -135,34 +150,53 @@ float3 ComputeSpotLight(Light L, Material mat, float3 pos, float3 normal, float3
     return BlinnPhong(lightStrength, lightVec, normal, toEye, mat);
 }
 
-float4 ComputeLighting(Light gLights[MaxLights], Material mat,
-                       float3 pos, float3 normal, float3 toEye,
-                       float3 shadowFactor)
+//---------------------------------------------------------------------------------------
+// Evaluates a point or spot light from the light buffer.
+//---------------------------------------------------------------------------------------
+float3 ComputeLocalLight(Light L, Material mat, float3 pos, float3 normal, float3 toEye)
 {
-    float3 result = 0.0f;
+    if(L.SpotPower > 0.0f)
+        return ComputeSpotLight(L, mat, pos, normal, toEye);
 
-    int i = 0;
+    return ComputePointLight(L, mat, pos, normal, toEye);
+}
 
-#if (NUM_DIR_LIGHTS > 0)
-    for(i = 0; i < NUM_DIR_LIGHTS; ++i)
-    {
-        result += shadowFactor[i] * ComputeDirectionalLight(gLights[i], mat, normal, toEye);
-    }
-#endif
+//---------------------------------------------------------------------------------------
+// Index of the cluster holding a pixel.  screenPos is in pixels (SV_Position.xy)
+// and viewZ is the view space depth.  tileScale is one over the tile size in
+// pixels; the depth slice is log(viewZ)*depthScale + depthBias.
+//---------------------------------------------------------------------------------------
+uint ComputeClusterIndex(float2 screenPos, float viewZ, float2 tileScale, float depthScale, float depthBias)
+{
+    uint2 tile = min(uint2(screenPos*tileScale), uint2(CLUSTER_COUNT_X - 1, CLUSTER_COUNT_Y - 1));
+    uint slice = (uint)clamp(log(viewZ)*depthScale + depthBias, 0.0f, CLUSTER_COUNT_Z - 1.0f);
+
+    return (slice*CLUSTER_COUNT_Y + tile.y)*CLUSTER_COUNT_X + tile.x;
+}
+
+//---------------------------------------------------------------------------------------
+// Sums the directional lights and the local lights binned into cluster.
+//---------------------------------------------------------------------------------------
+float4 ComputeLighting(Light dirLights[MAX_DIR_LIGHTS], uint dirLightCount,
+                       StructuredBuffer<Light> lights, StructuredBuffer<uint> clusterLights, uint cluster,
+                       Material mat, float3 pos, float3 normal, float3 toEye,
+                       float3 shadowFactor)
+{
+    float3 result = 0.0f;
 
-#if (NUM_POINT_LIGHTS > 0)
-    for(i = NUM_DIR_LIGHTS; i < NUM_DIR_LIGHTS+NUM_POINT_LIGHTS; ++i)
+    [unroll]
+    for(uint i = 0; i < MAX_DIR_LIGHTS; ++i)
     {
-        result += ComputePointLight(gLights[i], mat, pos, normal, toEye);
+        if(i < dirLightCount)
+            result += shadowFactor[i] * ComputeDirectionalLight(dirLights[i], mat, normal, toEye);
     }
-#endif
 
-#if (NUM_SPOT_LIGHTS > 0)
-    for(i = NUM_DIR_LIGHTS + NUM_POINT_LIGHTS; i < NUM_DIR_LIGHTS + NUM_POINT_LIGHTS + NUM_SPOT_LIGHTS; ++i)
+    uint base = cluster*CLUSTER_STRIDE;
+    uint lightCount = clusterLights[base];
+    for(uint j = 0; j < lightCount; ++j)
     {
-        result += ComputeSpotLight(gLights[i], mat, pos, normal, toEye);
+        result += ComputeLocalLight(lights[clusterLights[base + 1 + j]], mat, pos, normal, toEye);
     }
-#endif 
 
     return float4(result, 0.0f);
 }
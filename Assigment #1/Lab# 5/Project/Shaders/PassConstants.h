@@ -0,0 +1,144 @@
+//***************************************************************************************
+// PassConstants.h
+//
+// The per-pass constant buffers, written once and compiled as both C++
+// (FrameResource.h) and HLSL (Default.hlsl, TreeSprite.hlsl), so the two sides
+// cannot disagree about a field.  Every block is an X-macro list of its fields;
+// HLSL turns it into a cbuffer of g-prefixed globals, C++ into a struct, and
+// the C++ side then checks every field against the HLSL packing rules, which is
+// what keeps the offsets identical.
+//
+// The blocks are split by how often their inputs change, so each is uploaded
+// only when it does:
+//   camera    b1   the camera moved or the render size changed
+//   lighting  b2   the directional lights or the fog changed
+//   time      b4   every frame
+//
+// Fields must be 4-byte types; keep the explicit padding, HLSL never adds any
+// to a list that passes the checks.
+//***************************************************************************************
+
+#ifndef PASS_CONSTANTS_H
+#define PASS_CONSTANTS_H
+
+#define PASS_CAMERA_FIELDS(FIELD, ARRAY) \
+    FIELD(float4x4, View) \
+    FIELD(float4x4, InvView) \
+    FIELD(float4x4, Proj) \
+    FIELD(float4x4, InvProj) \
+    FIELD(float4x4, ViewProj) \
+    FIELD(float4x4, InvViewProj) \
+    FIELD(float3,   EyePosW) \
+    FIELD(float,    NearZ) \
+    FIELD(float2,   RenderTargetSize) \
+    FIELD(float2,   InvRenderTargetSize) \
+    FIELD(float,    FarZ) \
+    FIELD(float,    ClusterDepthScale) \
+    FIELD(float2,   ClusterTileScale) \
+    FIELD(float,    ClusterDepthBias) \
+    FIELD(float,    CameraPad0) \
+    FIELD(float2,   CameraPad1)
+
+// The point and spot lights are in a structured buffer of their own.
+#define PASS_LIGHTING_FIELDS(FIELD, ARRAY) \
+    FIELD(float4,   AmbientLight) \
+    FIELD(float4,   FogColor) \
+    FIELD(float,    FogStart) \
+    FIELD(float,    FogRange) \
+    FIELD(uint,     DirLightCount) \
+    FIELD(uint,     LightingPad0) \
+    ARRAY(Light,    DirLights, MAX_DIR_LIGHTS)
+
+#define PASS_TIME_FIELDS(FIELD, ARRAY) \
+    FIELD(float,    TotalTime) \
+    FIELD(float,    DeltaTime) \
+    FIELD(float2,   TimePad0)
+
+#ifdef __cplusplus
+
+#include "../../../Common/d3dUtil.h"
+
+// Must match LightingUtil.hlsl.
+#define MAX_DIR_LIGHTS 3
+
+// HLSL type names for the field lists, which are declared and checked in here.
+namespace PassTypes
+{
+    using float4x4 = DirectX::XMFLOAT4X4;
+    using float4 = DirectX::XMFLOAT4;
+    using float3 = DirectX::XMFLOAT3;
+    using float2 = DirectX::XMFLOAT2;
+    using uint = UINT;
+    using Light = ::Light;
+
+    // A field may not straddle a 16-byte register, and arrays and anything larger
+    // than a register start on one.  Array elements other than the last are
+    // padded to whole registers, so the element has to fill them already.
+    constexpr bool PacksLikeHlsl(size_t offset, size_t size)
+    {
+        return size >= 16 ? offset % 16 == 0 : offset % 16 + size <= 16;
+    }
+
+    constexpr bool ArrayPacksLikeHlsl(size_t offset, size_t elementSize)
+    {
+        return offset % 16 == 0 && elementSize % 16 == 0;
+    }
+
+#define PASS_DECLARE_FIELD(type, name) type name;
+#define PASS_DECLARE_ARRAY(type, name, count) type name[count];
+
+#define PASS_CHECK_FIELD(type, name) \
+    static_assert(PacksLikeHlsl(offsetof(PASS_CHECKED_BLOCK, name), sizeof(type)), \
+        #name " does not pack the way HLSL packs it");
+#define PASS_CHECK_ARRAY(type, name, count) \
+    static_assert(ArrayPacksLikeHlsl(offsetof(PASS_CHECKED_BLOCK, name), sizeof(type)), \
+        #name " does not pack the way HLSL packs it");
+
+    struct CameraConstants { PASS_CAMERA_FIELDS(PASS_DECLARE_FIELD, PASS_DECLARE_ARRAY) };
+    struct LightingConstants { PASS_LIGHTING_FIELDS(PASS_DECLARE_FIELD, PASS_DECLARE_ARRAY) };
+    struct TimeConstants { PASS_TIME_FIELDS(PASS_DECLARE_FIELD, PASS_DECLARE_ARRAY) };
+
+#define PASS_CHECKED_BLOCK CameraConstants
+    PASS_CAMERA_FIELDS(PASS_CHECK_FIELD, PASS_CHECK_ARRAY)
+#undef PASS_CHECKED_BLOCK
+
+#define PASS_CHECKED_BLOCK LightingConstants
+    PASS_LIGHTING_FIELDS(PASS_CHECK_FIELD, PASS_CHECK_ARRAY)
+#undef PASS_CHECKED_BLOCK
+
+#define PASS_CHECKED_BLOCK TimeConstants
+    PASS_TIME_FIELDS(PASS_CHECK_FIELD, PASS_CHECK_ARRAY)
+#undef PASS_CHECKED_BLOCK
+
+    static_assert(sizeof(CameraConstants) % 16 == 0, "CameraConstants must be whole registers");
+    static_assert(sizeof(LightingConstants) % 16 == 0, "LightingConstants must be whole registers");
+    static_assert(sizeof(TimeConstants) % 16 == 0, "TimeConstants must be whole registers");
+}
+
+using PassTypes::CameraConstants;
+using PassTypes::LightingConstants;
+using PassTypes::TimeConstants;
+
+#else
+
+#define PASS_DECLARE_FIELD(type, name) type g##name;
+#define PASS_DECLARE_ARRAY(type, name, count) type g##name[count];
+
+cbuffer cbCamera : register(b1)
+{
+    PASS_CAMERA_FIELDS(PASS_DECLARE_FIELD, PASS_DECLARE_ARRAY)
+};
+
+cbuffer cbLighting : register(b2)
+{
+    PASS_LIGHTING_FIELDS(PASS_DECLARE_FIELD, PASS_DECLARE_ARRAY)
+};
+
+cbuffer cbTime : register(b4)
+{
+    PASS_TIME_FIELDS(PASS_DECLARE_FIELD, PASS_DECLARE_ARRAY)
+};
+
+#endif
+
+#endif // PASS_CONSTANTS_H
@@ -0,0 +1,82 @@
+//***************************************************************************************
+// SpriteCull.hlsl
+//
+// Culls the tree sprites for TreeSprite.hlsl.  One thread per sprite tests the
+// sprite against the camera frustum and thins the sprites out with distance, then
+// appends the survivors to the visible list and bumps the instance count of the
+// indirect draw that expands them into quads.
+//***************************************************************************************
+
+// Byte offset of InstanceCount in D3D12_DRAW_ARGUMENTS.
+#define INSTANCE_COUNT_OFFSET 4
+
+struct TreeSprite
+{
+    float3 PosW;
+    float2 SizeW;
+};
+
+cbuffer cbCull : register(b0)
+{
+    float4 gFrustumPlanes[6];
+    float3 gEyePosW;
+    uint   gCullingEnabled;
+    uint   gObjectCount;
+    uint   gSpriteCount;
+    float  gSpriteLodStart;
+    float  gSpriteLodEnd;
+    float4 gLodScreenSizes;
+    float  gLodScale;
+    float  gLodHysteresis;
+    float  cbCullPad0;
+    float  cbCullPad1;
+};
+
+StructuredBuffer<TreeSprite> gTreeSprites    : register(t0);
+RWByteAddressBuffer          gDrawArgs       : register(u0);
+RWStructuredBuffer<uint>     gVisibleSprites : register(u1);
+
+// Stable per-sprite random number in [0, 1).
+float Hash(uint x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352d;
+    x ^= x >> 15;
+    x *= 0x846ca68b;
+    x ^= x >> 16;
+    return (x & 0x00ffffff) / 16777216.0f;
+}
+
+[numthreads(64, 1, 1)]
+void CS(uint3 dispatchThreadID : SV_DispatchThreadID)
+{
+    uint spriteIndex = dispatchThreadID.x;
+    if(spriteIndex >= gSpriteCount)
+        return;
+
+    TreeSprite sprite = gTreeSprites[spriteIndex];
+
+    // Distance LOD: past gSpriteLodStart a shrinking, fixed subset of the sprites
+    // is kept, so sprites fade out evenly and do not flicker as the camera moves.
+    float density = saturate((gSpriteLodEnd - distance(sprite.PosW, gEyePosW)) / (gSpriteLodEnd - gSpriteLodStart));
+    if(Hash(spriteIndex) >= density)
+        return;
+
+    // The quad turns about the y axis, so test its bounding sphere.
+    if(gCullingEnabled)
+    {
+        float radius = 0.5f*length(sprite.SizeW);
+
+        [unroll]
+        for(int i = 0; i < 6; ++i)
+        {
+            float4 plane = gFrustumPlanes[i];
+            if(dot(sprite.PosW, plane.xyz) + plane.w < -radius)
+                return;
+        }
+    }
+
+    uint slot;
+    gDrawArgs.InterlockedAdd(INSTANCE_COUNT_OFFSET, 1, slot);
+    gVisibleSprites[slot] = spriteIndex;
+}
@@ -2,19 +2,6 @@
 // TreeSprite.hlsl by Frank Luna (C) 2015 All Rights Reserved.
 //***************************************************************************************
 
-// Defaults for number of lights.
-#ifndef NUM_DIR_LIGHTS
-    #define NUM_DIR_LIGHTS 3
-#endif
-
-#ifndef NUM_POINT_LIGHTS
-    #define NUM_POINT_LIGHTS 0
-#endif
-
-#ifndef NUM_SPOT_LIGHTS
-    #define NUM_SPOT_LIGHTS 0
-#endif
-
 // Include structures and functions for lighting.
 #include "LightingUtil.hlsl"
 
@@ -28,145 +15,99 @@ SamplerState gsamLinearClamp      : register(s3);
 SamplerState gsamAnisotropicWrap  : register(s4);
 SamplerState gsamAnisotropicClamp : register(s5);
 
-// Constant data that varies per frame.
-cbuffer cbPerObject : register(b0)
+struct TreeSprite
 {
-    float4x4 gWorld;
-	float4x4 gTexTransform;
+    float3 PosW;
+    float2 SizeW;
 };
 
-// Constant data that varies per material.
-cbuffer cbPass : register(b1)
+// Every sprite, and the sprites that survived SpriteCull.hlsl this frame.  The
+// vertex shader pulls its sprite from these instead of reading a vertex buffer.
+StructuredBuffer<TreeSprite> gTreeSprites    : register(t3, space1);
+StructuredBuffer<uint>       gVisibleSprites : register(t4, space1);
+
+// Camera, lighting and time constants, shared with the C++ side.
+#include "PassConstants.h"
+
+// Point and spot lights, and the lights LightCull.hlsl binned into every cluster.
+StructuredBuffer<Light> gLights        : register(t5, space1);
+StructuredBuffer<uint>  gClusterLights : register(t6, space1);
+
+struct MaterialData
 {
-    float4x4 gView;
-    float4x4 gInvView;
-    float4x4 gProj;
-    float4x4 gInvProj;
-    float4x4 gViewProj;
-    float4x4 gInvViewProj;
-    float3 gEyePosW;
-    float cbPerObjectPad1;
-    float2 gRenderTargetSize;
-    float2 gInvRenderTargetSize;
-    float gNearZ;
-    float gFarZ;
-    float gTotalTime;
-    float gDeltaTime;
-    float4 gAmbientLight;
-
-	float4 gFogColor;
-	float gFogStart;
-	float gFogRange;
-	float2 cbPerObjectPad2;
-
-    // Indices [0, NUM_DIR_LIGHTS) are directional lights;
-    // indices [NUM_DIR_LIGHTS, NUM_DIR_LIGHTS+NUM_POINT_LIGHTS) are point lights;
-    // indices [NUM_DIR_LIGHTS+NUM_POINT_LIGHTS, NUM_DIR_LIGHTS+NUM_POINT_LIGHT+NUM_SPOT_LIGHTS)
-    // are spot lights for a maximum of MaxLights per object.
-    Light gLights[MaxLights];
+    float4   DiffuseAlbedo;
+    float3   FresnelR0;
+    float    Roughness;
+    float4x4 MatTransform;
+    uint     DiffuseMapIndex;
+    uint     DiffuseSlice;
+    uint     MatPad1;
+    uint     MatPad2;
 };
 
-cbuffer cbMaterial : register(b2)
+// Shared with Default.hlsl.  The tree array itself is still bound through the
+// descriptor table at t0, as every sprite picks its own slice.
+StructuredBuffer<MaterialData> gMaterialData : register(t2, space1);
+
+cbuffer cbDraw : register(b3)
 {
-	float4   gDiffuseAlbedo;
-    float3   gFresnelR0;
-    float    gRoughness;
-	float4x4 gMatTransform;
+    uint gMaterialIndex;
+    uint gInstanceStart;
 };
  
-struct VertexIn
-{
-	float3 PosW  : POSITION;
-	float2 SizeW : SIZE;
-};
-
 struct VertexOut
-{
-	float3 CenterW : POSITION;
-	float2 SizeW   : SIZE;
-};
-
-struct GeoOut
 {
 	float4 PosH    : SV_POSITION;
     float3 PosW    : POSITION;
     float3 NormalW : NORMAL;
     float2 TexC    : TEXCOORD;
-    uint   PrimID  : SV_PrimitiveID;
+    nointerpolation uint ArraySlice : SLICE;
 };
 
-VertexOut VS(VertexIn vin)
-{
-	VertexOut vout;
+// Corners of the quad, as two triangles of the strip v0 v1 v2 v3.
+static const uint gQuadCorners[6] = { 0, 1, 2, 2, 1, 3 };
 
-	// Just pass data over to geometry shader.
-	vout.CenterW = vin.PosW;
-	vout.SizeW   = vin.SizeW;
+// Draws six vertices per visible sprite and expands each into its corner of a
+// camera-facing quad.
+VertexOut VS(uint vertexID : SV_VertexID, uint instanceID : SV_InstanceID)
+{
+	uint spriteIndex = gVisibleSprites[instanceID];
+	TreeSprite sprite = gTreeSprites[spriteIndex];
 
-	return vout;
-}
- 
- // We expand each point into a quad (4 vertices), so the maximum number of vertices
- // we output per geometry shader invocation is 4.
-[maxvertexcount(4)]
-void GS(point VertexOut gin[1], 
-        uint primID : SV_PrimitiveID, 
-        inout TriangleStream<GeoOut> triStream)
-{	
 	//
 	// Compute the local coordinate system of the sprite relative to the world
 	// space such that the billboard is aligned with the y-axis and faces the eye.
 	//
 
 	float3 up = float3(0.0f, 1.0f, 0.0f);
-	float3 look = gEyePosW - gin[0].CenterW;
+	float3 look = gEyePosW - sprite.PosW;
 	look.y = 0.0f; // y-axis aligned, so project to xz-plane
 	look = normalize(look);
 	float3 right = cross(up, look);
 
-	//
-	// Compute triangle strip vertices (quad) in world space.
-	//
-	float halfWidth  = 0.5f*gin[0].SizeW.x;
-	float halfHeight = 0.5f*gin[0].SizeW.y;
-	
-	float4 v[4];
-	v[0] = float4(gin[0].CenterW + halfWidth*right - halfHeight*up, 1.0f);
-	v[1] = float4(gin[0].CenterW + halfWidth*right + halfHeight*up, 1.0f);
-	v[2] = float4(gin[0].CenterW - halfWidth*right - halfHeight*up, 1.0f);
-	v[3] = float4(gin[0].CenterW - halfWidth*right + halfHeight*up, 1.0f);
+	// v0 and v1 are on the right, v1 and v3 at the top.
+	uint corner = gQuadCorners[vertexID];
+	float sx = corner < 2 ? 1.0f : -1.0f;
+	float sy = (corner & 1) ? 1.0f : -1.0f;
 
-	//
-	// Transform quad vertices to world space and output 
-	// them as a triangle strip.
-	//
-	
-	float2 texC[4] = 
-	{
-		float2(0.0f, 1.0f),
-		float2(0.0f, 0.0f),
-		float2(1.0f, 1.0f),
-		float2(1.0f, 0.0f)
-	};
-	
-	GeoOut gout;
-	[unroll]
-	for(int i = 0; i < 4; ++i)
-	{
-		gout.PosH     = mul(v[i], gViewProj);
-		gout.PosW     = v[i].xyz;
-		gout.NormalW  = look;
-		gout.TexC     = texC[i];
-		gout.PrimID   = primID;
-		
-		triStream.Append(gout);
-	}
+	float3 posW = sprite.PosW + (0.5f*sprite.SizeW.x*sx)*right + (0.5f*sprite.SizeW.y*sy)*up;
+
+	VertexOut vout;
+	vout.PosH       = mul(float4(posW, 1.0f), gViewProj);
+	vout.PosW       = posW;
+	vout.NormalW    = look;
+	vout.TexC       = float2(corner < 2 ? 0.0f : 1.0f, (corner & 1) ? 0.0f : 1.0f);
+	vout.ArraySlice = spriteIndex % 3;
+
+	return vout;
 }
 
-float4 PS(GeoOut pin) : SV_Target
+float4 PS(VertexOut pin) : SV_Target
 {
-	float3 uvw = float3(pin.TexC, pin.PrimID%3);
-    float4 diffuseAlbedo = gTreeMapArray.Sample(gsamAnisotropicWrap, uvw) * gDiffuseAlbedo;
+	MaterialData matData = gMaterialData[gMaterialIndex];
+
+	float3 uvw = float3(pin.TexC, pin.ArraySlice);
+    float4 diffuseAlbedo = gTreeMapArray.Sample(gsamAnisotropicWrap, uvw) * matData.DiffuseAlbedo;
 	
 #ifdef ALPHA_TEST
 	// Discard pixel if texture alpha < 0.1.  We do this test as soon 
@@ -186,11 +127,13 @@ float4 PS(GeoOut pin) : SV_Target
     // Light terms.
     float4 ambient = gAmbientLight*diffuseAlbedo;
 
-    const float shininess = 1.0f - gRoughness;
-    Material mat = { diffuseAlbedo, gFresnelR0, shininess };
+    const float shininess = 1.0f - matData.Roughness;
+    Material mat = { diffuseAlbedo, matData.FresnelR0, shininess };
     float3 shadowFactor = 1.0f;
-    float4 directLight = ComputeLighting(gLights, mat, pin.PosW,
-        pin.NormalW, toEyeW, shadowFactor);
+    float viewZ = mul(float4(pin.PosW, 1.0f), gView).z;
+    uint cluster = ComputeClusterIndex(pin.PosH.xy, viewZ, gClusterTileScale, gClusterDepthScale, gClusterDepthBias);
+    float4 directLight = ComputeLighting(gDirLights, gDirLightCount, gLights, gClusterLights, cluster,
+        mat, pin.PosW, pin.NormalW, toEyeW, shadowFactor);
 
     float4 litColor = ambient + directLight;
 
@@ -0,0 +1,45 @@
+//***************************************************************************************
+// Upscale.hlsl
+//
+// Stretches the scene, rendered into the top left corner of the offscreen target
+// at the dynamic resolution, over the whole back buffer with one full screen
+// triangle and bilinear filtering.
+//***************************************************************************************
+
+Texture2D    gSceneColor : register(t0);
+SamplerState gsamLinearClamp : register(s0);
+
+cbuffer cbUpscale : register(b0)
+{
+    // Rendered fraction of the offscreen target, and the size of one of its
+    // texels in uv.
+    float2 gUvScale;
+    float2 gInvSourceSize;
+};
+
+struct VertexOut
+{
+    float4 PosH : SV_POSITION;
+    float2 TexC : TEXCOORD;
+};
+
+VertexOut VS(uint vertexID : SV_VertexID)
+{
+    // Corners (0,0), (2,0) and (0,2) in uv cover the screen.
+    float2 uv = float2((vertexID << 1) & 2, vertexID & 2);
+
+    VertexOut vout;
+    vout.PosH = float4(uv.x*2.0f - 1.0f, 1.0f - uv.y*2.0f, 0.0f, 1.0f);
+    vout.TexC = uv;
+
+    return vout;
+}
+
+float4 PS(VertexOut pin) : SV_Target
+{
+    // Keep the filter footprint inside the rendered area, so the stale texels
+    // beyond it never bleed into the right and bottom edges.
+    float2 uv = min(pin.TexC*gUvScale, gUvScale - 0.5f*gInvSourceSize);
+
+    return gSceneColor.SampleLevel(gsamLinearClamp, uv, 0.0f);
+}
@@ -0,0 +1,343 @@
+//***************************************************************************************
+// MeshConverter.cpp
+//
+// Offline converter from the text mesh format used by Models/skull.txt and
+// Models/car.txt to the packed binary container described in Common/MeshFormat.h.
+//
+// Usage: MeshConverter <input.txt> <output.mesh> [submeshName] [-lods N]
+//
+// The submesh name defaults to the file name of the input without extension
+// (e.g., "skull").  Texture coordinates are not present in the text format and
+// are written as zero.  Vertices are compressed with Common/VertexCompression
+// within the bounds of the mesh.  16-bit indices are used whenever the vertex
+// count allows.
+//
+// N - 1 coarser detail levels (default 4 levels in total) are simplified with
+// Common/MeshSimplifier, each to half the triangles of the one before, and are
+// stored as the submeshes <submeshName>_lod1 and so on (see MeshFormat.h).  They
+// share the vertex stream of the full detail mesh.
+//
+// Vertices with identical attributes are merged on load.  Every level is then
+// reordered with Common/MeshOptimizer for the vertex cache and overdraw, and the
+// vertices are renumbered in order of first use.  The
+// ACMR of each level before and after is printed.
+//
+// Link with Common/MeshOptimizer.cpp, Common/MeshSimplifier.cpp and
+// Common/VertexCompression.cpp.  Only depends on the standard library so it
+// builds with any C++11 compiler.
+//***************************************************************************************
+
+#include "../../Common/MeshFormat.h"
+#include "../../Common/MeshOptimizer.h"
+#include "../../Common/MeshSimplifier.h"
+#include "../../Common/VertexCompression.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+	// Vertex as read from the text file; compressed when the file is written.
+	struct TextVertex
+	{
+		float Pos[3];
+		float Normal[3];
+		float TexC[2];
+	};
+
+	std::string DefaultSubmeshName(const std::string& path)
+	{
+		size_t slash = path.find_last_of("/\\");
+		std::string name = (slash == std::string::npos) ? path : path.substr(slash + 1);
+
+		size_t dot = name.find_last_of('.');
+		if(dot != std::string::npos)
+			name = name.substr(0, dot);
+
+		return name;
+	}
+
+	bool ReadTextMesh(const std::string& path,
+		std::vector<TextVertex>& vertices,
+		std::vector<std::uint32_t>& indices)
+	{
+		std::ifstream fin(path);
+		if(!fin)
+		{
+			std::cerr << path << " not found." << std::endl;
+			return false;
+		}
+
+		std::uint32_t vcount = 0;
+		std::uint32_t tcount = 0;
+		std::string ignore;
+
+		fin >> ignore >> vcount;
+		fin >> ignore >> tcount;
+		fin >> ignore >> ignore >> ignore >> ignore;
+
+		vertices.assign(vcount, TextVertex());
+		for(std::uint32_t i = 0; i < vcount; ++i)
+		{
+			TextVertex& v = vertices[i];
+			fin >> v.Pos[0] >> v.Pos[1] >> v.Pos[2];
+			fin >> v.Normal[0] >> v.Normal[1] >> v.Normal[2];
+			v.TexC[0] = 0.0f;
+			v.TexC[1] = 0.0f;
+		}
+
+		fin >> ignore;
+		fin >> ignore;
+		fin >> ignore;
+
+		indices.assign(3 * tcount, 0);
+		for(std::uint32_t i = 0; i < 3 * tcount; ++i)
+			fin >> indices[i];
+
+		if(!fin)
+		{
+			std::cerr << path << " is truncated or malformed." << std::endl;
+			return false;
+		}
+
+		for(std::uint32_t index : indices)
+		{
+			if(index >= vcount)
+			{
+				std::cerr << path << " references vertex " << index << " of " << vcount << "." << std::endl;
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	void WritePadding(std::ofstream& fout, std::uint64_t offset)
+	{
+		static const char zeros[MeshFormat::StreamAlignment] = {};
+
+		std::uint64_t padding = MeshFormat::AlignOffset(offset) - offset;
+		fout.write(zeros, (std::streamsize)padding);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<std::string> positional;
+	int lodCount = 4;
+	for(int i = 1; i < argc; ++i)
+	{
+		if(std::strcmp(argv[i], "-lods") == 0 && i + 1 < argc)
+			lodCount = std::atoi(argv[++i]);
+		else
+			positional.push_back(argv[i]);
+	}
+
+	if(positional.size() < 2 || positional.size() > 3 || lodCount < 1 || lodCount > 9)
+	{
+		std::cerr << "Usage: MeshConverter <input.txt> <output.mesh> [submeshName] [-lods N]" << std::endl;
+		return 1;
+	}
+
+	const std::string inputPath = positional[0];
+	const std::string outputPath = positional[1];
+	const std::string submeshName = positional.size() > 2 ? positional[2] : DefaultSubmeshName(inputPath);
+
+	// Leave room for the "_lodN" suffix.
+	if(submeshName.size() + 5 >= MeshFormat::MaxSubmeshName)
+	{
+		std::cerr << "Submesh name \"" << submeshName << "\" is too long." << std::endl;
+		return 1;
+	}
+
+	std::vector<TextVertex> vertices;
+	std::vector<std::uint32_t> indices;
+	if(!ReadTextMesh(inputPath, vertices, indices))
+		return 1;
+
+	{
+		std::vector<std::uint32_t> weld;
+		std::vector<TextVertex> welded(MeshOptimizer::ComputeWeldRemap(weld, vertices.data(), vertices.size(), sizeof(TextVertex)));
+		MeshOptimizer::RemapIndices(indices, weld);
+		MeshOptimizer::RemapVertices(welded.data(), vertices.data(), vertices.size(), sizeof(TextVertex), weld);
+		vertices.swap(welded);
+	}
+
+	//
+	// Bounds of the whole mesh.
+	//
+
+	float vMin[3] = { +FLT_MAX, +FLT_MAX, +FLT_MAX };
+	float vMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for(const TextVertex& v : vertices)
+	{
+		for(int j = 0; j < 3; ++j)
+		{
+			vMin[j] = v.Pos[j] < vMin[j] ? v.Pos[j] : vMin[j];
+			vMax[j] = v.Pos[j] > vMax[j] ? v.Pos[j] : vMax[j];
+		}
+	}
+
+	//
+	// Detail levels.  Every level is simplified from the full mesh, which keeps
+	// the error from piling up, and appended to the index stream.
+	//
+
+	const std::vector<std::uint32_t> fullIndices = indices;
+
+	std::vector<MeshFormat::Submesh> submeshes;
+	for(int lod = 0; lod < lodCount; ++lod)
+	{
+		std::string name = submeshName;
+		std::uint32_t startIndex = 0;
+		std::uint32_t indexCount = (std::uint32_t)fullIndices.size();
+
+		if(lod > 0)
+		{
+			if(vertices.empty())
+				break;
+
+			const std::size_t target = (fullIndices.size() / 3) >> lod;
+			std::vector<std::uint32_t> simplified = MeshSimplifier::Simplify(
+				vertices[0].Pos, vertices.size(), sizeof(TextVertex), fullIndices, target);
+
+			// Stop once the simplifier cannot get any further.
+			if(simplified.empty() || simplified.size() >= submeshes.back().IndexCount)
+				break;
+
+			name += "_lod" + std::to_string(lod);
+			startIndex = (std::uint32_t)indices.size();
+			indexCount = (std::uint32_t)simplified.size();
+			indices.insert(indices.end(), simplified.begin(), simplified.end());
+		}
+
+		MeshFormat::Submesh submesh;
+		std::memset(&submesh, 0, sizeof(submesh));
+		std::memcpy(submesh.Name, name.c_str(), name.size());
+		submesh.IndexCount = indexCount;
+		submesh.StartIndexLocation = startIndex;
+		submesh.BaseVertexLocation = 0;
+
+		// The coarser levels keep the bounds of the full mesh, so switching levels
+		// never changes the culling result.
+		for(int j = 0; j < 3; ++j)
+		{
+			submesh.BoundsCenter[j] = vertices.empty() ? 0.0f : 0.5f*(vMin[j] + vMax[j]);
+			submesh.BoundsExtents[j] = vertices.empty() ? 0.0f : 0.5f*(vMax[j] - vMin[j]);
+		}
+
+		submeshes.push_back(submesh);
+	}
+
+	//
+	// Reorder every level for the vertex cache and overdraw, then number the
+	// vertices in order of first use, full detail level first.
+	//
+
+	std::vector<std::vector<std::uint32_t>> levelIndices(submeshes.size());
+	std::vector<const std::vector<std::uint32_t>*> levelLists;
+	for(size_t i = 0; i < submeshes.size(); ++i)
+	{
+		std::vector<std::uint32_t>& level = levelIndices[i];
+		level.assign(indices.begin() + submeshes[i].StartIndexLocation,
+			indices.begin() + submeshes[i].StartIndexLocation + submeshes[i].IndexCount);
+
+		const float acmrBefore = MeshOptimizer::ComputeAcmr(level, vertices.size());
+		MeshOptimizer::OptimizeTriangleOrder(level, vertices.empty() ? nullptr : vertices[0].Pos, vertices.size(),
+			sizeof(TextVertex), MeshOptimizer::DefaultOverdrawThreshold);
+		const float acmrAfter = MeshOptimizer::ComputeAcmr(level, vertices.size());
+
+		std::printf("%s: ACMR %.3f -> %.3f\n", submeshes[i].Name, acmrBefore, acmrAfter);
+		levelLists.push_back(&level);
+	}
+
+	const std::vector<std::uint32_t> remap = MeshOptimizer::ComputeVertexFetchRemap(levelLists, vertices.size());
+	for(size_t i = 0; i < submeshes.size(); ++i)
+	{
+		MeshOptimizer::RemapIndices(levelIndices[i], remap);
+		std::copy(levelIndices[i].begin(), levelIndices[i].end(), indices.begin() + submeshes[i].StartIndexLocation);
+	}
+
+	std::vector<TextVertex> ordered(vertices.size());
+	MeshOptimizer::RemapVertices(ordered.data(), vertices.data(), vertices.size(), sizeof(TextVertex), remap);
+	vertices.swap(ordered);
+
+	//
+	// Lay out the streams.
+	//
+
+	const bool use16BitIndices = vertices.size() <= 0x10000;
+
+	std::vector<VertexCompression::CompressedVertex> compressed(vertices.size());
+	if(!vertices.empty())
+	{
+		VertexCompression::Compress(vertices[0].Pos, vertices[0].Normal, vertices[0].TexC,
+			sizeof(TextVertex), vertices.size(), submeshes[0].BoundsCenter, submeshes[0].BoundsExtents,
+			compressed.data());
+	}
+
+	MeshFormat::Header header;
+	std::memset(&header, 0, sizeof(header));
+	header.Magic = MeshFormat::Magic;
+	header.Version = MeshFormat::Version;
+	header.VertexStride = sizeof(VertexCompression::CompressedVertex);
+	header.VertexCount = (std::uint32_t)vertices.size();
+	header.IndexSize = use16BitIndices ? MeshFormat::IndexSize16 : MeshFormat::IndexSize32;
+	header.IndexCount = (std::uint32_t)indices.size();
+	header.SubmeshCount = (std::uint32_t)submeshes.size();
+
+	const std::uint64_t vbByteSize = (std::uint64_t)header.VertexCount * header.VertexStride;
+	const std::uint64_t ibByteSize = (std::uint64_t)header.IndexCount * header.IndexSize;
+
+	header.VertexDataOffset = MeshFormat::AlignOffset(sizeof(MeshFormat::Header));
+	header.IndexDataOffset = MeshFormat::AlignOffset(header.VertexDataOffset + vbByteSize);
+	header.SubmeshTableOffset = MeshFormat::AlignOffset(header.IndexDataOffset + ibByteSize);
+
+	std::ofstream fout(outputPath, std::ios::binary);
+	if(!fout)
+	{
+		std::cerr << "Cannot open " << outputPath << " for writing." << std::endl;
+		return 1;
+	}
+
+	fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	WritePadding(fout, sizeof(header));
+
+	fout.write(reinterpret_cast<const char*>(compressed.data()), (std::streamsize)vbByteSize);
+	WritePadding(fout, header.VertexDataOffset + vbByteSize);
+
+	if(use16BitIndices)
+	{
+		std::vector<std::uint16_t> indices16(indices.begin(), indices.end());
+		fout.write(reinterpret_cast<const char*>(indices16.data()), (std::streamsize)ibByteSize);
+	}
+	else
+	{
+		fout.write(reinterpret_cast<const char*>(indices.data()), (std::streamsize)ibByteSize);
+	}
+	WritePadding(fout, header.IndexDataOffset + ibByteSize);
+
+	fout.write(reinterpret_cast<const char*>(submeshes.data()), (std::streamsize)(submeshes.size() * sizeof(MeshFormat::Submesh)));
+
+	if(!fout)
+	{
+		std::cerr << "Failed writing " << outputPath << "." << std::endl;
+		return 1;
+	}
+
+	std::cout << outputPath << ": " << header.VertexCount << " vertices, "
+		<< header.IndexCount << " indices (" << 8 * header.IndexSize << "-bit), submesh \""
+		<< submeshName << "\"";
+	for(size_t i = 1; i < submeshes.size(); ++i)
+		std::cout << (i == 1 ? " with LODs of " : ", ") << submeshes[i].IndexCount / 3;
+	std::cout << (submeshes.size() > 1 ? " triangles." : ".") << std::endl;
+
+	return 0;
+}
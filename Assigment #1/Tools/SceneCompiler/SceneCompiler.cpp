@@ -0,0 +1,363 @@
+//***************************************************************************************
+// SceneCompiler.cpp
+//
+// Offline compiler from the text scene description (e.g., Scenes/castle.scene.txt)
+// to the binary container described in Common/SceneFormat.h.
+//
+// Usage: SceneCompiler <input.txt> <output.scene>
+//
+// The text form is line based; '#' starts a comment:
+//
+//   chunk <name>
+//       Starts a chunk.  Every object belongs to the chunk before it.
+//   object <geometry> <submesh> <material> [opaque|alphatested|transparent]
+//       Adds an object, opaque unless a layer is given, with identity
+//       transforms.
+//   scale x y z | rotatex a | rotatey a | rotatez a | translate x y z
+//       Appended to the world transform of the current object, so they apply
+//       in the order written.  Angles are in radians.
+//   texscale x y z
+//       Appended to the texture transform of the current object.
+//
+// Chunk names must be unique, since the runtime matches chunks by name when it
+// reloads the file.  The binary file is written to a temporary name and renamed
+// at the end, so a running app never reads a half-written scene.
+//
+// Only depends on the standard library so it builds with any C++11 compiler.
+//***************************************************************************************
+
+#include "../../Common/SceneFormat.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+	struct SourceChunk
+	{
+		std::string Name;
+		std::vector<SceneFormat::Object> Objects;
+	};
+
+	// Row-major 4x4 for row vectors.
+	struct Matrix
+	{
+		float M[16];
+	};
+
+	Matrix Identity()
+	{
+		Matrix m;
+		for(int i = 0; i < 16; ++i)
+			m.M[i] = (i % 5 == 0) ? 1.0f : 0.0f;
+		return m;
+	}
+
+	Matrix Multiply(const Matrix& a, const Matrix& b)
+	{
+		Matrix r;
+		for(int row = 0; row < 4; ++row)
+		{
+			for(int col = 0; col < 4; ++col)
+			{
+				float sum = 0.0f;
+				for(int k = 0; k < 4; ++k)
+					sum += a.M[row*4 + k]*b.M[k*4 + col];
+				r.M[row*4 + col] = sum;
+			}
+		}
+		return r;
+	}
+
+	Matrix Scaling(float x, float y, float z)
+	{
+		Matrix m = Identity();
+		m.M[0] = x;
+		m.M[5] = y;
+		m.M[10] = z;
+		return m;
+	}
+
+	Matrix Translation(float x, float y, float z)
+	{
+		Matrix m = Identity();
+		m.M[12] = x;
+		m.M[13] = y;
+		m.M[14] = z;
+		return m;
+	}
+
+	// Same conventions as XMMatrixRotationX/Y/Z.
+	Matrix Rotation(int axis, float angle)
+	{
+		const float c = std::cos(angle);
+		const float s = std::sin(angle);
+
+		Matrix m = Identity();
+		const int i = (axis + 1) % 3;
+		const int j = (axis + 2) % 3;
+		m.M[i*4 + i] = c;
+		m.M[i*4 + j] = s;
+		m.M[j*4 + i] = -s;
+		m.M[j*4 + j] = c;
+		return m;
+	}
+
+	bool CopyName(char (&dest)[SceneFormat::MaxName], const std::string& name)
+	{
+		if(name.empty() || name.size() > SceneFormat::MaxName)
+			return false;
+
+		std::memset(dest, 0, sizeof(dest));
+		std::memcpy(dest, name.data(), name.size());
+		return true;
+	}
+
+	bool ParseLayer(const std::string& name, std::uint32_t& layer)
+	{
+		if(name == "opaque")
+			layer = SceneFormat::LayerOpaque;
+		else if(name == "alphatested")
+			layer = SceneFormat::LayerAlphaTested;
+		else if(name == "transparent")
+			layer = SceneFormat::LayerTransparent;
+		else
+			return false;
+
+		return true;
+	}
+
+	bool ReadTextScene(const std::string& path, std::vector<SourceChunk>& chunks)
+	{
+		std::ifstream fin(path);
+		if(!fin)
+		{
+			std::cerr << path << " not found." << std::endl;
+			return false;
+		}
+
+		// Transforms of the object being read; written out when the next one starts.
+		SceneFormat::Object* current = nullptr;
+		Matrix world = Identity();
+		Matrix texTransform = Identity();
+
+		auto finishObject = [&]()
+		{
+			if(current != nullptr)
+			{
+				std::memcpy(current->World, world.M, sizeof(world.M));
+				std::memcpy(current->TexTransform, texTransform.M, sizeof(texTransform.M));
+			}
+			current = nullptr;
+		};
+
+		std::string line;
+		int lineNumber = 0;
+		while(std::getline(fin, line))
+		{
+			++lineNumber;
+
+			size_t comment = line.find('#');
+			if(comment != std::string::npos)
+				line.erase(comment);
+
+			std::istringstream tokens(line);
+			std::string keyword;
+			if(!(tokens >> keyword))
+				continue;
+
+			bool valid = true;
+			if(keyword == "chunk")
+			{
+				finishObject();
+
+				SourceChunk chunk;
+				valid = static_cast<bool>(tokens >> chunk.Name) && chunk.Name.size() <= SceneFormat::MaxName;
+				for(const SourceChunk& other : chunks)
+				{
+					if(valid && other.Name == chunk.Name)
+					{
+						std::cerr << path << "(" << lineNumber << "): chunk \"" << chunk.Name << "\" is defined twice." << std::endl;
+						return false;
+					}
+				}
+
+				if(valid)
+					chunks.push_back(chunk);
+			}
+			else if(keyword == "object")
+			{
+				finishObject();
+
+				if(chunks.empty())
+				{
+					std::cerr << path << "(" << lineNumber << "): object outside of a chunk." << std::endl;
+					return false;
+				}
+
+				std::string geometry, submesh, material, layer = "opaque";
+				valid = static_cast<bool>(tokens >> geometry >> submesh >> material);
+				tokens >> layer;
+
+				SceneFormat::Object object;
+				std::memset(&object, 0, sizeof(object));
+				valid = valid &&
+					CopyName(object.Geometry, geometry) &&
+					CopyName(object.Submesh, submesh) &&
+					CopyName(object.Material, material) &&
+					ParseLayer(layer, object.Layer);
+
+				if(valid)
+				{
+					chunks.back().Objects.push_back(object);
+					current = &chunks.back().Objects.back();
+					world = Identity();
+					texTransform = Identity();
+				}
+			}
+			else if(current == nullptr)
+			{
+				std::cerr << path << "(" << lineNumber << "): \"" << keyword << "\" outside of an object." << std::endl;
+				return false;
+			}
+			else if(keyword == "scale" || keyword == "translate" || keyword == "texscale")
+			{
+				float x, y, z;
+				valid = static_cast<bool>(tokens >> x >> y >> z);
+				if(valid && keyword == "scale")
+					world = Multiply(world, Scaling(x, y, z));
+				else if(valid && keyword == "translate")
+					world = Multiply(world, Translation(x, y, z));
+				else if(valid)
+					texTransform = Multiply(texTransform, Scaling(x, y, z));
+			}
+			else if(keyword == "rotatex" || keyword == "rotatey" || keyword == "rotatez")
+			{
+				float angle;
+				valid = static_cast<bool>(tokens >> angle);
+				if(valid)
+					world = Multiply(world, Rotation(keyword[6] - 'x', angle));
+			}
+			else
+			{
+				valid = false;
+			}
+
+			std::string extra;
+			if(!valid || (tokens >> extra))
+			{
+				std::cerr << path << "(" << lineNumber << "): cannot parse \"" << line << "\"." << std::endl;
+				return false;
+			}
+		}
+
+		finishObject();
+		return true;
+	}
+
+	bool WriteBinaryScene(const std::string& path, const std::vector<SourceChunk>& chunks)
+	{
+		std::vector<SceneFormat::Chunk> table(chunks.size());
+
+		std::uint64_t offset = SceneFormat::AlignOffset(sizeof(SceneFormat::Header));
+		for(size_t i = 0; i < chunks.size(); ++i)
+		{
+			const std::vector<SceneFormat::Object>& objects = chunks[i].Objects;
+			const size_t byteSize = objects.size()*sizeof(SceneFormat::Object);
+
+			std::memset(&table[i], 0, sizeof(table[i]));
+			CopyName(table[i].Name, chunks[i].Name);
+			table[i].ObjectCount = (std::uint32_t)objects.size();
+			table[i].ObjectDataOffset = offset;
+			table[i].Hash = SceneFormat::HashBytes(objects.data(), byteSize);
+
+			offset = SceneFormat::AlignOffset(offset + byteSize);
+		}
+
+		SceneFormat::Header header;
+		std::memset(&header, 0, sizeof(header));
+		header.Magic = SceneFormat::Magic;
+		header.Version = SceneFormat::Version;
+		header.ChunkCount = (std::uint32_t)chunks.size();
+		header.ChunkTableOffset = offset;
+
+		const std::string tempPath = path + ".tmp";
+		{
+			std::ofstream fout(tempPath, std::ios::binary);
+			if(!fout)
+			{
+				std::cerr << "Cannot create " << tempPath << "." << std::endl;
+				return false;
+			}
+
+			auto padTo = [&fout](std::uint64_t target)
+			{
+				static const char zeros[SceneFormat::RecordAlignment] = {};
+				std::uint64_t pos = (std::uint64_t)fout.tellp();
+				if(target > pos)
+					fout.write(zeros, (std::streamsize)(target - pos));
+			};
+
+			fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			for(size_t i = 0; i < chunks.size(); ++i)
+			{
+				padTo(table[i].ObjectDataOffset);
+				fout.write(reinterpret_cast<const char*>(chunks[i].Objects.data()),
+					(std::streamsize)(chunks[i].Objects.size()*sizeof(SceneFormat::Object)));
+			}
+
+			padTo(header.ChunkTableOffset);
+			fout.write(reinterpret_cast<const char*>(table.data()), (std::streamsize)(table.size()*sizeof(SceneFormat::Chunk)));
+
+			if(!fout)
+			{
+				std::cerr << "Failed writing " << tempPath << "." << std::endl;
+				return false;
+			}
+		}
+
+		std::remove(path.c_str());
+		if(std::rename(tempPath.c_str(), path.c_str()) != 0)
+		{
+			std::cerr << "Cannot rename " << tempPath << " to " << path << "." << std::endl;
+			return false;
+		}
+
+		return true;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if(argc != 3)
+	{
+		std::cerr << "Usage: SceneCompiler <input.txt> <output.scene>" << std::endl;
+		return 1;
+	}
+
+	const std::string inputPath = argv[1];
+	const std::string outputPath = argv[2];
+
+	std::vector<SourceChunk> chunks;
+	if(!ReadTextScene(inputPath, chunks))
+		return 1;
+
+	if(!WriteBinaryScene(outputPath, chunks))
+		return 1;
+
+	size_t objectCount = 0;
+	for(const SourceChunk& chunk : chunks)
+	{
+		std::cout << chunk.Name << ": " << chunk.Objects.size() << " objects" << std::endl;
+		objectCount += chunk.Objects.size();
+	}
+
+	std::cout << outputPath << ": " << chunks.size() << " chunks, " << objectCount << " objects" << std::endl;
+	return 0;
+}
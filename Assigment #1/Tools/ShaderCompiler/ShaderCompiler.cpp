@@ -0,0 +1,71 @@
+//***************************************************************************************
+// ShaderCompiler.cpp
+//
+// Offline compiler that fills the precompiled shader cache (see Common/ShaderCache.h)
+// with every variant listed in ShaderVariants.h.
+//
+// Usage: ShaderCompiler [-debug]
+//
+// Run from the project directory, the same working directory the app uses.  By
+// default the blobs are compiled with the release flags; -debug builds the blobs
+// the debug configuration looks for.  Variants that are already cached are
+// skipped.
+//
+// ShaderCompiler.vcxproj builds it with Common/ShaderCache.cpp and Common/d3dUtil.cpp.
+// LitColumns references that project and runs the tool as the pre-build step of
+// its Release configuration.
+//***************************************************************************************
+
+#include "../../Common/ShaderCache.h"
+#include "../../Lab# 5/Project/ShaderVariants.h"
+
+#include <cstring>
+#include <iostream>
+
+#pragma comment(lib, "d3dcompiler.lib")
+#pragma comment(lib, "D3D12.lib")
+
+int main(int argc, char* argv[])
+{
+	UINT compileFlags = 0;
+	for(int i = 1; i < argc; ++i)
+	{
+		if(strcmp(argv[i], "-debug") == 0)
+		{
+			compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+		}
+		else
+		{
+			std::cerr << "Usage: ShaderCompiler [-debug]" << std::endl;
+			return 1;
+		}
+	}
+
+	try
+	{
+		ShaderCache cache(gShaderCacheDirectory, compileFlags, true);
+
+		for(const ShaderVariant& v : gShaderVariants)
+		{
+			UINT compiled = cache.GetCompileCount();
+			UINT storeFailures = cache.GetStoreFailureCount();
+			cache.GetShader(v.Filename, v.Defines, v.EntryPoint, v.Target);
+
+			const std::wstring blobPath = cache.GetBlobPath(v.Filename, v.Defines, v.EntryPoint, v.Target);
+			if(cache.GetStoreFailureCount() > storeFailures)
+			{
+				std::wcerr << L"could not write " << blobPath << std::endl;
+				return 1;
+			}
+
+			std::wcout << (cache.GetCompileCount() > compiled ? L"compiled " : L"cached   ") << blobPath << std::endl;
+		}
+	}
+	catch(DxException& e)
+	{
+		std::wcerr << e.ToString() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
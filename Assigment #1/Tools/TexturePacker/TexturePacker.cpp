@@ -0,0 +1,459 @@
+//***************************************************************************************
+// TexturePacker.cpp
+//
+// Offline packer that stacks DDS textures of the same format, size and mip count
+// into one Texture2DArray DDS, so the materials using them sample a single
+// texture with a slice index (MaterialData::DiffuseSlice) instead of one texture
+// each.
+//
+// Usage: TexturePacker <output.dds> <input.dds>... [-list]
+//
+// The slices are the inputs in command line order; inputs that are arrays
+// already contribute all of their slices.  The slice of every input is printed,
+// and that is the index to put in the material.  Inputs that do not match the
+// first one are rejected with their format, size and mip count, so incompatible
+// textures have to go into an array of their own.  With -list nothing is
+// written, the inputs are only described.
+//
+// Reads block compressed (BC1 to BC7) and 32-bit uncompressed textures with
+// either the legacy or the DX10 header; the output always has a DX10 header.
+// Cube maps and volume textures are not supported.
+//
+// Textures are packed into arrays rather than atlases: the materials tile their
+// textures with the texture transform, and an atlas would need its own wrapping
+// and mip padding in the shader.
+//
+// Only depends on the standard library so it builds with any C++11 compiler.
+//***************************************************************************************
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+	const std::uint32_t DdsMagic = 0x20534444; // "DDS "
+
+	const std::uint32_t DdsdCaps = 0x1;
+	const std::uint32_t DdsdHeight = 0x2;
+	const std::uint32_t DdsdWidth = 0x4;
+	const std::uint32_t DdsdPixelFormat = 0x1000;
+	const std::uint32_t DdsdMipMapCount = 0x20000;
+	const std::uint32_t DdsdLinearSize = 0x80000;
+
+	const std::uint32_t DdpfAlphaPixels = 0x1;
+	const std::uint32_t DdpfFourCC = 0x4;
+	const std::uint32_t DdpfRgb = 0x40;
+
+	const std::uint32_t DdsCapsComplex = 0x8;
+	const std::uint32_t DdsCapsTexture = 0x1000;
+	const std::uint32_t DdsCapsMipMap = 0x400000;
+
+	const std::uint32_t DdsCaps2CubeMap = 0x200;
+	const std::uint32_t DdsCaps2Volume = 0x200000;
+
+	const std::uint32_t ResourceDimensionTexture2D = 3;
+	const std::uint32_t ResourceMiscTextureCube = 0x4;
+
+	// DXGI_FORMAT values of the formats understood here.
+	enum DxgiFormat : std::uint32_t
+	{
+		FormatR8G8B8A8Unorm = 28,
+		FormatR8G8B8A8UnormSrgb = 29,
+		FormatBc1Unorm = 71,
+		FormatBc1UnormSrgb = 72,
+		FormatBc2Unorm = 74,
+		FormatBc2UnormSrgb = 75,
+		FormatBc3Unorm = 77,
+		FormatBc3UnormSrgb = 78,
+		FormatBc4Unorm = 80,
+		FormatBc4Snorm = 81,
+		FormatBc5Unorm = 83,
+		FormatBc5Snorm = 84,
+		FormatB8G8R8A8Unorm = 87,
+		FormatB8G8R8X8Unorm = 88,
+		FormatB8G8R8A8UnormSrgb = 91,
+		FormatB8G8R8X8UnormSrgb = 93,
+		FormatBc6hUf16 = 95,
+		FormatBc6hSf16 = 96,
+		FormatBc7Unorm = 98,
+		FormatBc7UnormSrgb = 99
+	};
+
+	struct DdsPixelFormat
+	{
+		std::uint32_t Size;
+		std::uint32_t Flags;
+		std::uint32_t FourCC;
+		std::uint32_t RgbBitCount;
+		std::uint32_t RBitMask;
+		std::uint32_t GBitMask;
+		std::uint32_t BBitMask;
+		std::uint32_t ABitMask;
+	};
+
+	struct DdsHeader
+	{
+		std::uint32_t Size;
+		std::uint32_t Flags;
+		std::uint32_t Height;
+		std::uint32_t Width;
+		std::uint32_t PitchOrLinearSize;
+		std::uint32_t Depth;
+		std::uint32_t MipMapCount;
+		std::uint32_t Reserved1[11];
+		DdsPixelFormat PixelFormat;
+		std::uint32_t Caps;
+		std::uint32_t Caps2;
+		std::uint32_t Caps3;
+		std::uint32_t Caps4;
+		std::uint32_t Reserved2;
+	};
+
+	struct DdsHeaderDx10
+	{
+		std::uint32_t DxgiFormat;
+		std::uint32_t ResourceDimension;
+		std::uint32_t MiscFlag;
+		std::uint32_t ArraySize;
+		std::uint32_t MiscFlags2;
+	};
+
+	static_assert(sizeof(DdsHeader) == 124, "DDS header size mismatch");
+	static_assert(sizeof(DdsHeaderDx10) == 20, "DDS DX10 header size mismatch");
+
+	std::uint32_t MakeFourCC(char a, char b, char c, char d)
+	{
+		return (std::uint32_t)(std::uint8_t)a | ((std::uint32_t)(std::uint8_t)b << 8) |
+			((std::uint32_t)(std::uint8_t)c << 16) | ((std::uint32_t)(std::uint8_t)d << 24);
+	}
+
+	struct SourceTexture
+	{
+		std::string Path;
+		std::uint32_t Format = 0;
+		std::uint32_t Width = 0;
+		std::uint32_t Height = 0;
+		std::uint32_t MipCount = 0;
+		std::uint32_t ArraySize = 0;
+
+		// Every slice's full mip chain in turn, as stored in the file.
+		std::vector<char> Data;
+	};
+
+	// Bytes per 4x4 block of a block compressed format, or 0.
+	std::uint32_t BlockBytes(std::uint32_t format)
+	{
+		switch(format)
+		{
+		case FormatBc1Unorm: case FormatBc1UnormSrgb:
+		case FormatBc4Unorm: case FormatBc4Snorm:
+			return 8;
+		case FormatBc2Unorm: case FormatBc2UnormSrgb:
+		case FormatBc3Unorm: case FormatBc3UnormSrgb:
+		case FormatBc5Unorm: case FormatBc5Snorm:
+		case FormatBc6hUf16: case FormatBc6hSf16:
+		case FormatBc7Unorm: case FormatBc7UnormSrgb:
+			return 16;
+		default:
+			return 0;
+		}
+	}
+
+	bool IsSupported(std::uint32_t format)
+	{
+		switch(format)
+		{
+		case FormatR8G8B8A8Unorm: case FormatR8G8B8A8UnormSrgb:
+		case FormatB8G8R8A8Unorm: case FormatB8G8R8X8Unorm:
+		case FormatB8G8R8A8UnormSrgb: case FormatB8G8R8X8UnormSrgb:
+			return true;
+		default:
+			return BlockBytes(format) != 0;
+		}
+	}
+
+	std::uint64_t SurfaceBytes(std::uint32_t format, std::uint32_t width, std::uint32_t height)
+	{
+		std::uint32_t blockBytes = BlockBytes(format);
+		if(blockBytes != 0)
+		{
+			std::uint64_t blocksWide = width > 0 ? (width + 3) / 4 : 0;
+			std::uint64_t blocksHigh = height > 0 ? (height + 3) / 4 : 0;
+			return blocksWide*blocksHigh*blockBytes;
+		}
+
+		return (std::uint64_t)width*height*4;
+	}
+
+	std::uint64_t SliceBytes(const SourceTexture& tex)
+	{
+		std::uint64_t bytes = 0;
+		std::uint32_t w = tex.Width;
+		std::uint32_t h = tex.Height;
+		for(std::uint32_t mip = 0; mip < tex.MipCount; ++mip)
+		{
+			bytes += SurfaceBytes(tex.Format, w, h);
+			w = w > 1 ? w / 2 : 1;
+			h = h > 1 ? h / 2 : 1;
+		}
+
+		return bytes;
+	}
+
+	// Format of a legacy header, or 0 if there is no DXGI equivalent.
+	std::uint32_t LegacyFormat(const DdsPixelFormat& pf)
+	{
+		if(pf.Flags & DdpfFourCC)
+		{
+			if(pf.FourCC == MakeFourCC('D', 'X', 'T', '1')) return FormatBc1Unorm;
+			if(pf.FourCC == MakeFourCC('D', 'X', 'T', '2')) return FormatBc2Unorm;
+			if(pf.FourCC == MakeFourCC('D', 'X', 'T', '3')) return FormatBc2Unorm;
+			if(pf.FourCC == MakeFourCC('D', 'X', 'T', '4')) return FormatBc3Unorm;
+			if(pf.FourCC == MakeFourCC('D', 'X', 'T', '5')) return FormatBc3Unorm;
+			if(pf.FourCC == MakeFourCC('A', 'T', 'I', '1')) return FormatBc4Unorm;
+			if(pf.FourCC == MakeFourCC('B', 'C', '4', 'U')) return FormatBc4Unorm;
+			if(pf.FourCC == MakeFourCC('B', 'C', '4', 'S')) return FormatBc4Snorm;
+			if(pf.FourCC == MakeFourCC('A', 'T', 'I', '2')) return FormatBc5Unorm;
+			if(pf.FourCC == MakeFourCC('B', 'C', '5', 'U')) return FormatBc5Unorm;
+			if(pf.FourCC == MakeFourCC('B', 'C', '5', 'S')) return FormatBc5Snorm;
+			return 0;
+		}
+
+		if((pf.Flags & DdpfRgb) && pf.RgbBitCount == 32)
+		{
+			if(pf.RBitMask == 0x000000ff && pf.GBitMask == 0x0000ff00 && pf.BBitMask == 0x00ff0000)
+				return FormatR8G8B8A8Unorm;
+			if(pf.RBitMask == 0x00ff0000 && pf.GBitMask == 0x0000ff00 && pf.BBitMask == 0x000000ff)
+				return (pf.Flags & DdpfAlphaPixels) ? FormatB8G8R8A8Unorm : FormatB8G8R8X8Unorm;
+		}
+
+		return 0;
+	}
+
+	bool ReadDds(const std::string& path, SourceTexture& tex)
+	{
+		std::ifstream fin(path, std::ios::binary);
+		if(!fin)
+		{
+			std::cerr << path << " not found." << std::endl;
+			return false;
+		}
+
+		std::uint32_t magic = 0;
+		DdsHeader header;
+		fin.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+		fin.read(reinterpret_cast<char*>(&header), sizeof(header));
+		if(!fin || magic != DdsMagic || header.Size != sizeof(DdsHeader) ||
+			header.PixelFormat.Size != sizeof(DdsPixelFormat))
+		{
+			std::cerr << path << " is not a DDS file." << std::endl;
+			return false;
+		}
+
+		tex.Path = path;
+		tex.Width = header.Width;
+		tex.Height = header.Height;
+		tex.MipCount = header.MipMapCount > 0 ? header.MipMapCount : 1;
+		tex.ArraySize = 1;
+
+		bool cube = (header.Caps2 & DdsCaps2CubeMap) != 0;
+		bool volume = (header.Caps2 & DdsCaps2Volume) != 0;
+
+		if((header.PixelFormat.Flags & DdpfFourCC) && header.PixelFormat.FourCC == MakeFourCC('D', 'X', '1', '0'))
+		{
+			DdsHeaderDx10 dx10;
+			fin.read(reinterpret_cast<char*>(&dx10), sizeof(dx10));
+			if(!fin)
+			{
+				std::cerr << path << " has a truncated DX10 header." << std::endl;
+				return false;
+			}
+
+			tex.Format = dx10.DxgiFormat;
+			tex.ArraySize = dx10.ArraySize > 0 ? dx10.ArraySize : 1;
+			cube = cube || (dx10.MiscFlag & ResourceMiscTextureCube) != 0;
+			volume = volume || dx10.ResourceDimension != ResourceDimensionTexture2D;
+		}
+		else
+		{
+			tex.Format = LegacyFormat(header.PixelFormat);
+		}
+
+		if(cube || volume)
+		{
+			std::cerr << path << " is a cube map or volume texture; only 2D textures can be packed." << std::endl;
+			return false;
+		}
+
+		if(!IsSupported(tex.Format))
+		{
+			std::cerr << path << " has an unsupported pixel format." << std::endl;
+			return false;
+		}
+
+		const std::uint64_t byteSize = SliceBytes(tex)*tex.ArraySize;
+		tex.Data.resize((size_t)byteSize);
+		fin.read(tex.Data.data(), (std::streamsize)byteSize);
+		if(!fin)
+		{
+			std::cerr << path << " is shorter than its mip chain." << std::endl;
+			return false;
+		}
+
+		return true;
+	}
+
+	void Describe(std::ostream& out, const SourceTexture& tex)
+	{
+		out << tex.Width << "x" << tex.Height << ", format " << tex.Format << ", " << tex.MipCount << " mips";
+		if(tex.ArraySize > 1)
+			out << ", " << tex.ArraySize << " slices";
+	}
+
+	bool WriteArray(const std::string& path, const std::vector<SourceTexture>& inputs)
+	{
+		const SourceTexture& first = inputs.front();
+
+		std::uint32_t arraySize = 0;
+		for(const SourceTexture& tex : inputs)
+			arraySize += tex.ArraySize;
+
+		DdsHeader header;
+		std::memset(&header, 0, sizeof(header));
+		header.Size = sizeof(DdsHeader);
+		header.Flags = DdsdCaps | DdsdHeight | DdsdWidth | DdsdPixelFormat | DdsdMipMapCount | DdsdLinearSize;
+		header.Height = first.Height;
+		header.Width = first.Width;
+		header.PitchOrLinearSize = (std::uint32_t)SurfaceBytes(first.Format, first.Width, first.Height);
+		header.MipMapCount = first.MipCount;
+		header.PixelFormat.Size = sizeof(DdsPixelFormat);
+		header.PixelFormat.Flags = DdpfFourCC;
+		header.PixelFormat.FourCC = MakeFourCC('D', 'X', '1', '0');
+		header.Caps = DdsCapsTexture | DdsCapsComplex | (first.MipCount > 1 ? DdsCapsMipMap : 0);
+
+		DdsHeaderDx10 dx10;
+		dx10.DxgiFormat = first.Format;
+		dx10.ResourceDimension = ResourceDimensionTexture2D;
+		dx10.MiscFlag = 0;
+		dx10.ArraySize = arraySize;
+		dx10.MiscFlags2 = 0;
+
+		std::ofstream fout(path, std::ios::binary);
+		if(!fout)
+		{
+			std::cerr << "Cannot create " << path << "." << std::endl;
+			return false;
+		}
+
+		fout.write(reinterpret_cast<const char*>(&DdsMagic), sizeof(DdsMagic));
+		fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		fout.write(reinterpret_cast<const char*>(&dx10), sizeof(dx10));
+
+		// DDS arrays store each slice's whole mip chain before the next slice,
+		// which is also how every input already lays out its data.
+		for(const SourceTexture& tex : inputs)
+			fout.write(tex.Data.data(), (std::streamsize)tex.Data.size());
+
+		if(!fout)
+		{
+			std::cerr << "Failed writing " << path << "." << std::endl;
+			return false;
+		}
+
+		return true;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<std::string> positional;
+	bool listOnly = false;
+	for(int i = 1; i < argc; ++i)
+	{
+		if(std::strcmp(argv[i], "-list") == 0)
+			listOnly = true;
+		else
+			positional.push_back(argv[i]);
+	}
+
+	if(positional.size() < (listOnly ? 1u : 2u))
+	{
+		std::cerr << "Usage: TexturePacker <output.dds> <input.dds>... [-list]" << std::endl;
+		return 1;
+	}
+
+	// With -list every argument is an input.
+	const std::string outputPath = listOnly ? std::string() : positional[0];
+	const size_t firstInput = listOnly ? 0 : 1;
+
+	std::vector<SourceTexture> inputs;
+	for(size_t i = firstInput; i < positional.size(); ++i)
+	{
+		SourceTexture tex;
+		if(!ReadDds(positional[i], tex))
+			return 1;
+
+		inputs.push_back(std::move(tex));
+	}
+
+	if(listOnly)
+	{
+		for(const SourceTexture& tex : inputs)
+		{
+			std::cout << tex.Path << ": ";
+			Describe(std::cout, tex);
+			std::cout << std::endl;
+		}
+
+		return 0;
+	}
+
+	// Every slice of an array shares the format and the mip chain.
+	const SourceTexture& first = inputs.front();
+	bool compatible = true;
+	for(const SourceTexture& tex : inputs)
+	{
+		if(tex.Format != first.Format || tex.Width != first.Width ||
+			tex.Height != first.Height || tex.MipCount != first.MipCount)
+		{
+			std::cerr << tex.Path << " (";
+			Describe(std::cerr, tex);
+			std::cerr << ") does not match " << first.Path << " (";
+			Describe(std::cerr, first);
+			std::cerr << ")." << std::endl;
+			compatible = false;
+		}
+	}
+
+	if(!compatible)
+		return 1;
+
+	if(!WriteArray(outputPath, inputs))
+		return 1;
+
+	std::uint32_t slice = 0;
+	for(const SourceTexture& tex : inputs)
+	{
+		std::cout << "slice " << slice;
+		if(tex.ArraySize > 1)
+			std::cout << "-" << slice + tex.ArraySize - 1;
+		std::cout << ": " << tex.Path << std::endl;
+		slice += tex.ArraySize;
+	}
+
+	std::cout << outputPath << ": ";
+	SourceTexture packed;
+	packed.Format = first.Format;
+	packed.Width = first.Width;
+	packed.Height = first.Height;
+	packed.MipCount = first.MipCount;
+	packed.ArraySize = slice;
+	Describe(std::cout, packed);
+	std::cout << std::endl;
+
+	return 0;
+}